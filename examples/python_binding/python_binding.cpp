@@ -1,4 +1,5 @@
 ﻿#include <stdexcept>
+#include <vector>
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
 #include <softcam/softcam.h>
@@ -23,12 +24,27 @@ class Camera
 
     ~Camera()
     {
-        Delete();
+        // Views of a locked frame keep the instance alive, so none is left.
+        scDeleteCamera(m_camera);
+        scDeleteCamera(m_orphan);
     }
 
     void Delete()
     {
-        scDeleteCamera(m_camera);
+        if (m_locked)
+        {
+            throw std::runtime_error("the frame is locked; call unlock_frame() first");
+        }
+        // The shared memory stays mapped while arrays from lock_frame() refer
+        // to it; the last one to go deletes the camera.
+        if (m_views > 0)
+        {
+            m_orphan = m_camera;
+        }
+        else
+        {
+            scDeleteCamera(m_camera);
+        }
         m_camera = nullptr;
     }
 
@@ -68,6 +84,59 @@ class Camera
         scSendFrame(m_camera, image.data(0, 0));
     }
 
+    py::array_t<uint8_t> LockFrame()
+    {
+        if (!m_camera)
+        {
+            throw std::runtime_error("the camera instance has been deleted");
+        }
+        void* bits = nullptr;
+        int stride = 0;
+        if (!scLockFrame(m_camera, &bits, &stride))
+        {
+            throw std::runtime_error("locking the frame buffer failed");
+        }
+        m_locked = true;
+
+        // The array is a view of the shared memory owned by the camera
+        // instance, which its base keeps alive.
+        py::capsule base(new FrameView(this), [](void* view) {
+            delete static_cast<FrameView*>(view);
+        });
+        py::array_t<uint8_t> image(
+            { (py::ssize_t)m_height, (py::ssize_t)m_width, (py::ssize_t)3 },
+            { (py::ssize_t)stride, (py::ssize_t)3, (py::ssize_t)1 },
+            static_cast<uint8_t*>(bits),
+            base
+        );
+        m_lockedImages.emplace_back(image);
+        return image;
+    }
+
+    void UnlockFrame()
+    {
+        if (!m_camera)
+        {
+            throw std::runtime_error("the camera instance has been deleted");
+        }
+
+        // Receivers read the frame from now on; the arrays can no longer be
+        // written (views taken from them can, and must not be).
+        for (auto& ref : m_lockedImages)
+        {
+            py::object image = ref();
+            if (!image.is_none())
+            {
+                image.attr("flags").attr("writeable") = false;
+            }
+        }
+        m_lockedImages.clear();
+        m_locked = false;
+
+        py::gil_scoped_release release;
+        scUnlockFrame(m_camera);
+    }
+
     bool WaitForConnection(float timeout = 0.0f)
     {
         if (!m_camera)
@@ -89,16 +158,102 @@ class Camera
         return scIsConnected(m_camera);
     }
 
+    void SetSendMode(int mode)
+    {
+        if (!m_camera)
+        {
+            throw std::runtime_error("the camera instance has been deleted");
+        }
+
+        // Waiting frames are delivered before the mode changes.
+        bool ok;
+        {
+            py::gil_scoped_release release;
+            ok = scSetSendMode(m_camera, mode);
+        }
+        if (!ok)
+        {
+            throw std::invalid_argument("unknown send mode: " + std::to_string(mode));
+        }
+    }
+
+    long long DroppedFrames()
+    {
+        if (!m_camera)
+        {
+            throw std::runtime_error("the camera instance has been deleted");
+        }
+
+        return scGetDroppedFrames(m_camera);
+    }
+
  private:
+    // Base object of the arrays returned by LockFrame()
+    class FrameView
+    {
+     public:
+        explicit FrameView(Camera* camera)
+            : m_camera(camera), m_owner(py::cast(camera, py::return_value_policy::reference))
+        {
+            m_camera->m_views++;
+        }
+        ~FrameView()
+        {
+            if (--m_camera->m_views == 0 && m_camera->m_orphan)
+            {
+                scDeleteCamera(m_camera->m_orphan);
+                m_camera->m_orphan = nullptr;
+            }
+        }
+
+     private:
+        Camera*     m_camera;
+        py::object  m_owner;
+    };
+
     scCamera    m_camera{};
     int         m_width = 0;
     int         m_height = 0;
+    bool        m_locked = false;
+    int         m_views = 0;                // live FrameView objects
+    scCamera    m_orphan{};                 // deleted, but still viewed
+    std::vector<py::weakref> m_lockedImages;
+};
+
+
+// Context manager which locks the frame on entry and unlocks it on exit.
+class LockedFrame
+{
+ public:
+    explicit LockedFrame(Camera& camera) : m_camera(camera) {}
+
+    py::array_t<uint8_t> Enter()
+    {
+        return m_camera.LockFrame();
+    }
+
+    void Exit(py::args)
+    {
+        m_camera.UnlockFrame();
+    }
+
+ private:
+    Camera& m_camera;
 };
 
 
 PYBIND11_MODULE(softcam, m) {
     m.doc() = "Softcam";
 
+    m.attr("SEND_MODE_BLOCKING") = (int)scSendMode_Blocking;
+    m.attr("SEND_MODE_ASYNC_DROP_OLDEST") = (int)scSendMode_AsyncDropOldest;
+    m.attr("SEND_MODE_ASYNC_DROP_NEWEST") = (int)scSendMode_AsyncDropNewest;
+
+    py::class_<LockedFrame>(m, "locked_frame")
+        .def("__enter__", &LockedFrame::Enter)
+        .def("__exit__", &LockedFrame::Exit)
+    ;
+
     py::class_<Camera>(m, "camera")
         .def(
             py::init<int, int, float>(),
@@ -115,6 +270,19 @@ PYBIND11_MODULE(softcam, m) {
             &Camera::SendFrame,
             py::arg("image")
         )
+        .def(
+            "lock_frame",
+            &Camera::LockFrame
+        )
+        .def(
+            "unlock_frame",
+            &Camera::UnlockFrame
+        )
+        .def(
+            "locked_frame",
+            [](Camera& camera) { return LockedFrame(camera); },
+            py::keep_alive<0, 1>()
+        )
         .def(
             "wait_for_connection",
             &Camera::WaitForConnection,
@@ -124,5 +292,14 @@ PYBIND11_MODULE(softcam, m) {
             "is_connected",
             &Camera::IsConnected
         )
+        .def(
+            "set_send_mode",
+            &Camera::SetSendMode,
+            py::arg("mode")
+        )
+        .def(
+            "dropped_frames",
+            &Camera::DroppedFrames
+        )
     ;
 }
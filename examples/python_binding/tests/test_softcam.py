@@ -104,6 +104,100 @@ def test_send_frame_use_after_free():
     assert e.value.args == ('the camera instance has been deleted',)
 
 
+def test_lock_frame_normalcase():
+    cam = softcam.camera(320, 240, 60)
+    img = cam.lock_frame()
+    assert img.shape == (240, 320, 3)
+    assert img.dtype == np.uint8
+    assert img.flags.writeable
+    img[:] = 128
+    cam.unlock_frame()
+    cam.delete()
+
+
+def test_lock_frame_twice_returns_same_area():
+    cam = softcam.camera(320, 240, 60)
+    img1 = cam.lock_frame()
+    img2 = cam.lock_frame()
+    assert img1.ctypes.data == img2.ctypes.data
+    cam.unlock_frame()
+    cam.delete()
+
+
+def test_unlock_frame_without_lock():
+    cam = softcam.camera(320, 240, 60)
+    cam.unlock_frame() # no effect
+    cam.delete()
+
+
+def test_lock_frame_use_after_free():
+    cam = softcam.camera(320, 240, 60)
+    cam.delete()
+    with pytest.raises(RuntimeError) as e:
+        cam.lock_frame()
+    assert e.value.args == ('the camera instance has been deleted',)
+    with pytest.raises(RuntimeError) as e:
+        cam.unlock_frame()
+    assert e.value.args == ('the camera instance has been deleted',)
+
+
+def test_unlock_frame_makes_array_readonly():
+    cam = softcam.camera(320, 240, 60)
+    img = cam.lock_frame()
+    img[:] = 128
+    cam.unlock_frame()
+    assert not img.flags.writeable
+    with pytest.raises(ValueError):
+        img[:] = 0
+    cam.delete()
+
+
+def test_locked_frame_context_manager():
+    cam = softcam.camera(320, 240, 60)
+    with cam.locked_frame() as img:
+        assert img.shape == (240, 320, 3)
+        assert img.flags.writeable
+        img[:] = 128
+    assert not img.flags.writeable
+    cam.delete()
+
+
+def test_delete_refuses_while_locked():
+    cam = softcam.camera(320, 240, 60)
+    cam.lock_frame()
+    with pytest.raises(RuntimeError) as e:
+        cam.delete()
+    assert e.value.args == ('the frame is locked; call unlock_frame() first',)
+    cam.unlock_frame()
+    cam.delete()
+
+
+def test_locked_array_outlives_delete():
+    cam = softcam.camera(320, 240, 60)
+    img = cam.lock_frame()
+    img[:] = 128
+    cam.unlock_frame()
+    cam.delete()
+    # The shared memory stays mapped, and the camera registered, until the
+    # array is gone
+    assert img[0, 0, 0] == 128
+    assert img.sum() == 128 * 240 * 320 * 3
+    with pytest.raises(RuntimeError):
+        softcam.camera(320, 240, 60)
+    del img
+    cam = softcam.camera(320, 240, 60)
+    cam.delete()
+
+
+def test_locked_array_keeps_camera_alive():
+    img = softcam.camera(320, 240, 60).lock_frame()
+    img[:] = 128 # the camera object has no other reference
+    assert img[239, 319, 2] == 128
+    del img
+    cam = softcam.camera(320, 240, 60)
+    cam.delete()
+
+
 def test_wait_for_connection():
     cam = softcam.camera(320, 240, 60)
     assert cam.wait_for_connection(0.01) == False
@@ -130,3 +224,26 @@ def test_is_connected_use_after_free():
     with pytest.raises(RuntimeError) as e:
         assert cam.is_connected()
     assert e.value.args == ('the camera instance has been deleted',)
+
+
+def test_set_send_mode():
+    cam = softcam.camera(320, 240, 60)
+    cam.set_send_mode(softcam.SEND_MODE_ASYNC_DROP_OLDEST)
+    for _ in range(3):
+        cam.send_frame(np.zeros((240, 320, 3), dtype=np.uint8))
+    cam.set_send_mode(softcam.SEND_MODE_BLOCKING)
+    assert cam.dropped_frames() >= 0
+    with pytest.raises(ValueError):
+        cam.set_send_mode(3)
+    cam.delete()
+
+
+def test_set_send_mode_use_after_free():
+    cam = softcam.camera(320, 240, 60)
+    cam.delete()
+    with pytest.raises(RuntimeError) as e:
+        cam.set_send_mode(softcam.SEND_MODE_ASYNC_DROP_OLDEST)
+    assert e.value.args == ('the camera instance has been deleted',)
+    with pytest.raises(RuntimeError) as e:
+        cam.dropped_frames()
+    assert e.value.args == ('the camera instance has been deleted',)
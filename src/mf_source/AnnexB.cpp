@@ -0,0 +1,138 @@
+#include "AnnexB.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLUXMIC_ANNEXB_SSE2 1
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace FluxMic {
+
+size_t FindStartCodeScalar(const uint8_t* data, size_t size, size_t from) {
+    for (size_t i = from; i + 2 < size; i++) {
+        if (data[i + 2] > 1) {
+            i += 2;     // none of the three bytes can start a start code here
+            continue;
+        }
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            return i;
+        }
+    }
+    return size;
+}
+
+#if FLUXMIC_ANNEXB_SSE2
+
+static int CountTrailingZeros32(uint32_t x) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return (int)index;
+#else
+    return __builtin_ctz(x);
+#endif
+}
+
+// Compares 16 candidate positions at a time: bytes i, i + 1 and i + 2 of
+// each are loaded as three overlapping vectors, so a set bit of the mask is
+// a whole 00 00 01.
+size_t FindStartCode(const uint8_t* data, size_t size, size_t from) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    size_t i = from;
+    while (i + 18 <= size) {
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(data + i + 1));
+        __m128i b2 = _mm_loadu_si128((const __m128i*)(data + i + 2));
+        __m128i match = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+                                      _mm_cmpeq_epi8(b2, one));
+        int mask = _mm_movemask_epi8(match);
+        if (mask != 0) return i + CountTrailingZeros32((uint32_t)mask);
+        i += 16;
+    }
+    return FindStartCodeScalar(data, size, i);
+}
+
+#else
+
+size_t FindStartCode(const uint8_t* data, size_t size, size_t from) {
+    return FindStartCodeScalar(data, size, from);
+}
+
+#endif
+
+bool NalScanner::Next(NalUnit& nal) {
+    while (m_pos < m_size) {
+        size_t start = FindStartCode(m_data, m_size, m_pos);
+        if (start == m_size) {
+            m_pos = m_size;
+            return false;
+        }
+        size_t begin = start + 3;
+        size_t next = FindStartCode(m_data, m_size, begin);
+        m_pos = next;
+
+        // Zero bytes before the next start code are its leading zero
+        // (4-byte form) or trailing_zero_8bits, not part of this NAL unit.
+        size_t end = next;
+        while (end > begin && m_data[end - 1] == 0) {
+            end--;
+        }
+        if (end == begin) continue;
+
+        nal.data = m_data + begin;
+        nal.size = end - begin;
+        nal.type = m_data[begin] & 0x1F;
+        nal.refIdc = (m_data[begin] >> 5) & 0x03;
+        return true;
+    }
+    return false;
+}
+
+AccessUnitInfo ScanAccessUnit(const uint8_t* data, size_t size) {
+    AccessUnitInfo info;
+    if (!data) return info;
+
+    NalScanner scanner(data, size);
+    NalUnit nal;
+    while (scanner.Next(nal)) {
+        switch (nal.type) {
+        case kNalSlice:
+        case kNalSliceDpa:
+        case kNalSliceIdr:
+            info.hasPicture = true;
+            if (nal.type == kNalSliceIdr) info.isIdr = true;
+            if (nal.refIdc != 0) info.isReference = true;
+            break;
+        case kNalSps:
+        case kNalPps:
+            info.hasParameterSets = true;
+            break;
+        default:
+            break;
+        }
+    }
+    return info;
+}
+
+size_t ExtractParameterSets(const uint8_t* data, size_t size, uint8_t* out) {
+    if (!data) return 0;
+
+    size_t written = 0;
+    NalScanner scanner(data, size);
+    NalUnit nal;
+    while (scanner.Next(nal)) {
+        if (nal.type != kNalSps && nal.type != kNalPps) continue;
+        out[written++] = 0;
+        out[written++] = 0;
+        out[written++] = 1;
+        memcpy(out + written, nal.data, nal.size);
+        written += nal.size;
+    }
+    return written;
+}
+
+} // namespace FluxMic
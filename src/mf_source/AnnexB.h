@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace FluxMic {
+
+/// H.264 NAL unit types we look at (ITU-T H.264 Table 7-1).
+enum NalUnitType : uint8_t {
+    kNalSlice         = 1,   // coded slice of a non-IDR picture
+    kNalSliceDpa      = 2,   // slice data partition A (B and C carry no header)
+    kNalSliceIdr      = 5,   // coded slice of an IDR picture
+    kNalSei           = 6,
+    kNalSps           = 7,
+    kNalPps           = 8,
+    kNalAud           = 9,
+    kNalEndOfSequence = 10,
+    kNalEndOfStream   = 11,
+};
+
+/// Index of the first 00 00 01 at or after `from`, or `size` if there is none.
+/// Uses SSE2 where the build targets it; FindStartCodeScalar() is the plain
+/// version, for tests and benchmarks to compare with.
+size_t FindStartCode(const uint8_t* data, size_t size, size_t from);
+size_t FindStartCodeScalar(const uint8_t* data, size_t size, size_t from);
+
+/// One NAL unit found in an Annex B byte stream.
+/// `data` points at the NAL header byte, after the start code.
+struct NalUnit {
+    const uint8_t* data;
+    size_t size;
+    uint8_t type;      // nal_unit_type
+    uint8_t refIdc;    // nal_ref_idc; 0 means no other picture references it
+};
+
+/// Iterates over the NAL units of an Annex B byte stream
+/// (3- or 4-byte 0x000001 start codes). Nothing is copied or allocated.
+class NalScanner {
+public:
+    NalScanner(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+    /// Find the next NAL unit. Returns false at the end of the data.
+    bool Next(NalUnit& nal);
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_pos = 0;
+};
+
+/// What one pipe message (one access unit) contains, as far as deciding
+/// whether it may be skipped is concerned.
+struct AccessUnitInfo {
+    bool hasPicture = false;        // has at least one coded slice
+    bool isIdr = false;             // has IDR slices; decodable without earlier frames
+    bool isReference = false;       // has slices with nal_ref_idc != 0
+    bool hasParameterSets = false;  // has SPS or PPS
+};
+
+/// Classify an Annex B access unit from its NAL headers.
+AccessUnitInfo ScanAccessUnit(const uint8_t* data, size_t size);
+
+/// Copy only the SPS and PPS NAL units of an Annex B access unit to `out`,
+/// each after a 3-byte start code, so that `out` needs at most `size` bytes.
+/// Returns the number of bytes written.
+size_t ExtractParameterSets(const uint8_t* data, size_t size, uint8_t* out);
+
+} // namespace FluxMic
@@ -0,0 +1,39 @@
+#include "BacklogPolicy.h"
+
+namespace FluxMic {
+
+void PlanBacklog(const AccessUnitInfo* units, size_t count, size_t skipThreshold,
+                 BacklogAction* actions) {
+    if (count == 0) return;
+
+    size_t first = 0;
+    if (count > skipThreshold) {
+        for (size_t i = count; i-- > 0; ) {
+            if (units[i].isIdr) {
+                first = i;
+                break;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const AccessUnitInfo& unit = units[i];
+        bool decode;
+        if (i == count - 1) {
+            decode = true;
+        } else if (i < first) {
+            // The decoder still needs parameter sets the IDR may not repeat,
+            // but not a picture whose references were skipped
+            if (unit.hasParameterSets && unit.hasPicture) {
+                actions[i] = BacklogAction::ParameterSets;
+                continue;
+            }
+            decode = unit.hasParameterSets;
+        } else {
+            decode = unit.isReference || unit.hasParameterSets || !unit.hasPicture;
+        }
+        actions[i] = decode ? BacklogAction::Decode : BacklogAction::Skip;
+    }
+}
+
+} // namespace FluxMic
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+
+#include "AnnexB.h"
+
+namespace FluxMic {
+
+/// What to do with one message of the backlog found by RequestSample().
+enum class BacklogAction {
+    Decode,         // feed to the decoder
+    Skip,           // safe to drop: no later frame we decode depends on it
+    ParameterSets,  // feed only its SPS/PPS (see ExtractParameterSets())
+};
+
+/// Frames queued beyond this many are not worth decoding one by one if a
+/// newer IDR frame is among them.
+static const size_t kBacklogSkipThreshold = 4;
+
+/// Decide which of `count` queued access units (oldest first) must be fed to
+/// the decoder so that the newest one decodes correctly.
+///
+/// Every reference frame is decoded, since dropping one corrupts the picture
+/// until the next IDR. Only these are skipped:
+/// - Non-reference pictures other than the newest; nothing refers to them.
+/// - If the backlog is longer than `skipThreshold`, everything before the
+///   newest IDR frame. Of messages carrying SPS/PPS there, only those are
+///   fed, without the picture, whose references are skipped.
+///
+/// The newest access unit is always decoded.
+void PlanBacklog(const AccessUnitInfo* units, size_t count, size_t skipThreshold,
+                 BacklogAction* actions);
+
+} // namespace FluxMic
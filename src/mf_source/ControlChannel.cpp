@@ -0,0 +1,86 @@
+#include "ControlChannel.h"
+
+namespace FluxMic {
+
+ControlChannel::ControlChannel(uint32_t minRequestIntervalMs)
+    : m_minRequestIntervalMs(minRequestIntervalMs) {
+}
+
+void ControlChannel::Attach(std::unique_ptr<ControlTransport> transport, uint64_t nowMs) {
+    m_transport = std::move(transport);
+    if (!m_transport) return;
+
+    // The app can't know what happened while nobody was connected
+    m_requestOutstanding = false;
+    if (!Send(MakeControlMessage(m_consumerActive ? kControlConsumerActive : kControlConsumerIdle))) return;
+    RequestKeyframe(kKeyframeConnect, 0, nowMs);
+}
+
+void ControlChannel::Detach() {
+    m_transport.reset();
+}
+
+void ControlChannel::SetConsumerActive(bool active) {
+    if (active == m_consumerActive) return;
+    m_consumerActive = active;
+    Send(MakeControlMessage(active ? kControlConsumerActive : kControlConsumerIdle));
+}
+
+void ControlChannel::OnFeedConnected(uint64_t nowMs) {
+    m_haveSequence = false;
+    RequestKeyframe(kKeyframeConnect, 0, nowMs);
+}
+
+void ControlChannel::OnFrameReceived(uint32_t sequence, bool isIdr, uint64_t nowMs) {
+    bool gap = m_haveSequence && sequence != m_lastSequence + 1;
+    uint32_t missing = m_lastSequence + 1;
+    m_haveSequence = true;
+    m_lastSequence = sequence;
+
+    if (isIdr) {
+        // Decoding starts over here, whatever was lost or asked for before
+        m_pendingReason = kKeyframeNone;
+        m_requestOutstanding = false;
+        return;
+    }
+    if (gap) RequestKeyframe(kKeyframeSequenceGap, missing, nowMs);
+}
+
+void ControlChannel::OnDecodeError(uint32_t sequence, uint64_t nowMs) {
+    // Until the keyframe comes, every frame references the broken picture
+    if (m_pendingReason != kKeyframeNone) return;
+    if (m_requestOutstanding && nowMs - m_lastRequestMs < m_minRequestIntervalMs) return;
+    Send(MakeControlMessage(kControlDecodeError, sequence));
+    RequestKeyframe(kKeyframeDecodeError, sequence, nowMs);
+}
+
+void ControlChannel::RequestKeyframe(KeyframeReason reason, uint32_t sequence, uint64_t nowMs) {
+    if (m_pendingReason == kKeyframeNone) {
+        m_pendingReason = reason;
+        m_pendingSequence = sequence;
+    }
+    Poll(nowMs);
+}
+
+void ControlChannel::Poll(uint64_t nowMs) {
+    if (m_pendingReason == kKeyframeNone || !m_transport) return;
+    if (m_requestOutstanding && nowMs - m_lastRequestMs < m_minRequestIntervalMs) return;
+
+    if (!Send(MakeControlMessage(kControlRequestKeyframe, m_pendingSequence, m_pendingReason))) return;
+    m_keyframeRequests++;
+    m_requestOutstanding = true;
+    m_lastRequestMs = nowMs;
+    m_pendingReason = kKeyframeNone;
+}
+
+bool ControlChannel::Send(const ControlMessage& message) {
+    if (!m_transport) return false;
+    if (m_transport->WriteMessage(reinterpret_cast<const uint8_t*>(&message), sizeof(message))) {
+        return true;
+    }
+    m_sendFailures++;
+    m_transport.reset();
+    return false;
+}
+
+} // namespace FluxMic
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "ControlMessage.h"
+
+namespace FluxMic {
+
+/// Writing end of a message-mode connection to the control server, such as
+/// the control pipe.
+class ControlTransport {
+public:
+    virtual ~ControlTransport() = default;
+
+    /// Write one whole message. Returns false if the server has gone away
+    /// or didn't take the message in time; the transport is then dropped.
+    virtual bool WriteMessage(const uint8_t* data, size_t size) = 0;
+};
+
+/// The MF source's side of the control channel. It tells the app when a
+/// consumer is streaming and asks it for a keyframe whenever the decoder
+/// can't produce a correct picture without one: on connecting, after lost
+/// frames and after decode errors.
+///
+/// Keyframe requests are not repeated while one is outstanding, i.e. until
+/// an IDR frame arrives or `minRequestIntervalMs` has passed; events in
+/// between leave a request pending, which Poll() sends once allowed.
+///
+/// Not thread-safe apart from the counters; the stream uses it from the
+/// decode worker only. Times are in milliseconds from any steady clock.
+class ControlChannel {
+public:
+    static const uint32_t kDefaultMinRequestIntervalMs = 1000;
+
+    explicit ControlChannel(uint32_t minRequestIntervalMs = kDefaultMinRequestIntervalMs);
+
+    // Non-copyable
+    ControlChannel(const ControlChannel&) = delete;
+    ControlChannel& operator=(const ControlChannel&) = delete;
+
+    /// Start sending to `transport`: the consumer state first, then a
+    /// keyframe request (the pending one, or kKeyframeConnect).
+    void Attach(std::unique_ptr<ControlTransport> transport, uint64_t nowMs);
+
+    /// Drop the transport. Events are still tracked, and a request they
+    /// leave pending is sent on the next Attach().
+    void Detach();
+
+    bool IsAttached() const { return m_transport != nullptr; }
+
+    /// Sends kControlConsumerActive or kControlConsumerIdle when it changes.
+    void SetConsumerActive(bool active);
+
+    /// A new connection to the video feed: sequence numbers start over and
+    /// a keyframe is needed.
+    void OnFeedConnected(uint64_t nowMs);
+
+    /// Every frame received from the video feed, in order, whether or not it
+    /// is decoded. A jump in the sequence numbers requests a keyframe unless
+    /// the frame is an IDR frame, which also answers any outstanding request.
+    void OnFrameReceived(uint32_t sequence, bool isIdr, uint64_t nowMs);
+
+    /// The frame `sequence` failed to decode. Reported, with a keyframe
+    /// request, unless a keyframe request is pending or still outstanding:
+    /// the frames after a lost or broken one fail as well until the keyframe.
+    void OnDecodeError(uint32_t sequence, uint64_t nowMs);
+
+    /// Send the pending keyframe request if the last one is no longer
+    /// outstanding. Call regularly, e.g. once per decode loop.
+    void Poll(uint64_t nowMs);
+
+    /// Keyframe requests sent, and messages which could not be sent.
+    /// May be read from any thread.
+    uint64_t KeyframeRequests() const { return m_keyframeRequests.load(std::memory_order_relaxed); }
+    uint64_t SendFailures() const { return m_sendFailures.load(std::memory_order_relaxed); }
+
+private:
+    void RequestKeyframe(KeyframeReason reason, uint32_t sequence, uint64_t nowMs);
+    bool Send(const ControlMessage& message);
+
+    const uint32_t m_minRequestIntervalMs;
+    std::unique_ptr<ControlTransport> m_transport;
+    bool m_consumerActive = false;
+
+    // Sequence number tracking of the video feed
+    bool m_haveSequence = false;
+    uint32_t m_lastSequence = 0;
+
+    // Keyframe requests; the first reason since the last request is kept
+    KeyframeReason m_pendingReason = kKeyframeNone;
+    uint32_t m_pendingSequence = 0;
+    bool m_requestOutstanding = false;
+    uint64_t m_lastRequestMs = 0;
+
+    std::atomic<uint64_t> m_keyframeRequests{0};
+    std::atomic<uint64_t> m_sendFailures{0};
+};
+
+} // namespace FluxMic
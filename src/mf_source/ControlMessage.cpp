@@ -0,0 +1,38 @@
+#include "ControlMessage.h"
+#include <cstring>
+
+namespace FluxMic {
+
+ControlMessage MakeControlMessage(ControlMessageType type, uint32_t sequence, KeyframeReason reason) {
+    ControlMessage message = {};
+    message.version = kControlProtocolVersion;
+    message.type = type;
+    message.sequence = sequence;
+    message.reason = reason;
+    return message;
+}
+
+bool ParseControlMessage(const uint8_t* data, size_t size, ControlMessage& message) {
+    if (!data || size != kControlMessageSize) return false;
+
+    ControlMessage msg;
+    memcpy(&msg, data, sizeof(ControlMessage));
+
+    if (msg.version != kControlProtocolVersion) return false;
+    switch (msg.type) {
+    case kControlRequestKeyframe:
+        if (msg.reason == kKeyframeNone || msg.reason > kKeyframeDecodeError) return false;
+        break;
+    case kControlConsumerActive:
+    case kControlConsumerIdle:
+    case kControlDecodeError:
+        break;
+    default:
+        return false;
+    }
+
+    message = msg;
+    return true;
+}
+
+} // namespace FluxMic
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// Wire format of the control channel from the MF source to the FluxMic app.
+///
+/// The app creates a duplex message-mode pipe next to the video feed (see
+/// ControlPipe.h); each message is one fixed-size record:
+///   Bytes 0-1:    version     (uint16_t LE, kControlProtocolVersion)
+///   Bytes 2-3:    type        (uint16_t LE, ControlMessageType)
+///   Bytes 4-7:    sequence    (uint32_t LE, a frame sequence number, see below)
+///   Bytes 8-11:   reason      (uint32_t LE, KeyframeReason of a keyframe request)
+///   Bytes 12-15:  reserved    (zero)
+///
+/// Nothing here depends on Windows, so the codec can be tested on any platform.
+
+namespace FluxMic {
+
+static const uint16_t kControlProtocolVersion = 1;
+static const size_t kControlMessageSize = 16;
+
+enum ControlMessageType : uint16_t {
+    /// Send an IDR frame as soon as possible. `sequence` is the first frame
+    /// which is missing or couldn't be decoded, 0 when connecting.
+    kControlRequestKeyframe = 1,
+    /// A consumer started or stopped streaming from the camera, so the app
+    /// may start or pause encoding.
+    kControlConsumerActive  = 2,
+    kControlConsumerIdle    = 3,
+    /// The frame `sequence` failed to decode, for the app's log.
+    kControlDecodeError     = 4,
+};
+
+/// Why a keyframe is requested
+enum KeyframeReason : uint32_t {
+    kKeyframeNone        = 0,
+    kKeyframeConnect     = 1,   // the source connected, or reconnected, mid-stream
+    kKeyframeSequenceGap = 2,   // frames were lost between the app and the decoder
+    kKeyframeDecodeError = 3,   // the decoder failed on a frame
+};
+
+#pragma pack(push, 1)
+struct ControlMessage {
+    uint16_t version;
+    uint16_t type;
+    uint32_t sequence;
+    uint32_t reason;
+    uint32_t reserved;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(ControlMessage) == kControlMessageSize, "ControlMessage must be 16 bytes");
+
+/// A message of the current version.
+ControlMessage MakeControlMessage(ControlMessageType type, uint32_t sequence = 0,
+                                  KeyframeReason reason = kKeyframeNone);
+
+/// Check that `size` bytes form one control message of a known version and
+/// type, and copy it out. Returns false otherwise.
+bool ParseControlMessage(const uint8_t* data, size_t size, ControlMessage& message);
+
+} // namespace FluxMic
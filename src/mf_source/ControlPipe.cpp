@@ -0,0 +1,103 @@
+#include "ControlPipe.h"
+#include <cstdio>
+
+// Debug trace helper (includes PID)
+static void ControlDbgLog(const char* fmt, ...) {
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    OutputDebugStringA(buf);
+    static bool dirCreated = false;
+    if (!dirCreated) {
+        CreateDirectoryA("C:\\ProgramData\\FluxMic", nullptr);
+        dirCreated = true;
+    }
+    FILE* f = fopen("C:\\ProgramData\\FluxMic\\mf_cam_debug.log", "a");
+    if (f) {
+        char prefix[64];
+        snprintf(prefix, sizeof(prefix), "[PID=%lu][Control] ", GetCurrentProcessId());
+        fprintf(f, "%s%s", prefix, buf);
+        fflush(f);
+        fclose(f);
+    }
+}
+
+namespace FluxMic {
+
+namespace {
+
+/// Message-mode pipe written with overlapped I/O, so that a write the app
+/// doesn't take can be abandoned. Owns the pipe handle.
+class PipeControlTransport : public ControlTransport {
+public:
+    explicit PipeControlTransport(HANDLE hPipe)
+        : m_hPipe(hPipe), m_ioEvent(CreateEventW(nullptr, TRUE, FALSE, nullptr)) {
+    }
+
+    ~PipeControlTransport() override {
+        CloseHandle(m_hPipe);
+        if (m_ioEvent) CloseHandle(m_ioEvent);
+    }
+
+    bool WriteMessage(const uint8_t* data, size_t size) override {
+        if (!m_ioEvent) return false;
+
+        OVERLAPPED ov = {};
+        ov.hEvent = m_ioEvent;
+        ResetEvent(m_ioEvent);
+
+        BOOL ok = WriteFile(m_hPipe, data, (DWORD)size, nullptr, &ov);
+        DWORD err = ok ? ERROR_SUCCESS : GetLastError();
+        if (!ok && err != ERROR_IO_PENDING) {
+            ControlDbgLog("WriteMessage: WriteFile failed, error=%lu\n", err);
+            return false;
+        }
+        if (err == ERROR_IO_PENDING
+            && WaitForSingleObject(m_ioEvent, kControlWriteTimeoutMs) != WAIT_OBJECT_0) {
+            CancelIoEx(m_hPipe, &ov);
+        }
+        // The OVERLAPPED must not go out of scope before the I/O completes.
+        DWORD written = 0;
+        if (!GetOverlappedResult(m_hPipe, &ov, &written, TRUE)) {
+            ControlDbgLog("WriteMessage: write failed or timed out, error=%lu\n", GetLastError());
+            return false;
+        }
+        return written == size;
+    }
+
+private:
+    HANDLE m_hPipe;
+    HANDLE m_ioEvent;
+};
+
+} // namespace
+
+std::unique_ptr<ControlTransport> OpenControlPipe() {
+    // GENERIC_READ as well, since the server side is duplex
+    HANDLE hPipe = CreateFileW(
+        kControlPipeName,
+        GENERIC_READ | GENERIC_WRITE,
+        0,              // no sharing
+        nullptr,        // default security (pipe server sets the DACL)
+        OPEN_EXISTING,
+        FILE_FLAG_OVERLAPPED,  // writes can time out
+        nullptr
+    );
+    if (hPipe == INVALID_HANDLE_VALUE) {
+        return nullptr;     // an app without the control pipe is normal
+    }
+
+    DWORD mode = PIPE_READMODE_MESSAGE;
+    if (!SetNamedPipeHandleState(hPipe, &mode, nullptr, nullptr)) {
+        ControlDbgLog("Open: SetNamedPipeHandleState failed, error=%lu\n", GetLastError());
+        CloseHandle(hPipe);
+        return nullptr;
+    }
+
+    ControlDbgLog("Open: Connected to control pipe\n");
+    return std::unique_ptr<ControlTransport>(new PipeControlTransport(hPipe));
+}
+
+} // namespace FluxMic
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <windows.h>
+#include <memory>
+
+#include "ControlChannel.h"
+
+/// Named pipe for the control channel from the MF source to the FluxMic
+/// app (see ControlMessage.h for the wire format).
+///
+/// The app creates it as a duplex message-mode pipe server next to the
+/// video feed, and this DLL connects as a client, like for the feed. Apps
+/// without it keep working; keyframes then only come when the encoder
+/// sends them by itself.
+
+namespace FluxMic {
+
+static const wchar_t* kControlPipeName = L"\\\\.\\pipe\\FluxMicControl";
+
+/// How long a control message may wait for the app to take it before the
+/// connection is given up, so that the decode worker is never held up.
+static const DWORD kControlWriteTimeoutMs = 100;
+
+/// Connect to the control pipe. Returns nullptr if the app doesn't offer
+/// one or the connection fails.
+std::unique_ptr<ControlTransport> OpenControlPipe();
+
+} // namespace FluxMic
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace FluxMic {
+
+/// Decoded NV12 picture, shared by reference between the decoder, the frame
+/// handoff and RequestSample() instead of being copied between them.
+///
+/// The planes live wherever the decoder put them (a decoder sample, a pooled
+/// buffer); a subclass keeps that memory alive and mapped until the last
+/// reference is released. The reference count is atomic, so a reference may
+/// be released on a different thread from the one which took it.
+class DecodedFrame {
+public:
+    // NV12: a luma plane of `height` rows and an interleaved chroma plane of
+    // `height / 2` rows, both `pitch` bytes apart.
+    const uint8_t* luma = nullptr;
+    const uint8_t* chroma = nullptr;
+    uint32_t pitch = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    // From the header of the message the picture was decoded from
+    uint32_t sequence = 0;
+    uint64_t timestamp = 0;   // QPC ticks from the app
+
+    void AddRef() const { m_refs.fetch_add(1, std::memory_order_relaxed); }
+    void Release() const {
+        if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+    }
+
+    /// More than one reference is held: for a pool, which hands a frame
+    /// out again only once its own reference is the last one.
+    bool IsShared() const { return m_refs.load(std::memory_order_acquire) > 1; }
+
+protected:
+    DecodedFrame() = default;
+    virtual ~DecodedFrame() = default;
+
+private:
+    DecodedFrame(const DecodedFrame&) = delete;
+    DecodedFrame& operator=(const DecodedFrame&) = delete;
+
+    mutable std::atomic<uint32_t> m_refs{1};
+};
+
+/// Owning reference to a DecodedFrame, in the manner of ComPtr.
+class FrameRef {
+public:
+    FrameRef() = default;
+    /// Takes over the reference the caller holds (e.g. from `new`).
+    explicit FrameRef(DecodedFrame* frame) : m_frame(frame) {}
+    FrameRef(const FrameRef& other) : m_frame(other.m_frame) { if (m_frame) m_frame->AddRef(); }
+    FrameRef(FrameRef&& other) noexcept : m_frame(other.m_frame) { other.m_frame = nullptr; }
+    ~FrameRef() { Reset(); }
+
+    FrameRef& operator=(FrameRef other) noexcept {
+        std::swap(m_frame, other.m_frame);
+        return *this;
+    }
+
+    void Reset() {
+        if (m_frame) {
+            m_frame->Release();
+            m_frame = nullptr;
+        }
+    }
+
+    DecodedFrame* Get() const { return m_frame; }
+    DecodedFrame* operator->() const { return m_frame; }
+    DecodedFrame& operator*() const { return *m_frame; }
+    explicit operator bool() const { return m_frame != nullptr; }
+
+private:
+    DecodedFrame* m_frame = nullptr;
+};
+
+/// DecodedFrame in memory of its own, for decoders which write into plain
+/// buffers, and for tests.
+class MemoryFrame : public DecodedFrame {
+public:
+    /// A black frame of the given size, tightly packed.
+    static FrameRef Create(uint32_t width, uint32_t height) {
+        MemoryFrame* frame = new MemoryFrame();
+        frame->m_data.resize((size_t)width * height * 3 / 2);
+        frame->width = width;
+        frame->height = height;
+        frame->pitch = width;
+        frame->luma = frame->m_data.data();
+        frame->chroma = frame->m_data.data() + (size_t)width * height;
+        std::fill(frame->m_data.begin(), frame->m_data.begin() + (size_t)width * height, (uint8_t)16);
+        std::fill(frame->m_data.begin() + (size_t)width * height, frame->m_data.end(), (uint8_t)128);
+        return FrameRef(frame);
+    }
+
+    /// Writable planes, while the frame isn't shared yet.
+    uint8_t* Data() { return m_data.data(); }
+
+private:
+    MemoryFrame() = default;
+    std::vector<uint8_t> m_data;
+};
+
+} // namespace FluxMic
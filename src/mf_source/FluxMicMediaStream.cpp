@@ -1,11 +1,13 @@
 #include "FluxMicMediaStream.h"
 #include "FluxMicMediaSource.h"
+#include "ControlPipe.h"
 
 #include <mfapi.h>
 #include <mferror.h>
 #include <mfobjects.h>
 
 #include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <cstdio>
 
@@ -32,6 +34,49 @@ static void StreamDbgLog(const char* fmt, ...) {
     }
 }
 
+// Microseconds between two QueryPerformanceCounter() readings
+static uint64_t ElapsedUs(const LARGE_INTEGER& from, const LARGE_INTEGER& to) {
+    static const LONGLONG freq = [] {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        return f.QuadPart;
+    }();
+    return (uint64_t)((to.QuadPart - from.QuadPart) * 1000000 / freq);
+}
+
+// How long the decode worker waits for frames or between attempts to open
+// the pipe; it notices a stop request within this time.
+static const DWORD kDecodeWaitMs = 20;
+static const DWORD kPipeRetryMs = 100;
+
+// Between attempts to connect to the control pipe, which older apps don't have
+static const uint64_t kControlRetryMs = 1000;
+
+// Room for the access units before the first SPS; PrepareDecoder() then
+// sizes m_nalBuffer for the stream
+static const size_t kInitialNalBufferSize = 256 * 1024;
+
+// The decoder backend chosen with the REG_SZ value "Decoder" under
+// HKLM\SOFTWARE\FluxMic ("auto", "mf" or "software"); auto without it.
+static FluxMic::DecoderBackend ReadDecoderBackend() {
+    char value[32] = {};
+    DWORD size = sizeof(value);
+    LONG result = RegGetValueA(HKEY_LOCAL_MACHINE, "SOFTWARE\\FluxMic", "Decoder",
+                               RRF_RT_REG_SZ, nullptr, value, &size);
+    if (result != ERROR_SUCCESS) return FluxMic::DecoderBackend::Auto;
+    return FluxMic::ParseDecoderBackend(value);
+}
+
+// Whether two SPSs describe the same picture format, so that the decoder
+// doesn't need preparing again
+static bool SameFormat(const FluxMic::H264Sps& a, const FluxMic::H264Sps& b) {
+    return a.profileIdc == b.profileIdc && a.levelIdc == b.levelIdc
+        && a.widthInMbs == b.widthInMbs && a.heightInMbs == b.heightInMbs
+        && a.Width() == b.Width() && a.Height() == b.Height()
+        && a.maxNumRefFrames == b.maxNumRefFrames
+        && a.numUnitsInTick == b.numUnitsInTick && a.timeScale == b.timeScale;
+}
+
 // PINNAME_VIDEO_CAPTURE GUID (from ksmedia.h)
 // {FB6C4281-0353-11d1-905F-0000C0CC16BA}
 static const GUID s_PINNAME_VIDEO_CAPTURE =
@@ -74,8 +119,9 @@ FluxMicMediaStream::FluxMicMediaStream(FluxMicMediaSource* pParent, IMFStreamDes
         }
     }
 
-    // Pre-allocate NAL buffer for max H.264 frame
-    m_nalBuffer.resize(kMaxFrameDataSize);
+    m_nalBuffer.resize(kInitialNalBufferSize);
+
+    m_decoderBackend = ReadDecoderBackend();
 }
 
 FluxMicMediaStream::~FluxMicMediaStream() {
@@ -186,95 +232,26 @@ STDMETHODIMP FluxMicMediaStream::RequestSample(IUnknown* pToken) {
         return MF_E_INVALIDREQUEST;
     }
 
-    // Performance timing
-    LARGE_INTEGER tStart, tPipeRead, tDecode, tCopy, tFreq;
+    LARGE_INTEGER tStart, tCopy;
     QueryPerformanceCounter(&tStart);
-    QueryPerformanceFrequency(&tFreq);
 
     // Log all requests (first 10 verbose, then every 100th)
     if (m_sampleIndex < 10 || m_sampleIndex % 100 == 0) {
         StreamDbgLog("[FluxMic] Stream::RequestSample #%llu (allocator=%p)\n", m_sampleIndex, m_pSampleAllocator);
     }
 
-    // Try to open pipe if not already open
-    if (!m_frameReader.IsOpen()) {
-        bool opened = m_frameReader.Open();
-        StreamDbgLog("[FluxMic] Stream::RequestSample pipe open=%d\n", opened);
-    }
-
-    // Initialize H.264 decoder on first use (lazy init)
-    if (!m_decoderInitialized) {
-        if (m_h264Decoder.Initialize()) {
-            m_decoderInitialized = true;
-            StreamDbgLog("[FluxMic] H.264 decoder initialized (MF H.264 MFT)\n");
-        } else {
-            StreamDbgLog("[FluxMic] H.264 decoder init FAILED\n");
-        }
-    }
-
-    // Try to read H.264 NAL data from the pipe and decode
-    bool haveDecodedFrame = false;
-    uint32_t decodedW = 0, decodedH = 0;
-    const uint8_t* decodedNv12 = nullptr;
-
-    if (m_frameReader.IsOpen() && m_decoderInitialized) {
-        bool gotFrame = m_frameReader.WaitForFrame(5);
-        QueryPerformanceCounter(&tPipeRead);
-
-        if (m_sampleIndex < 10) {
-            StreamDbgLog("[FluxMic] Stream::RequestSample WaitForFrame(5)=%d\n", gotFrame);
-        }
-
-        if (gotFrame) {
-            FrameHeader header = {};
-            if (m_frameReader.ReadHeader(header)) {
-                // Ensure NAL buffer is large enough
-                if (header.frame_size > m_nalBuffer.size()) {
-                    m_nalBuffer.resize(header.frame_size);
-                }
-                if (m_frameReader.ReadFrameData(m_nalBuffer.data(), m_nalBuffer.size(), header)) {
-                    if (m_sampleIndex < 10 || m_sampleIndex % 100 == 0) {
-                        StreamDbgLog("[FluxMic] Stream::RequestSample got H.264 NAL seq=%u size=%u\n",
-                                     header.sequence, header.frame_size);
-                    }
-
-                    // Decode H.264 NAL -> NV12
-                    if (m_h264Decoder.DecodeNal(m_nalBuffer.data(), header.frame_size)) {
-                        decodedW = m_h264Decoder.GetDecodedWidth();
-                        decodedH = m_h264Decoder.GetDecodedHeight();
-                        decodedNv12 = m_h264Decoder.GetDecodedData();
-                        haveDecodedFrame = true;
-
-                        // Cache this decoded frame for repeat
-                        uint32_t nv12Size = decodedW * decodedH * 3 / 2;
-                        if (m_lastNv12.size() < nv12Size) {
-                            m_lastNv12.resize(nv12Size);
-                        }
-                        memcpy(m_lastNv12.data(), decodedNv12, nv12Size);
-                        m_lastDecodedWidth = decodedW;
-                        m_lastDecodedHeight = decodedH;
-                        m_hasLastFrame = true;
-
-                        if (m_sampleIndex < 10 || m_sampleIndex % 100 == 0) {
-                            StreamDbgLog("[FluxMic] Stream::RequestSample decoded NV12 %ux%u\n",
-                                         decodedW, decodedH);
-                        }
-                    }
-                }
-            }
-        }
-
-        // No new decoded frame — re-use cached last-good NV12 frame
-        if (!haveDecodedFrame && m_hasLastFrame) {
-            decodedW = m_lastDecodedWidth;
-            decodedH = m_lastDecodedHeight;
-            decodedNv12 = m_lastNv12.data();
-            haveDecodedFrame = true;
-        }
-    } else {
-        QueryPerformanceCounter(&tPipeRead);
+    // The decode worker has published the newest picture, if any; the last
+    // one is repeated when the pipe has no new data.
+    bool newFrame = false;
+    const DecodedFrame* frame = m_handoff.Latest(&newFrame);
+    bool haveDecodedFrame = (frame != nullptr && frame->luma != nullptr);
+    uint32_t decodedW = haveDecodedFrame ? frame->width : 0;
+    uint32_t decodedH = haveDecodedFrame ? frame->height : 0;
+
+    if (m_sampleIndex < 10 && haveDecodedFrame) {
+        StreamDbgLog("[FluxMic] Stream::RequestSample frame seq=%u %ux%u new=%d\n",
+                     frame->sequence, decodedW, decodedH, newFrame);
     }
-    QueryPerformanceCounter(&tDecode);
 
     IMFSample* pSample = nullptr;
     HRESULT hr = E_FAIL;
@@ -308,9 +285,8 @@ STDMETHODIMP FluxMicMediaStream::RequestSample(IUnknown* pToken) {
                                       ? (UINT32)(cbBufferLength / pitch * 2 / 3)
                                       : m_height;
 
-                        if (haveDecodedFrame && decodedNv12) {
-                            CopyNv12ToBuffer(decodedNv12, decodedW, decodedH,
-                                             pbScanline0, pitch, bufW, bufH);
+                        if (haveDecodedFrame) {
+                            CopyNv12ToBuffer(*frame, pbScanline0, pitch, bufW, bufH);
                         } else {
                             // Black frame: Y=16, UV=128
                             for (UINT32 row = 0; row < bufH; row++) {
@@ -334,10 +310,10 @@ STDMETHODIMP FluxMicMediaStream::RequestSample(IUnknown* pToken) {
                     DWORD maxLen = 0;
                     hr = pBuffer->Lock(&pDst, &maxLen, nullptr);
                     if (SUCCEEDED(hr)) {
-                        if (haveDecodedFrame && decodedNv12) {
+                        if (haveDecodedFrame) {
                             uint32_t nv12Size = decodedW * decodedH * 3 / 2;
                             if (nv12Size <= maxLen) {
-                                memcpy(pDst, decodedNv12, nv12Size);
+                                CopyNv12ToBuffer(*frame, pDst, (LONG)decodedW, decodedW, decodedH);
                                 pBuffer->SetCurrentLength(nv12Size);
                             }
                         } else {
@@ -379,14 +355,9 @@ STDMETHODIMP FluxMicMediaStream::RequestSample(IUnknown* pToken) {
         }
         hr = m_pEventQueue->QueueEventParamUnk(MEMediaSample, GUID_NULL, S_OK, pSample);
 
-        // Performance log: pipe_ms | decode_ms | copy_ms | total_ms
+        m_copyMetrics.Record(ElapsedUs(tStart, tCopy));
         if (m_sampleIndex < 20 || m_sampleIndex % 100 == 0) {
-            double pipeMs   = (double)(tPipeRead.QuadPart - tStart.QuadPart) * 1000.0 / tFreq.QuadPart;
-            double decodeMs = (double)(tDecode.QuadPart - tPipeRead.QuadPart) * 1000.0 / tFreq.QuadPart;
-            double copyMs   = (double)(tCopy.QuadPart - tDecode.QuadPart) * 1000.0 / tFreq.QuadPart;
-            double totalMs  = (double)(tCopy.QuadPart - tStart.QuadPart) * 1000.0 / tFreq.QuadPart;
-            StreamDbgLog("[FluxMic] Sample #%llu decoded=%d pipe=%.1fms dec=%.1fms copy=%.1fms total=%.1fms\n",
-                         m_sampleIndex, haveDecodedFrame, pipeMs, decodeMs, copyMs, totalMs);
+            LogMetrics();
         }
 
         pSample->Release();
@@ -410,8 +381,10 @@ STDMETHODIMP FluxMicMediaStream::SetStreamState(MF_STREAM_STATE value) {
 
     if (value == MF_STREAM_STATE_RUNNING) {
         InitializeAllocatorLocked();
+        StartDecodeWorkerLocked();
         m_pEventQueue->QueueEventParamVar(MEStreamStarted, GUID_NULL, S_OK, nullptr);
     } else if (value == MF_STREAM_STATE_STOPPED) {
+        StopDecodeWorkerLocked();
         m_pEventQueue->QueueEventParamVar(MEStreamStopped, GUID_NULL, S_OK, nullptr);
     }
 
@@ -436,6 +409,7 @@ HRESULT FluxMicMediaStream::Start(UINT64 startTime) {
 
     m_streamState = MF_STREAM_STATE_RUNNING;
     InitializeAllocatorLocked();
+    StartDecodeWorkerLocked();
     m_pEventQueue->QueueEventParamVar(MEStreamStarted, GUID_NULL, S_OK, nullptr);
 
     return S_OK;
@@ -444,8 +418,7 @@ HRESULT FluxMicMediaStream::Start(UINT64 startTime) {
 HRESULT FluxMicMediaStream::Stop() {
     std::lock_guard<std::mutex> lock(m_lock);
     m_streamState = MF_STREAM_STATE_STOPPED;
-    m_frameReader.Close();
-    m_hasLastFrame = false;
+    StopDecodeWorkerLocked();
     m_pEventQueue->QueueEventParamVar(MEStreamStopped, GUID_NULL, S_OK, nullptr);
     return S_OK;
 }
@@ -455,9 +428,11 @@ HRESULT FluxMicMediaStream::Shutdown() {
     if (m_isShutdown) return S_OK;
     m_isShutdown = true;
 
-    m_frameReader.Close();
-    m_h264Decoder.Shutdown();
-    m_decoderInitialized = false;
+    StopDecodeWorkerLocked();
+    m_control.Detach();
+    m_decoder.store(nullptr);
+    m_mfDecoder.Shutdown();
+    m_softDecoder.Shutdown();
 
     if (m_pSampleAllocator) {
         m_pSampleAllocator->Release();
@@ -508,6 +483,206 @@ HRESULT FluxMicMediaStream::SetSampleAllocator(IMFVideoSampleAllocator* pAllocat
     return S_OK;
 }
 
+// ============================================================================
+// FluxMicMediaStream — Decode worker
+// ============================================================================
+
+void FluxMicMediaStream::StartDecodeWorkerLocked() {
+    if (m_decodeThread.joinable()) return;
+    m_stopDecode.store(false);
+    m_decodeThread = std::thread([this] { DecodeWorker(); });
+}
+
+void FluxMicMediaStream::StopDecodeWorkerLocked() {
+    if (m_decodeThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> wakeLock(m_decodeWakeLock);
+            m_stopDecode.store(true);
+        }
+        m_decodeWake.notify_all();
+        m_decodeThread.join();
+    }
+    m_frameReader.Close();
+    m_handoff.Reset();
+}
+
+void FluxMicMediaStream::DecodeWorker() {
+    // The decoder MFT is a COM object
+    HRESULT hrCom = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    StreamDbgLog("[FluxMic] Decode worker started\n");
+    m_control.SetConsumerActive(true);
+
+    while (!m_stopDecode.load()) {
+        uint64_t now = GetTickCount64();
+        if (!m_control.IsAttached() && now - m_controlRetryMs >= kControlRetryMs) {
+            m_controlRetryMs = now;
+            m_control.Attach(OpenControlPipe(), now);
+        }
+
+        // Try to open pipe if not already open
+        if (!m_frameReader.IsOpen()) {
+            bool opened = m_frameReader.Open();
+            StreamDbgLog("[FluxMic] Decode worker pipe open=%d\n", opened);
+            // Whatever the app sent before is gone; start from a keyframe
+            if (opened) m_control.OnFeedConnected(now);
+        }
+        m_control.Poll(now);
+
+        // Initialize H.264 decoder on first use (lazy init)
+        bool decoderReady = m_decoder.load() != nullptr || InitializeDecoder();
+
+        if (!m_frameReader.IsOpen() || !decoderReady) {
+            // The app isn't running yet; try again a little later
+            std::unique_lock<std::mutex> wakeLock(m_decodeWakeLock);
+            m_decodeWake.wait_for(wakeLock, std::chrono::milliseconds(kPipeRetryMs),
+                                  [this] { return m_stopDecode.load(); });
+            continue;
+        }
+
+        DecodeAvailableFrames();
+    }
+
+    m_control.SetConsumerActive(false);
+    StreamDbgLog("[FluxMic] Decode worker stopped\n");
+    if (SUCCEEDED(hrCom)) CoUninitialize();
+}
+
+// The configured backend; in auto mode the MFT, or the software decoder
+// where the MFT isn't available (e.g. Windows N without the Media Feature Pack).
+bool FluxMicMediaStream::InitializeDecoder() {
+    IVideoDecoder* decoder = nullptr;
+    if (m_decoderBackend != DecoderBackend::Software) {
+        if (m_mfDecoder.Initialize()) {
+            decoder = &m_mfDecoder;
+        } else {
+            StreamDbgLog("[FluxMic] H.264 decoder init FAILED (MF H.264 MFT)\n");
+        }
+    }
+    if (!decoder && m_decoderBackend != DecoderBackend::MediaFoundation) {
+        if (m_softDecoder.Initialize()) decoder = &m_softDecoder;
+    }
+    if (!decoder) return false;
+
+    StreamDbgLog("[FluxMic] H.264 decoder initialized (%s, backend=%s)\n",
+                 decoder->Name(), DecoderBackendName(m_decoderBackend));
+    m_decoder.store(decoder);
+    return true;
+}
+
+void FluxMicMediaStream::DecodeAvailableFrames() {
+    // Bounded, so that a stop request is noticed
+    if (!m_frameReader.WaitForFrame(kDecodeWaitMs)) return;
+
+    // Every frame received counts for lost frames, also those not decoded
+    uint64_t now = GetTickCount64();
+    for (size_t i = 0; i < m_frameReader.BacklogCount(); i++) {
+        m_control.OnFrameReceived(m_frameReader.BacklogSequence(i),
+                                  m_frameReader.BacklogInfo(i).isIdr, now);
+    }
+
+    // Feed the decoder every frame the backlog policy keeps, so the
+    // reference chain stays intact; only the last picture is published.
+    IVideoDecoder* decoder = m_decoder.load();
+    bool decoded = false;
+    FrameHeader lastHeader = {};
+    while (!m_stopDecode.load() && m_frameReader.NextFrame()) {
+        LARGE_INTEGER tRead, tDecode, tDone;
+        QueryPerformanceCounter(&tRead);
+
+        FrameHeader header = {};
+        if (!m_frameReader.ReadHeader(header)) continue;
+
+        // Ensure NAL buffer is large enough
+        if (header.frame_size > m_nalBuffer.size()) {
+            m_nalBuffer.resize(header.frame_size);
+        }
+        if (!m_frameReader.ReadFrameData(m_nalBuffer.data(), m_nalBuffer.size(), header)) continue;
+
+        // An SPS is parsed before its pictures are decoded, so the decoder
+        // is sized for the stream up front
+        H264Sps sps;
+        if (FindSps(m_nalBuffer.data(), header.frame_size, sps)
+            && !(m_hasStreamSps && SameFormat(sps, m_streamSps))) {
+            m_streamSps = sps;
+            m_hasStreamSps = true;
+            PrepareDecoder(decoder, header);
+        }
+
+        QueryPerformanceCounter(&tDecode);
+        m_readMetrics.Record(ElapsedUs(tRead, tDecode));
+
+        // Decode H.264 NAL -> NV12
+        uint64_t errorsBefore = decoder->DecodeErrors();
+        bool ok = decoder->DecodeNal(m_nalBuffer.data(), header.frame_size);
+        QueryPerformanceCounter(&tDone);
+        m_decodeMetrics.Record(ElapsedUs(tDecode, tDone));
+        if (decoder->DecodeErrors() != errorsBefore) {
+            m_control.OnDecodeError(header.sequence, now);
+        }
+        if (ok) {
+            decoded = true;
+            lastHeader = header;
+        }
+    }
+    if (!decoded) return;
+
+    LARGE_INTEGER tPublish, tDone;
+    QueryPerformanceCounter(&tPublish);
+
+    // The frame is the decoder's output sample or picture itself; the
+    // sample thread copies it once, straight into the allocator's buffer.
+    FrameRef frame = decoder->GetDecodedFrame();
+    if (!frame) return;
+    frame->sequence = lastHeader.sequence;
+    frame->timestamp = lastHeader.timestamp;
+    m_handoff.Publish(std::move(frame));
+
+    QueryPerformanceCounter(&tDone);
+    m_publishMetrics.Record(ElapsedUs(tPublish, tDone));
+}
+
+// Logs the stream format and sizes the decoder and m_nalBuffer for it
+void FluxMicMediaStream::PrepareDecoder(IVideoDecoder* decoder, const FrameHeader& header) {
+    const H264Sps& sps = m_streamSps;
+    StreamDbgLog("[FluxMic] SPS: profile %u level %u.%u, %ux%u (coded %ux%u), %u ref frames, %.2f fps "
+                 "(header %ux%u)\n",
+                 sps.profileIdc, sps.levelIdc / 10, sps.levelIdc % 10,
+                 sps.Width(), sps.Height(), sps.CodedWidth(), sps.CodedHeight(),
+                 sps.maxNumRefFrames, sps.FrameRate(), header.width, header.height);
+    decoder->Prepare(sps);
+
+    // Access units stay below the raw size of the picture, except at
+    // absurd bit rates; the buffer then grows to the frame as before
+    size_t rawSize = (size_t)sps.CodedWidth() * sps.CodedHeight() * 3 / 2;
+    size_t size = rawSize < kMaxFrameDataSize ? rawSize : kMaxFrameDataSize;
+    if (m_nalBuffer.size() < size) m_nalBuffer.resize(size);
+}
+
+// Averages and maxima since the stream started, in milliseconds
+void FluxMicMediaStream::LogMetrics() {
+    IVideoDecoder* decoder = m_decoder.load();
+    StageMetrics::Summary read = m_readMetrics.Get();
+    StageMetrics::Summary decode = m_decodeMetrics.Get();
+    StageMetrics::Summary publish = m_publishMetrics.Get();
+    StageMetrics::Summary copy = m_copyMetrics.Get();
+    StreamDbgLog("[FluxMic] Sample #%llu decoder thread: read=%.2f/%.2fms dec=%.2f/%.2fms (%llu) "
+                 "publish=%.2f/%.2fms (%llu, overwritten %llu) | sample thread: copy=%.2f/%.2fms | "
+                 "dropped=%llu invalid=%llu skipped=%llu | decoder alloc in=%llu out=%llu errors=%llu | "
+                 "keyframe requests=%llu control failures=%llu\n",
+                 m_sampleIndex,
+                 read.averageUs / 1000.0, read.maxUs / 1000.0,
+                 decode.averageUs / 1000.0, decode.maxUs / 1000.0, decode.count,
+                 publish.averageUs / 1000.0, publish.maxUs / 1000.0, publish.count,
+                 m_handoff.OverwrittenFrames(),
+                 copy.averageUs / 1000.0, copy.maxUs / 1000.0,
+                 m_frameReader.DroppedMessages(), m_frameReader.InvalidMessages(),
+                 m_frameReader.SkippedFrames(),
+                 decoder ? decoder->GetInputAllocations() : 0,
+                 decoder ? decoder->GetOutputAllocations() : 0,
+                 decoder ? decoder->DecodeErrors() : 0,
+                 m_control.KeyframeRequests(), m_control.SendFailures());
+}
+
 void FluxMicMediaStream::InitializeAllocatorLocked() {
     if (!m_pSampleAllocator || m_allocatorInitialized) return;
 
@@ -560,38 +735,41 @@ HRESULT FluxMicMediaStream::CreateBlackSample(IMFSample** ppSample) {
     return S_OK;
 }
 
-/// Copy decoded NV12 data to a 2D allocator buffer, handling pitch and
+/// Copy a decoded NV12 frame to an allocator buffer, handling pitch and
 /// resolution mismatch via nearest-neighbor scaling in NV12 space.
 void FluxMicMediaStream::CopyNv12ToBuffer(
-    const uint8_t* nv12Src, uint32_t srcW, uint32_t srcH,
+    const DecodedFrame& src,
     uint8_t* dst, LONG pitch, uint32_t dstW, uint32_t dstH)
 {
     uint8_t* yDst = dst;
     uint8_t* uvDst = dst + dstH * pitch;
 
-    const uint8_t* ySrc = nv12Src;
-    const uint8_t* uvSrc = nv12Src + srcW * srcH;
+    const uint32_t srcW = src.width;
+    const uint32_t srcH = src.height;
+    const uint32_t srcPitch = src.pitch;
+    const uint8_t* ySrc = src.luma;
+    const uint8_t* uvSrc = src.chroma;
 
-    if (srcW == dstW && srcH == dstH && (LONG)srcW == pitch) {
+    if (srcW == dstW && srcH == dstH && (LONG)srcPitch == pitch
+        && uvSrc == ySrc + (size_t)srcPitch * srcH) {
         // Perfect match — straight memcpy
-        memcpy(yDst, ySrc, srcW * srcH);
-        memcpy(uvDst, uvSrc, srcW * srcH / 2);
+        memcpy(yDst, ySrc, (size_t)srcPitch * srcH * 3 / 2);
     } else if (srcW == dstW && srcH == dstH) {
         // Same dimensions, different pitch — copy row by row
         // Y plane
         for (uint32_t row = 0; row < srcH; row++) {
-            memcpy(yDst + row * pitch, ySrc + row * srcW, srcW);
+            memcpy(yDst + row * pitch, ySrc + row * srcPitch, srcW);
         }
         // UV plane
         for (uint32_t row = 0; row < srcH / 2; row++) {
-            memcpy(uvDst + row * pitch, uvSrc + row * srcW, srcW);
+            memcpy(uvDst + row * pitch, uvSrc + row * srcPitch, srcW);
         }
     } else {
         // Resolution mismatch — nearest-neighbor scale in NV12 space
         // Y plane
         for (uint32_t dy = 0; dy < dstH; dy++) {
             uint32_t sy = (uint32_t)((uint64_t)dy * srcH / dstH);
-            const uint8_t* srcRow = ySrc + sy * srcW;
+            const uint8_t* srcRow = ySrc + (size_t)sy * srcPitch;
             uint8_t* dstRow = yDst + dy * pitch;
             for (uint32_t dx = 0; dx < dstW; dx++) {
                 uint32_t sx = (uint32_t)((uint64_t)dx * srcW / dstW);
@@ -601,11 +779,11 @@ void FluxMicMediaStream::CopyNv12ToBuffer(
         // UV plane (half resolution)
         uint32_t srcUvH = srcH / 2;
         uint32_t dstUvH = dstH / 2;
-        uint32_t srcUvW = srcW;  // UV stride = srcW (interleaved U,V pairs)
+        uint32_t srcUvW = srcW;  // interleaved U,V pairs
         uint32_t dstUvW = dstW;
         for (uint32_t dy = 0; dy < dstUvH; dy++) {
             uint32_t sy = (uint32_t)((uint64_t)dy * srcUvH / dstUvH);
-            const uint8_t* srcRow = uvSrc + sy * srcUvW;
+            const uint8_t* srcRow = uvSrc + (size_t)sy * srcPitch;
             uint8_t* dstRow = uvDst + dy * pitch;
             for (uint32_t dx = 0; dx < dstUvW; dx += 2) {
                 uint32_t sx = (uint32_t)((uint64_t)dx * srcUvW / dstUvW) & ~1u;
@@ -5,12 +5,19 @@
 #include <mferror.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <mutex>
 #include <thread>
 #include <vector>
 
+#include "ControlChannel.h"
+#include "DecodedFrame.h"
+#include "FrameHandoff.h"
 #include "SharedFrameBuffer.h"
 #include "H264Decoder.h"
+#include "SoftH264Decoder.h"
+#include "StageMetrics.h"
+#include "VideoDecoder.h"
 
 namespace FluxMic {
 
@@ -19,7 +26,13 @@ class FluxMicMediaSource;
 /// IMFMediaStream2 implementation for the FluxMic virtual camera.
 ///
 /// Reads H.264 NAL data from the named pipe, decodes to NV12 via the
-/// MF H.264 decoder MFT, and delivers NV12 frames as IMFSamples.
+/// MF H.264 decoder MFT or the software decoder, and delivers NV12 frames
+/// as IMFSamples.
+///
+/// Reading and decoding run on a decode worker thread while the stream is
+/// running, which publishes each decoded picture to a FrameHandoff.
+/// RequestSample() only copies the latest published picture into the sample,
+/// so a slow keyframe decode never holds m_lock.
 class FluxMicMediaStream :
     public IMFMediaStream2
 {
@@ -58,8 +71,18 @@ private:
     ~FluxMicMediaStream();
 
     void InitializeAllocatorLocked();  // must be called with m_lock held
+
+    // Decode worker (started and stopped with m_lock held; the worker itself
+    // never takes m_lock)
+    void StartDecodeWorkerLocked();
+    void StopDecodeWorkerLocked();
+    void DecodeWorker();
+    bool InitializeDecoder();
+    void DecodeAvailableFrames();
+    void PrepareDecoder(IVideoDecoder* decoder, const FrameHeader& header);
+    void LogMetrics();
     HRESULT CreateBlackSample(IMFSample** ppSample);
-    void CopyNv12ToBuffer(const uint8_t* nv12Src, uint32_t srcW, uint32_t srcH,
+    void CopyNv12ToBuffer(const DecodedFrame& src,
                           uint8_t* dst, LONG pitch, uint32_t dstW, uint32_t dstH);
 
     std::atomic<LONG> m_refCount{1};
@@ -83,18 +106,41 @@ private:
     UINT32 m_width = 1920;
     UINT32 m_height = 1080;
 
-    // H.264 decoder (MF H.264 MFT, lazy-initialized)
-    H264Decoder m_h264Decoder;
-    bool m_decoderInitialized = false;
+    // H.264 decoders (lazy-initialized); m_decoder points at the one in use,
+    // chosen by m_decoderBackend (HKLM\SOFTWARE\FluxMic, "Decoder").
+    // m_frameReader, the decoders and m_nalBuffer belong to the decode
+    // worker while it runs.
+    DecoderBackend m_decoderBackend = DecoderBackend::Auto;
+    H264Decoder m_mfDecoder;
+    SoftH264Decoder m_softDecoder;
+    std::atomic<IVideoDecoder*> m_decoder{nullptr};
 
     // Reusable buffer for H.264 NAL data from pipe
     std::vector<uint8_t> m_nalBuffer;
 
-    // Cached last-good NV12 frame for repeat when pipe has no new data
-    bool m_hasLastFrame = false;
-    std::vector<uint8_t> m_lastNv12;
-    uint32_t m_lastDecodedWidth = 0;
-    uint32_t m_lastDecodedHeight = 0;
+    // The last SPS the decoder was prepared for
+    H264Sps m_streamSps;
+    bool m_hasStreamSps = false;
+
+    // Keyframe requests and consumer state to the app (see ControlChannel.h);
+    // used by the decode worker while it runs
+    ControlChannel m_control;
+    uint64_t m_controlRetryMs = 0;   // GetTickCount64() of the last attempt to connect
+
+    std::thread m_decodeThread;
+    std::atomic<bool> m_stopDecode{false};
+    std::mutex m_decodeWakeLock;
+    std::condition_variable m_decodeWake;
+
+    // Latest decoded NV12 frame; repeated while the pipe has no new data
+    FrameHandoff m_handoff;
+
+    // Per-thread stage timing: read/decode/publish on the decode worker,
+    // copy on the RequestSample() caller
+    StageMetrics m_readMetrics;
+    StageMetrics m_decodeMetrics;
+    StageMetrics m_publishMetrics;
+    StageMetrics m_copyMetrics;
 };
 
 } // namespace FluxMic
@@ -0,0 +1,38 @@
+#include "FrameHandoff.h"
+
+#include <utility>
+
+namespace FluxMic {
+
+// Assigning the back slot releases the frame the consumer had before its
+// last swap, which it no longer uses.
+void FrameHandoff::Publish(FrameRef frame) {
+    m_slots[m_back] = std::move(frame);
+    uint8_t previous = m_middle.exchange(m_back | kFresh, std::memory_order_acq_rel);
+    m_back = previous & kIndexMask;
+    if (previous & kFresh) {
+        m_overwritten.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_published.fetch_add(1, std::memory_order_relaxed);
+}
+
+const DecodedFrame* FrameHandoff::Latest(bool* isNew) {
+    bool fresh = (m_middle.load(std::memory_order_relaxed) & kFresh) != 0;
+    if (fresh) {
+        uint8_t previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+        m_front = previous & kIndexMask;
+    }
+    if (isNew) *isNew = fresh;
+    return m_slots[m_front].Get();
+}
+
+void FrameHandoff::Reset() {
+    for (FrameRef& slot : m_slots) {
+        slot.Reset();
+    }
+    m_back = 0;
+    m_front = 1;
+    m_middle.store(2, std::memory_order_relaxed);
+}
+
+} // namespace FluxMic
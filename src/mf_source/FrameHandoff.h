@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "DecodedFrame.h"
+
+namespace FluxMic {
+
+/// Lock-free triple buffer passing the latest decoded frame from the decode
+/// thread to RequestSample().
+///
+/// The producer publishes a reference to each frame; the consumer takes the
+/// one published last. Neither side ever waits for the other, and frames the
+/// consumer had no time to take are simply replaced. Only references move,
+/// never pixels: a frame is released when the producer reuses the slot it
+/// was in, so it stays valid for the consumer until then.
+class FrameHandoff {
+public:
+    FrameHandoff() = default;
+
+    // Non-copyable
+    FrameHandoff(const FrameHandoff&) = delete;
+    FrameHandoff& operator=(const FrameHandoff&) = delete;
+
+    /// Producer: make `frame` the latest one.
+    void Publish(FrameRef frame);
+
+    /// Consumer: the latest published frame, or nullptr if none has been yet.
+    /// The frame stays valid and unchanged until the next call.
+    /// `isNew` tells whether it was published since the previous call.
+    const DecodedFrame* Latest(bool* isNew = nullptr);
+
+    /// Frames published, and those replaced before the consumer took them.
+    uint64_t PublishedFrames() const { return m_published.load(std::memory_order_relaxed); }
+    uint64_t OverwrittenFrames() const { return m_overwritten.load(std::memory_order_relaxed); }
+
+    /// Release the frames. Only while neither side is running.
+    void Reset();
+
+private:
+    static const uint8_t kIndexMask = 0x3;
+    static const uint8_t kFresh = 0x4;    // the middle slot hasn't been taken yet
+
+    FrameRef m_slots[3];
+    uint8_t m_back = 0;                   // producer only
+    uint8_t m_front = 1;                  // consumer only
+    std::atomic<uint8_t> m_middle{2};     // index | kFresh, swapped by both sides
+
+    std::atomic<uint64_t> m_published{0};
+    std::atomic<uint64_t> m_overwritten{0};
+};
+
+} // namespace FluxMic
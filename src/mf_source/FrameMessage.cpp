@@ -0,0 +1,19 @@
+#include "FrameMessage.h"
+#include <cstring>
+
+namespace FluxMic {
+
+bool ParseFrameMessage(const uint8_t* data, size_t size, FrameHeader& header) {
+    if (!data || size < kHeaderSize) return false;
+
+    FrameHeader hdr;
+    memcpy(&hdr, data, sizeof(FrameHeader));
+
+    if (hdr.frame_size == 0 || hdr.frame_size > kMaxFrameDataSize) return false;
+    if (size != kHeaderSize + hdr.frame_size) return false;
+
+    header = hdr;
+    return true;
+}
+
+} // namespace FluxMic
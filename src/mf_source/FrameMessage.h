@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// Wire format of the video feed from the FluxMic app.
+///
+/// Each pipe message carries one frame:
+///   Bytes 0-3:    width       (uint32_t LE, from SPS or 0 if unknown)
+///   Bytes 4-7:    height      (uint32_t LE, from SPS or 0 if unknown)
+///   Bytes 8-15:   timestamp   (uint64_t LE, QPC ticks)
+///   Bytes 16-19:  sequence    (uint32_t LE, wrapping counter)
+///   Bytes 20-23:  data_size   (uint32_t LE, H.264 NAL data size in bytes)
+///   Bytes 24+:    Raw H.264 Annex B NAL data (with 0x00000001 start codes)
+///
+/// Nothing here depends on Windows, so the framing can be tested on any platform.
+
+namespace FluxMic {
+
+// Header size in the wire message
+static const size_t kHeaderSize = 24;
+
+// Max supported resolution
+static const uint32_t kMaxWidth  = 1920;
+static const uint32_t kMaxHeight = 1080;
+
+// Max H.264 NAL data size per message (4MB — sufficient for worst-case keyframes)
+static const size_t kMaxFrameDataSize = 4 * 1024 * 1024;
+static const size_t kMaxMessageSize = kHeaderSize + kMaxFrameDataSize;
+
+#pragma pack(push, 1)
+struct FrameHeader {
+    uint32_t width;
+    uint32_t height;
+    uint64_t timestamp;   // QPC ticks
+    uint32_t sequence;    // wrapping frame counter
+    uint32_t frame_size;  // H.264 NAL data size in bytes
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FrameHeader) == kHeaderSize, "FrameHeader must be 24 bytes");
+
+/// Check that `size` bytes form one whole frame message and copy out its header.
+/// Returns false if the message is truncated, padded, empty or oversized.
+bool ParseFrameMessage(const uint8_t* data, size_t size, FrameHeader& header);
+
+} // namespace FluxMic
@@ -0,0 +1,74 @@
+#include "H264Bitstream.h"
+
+namespace FluxMic {
+
+size_t UnescapeRbsp(const uint8_t* data, size_t size, std::vector<uint8_t>& rbsp) {
+    if (rbsp.size() < size + BitReader::kReadAhead) {
+        rbsp.resize(size + BitReader::kReadAhead);
+    }
+    return UnescapeRbsp(data, size, rbsp.data(), rbsp.size());
+}
+
+size_t UnescapeRbsp(const uint8_t* data, size_t size, uint8_t* out, size_t capacity) {
+    if (capacity < BitReader::kReadAhead) return 0;
+    const size_t limit = capacity - BitReader::kReadAhead;
+    size_t length = 0;
+    int zeros = 0;
+    for (size_t i = 0; i < size && length < limit; i++) {
+        uint8_t byte = data[i];
+        if (zeros >= 2 && byte == 3) {
+            zeros = 0;      // emulation_prevention_three_byte
+            continue;
+        }
+        zeros = (byte == 0) ? zeros + 1 : 0;
+        out[length++] = byte;
+    }
+    for (size_t i = 0; i < BitReader::kReadAhead; i++) {
+        out[length + i] = 0;
+    }
+    return length;
+}
+
+BitReader::BitReader(const uint8_t* data, size_t size, bool paddedWithReadAhead)
+    : m_data(data)
+    , m_size(size)
+    , m_readable(paddedWithReadAhead ? size + kReadAhead : size)
+{
+    // The stop bit is the last bit set; trailing zero bytes may follow it
+    size_t last = size;
+    while (last > 0 && data[last - 1] == 0) {
+        last--;
+    }
+    if (last > 0) {
+        uint8_t byte = data[last - 1];
+        int bit = 7;
+        while (!(byte & (1 << (7 - bit)))) {
+            bit--;
+        }
+        m_stopBit = (last - 1) * 8 + bit;
+    }
+}
+
+uint64_t BitReader::LoadTail(size_t byte) const {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < 8; i++) {
+        bits <<= 8;
+        if (byte + i < m_size) bits |= m_data[byte + i];
+    }
+    return bits;
+}
+
+uint32_t BitReader::ReadLongUe() {
+    int zeros = 0;
+    while (ReadBit() == 0) {
+        // More than 31 zeros can't be a 32-bit value, and past the end
+        // everything reads as zero
+        if (++zeros > 31 || Overrun()) {
+            m_pos = m_size * 8 + 1;
+            return 0;
+        }
+    }
+    return ((1u << zeros) - 1) + ReadBits(zeros);
+}
+
+} // namespace FluxMic
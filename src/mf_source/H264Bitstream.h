@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace FluxMic {
+
+/// Number of zero bits above the highest set bit of `x`, which must not be zero.
+inline int CountLeadingZeros32(uint32_t x) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, x);
+    return 31 - (int)index;
+#else
+    return __builtin_clz(x);
+#endif
+}
+
+/// Copy the payload of a NAL unit (the bytes after its header byte) into
+/// `rbsp`, dropping the emulation prevention bytes (00 00 03 -> 00 00).
+/// The buffer only grows, so reusing it stops allocating once it holds the
+/// largest NAL unit; BitReader::kReadAhead zero bytes follow the payload.
+/// Returns the size of the payload without them.
+size_t UnescapeRbsp(const uint8_t* data, size_t size, std::vector<uint8_t>& rbsp);
+
+/// The same into a fixed buffer of `capacity` bytes, for small NAL units
+/// which are parsed without allocating. The payload is cut short if it
+/// doesn't fit with the kReadAhead zero bytes after it.
+size_t UnescapeRbsp(const uint8_t* data, size_t size, uint8_t* out, size_t capacity);
+
+/// Reads an RBSP bit by bit, MSB first, including the Exp-Golomb codes of
+/// ITU-T H.264 clause 9.1.
+///
+/// Reading past the end yields zero bits and makes Overrun() true, so a
+/// truncated slice is noticed once at the end of a macroblock instead of
+/// being checked at every syntax element.
+class BitReader {
+public:
+    /// Bytes after the data that reads may touch when they are present;
+    /// without them reads near the end take a slower path.
+    static const size_t kReadAhead = 8;
+
+    BitReader(const uint8_t* data, size_t size, bool paddedWithReadAhead = false);
+
+    uint32_t PeekBits(int count) const {   // 1..32 bits
+        uint64_t bits = Load64(m_pos >> 3) << (m_pos & 7);
+        return (uint32_t)(bits >> (64 - count));
+    }
+    void SkipBits(size_t count) { m_pos += count; }
+
+    uint32_t ReadBit() {
+        uint32_t bit = PeekBits(1);
+        m_pos++;
+        return bit;
+    }
+    uint32_t ReadBits(int count) {         // 0..32 bits
+        if (count == 0) return 0;
+        uint32_t bits = PeekBits(count);
+        m_pos += count;
+        return bits;
+    }
+
+    /// ue(v)
+    uint32_t ReadUe() {
+        uint32_t bits = PeekBits(32);
+        if (bits >= (1u << 16)) {
+            // Up to 15 leading zeros: the whole code is within the 32 bits
+            int zeros = CountLeadingZeros32(bits);
+            m_pos += 2 * zeros + 1;
+            return (bits >> (31 - 2 * zeros)) - 1;
+        }
+        return ReadLongUe();
+    }
+
+    /// se(v)
+    int32_t ReadSe() {
+        uint32_t code = ReadUe();
+        return (code & 1) ? (int32_t)((code >> 1) + 1) : -(int32_t)(code >> 1);
+    }
+
+    /// te(v) for a syntax element in 0..range (clause 9.1.1)
+    uint32_t ReadTe(uint32_t range) {
+        if (range > 1) return ReadUe();
+        return ReadBit() ^ 1;
+    }
+
+    bool IsByteAligned() const { return (m_pos & 7) == 0; }
+    void AlignToByte() { m_pos = (m_pos + 7) & ~(size_t)7; }
+
+    /// The data at the current position, which must be byte aligned.
+    const uint8_t* BytePointer() const { return m_data + (m_pos >> 3); }
+
+    /// more_rbsp_data(): whether anything precedes the rbsp_stop_one_bit
+    bool MoreRbspData() const { return m_pos < m_stopBit; }
+
+    size_t BitPosition() const { return m_pos; }
+    size_t BitsLeft() const { return Overrun() ? 0 : m_size * 8 - m_pos; }
+    bool Overrun() const { return m_pos > m_size * 8; }
+
+private:
+    uint64_t Load64(size_t byte) const {
+        if (byte + 8 <= m_readable) {
+            const uint8_t* p = m_data + byte;
+            return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) | ((uint64_t)p[2] << 40)
+                 | ((uint64_t)p[3] << 32) | ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16)
+                 | ((uint64_t)p[6] << 8) | (uint64_t)p[7];
+        }
+        return LoadTail(byte);
+    }
+    uint64_t LoadTail(size_t byte) const;
+    uint32_t ReadLongUe();
+
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_readable;      // bytes which may be loaded 8 at a time
+    size_t m_pos = 0;       // in bits
+    size_t m_stopBit = 0;   // position of the rbsp_stop_one_bit
+};
+
+} // namespace FluxMic
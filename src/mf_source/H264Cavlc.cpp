@@ -0,0 +1,341 @@
+#include "H264Cavlc.h"
+
+#include <cstdlib>
+#include <vector>
+
+namespace FluxMic {
+
+// ============================================================================
+// Code tables (ITU-T H.264 Tables 9-5, 9-7, 9-8, 9-10)
+// ============================================================================
+
+// coeff_token by [TotalCoeff * 4 + TrailingOnes]; a length of 0 marks the
+// combinations which don't exist. One table for each range of nC.
+static const uint8_t kCoeffTokenLength[4][4 * 17] = {
+    {   // 0 <= nC < 2
+         1, 0, 0, 0,
+         6, 2, 0, 0,     8, 6, 3, 0,     9, 8, 7, 5,    10, 9, 8, 6,
+        11,10, 9, 7,    13,11,10, 8,    13,13,11, 9,    13,13,13,10,
+        14,14,13,11,    14,14,14,13,    15,15,14,14,    15,15,15,14,
+        16,15,15,15,    16,16,16,15,    16,16,16,16,    16,16,16,16,
+    },
+    {   // 2 <= nC < 4
+         2, 0, 0, 0,
+         6, 2, 0, 0,     6, 5, 3, 0,     7, 6, 6, 4,     8, 6, 6, 4,
+         8, 7, 7, 5,     9, 8, 8, 6,    11, 9, 9, 6,    11,11,11, 7,
+        12,11,11, 9,    12,12,12,11,    12,12,12,11,    13,13,13,12,
+        13,13,13,13,    13,14,13,13,    14,14,14,13,    14,14,14,14,
+    },
+    {   // 4 <= nC < 8
+         4, 0, 0, 0,
+         6, 4, 0, 0,     6, 5, 4, 0,     6, 5, 5, 4,     7, 5, 5, 4,
+         7, 5, 5, 4,     7, 6, 6, 4,     7, 6, 6, 4,     8, 7, 7, 5,
+         8, 8, 7, 6,     9, 8, 8, 7,     9, 9, 8, 8,     9, 9, 9, 8,
+        10, 9, 9, 9,    10,10,10,10,    10,10,10,10,    10,10,10,10,
+    },
+    {   // 8 <= nC: 6-bit fixed length
+         6, 0, 0, 0,
+         6, 6, 0, 0,     6, 6, 6, 0,     6, 6, 6, 6,     6, 6, 6, 6,
+         6, 6, 6, 6,     6, 6, 6, 6,     6, 6, 6, 6,     6, 6, 6, 6,
+         6, 6, 6, 6,     6, 6, 6, 6,     6, 6, 6, 6,     6, 6, 6, 6,
+         6, 6, 6, 6,     6, 6, 6, 6,     6, 6, 6, 6,     6, 6, 6, 6,
+    },
+};
+
+static const uint8_t kCoeffTokenBits[4][4 * 17] = {
+    {
+         1, 0, 0, 0,
+         5, 1, 0, 0,     7, 4, 1, 0,     7, 6, 5, 3,     7, 6, 5, 3,
+         7, 6, 5, 4,    15, 6, 5, 4,    11,14, 5, 4,     8,10,13, 4,
+        15,14, 9, 4,    11,10,13,12,    15,14, 9,12,    11,10,13, 8,
+        15, 1, 9,12,    11,14,13, 8,     7,10, 9,12,     4, 6, 5, 8,
+    },
+    {
+         3, 0, 0, 0,
+        11, 2, 0, 0,     7, 7, 3, 0,     7,10, 9, 5,     7, 6, 5, 4,
+         4, 6, 5, 6,     7, 6, 5, 8,    15, 6, 5, 4,    11,14,13, 4,
+        15,10, 9, 4,    11,14,13,12,     8,10, 9, 8,    15,14,13,12,
+        11,10, 9,12,     7,11, 6, 8,     9, 8,10, 1,     7, 6, 5, 4,
+    },
+    {
+        15, 0, 0, 0,
+        15,14, 0, 0,    11,15,13, 0,     8,12,14,12,    15,10,11,11,
+        11, 8, 9,10,     9,14,13, 9,     8,10, 9, 8,    15,14,13,13,
+        11,14,10,12,    15,10,13,12,    11,14, 9,12,     8,10,13, 8,
+        13, 7, 9,12,     9,12,11,10,     5, 8, 7, 6,     1, 4, 3, 2,
+    },
+    {
+         3, 0, 0, 0,
+         0, 1, 0, 0,     4, 5, 6, 0,     8, 9,10,11,    12,13,14,15,
+        16,17,18,19,    20,21,22,23,    24,25,26,27,    28,29,30,31,
+        32,33,34,35,    36,37,38,39,    40,41,42,43,    44,45,46,47,
+        48,49,50,51,    52,53,54,55,    56,57,58,59,    60,61,62,63,
+    },
+};
+
+// coeff_token of chroma DC (nC == -1), TotalCoeff 0..4
+static const uint8_t kChromaDcCoeffTokenLength[4 * 5] = {
+     2, 0, 0, 0,
+     6, 1, 0, 0,
+     6, 6, 3, 0,
+     6, 7, 7, 6,
+     6, 8, 8, 7,
+};
+
+static const uint8_t kChromaDcCoeffTokenBits[4 * 5] = {
+     1, 0, 0, 0,
+     7, 1, 0, 0,
+     4, 6, 1, 0,
+     3, 3, 2, 5,
+     2, 3, 2, 0,
+};
+
+// total_zeros of 4x4 blocks by [TotalCoeff - 1][total_zeros]
+static const uint8_t kTotalZerosLength[15][16] = {
+    { 1, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 9 },
+    { 3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 6, 6, 6, 6 },
+    { 4, 3, 3, 3, 4, 4, 3, 3, 4, 5, 5, 6, 5, 6 },
+    { 5, 3, 4, 4, 3, 3, 3, 4, 3, 4, 5, 5, 5 },
+    { 4, 4, 4, 3, 3, 3, 3, 3, 4, 5, 4, 5 },
+    { 6, 5, 3, 3, 3, 3, 3, 3, 4, 3, 6 },
+    { 6, 5, 3, 3, 3, 2, 3, 4, 3, 6 },
+    { 6, 4, 5, 3, 2, 2, 3, 3, 6 },
+    { 6, 6, 4, 2, 2, 3, 2, 5 },
+    { 5, 5, 3, 2, 2, 2, 4 },
+    { 4, 4, 3, 3, 1, 3 },
+    { 4, 4, 2, 1, 3 },
+    { 3, 3, 1, 2 },
+    { 2, 2, 1 },
+    { 1, 1 },
+};
+
+static const uint8_t kTotalZerosBits[15][16] = {
+    { 1, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 1 },
+    { 7, 6, 5, 4, 3, 5, 4, 3, 2, 3, 2, 3, 2, 1, 0 },
+    { 5, 7, 6, 5, 4, 3, 4, 3, 2, 3, 2, 1, 1, 0 },
+    { 3, 7, 5, 4, 6, 5, 4, 3, 3, 2, 2, 1, 0 },
+    { 5, 4, 3, 7, 6, 5, 4, 3, 2, 1, 1, 0 },
+    { 1, 1, 7, 6, 5, 4, 3, 2, 1, 1, 0 },
+    { 1, 1, 5, 4, 3, 3, 2, 1, 1, 0 },
+    { 1, 1, 1, 3, 3, 2, 2, 1, 0 },
+    { 1, 0, 1, 3, 2, 1, 1, 1 },
+    { 1, 0, 1, 3, 2, 1, 1 },
+    { 0, 1, 1, 2, 1, 3 },
+    { 0, 1, 1, 1, 1 },
+    { 0, 1, 1, 1 },
+    { 0, 1, 1 },
+    { 0, 1 },
+};
+
+// total_zeros of 4:2:0 chroma DC by [TotalCoeff - 1][total_zeros]
+static const uint8_t kChromaDcTotalZerosLength[3][4] = {
+    { 1, 2, 3, 3 },
+    { 1, 2, 2 },
+    { 1, 1 },
+};
+
+static const uint8_t kChromaDcTotalZerosBits[3][4] = {
+    { 1, 1, 1, 0 },
+    { 1, 1, 0 },
+    { 1, 0 },
+};
+
+// run_before by [min(zerosLeft, 7) - 1][run_before]
+static const uint8_t kRunBeforeLength[7][15] = {
+    { 1, 1 },
+    { 1, 2, 2 },
+    { 2, 2, 2, 2 },
+    { 2, 2, 2, 3, 3 },
+    { 2, 2, 3, 3, 3, 3 },
+    { 2, 3, 3, 3, 3, 3, 3 },
+    { 3, 3, 3, 3, 3, 3, 3, 4, 5, 6, 7, 8, 9, 10, 11 },
+};
+
+static const uint8_t kRunBeforeBits[7][15] = {
+    { 1, 0 },
+    { 1, 1, 0 },
+    { 3, 2, 1, 0 },
+    { 3, 2, 1, 1, 0 },
+    { 3, 2, 3, 2, 1, 0 },
+    { 3, 0, 1, 3, 2, 5, 4 },
+    { 7, 6, 5, 4, 3, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1 },
+};
+
+// ============================================================================
+// VlcTable — two-level lookup of codes up to 16 bits
+// ============================================================================
+
+namespace {
+
+class VlcTable {
+public:
+    /// Codes of `lengths[i]` bits with the value `bits[i]` decode to i;
+    /// entries of length 0 are unused.
+    void Build(const uint8_t* lengths, const uint8_t* bits, int count) {
+        m_entries.assign(1 << kRootBits, Entry{ 0, 0, 0 });
+        for (int i = 0; i < count; i++) {
+            int length = lengths[i];
+            if (length == 0 || length > kRootBits) continue;
+            int first = bits[i] << (kRootBits - length);
+            for (int j = 0; j < (1 << (kRootBits - length)); j++) {
+                m_entries[first + j] = Entry{ (int16_t)i, (uint8_t)length, 0 };
+            }
+        }
+        // Longer codes go to a subtable for each root prefix
+        for (int prefix = 0; prefix < (1 << kRootBits); prefix++) {
+            int subBits = 0;
+            for (int i = 0; i < count; i++) {
+                int length = lengths[i];
+                if (length > kRootBits && (bits[i] >> (length - kRootBits)) == prefix) {
+                    if (length - kRootBits > subBits) subBits = length - kRootBits;
+                }
+            }
+            if (subBits == 0) continue;
+            size_t offset = m_entries.size();
+            m_entries.resize(offset + ((size_t)1 << subBits), Entry{ 0, 0, 0 });
+            m_entries[prefix] = Entry{ (int16_t)offset, 0, (uint8_t)subBits };
+            for (int i = 0; i < count; i++) {
+                int length = lengths[i];
+                if (length <= kRootBits || (bits[i] >> (length - kRootBits)) != prefix) continue;
+                int rest = length - kRootBits;
+                int first = (bits[i] & ((1 << rest) - 1)) << (subBits - rest);
+                for (int j = 0; j < (1 << (subBits - rest)); j++) {
+                    m_entries[offset + first + j] = Entry{ (int16_t)i, (uint8_t)length, 0 };
+                }
+            }
+        }
+    }
+
+    /// The value of the next code, or -1 if the bits match none.
+    int Read(BitReader& reader) const {
+        uint32_t bits = reader.PeekBits(16);
+        const Entry* entry = &m_entries[bits >> (16 - kRootBits)];
+        if (entry->subBits != 0) {
+            uint32_t index = (bits >> (16 - kRootBits - entry->subBits)) & ((1u << entry->subBits) - 1);
+            entry = &m_entries[entry->value + index];
+        }
+        if (entry->length == 0) return -1;
+        reader.SkipBits(entry->length);
+        return entry->value;
+    }
+
+private:
+    static const int kRootBits = 8;
+
+    struct Entry {
+        int16_t value;      // or the subtable offset
+        uint8_t length;     // 0 for a subtable or no code
+        uint8_t subBits;
+    };
+    std::vector<Entry> m_entries;
+};
+
+struct CavlcTables {
+    VlcTable coeffToken[4];
+    VlcTable chromaDcCoeffToken;
+    VlcTable totalZeros[15];
+    VlcTable chromaDcTotalZeros[3];
+    VlcTable runBefore[7];
+
+    CavlcTables() {
+        for (int i = 0; i < 4; i++) {
+            coeffToken[i].Build(kCoeffTokenLength[i], kCoeffTokenBits[i], 4 * 17);
+        }
+        chromaDcCoeffToken.Build(kChromaDcCoeffTokenLength, kChromaDcCoeffTokenBits, 4 * 5);
+        for (int i = 0; i < 15; i++) {
+            totalZeros[i].Build(kTotalZerosLength[i], kTotalZerosBits[i], 16);
+        }
+        for (int i = 0; i < 3; i++) {
+            chromaDcTotalZeros[i].Build(kChromaDcTotalZerosLength[i], kChromaDcTotalZerosBits[i], 4);
+        }
+        for (int i = 0; i < 7; i++) {
+            runBefore[i].Build(kRunBeforeLength[i], kRunBeforeBits[i], 15);
+        }
+    }
+};
+
+const CavlcTables& Tables() {
+    static const CavlcTables tables;
+    return tables;
+}
+
+} // namespace
+
+// ============================================================================
+// residual_block_cavlc()
+// ============================================================================
+
+int ReadResidualBlock(BitReader& reader, int nC, int maxNumCoeff, int16_t* coeffLevel) {
+    const CavlcTables& tables = Tables();
+    for (int i = 0; i < maxNumCoeff; i++) {
+        coeffLevel[i] = 0;
+    }
+
+    const VlcTable* tokenTable;
+    if (nC < 0) {
+        tokenTable = &tables.chromaDcCoeffToken;
+    } else {
+        tokenTable = &tables.coeffToken[nC < 2 ? 0 : nC < 4 ? 1 : nC < 8 ? 2 : 3];
+    }
+    int token = tokenTable->Read(reader);
+    if (token < 0) return -1;
+    int totalCoeff = token >> 2;
+    int trailingOnes = token & 3;
+    if (totalCoeff == 0) return 0;
+    if (totalCoeff > maxNumCoeff) return -1;
+
+    // Levels from the highest frequency down (9.2.2)
+    int level[16];
+    int suffixLength = (totalCoeff > 10 && trailingOnes < 3) ? 1 : 0;
+    for (int i = 0; i < totalCoeff; i++) {
+        if (i < trailingOnes) {
+            level[i] = 1 - 2 * (int)reader.ReadBit();
+            continue;
+        }
+        uint32_t peek = reader.PeekBits(32);
+        if (peek == 0) return -1;
+        int prefix = CountLeadingZeros32(peek);
+        reader.SkipBits(prefix + 1);
+
+        int levelCode = (prefix < 15 ? prefix : 15) << suffixLength;
+        if (suffixLength > 0 || prefix >= 14) {
+            int suffixSize = (prefix == 14 && suffixLength == 0) ? 4
+                           : (prefix >= 15) ? prefix - 3 : suffixLength;
+            levelCode += (int)reader.ReadBits(suffixSize);
+        }
+        if (prefix >= 15 && suffixLength == 0) levelCode += 15;
+        if (prefix >= 16) levelCode += (1 << (prefix - 3)) - 4096;
+        if (i == trailingOnes && trailingOnes < 3) levelCode += 2;
+
+        level[i] = (levelCode & 1) ? (-levelCode - 1) >> 1 : (levelCode + 2) >> 1;
+        if (suffixLength == 0) suffixLength = 1;
+        if (std::abs(level[i]) > (3 << (suffixLength - 1)) && suffixLength < 6) suffixLength++;
+    }
+
+    int zerosLeft = 0;
+    if (totalCoeff < maxNumCoeff) {
+        const VlcTable& zerosTable = (maxNumCoeff == 4)
+            ? tables.chromaDcTotalZeros[totalCoeff - 1]
+            : tables.totalZeros[totalCoeff - 1];
+        zerosLeft = zerosTable.Read(reader);
+        if (zerosLeft < 0 || totalCoeff + zerosLeft > maxNumCoeff) return -1;
+    }
+
+    // Place the levels, each run_before zeros below the previous one
+    int pos = totalCoeff + zerosLeft - 1;
+    for (int i = 0; i < totalCoeff; i++) {
+        int value = level[i];
+        coeffLevel[pos] = (int16_t)(value < -32768 ? -32768 : value > 32767 ? 32767 : value);
+        if (i == totalCoeff - 1) break;
+        int run = 0;
+        if (zerosLeft > 0) {
+            run = tables.runBefore[(zerosLeft < 7 ? zerosLeft : 7) - 1].Read(reader);
+            if (run < 0 || run > zerosLeft) return -1;
+            zerosLeft -= run;
+        }
+        pos -= run + 1;
+    }
+    return totalCoeff;
+}
+
+} // namespace FluxMic
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+#include "H264Bitstream.h"
+
+namespace FluxMic {
+
+/// nC for the coeff_token of a chroma DC block (4:2:0)
+static const int kCavlcChromaDcNc = -1;
+
+/// Decode one residual_block_cavlc() (ITU-T H.264 7.3.5.3.2, 9.2).
+///
+/// `nC` selects the coeff_token table: kCavlcChromaDcNc for chroma DC,
+/// otherwise the average of the neighbouring blocks' coefficient counts
+/// (9.2.1). The `maxNumCoeff` levels are written to `coeffLevel` in scan
+/// order, including the zeros.
+///
+/// Returns TotalCoeff, or -1 if the data can't be a valid block.
+int ReadResidualBlock(BitReader& reader, int nC, int maxNumCoeff, int16_t* coeffLevel);
+
+} // namespace FluxMic
@@ -0,0 +1,135 @@
+#include "H264Deblock.h"
+
+#include <cstdlib>
+
+namespace FluxMic {
+
+// α' and β' by indexA / indexB (Table 8-16)
+static const uint8_t kAlpha[52] = {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      4,   4,   5,   6,   7,   8,   9,  10,  12,  13,  15,  17,  20,  22,  25,  28,
+     32,  36,  40,  45,  50,  56,  63,  71,  80,  90, 101, 113, 127, 144, 162, 182,
+    203, 226, 255, 255,
+};
+
+static const uint8_t kBeta[52] = {
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     2,  2,  2,  3,  3,  3,  3,  4,  4,  4,  6,  6,  7,  7,  8,  8,
+     9,  9, 10, 10, 11, 11, 12, 12, 13, 13, 14, 14, 15, 15, 16, 16,
+    17, 17, 18, 18,
+};
+
+// t'C0 by indexA and bS - 1 (Table 8-17)
+static const uint8_t kTc0[52][3] = {
+    {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0},
+    {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0}, {0,0,0},
+    {0,0,0}, {0,0,1}, {0,0,1}, {0,0,1}, {0,0,1}, {0,1,1}, {0,1,1}, {1,1,1},
+    {1,1,1}, {1,1,1}, {1,1,1}, {1,1,2}, {1,1,2}, {1,1,2}, {1,1,2}, {1,2,3},
+    {1,2,3}, {2,2,3}, {2,2,4}, {2,3,4}, {2,3,4}, {3,3,5}, {3,4,6}, {3,4,6},
+    {4,5,7}, {4,5,8}, {4,6,9}, {5,7,10}, {6,8,11}, {6,8,13}, {7,10,14}, {8,11,16},
+    {9,12,18}, {10,13,20}, {11,15,23}, {13,17,25},
+};
+
+static inline int Clip3(int lo, int hi, int value) {
+    return value < lo ? lo : value > hi ? hi : value;
+}
+
+static inline uint8_t Clip1(int value) {
+    return (uint8_t)Clip3(0, 255, value);
+}
+
+/// One line of samples p3..q3 crossing the edge (8.7.2.3, 8.7.2.4)
+template <bool Chroma>
+static inline void FilterLine(uint8_t* pix, ptrdiff_t across, int bS, int alpha, int beta, int tc0) {
+    int p0 = pix[-across];
+    int q0 = pix[0];
+    int p1 = pix[-2 * across];
+    int q1 = pix[across];
+    if (abs(p0 - q0) >= alpha || abs(p1 - p0) >= beta || abs(q1 - q0) >= beta) {
+        return;
+    }
+
+    if (Chroma) {
+        if (bS < 4) {
+            int tc = tc0 + 1;
+            int delta = Clip3(-tc, tc, ((q0 - p0) * 4 + (p1 - q1) + 4) >> 3);
+            pix[-across] = Clip1(p0 + delta);
+            pix[0] = Clip1(q0 - delta);
+        } else {
+            pix[-across] = (uint8_t)((2 * p1 + p0 + q1 + 2) >> 2);
+            pix[0] = (uint8_t)((2 * q1 + q0 + p1 + 2) >> 2);
+        }
+        return;
+    }
+
+    int p2 = pix[-3 * across];
+    int q2 = pix[2 * across];
+    bool filterP = abs(p2 - p0) < beta;
+    bool filterQ = abs(q2 - q0) < beta;
+
+    if (bS < 4) {
+        int tc = tc0 + (filterP ? 1 : 0) + (filterQ ? 1 : 0);
+        int delta = Clip3(-tc, tc, ((q0 - p0) * 4 + (p1 - q1) + 4) >> 3);
+        pix[-across] = Clip1(p0 + delta);
+        pix[0] = Clip1(q0 - delta);
+        if (filterP) {
+            pix[-2 * across] = (uint8_t)(p1 + Clip3(-tc0, tc0, (p2 + ((p0 + q0 + 1) >> 1) - (p1 << 1)) >> 1));
+        }
+        if (filterQ) {
+            pix[across] = (uint8_t)(q1 + Clip3(-tc0, tc0, (q2 + ((p0 + q0 + 1) >> 1) - (q1 << 1)) >> 1));
+        }
+        return;
+    }
+
+    bool strong = abs(p0 - q0) < ((alpha >> 2) + 2);
+    if (filterP && strong) {
+        int p3 = pix[-4 * across];
+        pix[-across] = (uint8_t)((p2 + 2 * p1 + 2 * p0 + 2 * q0 + q1 + 4) >> 3);
+        pix[-2 * across] = (uint8_t)((p2 + p1 + p0 + q0 + 2) >> 2);
+        pix[-3 * across] = (uint8_t)((2 * p3 + 3 * p2 + p1 + p0 + q0 + 4) >> 3);
+    } else {
+        pix[-across] = (uint8_t)((2 * p1 + p0 + q1 + 2) >> 2);
+    }
+    if (filterQ && strong) {
+        int q3 = pix[3 * across];
+        pix[0] = (uint8_t)((p1 + 2 * p0 + 2 * q0 + 2 * q1 + q2 + 4) >> 3);
+        pix[across] = (uint8_t)((p0 + q0 + q1 + q2 + 2) >> 2);
+        pix[2 * across] = (uint8_t)((2 * q3 + 3 * q2 + q1 + q0 + p0 + 4) >> 3);
+    } else {
+        pix[0] = (uint8_t)((2 * q1 + q0 + p1 + 2) >> 2);
+    }
+}
+
+template <bool Chroma>
+static void FilterEdge(uint8_t* pix, ptrdiff_t across, ptrdiff_t along,
+                       const uint8_t bS[4], int indexA, int indexB) {
+    int alpha = kAlpha[indexA];
+    int beta = kBeta[indexB];
+    if (alpha == 0 || beta == 0) {
+        return;
+    }
+    const int linesPerBs = Chroma ? 2 : 4;
+    for (int i = 0; i < 4; i++) {
+        if (bS[i] == 0) {
+            pix += linesPerBs * along;
+            continue;
+        }
+        int tc0 = bS[i] < 4 ? kTc0[indexA][bS[i] - 1] : 0;
+        for (int line = 0; line < linesPerBs; line++) {
+            FilterLine<Chroma>(pix, across, bS[i], alpha, beta, tc0);
+            pix += along;
+        }
+    }
+}
+
+void DeblockLumaEdge(uint8_t* pix, ptrdiff_t across, ptrdiff_t along,
+                     const uint8_t bS[4], int indexA, int indexB) {
+    FilterEdge<false>(pix, across, along, bS, indexA, indexB);
+}
+
+void DeblockChromaEdge(uint8_t* pix, ptrdiff_t across, ptrdiff_t along,
+                       const uint8_t bS[4], int indexA, int indexB) {
+    FilterEdge<true>(pix, across, along, bS, indexA, indexB);
+}
+
+} // namespace FluxMic
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace FluxMic {
+
+// The sample filtering of the H.264 deblocking filter (ITU-T H.264 8.7.2),
+// one edge at a time. Deciding which edges to filter, and how strongly, is
+// up to the slice decoder.
+//
+// `pix` is the first q0 sample of the edge. `across` steps from p0 to q0:
+// 1 for a vertical luma edge, 2 for a vertical edge of interleaved chroma,
+// the stride for a horizontal one. `along` steps to the next line of
+// samples crossing the edge. `bS` is the boundary strength (0 to 4) of each
+// 4 luma lines; indexA and indexB are clipped to 0..51 by the caller.
+
+/// Filter the 16 lines of luma samples crossing an edge.
+void DeblockLumaEdge(uint8_t* pix, ptrdiff_t across, ptrdiff_t along,
+                     const uint8_t bS[4], int indexA, int indexB);
+
+/// Filter the 8 lines of one chroma component crossing an edge, in 4:2:0
+/// each bS covering 2 of them.
+void DeblockChromaEdge(uint8_t* pix, ptrdiff_t across, ptrdiff_t along,
+                       const uint8_t bS[4], int indexA, int indexB);
+
+} // namespace FluxMic
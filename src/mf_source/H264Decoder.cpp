@@ -4,6 +4,7 @@
 #include <mferror.h>
 #include <wmcodecdsp.h>  // CLSID_CMSH264DecoderMFT
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 
@@ -32,6 +33,121 @@ static void DecDbgLog(const char* fmt, ...) {
 
 namespace FluxMic {
 
+// ============================================================================
+// H264Decoder::MFSampleOps — pooled samples
+// ============================================================================
+
+IMFSample* H264Decoder::MFSampleOps::Create(size_t capacity) {
+    IMFSample* pSample = nullptr;
+    if (FAILED(MFCreateSample(&pSample))) return nullptr;
+    if (!Grow(pSample, capacity)) {
+        pSample->Release();
+        return nullptr;
+    }
+    return pSample;
+}
+
+bool H264Decoder::MFSampleOps::Grow(IMFSample* pSample, size_t capacity) {
+    IMFMediaBuffer* pBuffer = nullptr;
+    if (FAILED(MFCreateMemoryBuffer((DWORD)capacity, &pBuffer))) return false;
+    pSample->RemoveAllBuffers();
+    HRESULT hr = pSample->AddBuffer(pBuffer);
+    pBuffer->Release();
+    return SUCCEEDED(hr);
+}
+
+size_t H264Decoder::MFSampleOps::Capacity(IMFSample* pSample) {
+    IMFMediaBuffer* pBuffer = nullptr;
+    if (FAILED(pSample->GetBufferByIndex(0, &pBuffer))) return 0;
+    DWORD maxLength = 0;
+    pBuffer->GetMaxLength(&maxLength);
+    pBuffer->Release();
+    return maxLength;
+}
+
+// Only the pool's reference is left if AddRef() brings the count to two.
+bool H264Decoder::MFSampleOps::IsIdle(IMFSample* pSample) {
+    ULONG refs = pSample->AddRef();
+    pSample->Release();
+    return refs == 2;
+}
+
+// ============================================================================
+// MFDecodedFrame — decoded frame in a decoder output sample
+// ============================================================================
+
+/// Keeps the output sample and its buffer locked while the frame is referenced.
+/// The sample's reference count tells the output pool it is in use.
+class MFDecodedFrame : public DecodedFrame {
+public:
+    static FrameRef Create(IMFSample* pSample, uint32_t w, uint32_t h, uint32_t defaultStride) {
+        if (w == 0 || h == 0) return FrameRef();
+
+        // With a single buffer this returns that buffer without copying
+        IMFMediaBuffer* pBuffer = nullptr;
+        if (FAILED(pSample->ConvertToContiguousBuffer(&pBuffer))) return FrameRef();
+
+        MFDecodedFrame* frame = new MFDecodedFrame(pSample, pBuffer);
+        pBuffer->Release();
+        if (!frame->Map(w, h, defaultStride)) {
+            frame->Release();
+            return FrameRef();
+        }
+        return FrameRef(frame);
+    }
+
+protected:
+    ~MFDecodedFrame() override {
+        if (m_p2DBuffer) {
+            if (m_locked) m_p2DBuffer->Unlock2D();
+            m_p2DBuffer->Release();
+        } else if (m_locked) {
+            m_pBuffer->Unlock();
+        }
+        m_pBuffer->Release();
+        m_pSample->Release();
+    }
+
+private:
+    MFDecodedFrame(IMFSample* pSample, IMFMediaBuffer* pBuffer)
+        : m_pSample(pSample), m_pBuffer(pBuffer) {
+        m_pSample->AddRef();
+        m_pBuffer->AddRef();
+    }
+
+    // Prefer the 2D lock, which gives the real pitch of the buffer
+    bool Map(uint32_t w, uint32_t h, uint32_t defaultStride) {
+        BYTE* pScanline0 = nullptr;
+        LONG pitch = 0;
+        DWORD length = 0;
+        if (SUCCEEDED(m_pBuffer->QueryInterface(IID_PPV_ARGS(&m_p2DBuffer)))) {
+            if (FAILED(m_p2DBuffer->Lock2D(&pScanline0, &pitch))) return false;
+            m_locked = true;
+            if (pitch <= 0) return false;   // bottom-up NV12 doesn't exist
+        } else {
+            if (FAILED(m_pBuffer->Lock(&pScanline0, nullptr, &length))) return false;
+            m_locked = true;
+            pitch = (LONG)defaultStride;
+            if (length < (DWORD)pitch * h * 3 / 2) return false;
+        }
+        luma = pScanline0;
+        chroma = pScanline0 + (size_t)pitch * h;
+        this->pitch = (uint32_t)pitch;
+        width = w;
+        height = h;
+        return true;
+    }
+
+    IMFSample* m_pSample;
+    IMFMediaBuffer* m_pBuffer;
+    IMF2DBuffer* m_p2DBuffer = nullptr;
+    bool m_locked = false;
+};
+
+// ============================================================================
+// H264Decoder
+// ============================================================================
+
 H264Decoder::H264Decoder() = default;
 
 H264Decoder::~H264Decoder() {
@@ -70,43 +186,78 @@ bool H264Decoder::Initialize() {
         pCodecAPI->Release();
     }
 
-    // Set input type: H.264 Elementary Stream (raw Annex B, MFT parses SPS/PPS)
+    if (!SetInputType(nullptr)) {
+        Shutdown();
+        return false;
+    }
+
+    DecDbgLog("Initialize: MF H.264 decoder created, input type set (H264_ES)\n");
+    m_initialized = true;
+    m_outputConfigured = false;
+    return true;
+}
+
+// Raw Annex B; the MFT parses SPS/PPS itself
+bool H264Decoder::SetInputType(const H264Sps* sps) {
     IMFMediaType* pInputType = nullptr;
-    hr = MFCreateMediaType(&pInputType);
+    HRESULT hr = MFCreateMediaType(&pInputType);
     if (FAILED(hr)) {
-        DecDbgLog("Initialize: MFCreateMediaType (input) failed: 0x%08X\n", hr);
-        Shutdown();
+        DecDbgLog("SetInputType: MFCreateMediaType failed: 0x%08X\n", hr);
         return false;
     }
 
     pInputType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
     pInputType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_H264_ES);
+    if (sps) {
+        MFSetAttributeSize(pInputType, MF_MT_FRAME_SIZE, sps->Width(), sps->Height());
+        pInputType->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
+        if (sps->timingInfoPresent && sps->numUnitsInTick <= 0x7FFFFFFF) {
+            MFSetAttributeRatio(pInputType, MF_MT_FRAME_RATE, sps->timeScale, 2 * sps->numUnitsInTick);
+        }
+    }
 
     hr = m_pDecoder->SetInputType(0, pInputType, 0);
     pInputType->Release();
-
     if (FAILED(hr)) {
-        DecDbgLog("Initialize: SetInputType (H264_ES) failed: 0x%08X\n", hr);
-        Shutdown();
+        DecDbgLog("SetInputType: SetInputType (H264_ES%s) failed: 0x%08X\n", sps ? ", sized" : "", hr);
         return false;
     }
-
-    DecDbgLog("Initialize: MF H.264 decoder created, input type set (H264_ES)\n");
-    m_initialized = true;
-    m_outputConfigured = false;
     return true;
 }
 
+void H264Decoder::Prepare(const H264Sps& sps) {
+    m_expectedFrameSize = sps.CodedWidth() * sps.CodedHeight() * 3 / 2;
+    if (!m_initialized || m_outputConfigured) return;   // mid-stream the MFT follows the SPS itself
+
+    // Without the size the input type still works, so a failure is only logged
+    if (SetInputType(&sps)) {
+        DecDbgLog("Prepare: input type set to %ux%u, %.2f fps\n", sps.Width(), sps.Height(), sps.FrameRate());
+    }
+
+    // The frame being decoded and the one the stream still holds
+    MFT_OUTPUT_STREAM_INFO info = {};
+    if (SUCCEEDED(m_pDecoder->GetOutputStreamInfo(0, &info))
+        && !(info.dwFlags & MFT_OUTPUT_STREAM_PROVIDES_SAMPLES)) {
+        m_outputPool.Reserve(2, std::max<size_t>(info.cbSize, m_expectedFrameSize));
+    }
+}
+
 void H264Decoder::Shutdown() {
     if (m_pDecoder) {
         m_pDecoder->Release();
         m_pDecoder = nullptr;
     }
+    m_inputPool.Clear();
+    m_outputPool.Clear();
     m_initialized = false;
     m_outputConfigured = false;
+    m_streamInfo = {};
+    m_mftProvidesSamples = false;
     m_width = 0;
     m_height = 0;
-    m_nv12Output.clear();
+    m_defaultStride = 0;
+    m_expectedFrameSize = 0;
+    m_decodedFrame.Reset();
 }
 
 bool H264Decoder::NegotiateOutputType() {
@@ -127,6 +278,7 @@ bool H264Decoder::NegotiateOutputType() {
             // Get dimensions from the output type (set by MFT after parsing SPS)
             UINT32 w = 0, h = 0;
             MFGetAttributeSize(pType, MF_MT_FRAME_SIZE, &w, &h);
+            UINT32 stride = MFGetAttributeUINT32(pType, MF_MT_DEFAULT_STRIDE, w);
 
             hr = m_pDecoder->SetOutputType(0, pType, 0);
             pType->Release();
@@ -135,9 +287,17 @@ bool H264Decoder::NegotiateOutputType() {
                 m_width = w;
                 m_height = h;
                 m_outputConfigured = true;
-                // Pre-allocate NV12 buffer: Y plane (w*h) + UV plane (w*h/2)
-                m_nv12Output.resize(w * h * 3 / 2);
-                DecDbgLog("NegotiateOutputType: NV12 %ux%u configured\n", w, h);
+                m_defaultStride = ((INT32)stride > 0) ? stride : w;
+
+                // The stream info only changes with the output type
+                hr = m_pDecoder->GetOutputStreamInfo(0, &m_streamInfo);
+                if (FAILED(hr)) {
+                    DecDbgLog("NegotiateOutputType: GetOutputStreamInfo failed: 0x%08X\n", hr);
+                    m_streamInfo = {};
+                }
+                m_mftProvidesSamples = (m_streamInfo.dwFlags & MFT_OUTPUT_STREAM_PROVIDES_SAMPLES) != 0;
+                DecDbgLog("NegotiateOutputType: NV12 %ux%u configured (cbSize=%lu, mftSamples=%d)\n",
+                          w, h, m_streamInfo.cbSize, m_mftProvidesSamples);
                 return true;
             } else {
                 DecDbgLog("NegotiateOutputType: SetOutputType NV12 failed: 0x%08X\n", hr);
@@ -154,43 +314,46 @@ bool H264Decoder::NegotiateOutputType() {
 bool H264Decoder::DrainOutput() {
     if (!m_pDecoder) return false;
 
-    // Check if the MFT allocates output buffers itself
-    MFT_OUTPUT_STREAM_INFO streamInfo = {};
-    HRESULT hr = m_pDecoder->GetOutputStreamInfo(0, &streamInfo);
-    if (FAILED(hr)) {
-        DecDbgLog("DrainOutput: GetOutputStreamInfo failed: 0x%08X\n", hr);
-        return false;
+    // Until the output type is negotiated, the stream info isn't cached yet
+    HRESULT hr = S_OK;
+    if (!m_outputConfigured) {
+        hr = m_pDecoder->GetOutputStreamInfo(0, &m_streamInfo);
+        if (FAILED(hr)) {
+            DecDbgLog("DrainOutput: GetOutputStreamInfo failed: 0x%08X\n", hr);
+            return false;
+        }
+        m_mftProvidesSamples = (m_streamInfo.dwFlags & MFT_OUTPUT_STREAM_PROVIDES_SAMPLES) != 0;
     }
 
-    bool mftProvidesSamples = (streamInfo.dwFlags & MFT_OUTPUT_STREAM_PROVIDES_SAMPLES) != 0;
-
     MFT_OUTPUT_DATA_BUFFER outputData = {};
     outputData.dwStreamID = 0;
 
-    if (!mftProvidesSamples) {
+    // A sample from our pool stays owned by the pool; only the MFT's own
+    // samples are released here.
+    IMFSample* pPooledSample = nullptr;
+    if (!m_mftProvidesSamples) {
         // We must provide an output sample + buffer
-        IMFSample* pSample = nullptr;
-        hr = MFCreateSample(&pSample);
-        if (FAILED(hr)) return false;
-
-        DWORD bufSize = streamInfo.cbSize;
+        DWORD bufSize = m_streamInfo.cbSize;
         if (bufSize == 0) {
-            // Fallback: allocate for max expected NV12 size
+            // Fallback: the NV12 size of the output type, or of the SPS
+            // Prepare() saw, or a guess
             bufSize = m_width * m_height * 3 / 2;
+            if (bufSize == 0) bufSize = m_expectedFrameSize;
             if (bufSize == 0) bufSize = 1920 * 1080 * 3 / 2;
         }
+        pPooledSample = m_outputPool.Acquire(bufSize);
+        if (!pPooledSample) return false;
+        outputData.pSample = pPooledSample;
+    }
 
-        IMFMediaBuffer* pBuffer = nullptr;
-        hr = MFCreateMemoryBuffer(bufSize, &pBuffer);
-        if (FAILED(hr)) {
-            pSample->Release();
-            return false;
+    auto releaseOutput = [&]() {
+        if (outputData.pSample && outputData.pSample != pPooledSample) {
+            outputData.pSample->Release();
         }
-        pSample->AddBuffer(pBuffer);
-        pBuffer->Release();
-
-        outputData.pSample = pSample;
-    }
+        if (outputData.pEvents) {
+            outputData.pEvents->Release();
+        }
+    };
 
     DWORD status = 0;
     hr = m_pDecoder->ProcessOutput(0, 1, &outputData, &status);
@@ -198,7 +361,7 @@ bool H264Decoder::DrainOutput() {
     if (hr == MF_E_TRANSFORM_STREAM_CHANGE || hr == static_cast<HRESULT>(0xC00D6D60) /*MF_E_TRANSFORM_TYPE_NOT_SET*/) {
         // Output type needs to be (re)negotiated — happens after MFT parses SPS/PPS
         DecDbgLog("DrainOutput: stream/type change (0x%08X), negotiating output type\n", hr);
-        if (outputData.pSample) outputData.pSample->Release();
+        releaseOutput();
         if (!NegotiateOutputType()) {
             DecDbgLog("DrainOutput: NegotiateOutputType failed after stream change\n");
             return false;
@@ -207,97 +370,71 @@ bool H264Decoder::DrainOutput() {
     }
 
     if (hr == MF_E_TRANSFORM_NEED_MORE_INPUT) {
-        if (outputData.pSample) outputData.pSample->Release();
+        releaseOutput();
         return false; // Need more input data
     }
 
     if (FAILED(hr)) {
         DecDbgLog("DrainOutput: ProcessOutput failed: 0x%08X\n", hr);
-        if (outputData.pSample) outputData.pSample->Release();
+        m_decodeErrors.fetch_add(1, std::memory_order_relaxed);
+        releaseOutput();
         return false;
     }
 
-    // Success — read NV12 data from the output sample
+    // Success — wrap the output sample as the decoded frame, without copying
     IMFSample* pOutputSample = outputData.pSample;
     if (!pOutputSample) {
+        releaseOutput();
         return false;
     }
 
-    IMFMediaBuffer* pBuf = nullptr;
-    hr = pOutputSample->ConvertToContiguousBuffer(&pBuf);
-    if (FAILED(hr)) {
-        pOutputSample->Release();
+    FrameRef frame = MFDecodedFrame::Create(pOutputSample, m_width, m_height, m_defaultStride);
+    releaseOutput();
+    if (!frame) {
+        DecDbgLog("DrainOutput: could not map the output sample\n");
         return false;
     }
-
-    BYTE* pData = nullptr;
-    DWORD dataLen = 0;
-    hr = pBuf->Lock(&pData, nullptr, &dataLen);
-    if (SUCCEEDED(hr) && pData && dataLen > 0) {
-        uint32_t expectedSize = m_width * m_height * 3 / 2;
-        if (dataLen >= expectedSize) {
-            if (m_nv12Output.size() < expectedSize) {
-                m_nv12Output.resize(expectedSize);
-            }
-            memcpy(m_nv12Output.data(), pData, expectedSize);
-        }
-        pBuf->Unlock();
-    }
-
-    pBuf->Release();
-    pOutputSample->Release();
-
-    return (SUCCEEDED(hr) && dataLen > 0);
+    m_decodedFrame = frame;
+    return true;
 }
 
-bool H264Decoder::DecodeNal(const uint8_t* nalData, uint32_t nalSize) {
-    if (!m_initialized || !m_pDecoder || !nalData || nalSize == 0) {
-        return false;
-    }
+IMFSample* H264Decoder::PrepareInputSample(const uint8_t* nalData, uint32_t nalSize) {
+    IMFSample* pSample = m_inputPool.Acquire(nalSize);
+    if (!pSample) return nullptr;
 
-    // Create an input sample containing the NAL data
-    IMFSample* pInputSample = nullptr;
-    HRESULT hr = MFCreateSample(&pInputSample);
-    if (FAILED(hr)) return false;
-
-    IMFMediaBuffer* pInputBuffer = nullptr;
-    hr = MFCreateMemoryBuffer(nalSize, &pInputBuffer);
-    if (FAILED(hr)) {
-        pInputSample->Release();
-        return false;
-    }
+    IMFMediaBuffer* pBuffer = nullptr;
+    if (FAILED(pSample->GetBufferByIndex(0, &pBuffer))) return nullptr;
 
     // Copy NAL data into the MF buffer
     BYTE* pDst = nullptr;
-    hr = pInputBuffer->Lock(&pDst, nullptr, nullptr);
+    HRESULT hr = pBuffer->Lock(&pDst, nullptr, nullptr);
     if (SUCCEEDED(hr)) {
         memcpy(pDst, nalData, nalSize);
-        pInputBuffer->Unlock();
-        pInputBuffer->SetCurrentLength(nalSize);
+        pBuffer->Unlock();
+        pBuffer->SetCurrentLength(nalSize);
     }
+    pBuffer->Release();
+    return SUCCEEDED(hr) ? pSample : nullptr;
+}
 
-    pInputSample->AddBuffer(pInputBuffer);
-    pInputBuffer->Release();
+bool H264Decoder::DecodeNal(const uint8_t* nalData, uint32_t nalSize) {
+    if (!m_initialized || !m_pDecoder || !nalData || nalSize == 0) {
+        return false;
+    }
+
+    // Fill a pooled input sample with the NAL data. The MFT may keep a
+    // reference to it; the pool then hands out another one next time.
+    IMFSample* pInputSample = PrepareInputSample(nalData, nalSize);
+    if (!pInputSample) return false;
 
     // Feed input to the MFT
-    hr = m_pDecoder->ProcessInput(0, pInputSample, 0);
-    pInputSample->Release();
+    HRESULT hr = m_pDecoder->ProcessInput(0, pInputSample, 0);
 
     if (hr == MF_E_NOTACCEPTING) {
-        // Output buffer full — drain first, then retry
+        // Output buffer full — drain first, then retry with the same sample,
+        // which the MFT didn't take
         DrainOutput();
-        // Retry input (create new sample)
-        pInputSample = nullptr;
-        MFCreateSample(&pInputSample);
-        MFCreateMemoryBuffer(nalSize, &pInputBuffer);
-        pInputBuffer->Lock(&pDst, nullptr, nullptr);
-        memcpy(pDst, nalData, nalSize);
-        pInputBuffer->Unlock();
-        pInputBuffer->SetCurrentLength(nalSize);
-        pInputSample->AddBuffer(pInputBuffer);
-        pInputBuffer->Release();
         hr = m_pDecoder->ProcessInput(0, pInputSample, 0);
-        pInputSample->Release();
     }
 
     if (FAILED(hr)) {
@@ -306,6 +443,7 @@ bool H264Decoder::DecodeNal(const uint8_t* nalData, uint32_t nalSize) {
             DecDbgLog("DecodeNal: ProcessInput failed: 0x%08X (size=%u)\n", hr, nalSize);
         }
         errCount++;
+        m_decodeErrors.fetch_add(1, std::memory_order_relaxed);
         return false;
     }
 
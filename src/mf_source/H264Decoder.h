@@ -5,9 +5,14 @@
 #include <mftransform.h>
 #include <codecapi.h>
 
+#include <atomic>
 #include <cstdint>
 #include <vector>
 
+#include "DecodedFrame.h"
+#include "SamplePool.h"
+#include "VideoDecoder.h"
+
 namespace FluxMic {
 
 /// Wraps the Windows Media Foundation H.264 decoder MFT (CLSID_CMSH264DecoderMFT).
@@ -15,10 +20,14 @@ namespace FluxMic {
 /// Accepts raw Annex B H.264 NAL data and decodes to NV12 frames.
 /// Uses software decode only (reliable in Session 0, no D3D device manager).
 /// Sets CODECAPI_AVLowLatencyMode for real-time decode.
-class H264Decoder {
+///
+/// Input samples, and output samples when the MFT doesn't provide its own,
+/// come from pools owned by the decoder, so decoding allocates nothing once
+/// the pools hold a sample of the right size.
+class H264Decoder : public IVideoDecoder {
 public:
     H264Decoder();
-    ~H264Decoder();
+    ~H264Decoder() override;
 
     // Non-copyable
     H264Decoder(const H264Decoder&) = delete;
@@ -26,25 +35,53 @@ public:
 
     /// Create the MF H.264 decoder MFT and configure input type.
     /// Output type is negotiated on first successful decode (after SPS/PPS).
-    bool Initialize();
+    bool Initialize() override;
 
     /// Release the MFT and all resources.
-    void Shutdown();
+    void Shutdown() override;
+
+    bool IsInitialized() const override { return m_initialized; }
 
-    bool IsInitialized() const { return m_initialized; }
+    /// Before the first frame, put the size and rate from the SPS on the
+    /// input type and fill the output pool, instead of learning the size
+    /// from MF_E_TRANSFORM_STREAM_CHANGE and guessing the first buffer.
+    void Prepare(const H264Sps& sps) override;
 
     /// Feed H.264 NAL data (Annex B, with 0x00000001 start codes).
-    /// Returns true if a decoded NV12 frame is available in the output buffer.
+    /// Returns true if a decoded NV12 frame is available.
     /// On success, use GetDecodedFrame() to access the NV12 data.
-    bool DecodeNal(const uint8_t* nalData, uint32_t nalSize);
-
-    /// Get the decoded NV12 frame data (valid only after DecodeNal returns true).
-    const uint8_t* GetDecodedData() const { return m_nv12Output.data(); }
-    uint32_t GetDecodedSize() const { return (uint32_t)m_nv12Output.size(); }
-    uint32_t GetDecodedWidth() const { return m_width; }
-    uint32_t GetDecodedHeight() const { return m_height; }
+    bool DecodeNal(const uint8_t* nalData, uint32_t nalSize) override;
+
+    /// The last decoded NV12 frame (valid only after DecodeNal returns true).
+    /// It maps the decoder's output sample directly, without copying; while
+    /// a reference is held, that sample is not reused.
+    FrameRef GetDecodedFrame() const override { return m_decodedFrame; }
+    uint32_t GetDecodedWidth() const override { return m_width; }
+    uint32_t GetDecodedHeight() const override { return m_height; }
+
+    /// Samples and buffers created so far for input and output.
+    /// They stop increasing once decoding reaches the steady state.
+    uint64_t GetInputAllocations() const override { return m_inputPool.Allocations(); }
+    uint64_t GetOutputAllocations() const override { return m_outputPool.Allocations(); }
+
+    /// Inputs the MFT rejected and outputs it failed to produce
+    uint64_t DecodeErrors() const override { return m_decodeErrors.load(std::memory_order_relaxed); }
+
+    const char* Name() const override { return "MF H.264 MFT"; }
+
+    /// SamplePool operations on IMFSample with one memory buffer.
+    struct MFSampleOps {
+        static IMFSample* Create(size_t capacity);
+        static bool Grow(IMFSample* pSample, size_t capacity);
+        static size_t Capacity(IMFSample* pSample);
+        static bool IsIdle(IMFSample* pSample);
+        static void Destroy(IMFSample* pSample) { pSample->Release(); }
+    };
 
 private:
+    /// H.264 ES input type, with the frame size and rate if `sps` is given.
+    bool SetInputType(const H264Sps* sps);
+
     /// Negotiate the output media type (NV12) after the MFT has parsed SPS/PPS.
     bool NegotiateOutputType();
 
@@ -52,15 +89,29 @@ private:
     /// Returns true if a frame was successfully read.
     bool DrainOutput();
 
+    /// Fill a pooled input sample with the NAL data.
+    IMFSample* PrepareInputSample(const uint8_t* nalData, uint32_t nalSize);
+
     IMFTransform* m_pDecoder = nullptr;
     bool m_initialized = false;
     bool m_outputConfigured = false;
 
+    /// Output stream info, cached by NegotiateOutputType()
+    MFT_OUTPUT_STREAM_INFO m_streamInfo = {};
+    bool m_mftProvidesSamples = false;
+
+    SamplePool<IMFSample, MFSampleOps> m_inputPool;
+    SamplePool<IMFSample, MFSampleOps> m_outputPool;
+
     uint32_t m_width = 0;
     uint32_t m_height = 0;
+    uint32_t m_defaultStride = 0;  // for output buffers without IMF2DBuffer
+    uint32_t m_expectedFrameSize = 0;  // NV12 bytes of a coded frame, from Prepare()
+
+    /// Last decoded NV12 frame
+    FrameRef m_decodedFrame;
 
-    /// Decoded NV12 frame buffer
-    std::vector<uint8_t> m_nv12Output;
+    std::atomic<uint64_t> m_decodeErrors{0};
 };
 
 } // namespace FluxMic
@@ -0,0 +1,511 @@
+#include "H264Dsp.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLUXMIC_H264_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace FluxMic {
+
+const uint8_t kH264Dequant4x4[6][16] = {
+    { 10, 13, 10, 13, 13, 16, 13, 16, 10, 13, 10, 13, 13, 16, 13, 16 },
+    { 11, 14, 11, 14, 14, 18, 14, 18, 11, 14, 11, 14, 14, 18, 14, 18 },
+    { 13, 16, 13, 16, 16, 20, 16, 20, 13, 16, 13, 16, 16, 20, 16, 20 },
+    { 14, 18, 14, 18, 18, 23, 18, 23, 14, 18, 14, 18, 18, 23, 18, 23 },
+    { 16, 20, 16, 20, 20, 25, 20, 25, 16, 20, 16, 20, 20, 25, 20, 25 },
+    { 18, 23, 18, 23, 23, 29, 23, 29, 18, 23, 18, 23, 23, 29, 23, 29 },
+};
+
+static inline uint8_t Clip1(int value) {
+    return (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+static inline int16_t ClipInt16(int64_t value) {
+    return (int16_t)(value < -32768 ? -32768 : value > 32767 ? 32767 : value);
+}
+
+// ============================================================================
+// DC transforms (scalar only; once per macroblock)
+// ============================================================================
+
+void H264LumaDcDequant(int16_t* dc, int qp) {
+    // f = H * c * H with the 4x4 Hadamard matrix H, rows first
+    int f[16];
+    for (int i = 0; i < 4; i++) {
+        const int16_t* c = dc + 4 * i;
+        int s0 = c[0] + c[1], s1 = c[0] - c[1];
+        int s2 = c[2] + c[3], s3 = c[2] - c[3];
+        f[4 * i + 0] = s0 + s2;
+        f[4 * i + 1] = s1 + s3;
+        f[4 * i + 2] = s1 - s3;
+        f[4 * i + 3] = s0 - s2;
+    }
+    for (int j = 0; j < 4; j++) {
+        int s0 = f[j] + f[4 + j], s1 = f[j] - f[4 + j];
+        int s2 = f[8 + j] + f[12 + j], s3 = f[8 + j] - f[12 + j];
+        f[j] = s0 + s2;
+        f[4 + j] = s1 + s3;
+        f[8 + j] = s1 - s3;
+        f[12 + j] = s0 - s2;
+    }
+    // Out-of-range levels of damaged data mustn't overflow
+    int64_t scale = 16 * kH264Dequant4x4[qp % 6][0];
+    int shift = qp / 6;
+    for (int i = 0; i < 16; i++) {
+        int64_t value = (shift >= 6)
+            ? f[i] * (scale << (shift - 6))
+            : (f[i] * scale + (1 << (5 - shift))) >> (6 - shift);
+        dc[i] = ClipInt16(value);
+    }
+}
+
+void H264ChromaDcDequant(int16_t* dc, int qp) {
+    int f0 = dc[0] + dc[1] + dc[2] + dc[3];
+    int f1 = dc[0] - dc[1] + dc[2] - dc[3];
+    int f2 = dc[0] + dc[1] - dc[2] - dc[3];
+    int f3 = dc[0] - dc[1] - dc[2] + dc[3];
+    int64_t scale = (int64_t)(16 * kH264Dequant4x4[qp % 6][0]) << (qp / 6);
+    dc[0] = ClipInt16((f0 * scale) >> 5);
+    dc[1] = ClipInt16((f1 * scale) >> 5);
+    dc[2] = ClipInt16((f2 * scale) >> 5);
+    dc[3] = ClipInt16((f3 * scale) >> 5);
+}
+
+// ============================================================================
+// Scalar kernels
+// ============================================================================
+
+static void IdctAdd4x4Scalar(uint8_t* dst, ptrdiff_t stride, int16_t* block) {
+    int t[16];
+    for (int i = 0; i < 4; i++) {
+        const int16_t* d = block + 4 * i;
+        int e0 = d[0] + d[2];
+        int e1 = d[0] - d[2];
+        int e2 = (d[1] >> 1) - d[3];
+        int e3 = d[1] + (d[3] >> 1);
+        t[4 * i + 0] = e0 + e3;
+        t[4 * i + 1] = e1 + e2;
+        t[4 * i + 2] = e1 - e2;
+        t[4 * i + 3] = e0 - e3;
+    }
+    for (int j = 0; j < 4; j++) {
+        int g0 = t[j] + t[8 + j];
+        int g1 = t[j] - t[8 + j];
+        int g2 = (t[4 + j] >> 1) - t[12 + j];
+        int g3 = t[4 + j] + (t[12 + j] >> 1);
+        dst[j] = Clip1(dst[j] + ((g0 + g3 + 32) >> 6));
+        dst[stride + j] = Clip1(dst[stride + j] + ((g1 + g2 + 32) >> 6));
+        dst[2 * stride + j] = Clip1(dst[2 * stride + j] + ((g1 - g2 + 32) >> 6));
+        dst[3 * stride + j] = Clip1(dst[3 * stride + j] + ((g0 - g3 + 32) >> 6));
+    }
+    memset(block, 0, 16 * sizeof(int16_t));
+}
+
+static void IdctDcAdd4x4Scalar(uint8_t* dst, ptrdiff_t stride, int16_t* block) {
+    int dc = (block[0] + 32) >> 6;
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            dst[x] = Clip1(dst[x] + dc);
+        }
+        dst += stride;
+    }
+    block[0] = 0;
+}
+
+static inline int Tap6(int a, int b, int c, int d, int e, int f) {
+    return a - 5 * b + 20 * c + 20 * d - 5 * e + f;
+}
+
+struct ScalarMc {
+    static void Copy(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride,
+                     int width, int height) {
+        for (int y = 0; y < height; y++) {
+            memcpy(dst + y * dstStride, src + y * srcStride, width);
+        }
+    }
+
+    // b: half sample between columns x and x + 1
+    static void HalfH(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride,
+                      int width, int height) {
+        for (int y = 0; y < height; y++) {
+            const uint8_t* s = src + y * srcStride;
+            for (int x = 0; x < width; x++) {
+                dst[y * dstStride + x] =
+                    Clip1((Tap6(s[x - 2], s[x - 1], s[x], s[x + 1], s[x + 2], s[x + 3]) + 16) >> 5);
+            }
+        }
+    }
+
+    // h: half sample between rows y and y + 1
+    static void HalfV(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride,
+                      int width, int height) {
+        for (int y = 0; y < height; y++) {
+            const uint8_t* s = src + y * srcStride;
+            for (int x = 0; x < width; x++) {
+                dst[y * dstStride + x] = Clip1((Tap6(s[x - 2 * srcStride], s[x - srcStride], s[x],
+                                                     s[x + srcStride], s[x + 2 * srcStride],
+                                                     s[x + 3 * srcStride]) + 16) >> 5);
+            }
+        }
+    }
+
+    // j: the centre, from the unrounded horizontal half samples
+    static void HalfHV(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride,
+                       int width, int height) {
+        int16_t tmp[21 * 16];
+        for (int y = -2; y < height + 3; y++) {
+            const uint8_t* s = src + y * srcStride;
+            for (int x = 0; x < width; x++) {
+                tmp[(y + 2) * 16 + x] =
+                    (int16_t)Tap6(s[x - 2], s[x - 1], s[x], s[x + 1], s[x + 2], s[x + 3]);
+            }
+        }
+        for (int y = 0; y < height; y++) {
+            const int16_t* t = tmp + (y + 2) * 16;
+            for (int x = 0; x < width; x++) {
+                dst[y * dstStride + x] =
+                    Clip1((Tap6(t[x - 32], t[x - 16], t[x], t[x + 16], t[x + 32], t[x + 48]) + 512) >> 10);
+            }
+        }
+    }
+
+    static void Average(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* a, ptrdiff_t aStride,
+                        const uint8_t* b, ptrdiff_t bStride, int width, int height) {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                dst[y * dstStride + x] = (uint8_t)((a[y * aStride + x] + b[y * bStride + x] + 1) >> 1);
+            }
+        }
+    }
+};
+
+// The quarter sample positions of Table 8-12 from the half sample planes
+// b (HalfH), h (HalfV) and j (HalfHV), and their neighbours s = b one row
+// down and m = h one column right.
+template <typename Mc>
+static void LumaMc(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride,
+                   int width, int height, int xFrac, int yFrac) {
+    uint8_t a[16 * 16];
+    uint8_t b[16 * 16];
+    switch (yFrac * 4 + xFrac) {
+    case 0:     // G
+        Mc::Copy(dst, dstStride, src, srcStride, width, height);
+        break;
+    case 1:     // a
+        Mc::HalfH(a, 16, src, srcStride, width, height);
+        Mc::Average(dst, dstStride, a, 16, src, srcStride, width, height);
+        break;
+    case 2:     // b
+        Mc::HalfH(dst, dstStride, src, srcStride, width, height);
+        break;
+    case 3:     // c
+        Mc::HalfH(a, 16, src, srcStride, width, height);
+        Mc::Average(dst, dstStride, a, 16, src + 1, srcStride, width, height);
+        break;
+    case 4:     // d
+        Mc::HalfV(a, 16, src, srcStride, width, height);
+        Mc::Average(dst, dstStride, a, 16, src, srcStride, width, height);
+        break;
+    case 8:     // h
+        Mc::HalfV(dst, dstStride, src, srcStride, width, height);
+        break;
+    case 12:    // n
+        Mc::HalfV(a, 16, src, srcStride, width, height);
+        Mc::Average(dst, dstStride, a, 16, src + srcStride, srcStride, width, height);
+        break;
+    case 5:     // e = (b + h)
+    case 7:     // g = (b + m)
+    case 13:    // p = (h + s)
+    case 15:    // r = (m + s)
+        Mc::HalfH(a, 16, src + (yFrac == 3 ? srcStride : 0), srcStride, width, height);
+        Mc::HalfV(b, 16, src + (xFrac == 3 ? 1 : 0), srcStride, width, height);
+        Mc::Average(dst, dstStride, a, 16, b, 16, width, height);
+        break;
+    case 10:    // j
+        Mc::HalfHV(dst, dstStride, src, srcStride, width, height);
+        break;
+    case 6:     // f = (b + j)
+    case 14:    // q = (j + s)
+        Mc::HalfHV(a, 16, src, srcStride, width, height);
+        Mc::HalfH(b, 16, src + (yFrac == 3 ? srcStride : 0), srcStride, width, height);
+        Mc::Average(dst, dstStride, a, 16, b, 16, width, height);
+        break;
+    case 9:     // i = (h + j)
+    case 11:    // k = (j + m)
+        Mc::HalfHV(a, 16, src, srcStride, width, height);
+        Mc::HalfV(b, 16, src + (xFrac == 3 ? 1 : 0), srcStride, width, height);
+        Mc::Average(dst, dstStride, a, 16, b, 16, width, height);
+        break;
+    }
+}
+
+static void LumaMcScalar(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride,
+                         int width, int height, int xFrac, int yFrac) {
+    LumaMc<ScalarMc>(dst, dstStride, src, srcStride, width, height, xFrac, yFrac);
+}
+
+static void ChromaMcScalar(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride,
+                           int width, int height, int xFrac, int yFrac) {
+    int wA = (8 - xFrac) * (8 - yFrac);
+    int wB = xFrac * (8 - yFrac);
+    int wC = (8 - xFrac) * yFrac;
+    int wD = xFrac * yFrac;
+    for (int y = 0; y < height; y++) {
+        const uint8_t* s = src + y * srcStride;
+        for (int x = 0; x < 2 * width; x++) {
+            dst[y * dstStride + x] = (uint8_t)((wA * s[x] + wB * s[x + 2] + wC * s[x + srcStride]
+                                                + wD * s[x + srcStride + 2] + 32) >> 6);
+        }
+    }
+}
+
+const H264DspFunctions& H264DspScalar() {
+    static const H264DspFunctions functions = {
+        IdctAdd4x4Scalar,
+        IdctDcAdd4x4Scalar,
+        LumaMcScalar,
+        ChromaMcScalar,
+        "scalar",
+    };
+    return functions;
+}
+
+#if FLUXMIC_H264_SSE2
+
+// ============================================================================
+// SSE2 kernels
+// ============================================================================
+
+static inline __m128i Load8(const uint8_t* p) {
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+}
+
+// Store the low `width` (4, 8 or 16) bytes
+static inline void StoreBytes(uint8_t* p, __m128i v, int width) {
+    if (width == 16) {
+        _mm_storeu_si128((__m128i*)p, v);
+    } else if (width == 8) {
+        _mm_storel_epi64((__m128i*)p, v);
+    } else {
+        int32_t word = _mm_cvtsi128_si32(v);
+        memcpy(p, &word, 4);
+    }
+}
+
+static inline void Transpose4x4(__m128i& r0, __m128i& r1, __m128i& r2, __m128i& r3) {
+    __m128i t0 = _mm_unpacklo_epi16(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi16(r2, r3);
+    __m128i c01 = _mm_unpacklo_epi32(t0, t1);
+    __m128i c23 = _mm_unpackhi_epi32(t0, t1);
+    r0 = c01;
+    r1 = _mm_srli_si128(c01, 8);
+    r2 = c23;
+    r3 = _mm_srli_si128(c23, 8);
+}
+
+static inline void Butterfly4(__m128i& d0, __m128i& d1, __m128i& d2, __m128i& d3) {
+    __m128i e0 = _mm_add_epi16(d0, d2);
+    __m128i e1 = _mm_sub_epi16(d0, d2);
+    __m128i e2 = _mm_sub_epi16(_mm_srai_epi16(d1, 1), d3);
+    __m128i e3 = _mm_add_epi16(d1, _mm_srai_epi16(d3, 1));
+    d0 = _mm_add_epi16(e0, e3);
+    d1 = _mm_add_epi16(e1, e2);
+    d2 = _mm_sub_epi16(e1, e2);
+    d3 = _mm_sub_epi16(e0, e3);
+}
+
+static inline void AddRow4(uint8_t* dst, __m128i residual) {
+    int32_t word;
+    memcpy(&word, dst, 4);
+    __m128i pred = _mm_unpacklo_epi8(_mm_cvtsi32_si128(word), _mm_setzero_si128());
+    __m128i sum = _mm_packus_epi16(_mm_add_epi16(pred, residual), _mm_setzero_si128());
+    word = _mm_cvtsi128_si32(sum);
+    memcpy(dst, &word, 4);
+}
+
+static void IdctAdd4x4Sse2(uint8_t* dst, ptrdiff_t stride, int16_t* block) {
+    __m128i r0 = _mm_loadl_epi64((const __m128i*)(block + 0));
+    __m128i r1 = _mm_loadl_epi64((const __m128i*)(block + 4));
+    __m128i r2 = _mm_loadl_epi64((const __m128i*)(block + 8));
+    __m128i r3 = _mm_loadl_epi64((const __m128i*)(block + 12));
+
+    // Rows first: with the block transposed, lane i of register k is
+    // coefficient k of row i
+    Transpose4x4(r0, r1, r2, r3);
+    Butterfly4(r0, r1, r2, r3);
+    Transpose4x4(r0, r1, r2, r3);
+    Butterfly4(r0, r1, r2, r3);
+
+    __m128i round = _mm_set1_epi16(32);
+    AddRow4(dst, _mm_srai_epi16(_mm_add_epi16(r0, round), 6));
+    AddRow4(dst + stride, _mm_srai_epi16(_mm_add_epi16(r1, round), 6));
+    AddRow4(dst + 2 * stride, _mm_srai_epi16(_mm_add_epi16(r2, round), 6));
+    AddRow4(dst + 3 * stride, _mm_srai_epi16(_mm_add_epi16(r3, round), 6));
+
+    _mm_storeu_si128((__m128i*)block, _mm_setzero_si128());
+    _mm_storeu_si128((__m128i*)(block + 8), _mm_setzero_si128());
+}
+
+static void IdctDcAdd4x4Sse2(uint8_t* dst, ptrdiff_t stride, int16_t* block) {
+    __m128i dc = _mm_set1_epi16((int16_t)((block[0] + 32) >> 6));
+    for (int y = 0; y < 4; y++) {
+        AddRow4(dst + y * stride, dc);
+    }
+    block[0] = 0;
+}
+
+// Six-tap filter of 8 samples held as 16-bit lanes, not rounded
+static inline __m128i Tap6x8(__m128i a, __m128i b, __m128i c, __m128i d, __m128i e, __m128i f) {
+    __m128i outer = _mm_add_epi16(a, f);
+    __m128i inner = _mm_add_epi16(c, d);
+    __m128i middle = _mm_add_epi16(b, e);
+    __m128i sum = _mm_add_epi16(outer, _mm_slli_epi16(inner, 4));
+    sum = _mm_add_epi16(sum, _mm_slli_epi16(inner, 2));
+    return _mm_sub_epi16(sum, _mm_add_epi16(middle, _mm_slli_epi16(middle, 2)));
+}
+
+static inline __m128i RoundHalf(__m128i sum) {
+    return _mm_srai_epi16(_mm_add_epi16(sum, _mm_set1_epi16(16)), 5);
+}
+
+struct Sse2Mc {
+    static void Copy(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride,
+                     int width, int height) {
+        for (int y = 0; y < height; y++) {
+            StoreBytes(dst + y * dstStride, _mm_loadu_si128((const __m128i*)(src + y * srcStride)), width);
+        }
+    }
+
+    static void HalfH(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride,
+                      int width, int height) {
+        for (int y = 0; y < height; y++) {
+            const uint8_t* s = src + y * srcStride;
+            __m128i lo = RoundHalf(Tap6x8(Load8(s - 2), Load8(s - 1), Load8(s),
+                                          Load8(s + 1), Load8(s + 2), Load8(s + 3)));
+            __m128i hi = _mm_setzero_si128();
+            if (width == 16) {
+                hi = RoundHalf(Tap6x8(Load8(s + 6), Load8(s + 7), Load8(s + 8),
+                                      Load8(s + 9), Load8(s + 10), Load8(s + 11)));
+            }
+            StoreBytes(dst + y * dstStride, _mm_packus_epi16(lo, hi), width);
+        }
+    }
+
+    static void HalfV(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride,
+                      int width, int height) {
+        for (int x = 0; x < width; x += 8) {
+            const uint8_t* s = src + x;
+            __m128i r0 = Load8(s - 2 * srcStride);
+            __m128i r1 = Load8(s - srcStride);
+            __m128i r2 = Load8(s);
+            __m128i r3 = Load8(s + srcStride);
+            __m128i r4 = Load8(s + 2 * srcStride);
+            for (int y = 0; y < height; y++) {
+                __m128i r5 = Load8(s + (y + 3) * srcStride);
+                __m128i v = RoundHalf(Tap6x8(r0, r1, r2, r3, r4, r5));
+                StoreBytes(dst + y * dstStride + x, _mm_packus_epi16(v, v), width < 8 ? width : 8);
+                r0 = r1; r1 = r2; r2 = r3; r3 = r4; r4 = r5;
+            }
+        }
+    }
+
+    static void HalfHV(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride,
+                       int width, int height) {
+        // Unrounded horizontal half samples of rows -2 to height + 2; they
+        // fit in 16 bits, but the vertical filter of them needs 32
+        alignas(16) int16_t tmp[21 * 16];
+        for (int y = 0; y < height + 5; y++) {
+            const uint8_t* s = src + (y - 2) * srcStride;
+            for (int x = 0; x < width; x += 8) {
+                __m128i v = Tap6x8(Load8(s + x - 2), Load8(s + x - 1), Load8(s + x),
+                                   Load8(s + x + 1), Load8(s + x + 2), Load8(s + x + 3));
+                _mm_store_si128((__m128i*)(tmp + y * 16 + x), v);
+            }
+        }
+        const __m128i one = _mm_set1_epi16(1);
+        const __m128i minusFive = _mm_set1_epi16(-5);
+        const __m128i twenty = _mm_set1_epi16(20);
+        const __m128i round = _mm_set1_epi32(512);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x += 8) {
+                const int16_t* t = tmp + y * 16 + x;
+                __m128i a = _mm_load_si128((const __m128i*)(t + 0 * 16));
+                __m128i b = _mm_load_si128((const __m128i*)(t + 1 * 16));
+                __m128i c = _mm_load_si128((const __m128i*)(t + 2 * 16));
+                __m128i d = _mm_load_si128((const __m128i*)(t + 3 * 16));
+                __m128i e = _mm_load_si128((const __m128i*)(t + 4 * 16));
+                __m128i f = _mm_load_si128((const __m128i*)(t + 5 * 16));
+                __m128i lo = _mm_add_epi32(
+                    _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, f), one),
+                                  _mm_madd_epi16(_mm_unpacklo_epi16(b, e), minusFive)),
+                    _mm_madd_epi16(_mm_unpacklo_epi16(c, d), twenty));
+                __m128i hi = _mm_add_epi32(
+                    _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, f), one),
+                                  _mm_madd_epi16(_mm_unpackhi_epi16(b, e), minusFive)),
+                    _mm_madd_epi16(_mm_unpackhi_epi16(c, d), twenty));
+                lo = _mm_srai_epi32(_mm_add_epi32(lo, round), 10);
+                hi = _mm_srai_epi32(_mm_add_epi32(hi, round), 10);
+                __m128i v = _mm_packs_epi32(lo, hi);
+                StoreBytes(dst + y * dstStride + x, _mm_packus_epi16(v, v), width < 8 ? width : 8);
+            }
+        }
+    }
+
+    static void Average(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* a, ptrdiff_t aStride,
+                        const uint8_t* b, ptrdiff_t bStride, int width, int height) {
+        for (int y = 0; y < height; y++) {
+            __m128i va = _mm_loadu_si128((const __m128i*)(a + y * aStride));
+            __m128i vb = _mm_loadu_si128((const __m128i*)(b + y * bStride));
+            StoreBytes(dst + y * dstStride, _mm_avg_epu8(va, vb), width);
+        }
+    }
+};
+
+static void LumaMcSse2(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride,
+                       int width, int height, int xFrac, int yFrac) {
+    LumaMc<Sse2Mc>(dst, dstStride, src, srcStride, width, height, xFrac, yFrac);
+}
+
+static void ChromaMcSse2(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride,
+                         int width, int height, int xFrac, int yFrac) {
+    const __m128i wA = _mm_set1_epi16((int16_t)((8 - xFrac) * (8 - yFrac)));
+    const __m128i wB = _mm_set1_epi16((int16_t)(xFrac * (8 - yFrac)));
+    const __m128i wC = _mm_set1_epi16((int16_t)((8 - xFrac) * yFrac));
+    const __m128i wD = _mm_set1_epi16((int16_t)(xFrac * yFrac));
+    const __m128i round = _mm_set1_epi16(32);
+    int bytes = 2 * width;
+    for (int y = 0; y < height; y++) {
+        const uint8_t* s = src + y * srcStride;
+        for (int x = 0; x < bytes; x += 8) {
+            __m128i sum = _mm_add_epi16(_mm_mullo_epi16(Load8(s + x), wA),
+                                        _mm_mullo_epi16(Load8(s + x + 2), wB));
+            sum = _mm_add_epi16(sum, _mm_mullo_epi16(Load8(s + x + srcStride), wC));
+            sum = _mm_add_epi16(sum, _mm_mullo_epi16(Load8(s + x + srcStride + 2), wD));
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 6);
+            StoreBytes(dst + y * dstStride + x, _mm_packus_epi16(sum, sum), bytes < 8 ? bytes : 8);
+        }
+    }
+}
+
+const H264DspFunctions& H264DspBest() {
+    static const H264DspFunctions functions = {
+        IdctAdd4x4Sse2,
+        IdctDcAdd4x4Sse2,
+        LumaMcSse2,
+        ChromaMcSse2,
+        "sse2",
+    };
+    return functions;
+}
+
+#else
+
+const H264DspFunctions& H264DspBest() {
+    return H264DspScalar();
+}
+
+#endif
+
+} // namespace FluxMic
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace FluxMic {
+
+/// The per-block kernels of the software H.264 decoder: the inverse
+/// transforms of ITU-T H.264 8.5.12 and the sample interpolation of 8.4.2.2,
+/// for 8-bit 4:2:0 pictures with interleaved (NV12) chroma.
+///
+/// Each implementation gives bit-identical results; the SIMD one is only
+/// faster. The tests check that against the scalar one.
+struct H264DspFunctions {
+    /// Add the inverse transform of a dequantised 4x4 block (raster order)
+    /// to the prediction in `dst`, and clear the block.
+    void (*idctAdd4x4)(uint8_t* dst, ptrdiff_t stride, int16_t* block);
+
+    /// The same for a block in which only the DC coefficient is non-zero.
+    void (*idctDcAdd4x4)(uint8_t* dst, ptrdiff_t stride, int16_t* block);
+
+    /// Luma prediction of a `width` x `height` block (4, 8 or 16 each) at
+    /// the quarter sample offset (xFrac, yFrac) from the integer position
+    /// `src`. Rows -2 to height + 2 and columns -2 to width + 12 around it
+    /// may be read.
+    void (*lumaMc)(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride,
+                   int width, int height, int xFrac, int yFrac);
+
+    /// Prediction of `width` x `height` interleaved CbCr pairs (2, 4 or 8
+    /// each) at the eighth sample offset (xFrac, yFrac) from `src`. One more
+    /// row, and up to 8 bytes beyond the row, may be read.
+    void (*chromaMc)(uint8_t* dst, ptrdiff_t dstStride, const uint8_t* src, ptrdiff_t srcStride,
+                     int width, int height, int xFrac, int yFrac);
+
+    const char* name;
+};
+
+/// Plain C++ kernels, the reference for the others.
+const H264DspFunctions& H264DspScalar();
+
+/// The fastest kernels this build has: SSE2 when the compiler targets it,
+/// otherwise the scalar ones.
+const H264DspFunctions& H264DspBest();
+
+/// Inverse Intra16x16 DC transform and scaling (8.5.10), in place. `dc`
+/// holds the 4x4 DC levels in raster order; the result is the DC
+/// coefficient of each 4x4 luma block, also in raster order.
+void H264LumaDcDequant(int16_t* dc, int qp);
+
+/// Inverse chroma DC transform and scaling for 4:2:0 (8.5.11.2), in place.
+void H264ChromaDcDequant(int16_t* dc, int qp);
+
+/// LevelScale4x4 / 16 for flat scaling matrices, by [qP % 6][raster position]
+extern const uint8_t kH264Dequant4x4[6][16];
+
+} // namespace FluxMic
@@ -0,0 +1,284 @@
+#include "H264Intra.h"
+
+#include <cstring>
+
+namespace FluxMic {
+
+static inline uint8_t Clip1(int value) {
+    return (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+// ============================================================================
+// Intra_4x4 (8.3.1.2)
+// ============================================================================
+
+void PredictIntra4x4(uint8_t* dst, ptrdiff_t stride, int mode, unsigned neighbours) {
+    // p[x, -1] for x = -1..7 at top[x + 1], p[-1, y] for y = -1..3 at left[y + 1]
+    int top[9];
+    int left[5];
+    const uint8_t* above = dst - stride;
+    top[0] = left[0] = above[-1];
+    for (int x = 0; x < 4; x++) {
+        top[x + 1] = above[x];
+    }
+    for (int x = 4; x < 8; x++) {
+        // Substituted by p[3, -1] when not available (8.3.1.2)
+        top[x + 1] = (neighbours & kIntraTopRight) ? above[x] : above[3];
+    }
+    for (int y = 0; y < 4; y++) {
+        left[y + 1] = dst[y * stride - 1];
+    }
+    auto P = [&](int x, int y) -> int {     // p[x, -1] or p[-1, y]
+        return (y < 0) ? top[x + 1] : left[y + 1];
+    };
+
+    int pred[4][4];
+    switch (mode) {
+    case kIntra4x4Vertical:
+        for (int y = 0; y < 4; y++)
+            for (int x = 0; x < 4; x++)
+                pred[y][x] = P(x, -1);
+        break;
+
+    case kIntra4x4Horizontal:
+        for (int y = 0; y < 4; y++)
+            for (int x = 0; x < 4; x++)
+                pred[y][x] = P(-1, y);
+        break;
+
+    case kIntra4x4Dc: {
+        bool haveTop = (neighbours & kIntraTop) != 0;
+        bool haveLeft = (neighbours & kIntraLeft) != 0;
+        int sumTop = P(0, -1) + P(1, -1) + P(2, -1) + P(3, -1);
+        int sumLeft = P(-1, 0) + P(-1, 1) + P(-1, 2) + P(-1, 3);
+        int dc = 128;
+        if (haveTop && haveLeft) dc = (sumTop + sumLeft + 4) >> 3;
+        else if (haveLeft) dc = (sumLeft + 2) >> 2;
+        else if (haveTop) dc = (sumTop + 2) >> 2;
+        for (int y = 0; y < 4; y++)
+            for (int x = 0; x < 4; x++)
+                pred[y][x] = dc;
+        break;
+    }
+
+    case kIntra4x4DiagonalDownLeft:
+        for (int y = 0; y < 4; y++)
+            for (int x = 0; x < 4; x++)
+                pred[y][x] = (x == 3 && y == 3)
+                    ? (P(6, -1) + 3 * P(7, -1) + 2) >> 2
+                    : (P(x + y, -1) + 2 * P(x + y + 1, -1) + P(x + y + 2, -1) + 2) >> 2;
+        break;
+
+    case kIntra4x4DiagonalDownRight:
+        for (int y = 0; y < 4; y++)
+            for (int x = 0; x < 4; x++)
+                if (x > y)
+                    pred[y][x] = (P(x - y - 2, -1) + 2 * P(x - y - 1, -1) + P(x - y, -1) + 2) >> 2;
+                else if (x < y)
+                    pred[y][x] = (P(-1, y - x - 2) + 2 * P(-1, y - x - 1) + P(-1, y - x) + 2) >> 2;
+                else
+                    pred[y][x] = (P(0, -1) + 2 * P(-1, -1) + P(-1, 0) + 2) >> 2;
+        break;
+
+    case kIntra4x4VerticalRight:
+        for (int y = 0; y < 4; y++)
+            for (int x = 0; x < 4; x++) {
+                int z = 2 * x - y;
+                if (z >= 0 && (z & 1) == 0)
+                    pred[y][x] = (P(x - (y >> 1) - 1, -1) + P(x - (y >> 1), -1) + 1) >> 1;
+                else if (z >= 0)
+                    pred[y][x] = (P(x - (y >> 1) - 2, -1) + 2 * P(x - (y >> 1) - 1, -1)
+                                  + P(x - (y >> 1), -1) + 2) >> 2;
+                else if (z == -1)
+                    pred[y][x] = (P(-1, 0) + 2 * P(-1, -1) + P(0, -1) + 2) >> 2;
+                else
+                    pred[y][x] = (P(-1, y - 1) + 2 * P(-1, y - 2) + P(-1, y - 3) + 2) >> 2;
+            }
+        break;
+
+    case kIntra4x4HorizontalDown:
+        for (int y = 0; y < 4; y++)
+            for (int x = 0; x < 4; x++) {
+                int z = 2 * y - x;
+                if (z >= 0 && (z & 1) == 0)
+                    pred[y][x] = (P(-1, y - (x >> 1) - 1) + P(-1, y - (x >> 1)) + 1) >> 1;
+                else if (z >= 0)
+                    pred[y][x] = (P(-1, y - (x >> 1) - 2) + 2 * P(-1, y - (x >> 1) - 1)
+                                  + P(-1, y - (x >> 1)) + 2) >> 2;
+                else if (z == -1)
+                    pred[y][x] = (P(-1, 0) + 2 * P(-1, -1) + P(0, -1) + 2) >> 2;
+                else
+                    pred[y][x] = (P(x - 1, -1) + 2 * P(x - 2, -1) + P(x - 3, -1) + 2) >> 2;
+            }
+        break;
+
+    case kIntra4x4VerticalLeft:
+        for (int y = 0; y < 4; y++)
+            for (int x = 0; x < 4; x++)
+                pred[y][x] = (y & 1)
+                    ? (P(x + (y >> 1), -1) + 2 * P(x + (y >> 1) + 1, -1) + P(x + (y >> 1) + 2, -1) + 2) >> 2
+                    : (P(x + (y >> 1), -1) + P(x + (y >> 1) + 1, -1) + 1) >> 1;
+        break;
+
+    case kIntra4x4HorizontalUp:
+    default:
+        for (int y = 0; y < 4; y++)
+            for (int x = 0; x < 4; x++) {
+                int z = x + 2 * y;
+                if (z > 5)
+                    pred[y][x] = P(-1, 3);
+                else if (z == 5)
+                    pred[y][x] = (P(-1, 2) + 3 * P(-1, 3) + 2) >> 2;
+                else if (z & 1)
+                    pred[y][x] = (P(-1, y + (x >> 1)) + 2 * P(-1, y + (x >> 1) + 1)
+                                  + P(-1, y + (x >> 1) + 2) + 2) >> 2;
+                else
+                    pred[y][x] = (P(-1, y + (x >> 1)) + P(-1, y + (x >> 1) + 1) + 1) >> 1;
+            }
+        break;
+    }
+
+    for (int y = 0; y < 4; y++)
+        for (int x = 0; x < 4; x++)
+            dst[y * stride + x] = (uint8_t)pred[y][x];
+}
+
+// ============================================================================
+// Intra_16x16 (8.3.3)
+// ============================================================================
+
+void PredictIntra16x16(uint8_t* dst, ptrdiff_t stride, int mode, unsigned neighbours) {
+    const uint8_t* above = dst - stride;
+    switch (mode) {
+    case kIntra16x16Vertical:
+        for (int y = 0; y < 16; y++) {
+            memcpy(dst + y * stride, above, 16);
+        }
+        break;
+
+    case kIntra16x16Horizontal:
+        for (int y = 0; y < 16; y++) {
+            memset(dst + y * stride, dst[y * stride - 1], 16);
+        }
+        break;
+
+    case kIntra16x16Dc: {
+        int sumTop = 0;
+        int sumLeft = 0;
+        for (int i = 0; i < 16; i++) {
+            sumTop += above[i];
+            sumLeft += dst[i * stride - 1];
+        }
+        bool haveTop = (neighbours & kIntraTop) != 0;
+        bool haveLeft = (neighbours & kIntraLeft) != 0;
+        int dc = 128;
+        if (haveTop && haveLeft) dc = (sumTop + sumLeft + 16) >> 5;
+        else if (haveLeft) dc = (sumLeft + 8) >> 4;
+        else if (haveTop) dc = (sumTop + 8) >> 4;
+        for (int y = 0; y < 16; y++) {
+            memset(dst + y * stride, dc, 16);
+        }
+        break;
+    }
+
+    case kIntra16x16Plane:
+    default: {
+        // p[-1, -1] is at above[-1] and at the left column's row -1
+        int h = 0;
+        int v = 0;
+        for (int i = 0; i < 8; i++) {
+            h += (i + 1) * (above[8 + i] - above[6 - i]);
+            v += (i + 1) * (dst[(8 + i) * stride - 1] - dst[(6 - i) * stride - 1]);
+        }
+        int a = 16 * (dst[15 * stride - 1] + above[15]);
+        int b = (5 * h + 32) >> 6;
+        int c = (5 * v + 32) >> 6;
+        for (int y = 0; y < 16; y++) {
+            for (int x = 0; x < 16; x++) {
+                dst[y * stride + x] = Clip1((a + b * (x - 7) + c * (y - 7) + 16) >> 5);
+            }
+        }
+        break;
+    }
+    }
+}
+
+// ============================================================================
+// Chroma (8.3.4), one component of the interleaved pair at a time
+// ============================================================================
+
+static void PredictChromaComponent(uint8_t* dst, ptrdiff_t stride, int mode, unsigned neighbours) {
+    // Sample x of the component is at dst[2 * x]
+    const uint8_t* above = dst - stride;
+    auto Top = [&](int x) -> int { return above[2 * x]; };
+    auto Left = [&](int y) -> int { return dst[y * stride - 2]; };
+    auto Put = [&](int x, int y, int value) { dst[y * stride + 2 * x] = (uint8_t)value; };
+
+    switch (mode) {
+    case kIntraChromaDc:
+    default: {
+        bool haveTop = (neighbours & kIntraTop) != 0;
+        bool haveLeft = (neighbours & kIntraLeft) != 0;
+        for (int yO = 0; yO < 8; yO += 4) {
+            for (int xO = 0; xO < 8; xO += 4) {
+                int sumTop = Top(xO) + Top(xO + 1) + Top(xO + 2) + Top(xO + 3);
+                int sumLeft = Left(yO) + Left(yO + 1) + Left(yO + 2) + Left(yO + 3);
+                int dc = 128;
+                if ((xO == 0 && yO == 0) || (xO > 0 && yO > 0)) {
+                    if (haveTop && haveLeft) dc = (sumTop + sumLeft + 4) >> 3;
+                    else if (haveLeft) dc = (sumLeft + 2) >> 2;
+                    else if (haveTop) dc = (sumTop + 2) >> 2;
+                } else if (xO > 0) {
+                    // Upper right block: prefers the samples above
+                    if (haveTop) dc = (sumTop + 2) >> 2;
+                    else if (haveLeft) dc = (sumLeft + 2) >> 2;
+                } else {
+                    // Lower left block: prefers the samples to the left
+                    if (haveLeft) dc = (sumLeft + 2) >> 2;
+                    else if (haveTop) dc = (sumTop + 2) >> 2;
+                }
+                for (int y = 0; y < 4; y++)
+                    for (int x = 0; x < 4; x++)
+                        Put(xO + x, yO + y, dc);
+            }
+        }
+        break;
+    }
+
+    case kIntraChromaHorizontal:
+        for (int y = 0; y < 8; y++)
+            for (int x = 0; x < 8; x++)
+                Put(x, y, Left(y));
+        break;
+
+    case kIntraChromaVertical:
+        for (int y = 0; y < 8; y++)
+            for (int x = 0; x < 8; x++)
+                Put(x, y, Top(x));
+        break;
+
+    case kIntraChromaPlane: {
+        // p[-1, -1] is both Top(-1) and Left(-1)
+        int h = 0;
+        int v = 0;
+        for (int i = 0; i < 4; i++) {
+            h += (i + 1) * (Top(4 + i) - Top(2 - i));
+            v += (i + 1) * (Left(4 + i) - Left(2 - i));
+        }
+        int a = 16 * (Left(7) + Top(7));
+        int b = (34 * h + 32) >> 6;
+        int c = (34 * v + 32) >> 6;
+        for (int y = 0; y < 8; y++)
+            for (int x = 0; x < 8; x++)
+                Put(x, y, Clip1((a + b * (x - 3) + c * (y - 3) + 16) >> 5));
+        break;
+    }
+    }
+}
+
+void PredictIntraChroma(uint8_t* dst, ptrdiff_t stride, int mode, unsigned neighbours) {
+    PredictChromaComponent(dst, stride, mode, neighbours);        // Cb
+    PredictChromaComponent(dst + 1, stride, mode, neighbours);    // Cr
+}
+
+} // namespace FluxMic
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace FluxMic {
+
+/// Neighbouring samples which may be used for intra prediction (ITU-T H.264
+/// 8.3.1.2, 8.3.3, 8.3.4): those of a macroblock which is available and,
+/// with constrained_intra_pred_flag, intra coded.
+enum IntraNeighbours : unsigned {
+    kIntraLeft      = 1,
+    kIntraTop       = 2,
+    kIntraTopLeft   = 4,
+    kIntraTopRight  = 8,    // Intra_4x4 only
+};
+
+/// Intra4x4PredMode (Table 8-2)
+enum Intra4x4Mode {
+    kIntra4x4Vertical = 0,
+    kIntra4x4Horizontal,
+    kIntra4x4Dc,
+    kIntra4x4DiagonalDownLeft,
+    kIntra4x4DiagonalDownRight,
+    kIntra4x4VerticalRight,
+    kIntra4x4HorizontalDown,
+    kIntra4x4VerticalLeft,
+    kIntra4x4HorizontalUp,
+};
+
+/// Intra16x16PredMode (Table 8-4)
+enum Intra16x16Mode {
+    kIntra16x16Vertical = 0,
+    kIntra16x16Horizontal,
+    kIntra16x16Dc,
+    kIntra16x16Plane,
+};
+
+/// intra_chroma_pred_mode (Table 8-5)
+enum IntraChromaMode {
+    kIntraChromaDc = 0,
+    kIntraChromaHorizontal,
+    kIntraChromaVertical,
+    kIntraChromaPlane,
+};
+
+// Each predicts the block at `dst` from the samples around it in the same
+// picture: the row above (and, for 4x4 blocks, 4 to its right) and the
+// column to the left. Samples whose IntraNeighbours bit isn't set are not
+// used, except as the spec substitutes them.
+
+/// A 4x4 luma block
+void PredictIntra4x4(uint8_t* dst, ptrdiff_t stride, int mode, unsigned neighbours);
+
+/// A 16x16 luma macroblock
+void PredictIntra16x16(uint8_t* dst, ptrdiff_t stride, int mode, unsigned neighbours);
+
+/// Both 8x8 chroma blocks of a macroblock, interleaved as in NV12
+void PredictIntraChroma(uint8_t* dst, ptrdiff_t stride, int mode, unsigned neighbours);
+
+} // namespace FluxMic
@@ -0,0 +1,239 @@
+#include "H264ParameterSets.h"
+
+namespace FluxMic {
+
+// Larger than any level allows (level 6.2: 139264 macroblocks per frame)
+static const uint32_t kMaxFrameMbs = 139264;
+static const uint32_t kMaxWidthInMbs = 1024;
+
+// scaling_list() (7.3.2.1.1.1); the values are not kept
+static void SkipScalingList(BitReader& reader, int size) {
+    int lastScale = 8;
+    int nextScale = 8;
+    for (int j = 0; j < size; j++) {
+        if (nextScale != 0) {
+            int delta = reader.ReadSe();
+            nextScale = (lastScale + delta + 256) % 256;
+        }
+        lastScale = (nextScale == 0) ? lastScale : nextScale;
+    }
+}
+
+// vui_parameters() (E.1.1) up to and including timing_info; the rest of
+// it isn't needed
+static void ParseVuiTiming(BitReader& reader, H264Sps& sps) {
+    if (reader.ReadBit()) {             // aspect_ratio_info_present_flag
+        if (reader.ReadBits(8) == 255) {
+            reader.SkipBits(32);        // sar_width, sar_height (Extended_SAR)
+        }
+    }
+    if (reader.ReadBit()) {             // overscan_info_present_flag
+        reader.ReadBit();
+    }
+    if (reader.ReadBit()) {             // video_signal_type_present_flag
+        reader.SkipBits(4);             // video_format, video_full_range_flag
+        if (reader.ReadBit()) {         // colour_description_present_flag
+            reader.SkipBits(24);
+        }
+    }
+    if (reader.ReadBit()) {             // chroma_loc_info_present_flag
+        reader.ReadUe();
+        reader.ReadUe();
+    }
+    if (!reader.ReadBit()) return;      // timing_info_present_flag
+    uint32_t numUnitsInTick = reader.ReadBits(32);
+    uint32_t timeScale = reader.ReadBits(32);
+    bool fixedFrameRate = reader.ReadBit() != 0;
+    if (reader.Overrun() || numUnitsInTick == 0 || timeScale == 0) return;
+    sps.timingInfoPresent = true;
+    sps.numUnitsInTick = numUnitsInTick;
+    sps.timeScale = timeScale;
+    sps.fixedFrameRate = fixedFrameRate;
+}
+
+static bool IsHighProfile(uint8_t profileIdc) {
+    switch (profileIdc) {
+    case 100: case 110: case 122: case 244: case 44:
+    case 83: case 86: case 118: case 128: case 138: case 139: case 134: case 135:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool ParseSps(BitReader& reader, H264Sps& sps) {
+    sps = H264Sps();
+    sps.profileIdc = (uint8_t)reader.ReadBits(8);
+    sps.constraintFlags = (uint8_t)reader.ReadBits(8);
+    sps.levelIdc = (uint8_t)reader.ReadBits(8);
+    sps.id = reader.ReadUe();
+    if (sps.id > 31) return false;
+
+    if (IsHighProfile(sps.profileIdc)) {
+        sps.chromaFormatIdc = reader.ReadUe();
+        if (sps.chromaFormatIdc > 3) return false;
+        if (sps.chromaFormatIdc == 3) {
+            reader.ReadBit();   // separate_colour_plane_flag
+        }
+        sps.bitDepthLuma = reader.ReadUe() + 8;
+        sps.bitDepthChroma = reader.ReadUe() + 8;
+        if (sps.bitDepthLuma > 14 || sps.bitDepthChroma > 14) return false;
+        sps.transformBypass = reader.ReadBit() != 0;
+        sps.scalingMatrixPresent = reader.ReadBit() != 0;
+        if (sps.scalingMatrixPresent) {
+            int lists = (sps.chromaFormatIdc != 3) ? 8 : 12;
+            for (int i = 0; i < lists; i++) {
+                if (reader.ReadBit()) {
+                    SkipScalingList(reader, i < 6 ? 16 : 64);
+                }
+            }
+        }
+    }
+
+    sps.log2MaxFrameNum = reader.ReadUe() + 4;
+    if (sps.log2MaxFrameNum > 16) return false;
+    sps.picOrderCntType = reader.ReadUe();
+    if (sps.picOrderCntType == 0) {
+        sps.log2MaxPocLsb = reader.ReadUe() + 4;
+        if (sps.log2MaxPocLsb > 16) return false;
+    } else if (sps.picOrderCntType == 1) {
+        sps.deltaPicOrderAlwaysZero = reader.ReadBit() != 0;
+        reader.ReadSe();        // offset_for_non_ref_pic
+        reader.ReadSe();        // offset_for_top_to_bottom_field
+        uint32_t cycle = reader.ReadUe();
+        if (cycle > 255) return false;
+        for (uint32_t i = 0; i < cycle; i++) {
+            reader.ReadSe();    // offset_for_ref_frame
+        }
+    } else if (sps.picOrderCntType != 2) {
+        return false;
+    }
+
+    sps.maxNumRefFrames = reader.ReadUe();
+    if (sps.maxNumRefFrames > 16) return false;
+    sps.gapsInFrameNumAllowed = reader.ReadBit() != 0;
+
+    uint32_t widthInMbs = reader.ReadUe() + 1;
+    uint32_t heightInMapUnits = reader.ReadUe() + 1;
+    sps.frameMbsOnly = reader.ReadBit() != 0;
+    if (!sps.frameMbsOnly) {
+        sps.mbAdaptiveFrameField = reader.ReadBit() != 0;
+    }
+    reader.ReadBit();           // direct_8x8_inference_flag
+    if (widthInMbs > kMaxWidthInMbs || heightInMapUnits > kMaxFrameMbs) return false;
+    sps.widthInMbs = widthInMbs;
+    sps.heightInMbs = heightInMapUnits * (sps.frameMbsOnly ? 1 : 2);
+    if (sps.widthInMbs * sps.heightInMbs > kMaxFrameMbs) return false;
+
+    if (reader.ReadBit()) {     // frame_cropping_flag
+        // Offsets are in chroma samples, and in field lines for interlaced
+        uint32_t unitX = (sps.chromaFormatIdc == 1 || sps.chromaFormatIdc == 2) ? 2 : 1;
+        uint32_t unitY = (sps.chromaFormatIdc == 1) ? 2 : 1;
+        if (!sps.frameMbsOnly) unitY *= 2;
+        uint32_t left = reader.ReadUe();
+        uint32_t right = reader.ReadUe();
+        uint32_t top = reader.ReadUe();
+        uint32_t bottom = reader.ReadUe();
+        uint64_t cropX = ((uint64_t)left + right) * unitX;
+        uint64_t cropY = ((uint64_t)top + bottom) * unitY;
+        if (cropX >= sps.CodedWidth() || cropY >= sps.CodedHeight()) return false;
+        sps.cropLeft = left * unitX;
+        sps.cropRight = right * unitX;
+        sps.cropTop = top * unitY;
+        sps.cropBottom = bottom * unitY;
+    }
+    if (reader.Overrun()) return false;
+    if (reader.ReadBit()) {     // vui_parameters_present_flag
+        ParseVuiTiming(reader, sps);
+    }
+    return true;
+}
+
+bool ParsePps(BitReader& reader, H264Pps& pps) {
+    pps = H264Pps();
+    pps.id = reader.ReadUe();
+    pps.spsId = reader.ReadUe();
+    if (pps.id > 255 || pps.spsId > 31) return false;
+    pps.entropyCodingMode = reader.ReadBit() != 0;
+    pps.bottomFieldPicOrderInFramePresent = reader.ReadBit() != 0;
+
+    pps.numSliceGroups = reader.ReadUe() + 1;
+    if (pps.numSliceGroups > 8) return false;
+    if (pps.numSliceGroups > 1) {
+        uint32_t mapType = reader.ReadUe();
+        if (mapType == 0) {
+            for (uint32_t i = 0; i < pps.numSliceGroups; i++) {
+                reader.ReadUe();    // run_length_minus1
+            }
+        } else if (mapType == 2) {
+            for (uint32_t i = 0; i + 1 < pps.numSliceGroups; i++) {
+                reader.ReadUe();    // top_left
+                reader.ReadUe();    // bottom_right
+            }
+        } else if (mapType >= 3 && mapType <= 5) {
+            reader.ReadBit();       // slice_group_change_direction_flag
+            reader.ReadUe();        // slice_group_change_rate_minus1
+        } else if (mapType == 6) {
+            uint32_t mapUnits = reader.ReadUe() + 1;
+            if (mapUnits > kMaxFrameMbs) return false;
+            int bits = 0;
+            while ((1u << bits) < pps.numSliceGroups) {
+                bits++;
+            }
+            reader.SkipBits((size_t)mapUnits * bits);
+        } else if (mapType > 6) {
+            return false;
+        }
+    }
+
+    pps.numRefIdxL0DefaultActive = reader.ReadUe() + 1;
+    pps.numRefIdxL1DefaultActive = reader.ReadUe() + 1;
+    if (pps.numRefIdxL0DefaultActive > 32 || pps.numRefIdxL1DefaultActive > 32) return false;
+    pps.weightedPred = reader.ReadBit() != 0;
+    pps.weightedBipredIdc = reader.ReadBits(2);
+    pps.picInitQp = 26 + reader.ReadSe();
+    pps.picInitQs = 26 + reader.ReadSe();
+    pps.chromaQpIndexOffset = reader.ReadSe();
+    if (pps.picInitQp < 0 || pps.picInitQp > 51) return false;
+    if (pps.chromaQpIndexOffset < -12 || pps.chromaQpIndexOffset > 12) return false;
+    pps.deblockingFilterControlPresent = reader.ReadBit() != 0;
+    pps.constrainedIntraPred = reader.ReadBit() != 0;
+    pps.redundantPicCntPresent = reader.ReadBit() != 0;
+
+    pps.secondChromaQpIndexOffset = pps.chromaQpIndexOffset;
+    if (reader.MoreRbspData()) {
+        // High profile extension. The number of 8x8 lists depends on the
+        // SPS; 4:4:4 isn't decoded anyway, so two are assumed.
+        pps.transform8x8Mode = reader.ReadBit() != 0;
+        pps.scalingMatrixPresent = reader.ReadBit() != 0;
+        if (pps.scalingMatrixPresent) {
+            int lists = 6 + (pps.transform8x8Mode ? 2 : 0);
+            for (int i = 0; i < lists; i++) {
+                if (reader.ReadBit()) {
+                    SkipScalingList(reader, i < 6 ? 16 : 64);
+                }
+            }
+        }
+        pps.secondChromaQpIndexOffset = reader.ReadSe();
+    }
+    return !reader.Overrun();
+}
+
+bool FindSps(const uint8_t* data, size_t size, H264Sps& sps) {
+    if (!data) return false;
+
+    // Far more than an SPS without scaling lists needs to reach the VUI timing
+    uint8_t rbsp[256 + BitReader::kReadAhead];
+    NalScanner scanner(data, size);
+    NalUnit nal;
+    while (scanner.Next(nal)) {
+        if (nal.type == kNalSlice || nal.type == kNalSliceDpa || nal.type == kNalSliceIdr) break;
+        if (nal.type != kNalSps || nal.size < 2) continue;
+        size_t length = UnescapeRbsp(nal.data + 1, nal.size - 1, rbsp, sizeof(rbsp));
+        BitReader reader(rbsp, length, true);
+        if (ParseSps(reader, sps)) return true;
+    }
+    return false;
+}
+
+} // namespace FluxMic
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+
+#include "AnnexB.h"
+#include "H264Bitstream.h"
+
+namespace FluxMic {
+
+/// Sequence parameter set (ITU-T H.264 7.3.2.1.1), as far as decoding and
+/// sizing the pictures needs it. Of the VUI only the timing is kept.
+struct H264Sps {
+    uint8_t profileIdc = 0;
+    uint8_t constraintFlags = 0;        // constraint_set0_flag in the MSB
+    uint8_t levelIdc = 0;
+    uint32_t id = 0;
+
+    uint32_t chromaFormatIdc = 1;       // 4:2:0 unless a High profile says otherwise
+    uint32_t bitDepthLuma = 8;
+    uint32_t bitDepthChroma = 8;
+    bool transformBypass = false;
+    bool scalingMatrixPresent = false;
+
+    uint32_t log2MaxFrameNum = 4;
+    uint32_t picOrderCntType = 0;
+    uint32_t log2MaxPocLsb = 4;
+    bool deltaPicOrderAlwaysZero = false;
+    uint32_t maxNumRefFrames = 0;
+    bool gapsInFrameNumAllowed = false;
+
+    uint32_t widthInMbs = 0;
+    uint32_t heightInMbs = 0;           // of the frame, not the field
+    bool frameMbsOnly = true;
+    bool mbAdaptiveFrameField = false;
+
+    // Cropped off the decoded frame, in luma samples
+    uint32_t cropLeft = 0;
+    uint32_t cropRight = 0;
+    uint32_t cropTop = 0;
+    uint32_t cropBottom = 0;
+
+    // VUI timing_info (E.1.1); a malformed VUI leaves it absent
+    bool timingInfoPresent = false;
+    uint32_t numUnitsInTick = 0;
+    uint32_t timeScale = 0;
+    bool fixedFrameRate = false;
+
+    uint32_t CodedWidth() const { return widthInMbs * 16; }
+    uint32_t CodedHeight() const { return heightInMbs * 16; }
+    uint32_t Width() const { return CodedWidth() - cropLeft - cropRight; }
+    uint32_t Height() const { return CodedHeight() - cropTop - cropBottom; }
+
+    /// Frames per second from the VUI timing (a frame is two ticks), or 0
+    double FrameRate() const {
+        return timingInfoPresent ? timeScale / (2.0 * numUnitsInTick) : 0.0;
+    }
+};
+
+/// Picture parameter set (ITU-T H.264 7.3.2.2). Slice group maps and
+/// scaling lists are skipped, not kept.
+struct H264Pps {
+    uint32_t id = 0;
+    uint32_t spsId = 0;
+    bool entropyCodingMode = false;     // CABAC
+    bool bottomFieldPicOrderInFramePresent = false;
+    uint32_t numSliceGroups = 1;
+    uint32_t numRefIdxL0DefaultActive = 1;
+    uint32_t numRefIdxL1DefaultActive = 1;
+    bool weightedPred = false;
+    uint32_t weightedBipredIdc = 0;
+    int32_t picInitQp = 26;
+    int32_t picInitQs = 26;
+    int32_t chromaQpIndexOffset = 0;
+    bool deblockingFilterControlPresent = false;
+    bool constrainedIntraPred = false;
+    bool redundantPicCntPresent = false;
+    bool transform8x8Mode = false;
+    bool scalingMatrixPresent = false;
+    int32_t secondChromaQpIndexOffset = 0;
+};
+
+/// Parse the RBSP of an SPS NAL unit (after the NAL header byte).
+/// Returns false if it is malformed or out of range.
+bool ParseSps(BitReader& reader, H264Sps& sps);
+
+/// Parse the RBSP of a PPS NAL unit (after the NAL header byte).
+/// Returns false if it is malformed or out of range.
+bool ParsePps(BitReader& reader, H264Pps& pps);
+
+/// Parse the first SPS of an Annex B access unit, looking no further than
+/// its first slice, so the stream's format is known before anything is
+/// decoded. Allocates nothing. Returns false if there is no valid SPS.
+bool FindSps(const uint8_t* data, size_t size, H264Sps& sps);
+
+} // namespace FluxMic
@@ -0,0 +1,93 @@
+#include "H264Picture.h"
+
+#include <cstring>
+#include <new>
+
+namespace FluxMic {
+
+// Loads of 16 bytes near the end of the last row may run past the margin
+static const size_t kTailSlack = 16;
+
+size_t H264Picture::BufferSize(uint32_t codedWidth, uint32_t codedHeight) {
+    size_t pitch = (size_t)codedWidth + 2 * kPad;
+    size_t lumaRows = (size_t)codedHeight + 2 * kPad;
+    size_t chromaRows = (size_t)codedHeight / 2 + kPad;
+    return pitch * (lumaRows + chromaRows) + kTailSlack;
+}
+
+void H264Picture::Configure(uint32_t codedWidth, uint32_t codedHeight) {
+    m_codedWidth = codedWidth;
+    m_codedHeight = codedHeight;
+    m_pitch = (ptrdiff_t)codedWidth + 2 * kPad;
+    m_luma = m_buffer.data() + m_pitch * kPad + kPad;
+    m_chroma = m_buffer.data() + m_pitch * ((ptrdiff_t)codedHeight + 2 * kPad)
+             + m_pitch * (kPad / 2) + kPad;
+    SetVisibleRect(0, 0, codedWidth, codedHeight);
+}
+
+void H264Picture::SetVisibleRect(uint32_t left, uint32_t top, uint32_t visibleWidth, uint32_t visibleHeight) {
+    // 4:2:0 crops in steps of 2 luma samples, so chroma starts on a pair
+    luma = m_luma + (ptrdiff_t)top * m_pitch + left;
+    chroma = m_chroma + (ptrdiff_t)(top / 2) * m_pitch + (left & ~1u);
+    pitch = (uint32_t)m_pitch;
+    width = visibleWidth;
+    height = visibleHeight;
+}
+
+void H264Picture::ExtendEdges() {
+    // Left and right, then the top and bottom rows including the corners
+    const ptrdiff_t w = m_codedWidth;
+    const ptrdiff_t h = m_codedHeight;
+    for (ptrdiff_t y = 0; y < h; y++) {
+        uint8_t* row = m_luma + y * m_pitch;
+        memset(row - kPad, row[0], kPad);
+        memset(row + w, row[w - 1], kPad);
+    }
+    for (ptrdiff_t y = 1; y <= kPad; y++) {
+        memcpy(m_luma - y * m_pitch - kPad, m_luma - kPad, m_pitch);
+        memcpy(m_luma + (h - 1 + y) * m_pitch - kPad, m_luma + (h - 1) * m_pitch - kPad, m_pitch);
+    }
+
+    const ptrdiff_t chromaRows = h / 2;
+    for (ptrdiff_t y = 0; y < chromaRows; y++) {
+        uint8_t* row = m_chroma + y * m_pitch;
+        for (ptrdiff_t x = 0; x < kPad; x += 2) {
+            row[-kPad + x] = row[0];
+            row[-kPad + x + 1] = row[1];
+            row[w + x] = row[w - 2];
+            row[w + x + 1] = row[w - 1];
+        }
+    }
+    for (ptrdiff_t y = 1; y <= kPad / 2; y++) {
+        memcpy(m_chroma - y * m_pitch - kPad, m_chroma - kPad, m_pitch);
+        memcpy(m_chroma + (chromaRows - 1 + y) * m_pitch - kPad,
+               m_chroma + (chromaRows - 1) * m_pitch - kPad, m_pitch);
+    }
+}
+
+// ============================================================================
+// H264Picture::PoolOps
+// ============================================================================
+
+H264Picture* H264Picture::PoolOps::Create(size_t capacity) {
+    H264Picture* picture = new (std::nothrow) H264Picture();
+    if (!picture) return nullptr;
+    if (!Grow(picture, capacity)) {
+        picture->Release();
+        return nullptr;
+    }
+    return picture;
+}
+
+bool H264Picture::PoolOps::Grow(H264Picture* picture, size_t capacity) {
+    try {
+        picture->m_buffer.resize(capacity);
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+    // The planes move with the buffer; Configure() lays them out again
+    picture->m_luma = picture->m_chroma = nullptr;
+    return true;
+}
+
+} // namespace FluxMic
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "DecodedFrame.h"
+
+namespace FluxMic {
+
+/// Picture of the software H.264 decoder: NV12 planes of the coded size
+/// with a margin around them, so that motion vectors pointing a little
+/// outside the reference picture read replicated edge samples directly.
+///
+/// The DecodedFrame fields describe the cropped picture handed out. Pictures
+/// are pooled (see PoolOps); one is written only while the decoder is the
+/// only holder.
+class H264Picture : public DecodedFrame {
+public:
+    /// Luma samples around the luma plane. The chroma plane has the same
+    /// pitch, so the same number of bytes (kPad / 2 CbCr pairs) on each
+    /// side, and kPad / 2 rows above and below.
+    static const int kPad = 32;
+
+    /// Bytes for the planes of a picture of the coded size
+    static size_t BufferSize(uint32_t codedWidth, uint32_t codedHeight);
+
+    /// Lay out the planes for the coded size, which the buffer must have
+    /// room for, and show the whole picture.
+    void Configure(uint32_t codedWidth, uint32_t codedHeight);
+
+    /// Show only part of the picture (the SPS cropping rectangle).
+    void SetVisibleRect(uint32_t left, uint32_t top, uint32_t visibleWidth, uint32_t visibleHeight);
+
+    uint8_t* Luma() { return m_luma; }
+    uint8_t* Chroma() { return m_chroma; }
+    const uint8_t* Luma() const { return m_luma; }
+    const uint8_t* Chroma() const { return m_chroma; }
+    ptrdiff_t Pitch() const { return m_pitch; }
+    uint32_t CodedWidth() const { return m_codedWidth; }
+    uint32_t CodedHeight() const { return m_codedHeight; }
+
+    /// Replicate the outermost samples into the margin, once the picture
+    /// is decoded and before it is used as a reference.
+    void ExtendEdges();
+
+    /// SamplePool operations; the capacity is BufferSize().
+    struct PoolOps {
+        static H264Picture* Create(size_t capacity);
+        static bool Grow(H264Picture* picture, size_t capacity);
+        static size_t Capacity(H264Picture* picture) { return picture->m_buffer.size(); }
+        static bool IsIdle(H264Picture* picture) { return !picture->IsShared(); }
+        static void Destroy(H264Picture* picture) { picture->Release(); }
+    };
+
+private:
+    H264Picture() = default;
+
+    std::vector<uint8_t> m_buffer;
+    uint8_t* m_luma = nullptr;          // sample (0, 0) of each plane
+    uint8_t* m_chroma = nullptr;
+    ptrdiff_t m_pitch = 0;
+    uint32_t m_codedWidth = 0;
+    uint32_t m_codedHeight = 0;
+};
+
+} // namespace FluxMic
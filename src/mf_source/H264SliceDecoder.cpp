@@ -0,0 +1,813 @@
+#include "H264SliceDecoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "H264Cavlc.h"
+#include "H264Deblock.h"
+#include "H264Intra.h"
+
+namespace FluxMic {
+
+// Raster position of each coefficient of a 4x4 block in zig-zag scan order
+static const uint8_t kZigzag4x4[16] = { 0, 1, 4, 8, 5, 2, 3, 6, 9, 12, 13, 10, 7, 11, 14, 15 };
+
+// luma4x4BlkIdx to the raster index of the 4x4 block in its macroblock,
+// which is also the other way round
+static const uint8_t kBlockRaster[16] = { 0, 1, 4, 5, 2, 3, 6, 7, 8, 9, 12, 13, 10, 11, 14, 15 };
+
+// coded_block_pattern by codeNum of me(v) (Table 9-4)
+static const uint8_t kCbpIntra[48] = {
+    47, 31, 15,  0, 23, 27, 29, 30,  7, 11, 13, 14, 39, 43, 45, 46,
+    16,  3,  5, 10, 12, 19, 21, 26, 28, 35, 37, 42, 44,  1,  2,  4,
+     8, 17, 18, 20, 24,  6,  9, 22, 25, 32, 33, 34, 36, 40, 38, 41,
+};
+static const uint8_t kCbpInter[48] = {
+     0, 16,  1,  2,  4,  8, 32,  3,  5, 10, 12, 15, 47,  7, 11, 13,
+    14,  6,  9, 31, 35, 37, 42, 44, 33, 34, 36, 40, 39, 43, 45, 46,
+    17, 18, 20, 24, 19, 21, 26, 28, 23, 27, 29, 30, 22, 25, 38, 41,
+};
+
+// QPC by qPI (Table 8-15)
+static const uint8_t kChromaQp[52] = {
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+    16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 29, 30,
+    31, 32, 32, 33, 34, 34, 35, 35, 36, 36, 37, 37, 37, 38, 38, 38,
+    39, 39, 39, 39,
+};
+
+// Partition shapes with a directional motion vector prediction (8.4.1.3)
+enum MvShape {
+    kShapeMedian,
+    kShape16x8Upper,
+    kShape16x8Lower,
+    kShape8x16Left,
+    kShape8x16Right,
+};
+
+static inline int Clip3(int lo, int hi, int value) {
+    return value < lo ? lo : value > hi ? hi : value;
+}
+
+static inline int Median(int a, int b, int c) {
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+static inline int ChromaQp(int qp, int offset) {
+    return kChromaQp[Clip3(0, 51, qp + offset)];
+}
+
+static inline int16_t Dequant(int level, int qp, int position) {
+    // LevelScale4x4 is 16 times the table, which the >> 4 of 8.5.12.1 cancels
+    int64_t value = (int64_t)level * (kH264Dequant4x4[qp % 6][position] << (qp / 6));
+    return (int16_t)(value < -32768 ? -32768 : value > 32767 ? 32767 : value);
+}
+
+// ============================================================================
+// Slices
+// ============================================================================
+
+void H264SliceDecoder::StartPicture(const H264Sps& sps, H264Picture* picture) {
+    m_picture = picture;
+    m_widthInMbs = sps.widthInMbs;
+    m_heightInMbs = sps.heightInMbs;
+    m_mbs.resize((size_t)m_widthInMbs * m_heightInMbs);
+    for (MbInfo& mb : m_mbs) {
+        mb.slice = -1;
+    }
+    m_slices.clear();
+}
+
+bool H264SliceDecoder::DecodeSlice(BitReader& reader, const H264SliceHeader& header, const H264Pps& pps,
+                                   const H264Picture* const* refList) {
+    m_header = &header;
+    m_pps = &pps;
+    m_refList = refList;
+    m_slice = (int32_t)m_slices.size();
+    m_slices.push_back({ header.disableDeblockingFilterIdc, header.filterOffsetA, header.filterOffsetB,
+                         { pps.chromaQpIndexOffset, pps.secondChromaQpIndexOffset } });
+
+    // Left over from a slice which broke off in the middle of a macroblock
+    memset(m_lumaCoeffs, 0, sizeof(m_lumaCoeffs));
+    memset(m_chromaCoeffs, 0, sizeof(m_chromaCoeffs));
+
+    m_qp = pps.picInitQp + header.sliceQpDelta;
+    if (m_qp < 0 || m_qp > 51) return false;
+
+    const uint32_t mbCount = (uint32_t)m_mbs.size();
+    uint32_t mbAddr = header.firstMbInSlice;
+    const bool isP = header.sliceType == kSliceP;
+    for (;;) {
+        if (isP) {
+            uint32_t skipRun = reader.ReadUe();
+            if (reader.Overrun() || skipRun > mbCount - mbAddr) return false;
+            if (skipRun > 0) {
+                for (; skipRun > 0; skipRun--) {
+                    if (!DecodeSkip(mbAddr)) return false;
+                    mbAddr++;
+                }
+                if (!reader.MoreRbspData()) break;
+            }
+        }
+        if (mbAddr >= mbCount) return false;
+        if (!DecodeMacroblock(reader, mbAddr) || reader.Overrun()) {
+            m_mbs[mbAddr].slice = -1;
+            return false;
+        }
+        mbAddr++;
+        if (!reader.MoreRbspData()) break;
+    }
+    return true;
+}
+
+uint32_t H264SliceDecoder::FinishPicture(const H264Picture* concealFrom) {
+    uint32_t concealed = 0;
+    for (uint32_t mbAddr = 0; mbAddr < m_mbs.size(); mbAddr++) {
+        if (m_mbs[mbAddr].slice < 0) {
+            Conceal(mbAddr, concealFrom);
+            concealed++;
+        }
+    }
+    for (uint32_t mbAddr = 0; mbAddr < m_mbs.size(); mbAddr++) {
+        DeblockMacroblock(mbAddr);
+    }
+    m_picture->ExtendEdges();
+    m_picture = nullptr;
+    return concealed;
+}
+
+// ============================================================================
+// Neighbours (6.4.11)
+// ============================================================================
+
+const H264SliceDecoder::MbInfo* H264SliceDecoder::NeighbourMb(int dx, int dy) const {
+    int x = m_mbX + dx;
+    int y = m_mbY + dy;
+    if (x < 0 || y < 0 || x >= (int)m_widthInMbs) return nullptr;
+    const MbInfo& mb = m_mbs[(size_t)y * m_widthInMbs + x];
+    return (mb.slice == m_slice) ? &mb : nullptr;
+}
+
+bool H264SliceDecoder::IntraAvailable(const MbInfo* neighbour) const {
+    return neighbour && (!m_pps->constrainedIntraPred || neighbour->kind != kMbInter);
+}
+
+// nC of a coeff_token (9.2.1): blocks `base` onwards of MbInfo::totalCoeff
+// are a gridSize x gridSize raster of 4x4 blocks
+int H264SliceDecoder::Nc(const MbInfo& mb, int base, int x, int y, int gridSize) const {
+    const MbInfo* left = (x > 0) ? &mb : NeighbourMb(-1, 0);
+    const MbInfo* top = (y > 0) ? &mb : NeighbourMb(0, -1);
+    int leftX = (x > 0) ? x - 1 : gridSize - 1;
+    int topY = (y > 0) ? y - 1 : gridSize - 1;
+    if (left && top) {
+        return (left->totalCoeff[base + y * gridSize + leftX]
+                + top->totalCoeff[base + topY * gridSize + x] + 1) >> 1;
+    }
+    if (left) return left->totalCoeff[base + y * gridSize + leftX];
+    if (top) return top->totalCoeff[base + topY * gridSize + x];
+    return 0;
+}
+
+// predIntra4x4PredMode (8.3.1.1) of the 4x4 block at (x, y)
+int H264SliceDecoder::PredictIntra4x4Mode(const MbInfo& mb, int x, int y) const {
+    const MbInfo* left = (x > 0) ? &mb : NeighbourMb(-1, 0);
+    const MbInfo* top = (y > 0) ? &mb : NeighbourMb(0, -1);
+    if (!left || !top) return kIntra4x4Dc;
+    if (m_pps->constrainedIntraPred && (left->kind == kMbInter || top->kind == kMbInter)) {
+        return kIntra4x4Dc;
+    }
+    int modeLeft = (left->kind == kMbIntra4x4) ? left->intraModes[y * 4 + ((x + 3) & 3)] : (int)kIntra4x4Dc;
+    int modeTop = (top->kind == kMbIntra4x4) ? top->intraModes[((y + 3) & 3) * 4 + x] : (int)kIntra4x4Dc;
+    return std::min(modeLeft, modeTop);
+}
+
+// Motion data of the 4x4 block at (x, y) relative to the current
+// macroblock, x in -1..4 and y in -1..3 (8.4.1.3.2)
+H264SliceDecoder::MvNeighbour H264SliceDecoder::MvAt(const MbInfo& mb, int x, int y) const {
+    if (x >= 0 && x < 4 && y >= 0) {
+        int block = y * 4 + x;
+        if (mb.refIdx[block] == -2) return { false, -1, 0, 0 };
+        return { true, mb.refIdx[block], mb.mv[block][0], mb.mv[block][1] };
+    }
+    const MbInfo* neighbour = nullptr;
+    if (y < 0) {
+        neighbour = NeighbourMb(x < 0 ? -1 : (x > 3 ? 1 : 0), -1);
+    } else if (x < 0) {
+        neighbour = NeighbourMb(-1, 0);
+    }
+    if (!neighbour) return { false, -1, 0, 0 };
+    int block = (y & 3) * 4 + (x & 3);
+    return { true, neighbour->refIdx[block], neighbour->mv[block][0], neighbour->mv[block][1] };
+}
+
+// mvpLX (8.4.1.3) of the partition of w x h 4x4 blocks at (x, y)
+void H264SliceDecoder::PredictMv(const MbInfo& mb, int x, int y, int w, int h, int refIdx,
+                                 int shape, int* mv) const {
+    (void)h;
+    MvNeighbour a = MvAt(mb, x - 1, y);
+    MvNeighbour b = MvAt(mb, x, y - 1);
+    MvNeighbour c = MvAt(mb, x + w, y - 1);
+    if (!c.available) {
+        c = MvAt(mb, x - 1, y - 1);
+    }
+
+    const MvNeighbour* pick = nullptr;
+    if (shape == kShape16x8Upper && b.refIdx == refIdx) pick = &b;
+    else if (shape == kShape16x8Lower && a.refIdx == refIdx) pick = &a;
+    else if (shape == kShape8x16Left && a.refIdx == refIdx) pick = &a;
+    else if (shape == kShape8x16Right && c.refIdx == refIdx) pick = &c;
+    if (pick) {
+        mv[0] = pick->mvx;
+        mv[1] = pick->mvy;
+        return;
+    }
+
+    // Median (8.4.1.3.1)
+    if (!b.available && !c.available && a.available) {
+        mv[0] = a.mvx;
+        mv[1] = a.mvy;
+        return;
+    }
+    int matches = (a.refIdx == refIdx) + (b.refIdx == refIdx) + (c.refIdx == refIdx);
+    if (matches == 1) {
+        pick = (a.refIdx == refIdx) ? &a : (b.refIdx == refIdx) ? &b : &c;
+        mv[0] = pick->mvx;
+        mv[1] = pick->mvy;
+        return;
+    }
+    mv[0] = Median(a.mvx, b.mvx, c.mvx);
+    mv[1] = Median(a.mvy, b.mvy, c.mvy);
+}
+
+void H264SliceDecoder::SetMotion(MbInfo& mb, int x, int y, int w, int h, int refIdx, const int* mv) {
+    for (int j = y; j < y + h; j++) {
+        for (int i = x; i < x + w; i++) {
+            mb.refIdx[j * 4 + i] = (int8_t)refIdx;
+            mb.mv[j * 4 + i][0] = (int16_t)mv[0];
+            mb.mv[j * 4 + i][1] = (int16_t)mv[1];
+        }
+    }
+}
+
+const H264Picture* H264SliceDecoder::RefPicture(uint32_t refIdx) const {
+    // A missing reference picture is replaced by another one
+    if (m_refList[refIdx]) return m_refList[refIdx];
+    for (uint32_t i = 0; i < m_header->numRefIdxL0Active; i++) {
+        if (m_refList[i]) return m_refList[i];
+    }
+    return nullptr;
+}
+
+// ============================================================================
+// Macroblock layer (7.3.5)
+// ============================================================================
+
+bool H264SliceDecoder::DecodeSkip(uint32_t mbAddr) {
+    m_mbX = (int)(mbAddr % m_widthInMbs);
+    m_mbY = (int)(mbAddr / m_widthInMbs);
+    MbInfo& mb = m_mbs[mbAddr];
+    mb.kind = kMbInter;
+    mb.qp = (uint8_t)m_qp;
+    memset(mb.totalCoeff, 0, sizeof(mb.totalCoeff));
+    memset(mb.intraModes, kIntra4x4Dc, sizeof(mb.intraModes));
+    memset(mb.refIdx, -2, sizeof(mb.refIdx));
+
+    const H264Picture* ref = RefPicture(0);
+    if (!ref) return false;
+    mb.slice = m_slice;
+
+    // 8.4.1.1: zero unless both neighbours exist and neither is still
+    MvNeighbour a = MvAt(mb, -1, 0);
+    MvNeighbour b = MvAt(mb, 0, -1);
+    int mv[2] = { 0, 0 };
+    if (a.available && b.available
+        && !(a.refIdx == 0 && a.mvx == 0 && a.mvy == 0)
+        && !(b.refIdx == 0 && b.mvx == 0 && b.mvy == 0)) {
+        PredictMv(mb, 0, 0, 4, 4, 0, kShapeMedian, mv);
+    }
+    SetMotion(mb, 0, 0, 4, 4, 0, mv);
+    for (int i = 0; i < 4; i++) {
+        mb.refPic[i] = ref;
+    }
+    PredictInter(ref, m_mbX * 16, m_mbY * 16, 16, 16, mv[0], mv[1]);
+    return true;
+}
+
+bool H264SliceDecoder::DecodeMacroblock(BitReader& reader, uint32_t mbAddr) {
+    m_mbX = (int)(mbAddr % m_widthInMbs);
+    m_mbY = (int)(mbAddr / m_widthInMbs);
+    MbInfo& mb = m_mbs[mbAddr];
+    mb.slice = m_slice;
+    memset(mb.totalCoeff, 0, sizeof(mb.totalCoeff));
+
+    uint32_t mbType = reader.ReadUe();
+    if (m_header->sliceType == kSliceP) {
+        if (mbType < 5) {
+            mb.kind = kMbInter;
+            memset(mb.intraModes, kIntra4x4Dc, sizeof(mb.intraModes));
+            if (!DecodeInterPrediction(reader, mb, mbType)) return false;
+
+            uint32_t code = reader.ReadUe();
+            if (code > 47) return false;
+            uint32_t cbp = kCbpInter[code];
+            if (cbp) {
+                int32_t delta = reader.ReadSe();
+                if (delta < -26 || delta > 25) return false;
+                m_qp = (m_qp + delta + 52) % 52;
+            }
+            mb.qp = (uint8_t)m_qp;
+            if (!DecodeResidual(reader, mb, cbp, false)) return false;
+            AddLumaResidual(mb);
+            AddChromaResidual(mb, cbp);
+            return true;
+        }
+        mbType -= 5;
+    }
+
+    // I macroblock types (Table 7-11)
+    if (mbType > 25) return false;
+    memset(mb.refIdx, -1, sizeof(mb.refIdx));
+    memset(mb.mv, 0, sizeof(mb.mv));
+    memset(mb.refPic, 0, sizeof(mb.refPic));
+    if (mbType == 25) return DecodePcm(reader, mb);
+
+    bool intra16x16 = mbType != 0;
+    int intra16x16Mode = 0;
+    uint32_t cbp = 0;
+    if (intra16x16) {
+        mb.kind = kMbIntra16x16;
+        memset(mb.intraModes, kIntra4x4Dc, sizeof(mb.intraModes));
+        intra16x16Mode = (int)(mbType - 1) % 4;
+        cbp = (((mbType - 1) / 4) % 3) << 4;
+        if (mbType >= 13) cbp |= 15;
+    } else {
+        mb.kind = kMbIntra4x4;
+        for (int blk = 0; blk < 16; blk++) {
+            int raster = kBlockRaster[blk];
+            int predicted = PredictIntra4x4Mode(mb, raster & 3, raster >> 2);
+            int mode = predicted;
+            if (!reader.ReadBit()) {
+                int rem = (int)reader.ReadBits(3);
+                mode = (rem < predicted) ? rem : rem + 1;
+            }
+            mb.intraModes[raster] = (int8_t)mode;
+        }
+    }
+    uint32_t chromaMode = reader.ReadUe();
+    if (chromaMode > 3) return false;
+    if (!intra16x16) {
+        uint32_t code = reader.ReadUe();
+        if (code > 47) return false;
+        cbp = kCbpIntra[code];
+    }
+    if (cbp || intra16x16) {
+        int32_t delta = reader.ReadSe();
+        if (delta < -26 || delta > 25) return false;
+        m_qp = (m_qp + delta + 52) % 52;
+    }
+    mb.qp = (uint8_t)m_qp;
+    if (!DecodeResidual(reader, mb, cbp, intra16x16)) return false;
+    ReconstructIntra(mb, intra16x16 ? intra16x16Mode : -1, (int)chromaMode, cbp);
+    return true;
+}
+
+bool H264SliceDecoder::DecodePcm(BitReader& reader, MbInfo& mb) {
+    reader.AlignToByte();
+    if (reader.BitsLeft() < 384 * 8) return false;
+    const uint8_t* samples = reader.BytePointer();
+
+    const ptrdiff_t pitch = m_picture->Pitch();
+    uint8_t* luma = m_picture->Luma() + (ptrdiff_t)m_mbY * 16 * pitch + m_mbX * 16;
+    for (int y = 0; y < 16; y++) {
+        memcpy(luma + y * pitch, samples + y * 16, 16);
+    }
+    uint8_t* chroma = m_picture->Chroma() + (ptrdiff_t)m_mbY * 8 * pitch + m_mbX * 16;
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            chroma[y * pitch + 2 * x] = samples[256 + y * 8 + x];
+            chroma[y * pitch + 2 * x + 1] = samples[320 + y * 8 + x];
+        }
+    }
+    reader.SkipBits(384 * 8);
+
+    // QPY carries on to the next macroblock; deblocking takes 0 (8.7.2.2)
+    mb.kind = kMbPcm;
+    mb.qp = 0;
+    memset(mb.totalCoeff, 16, sizeof(mb.totalCoeff));
+    memset(mb.intraModes, kIntra4x4Dc, sizeof(mb.intraModes));
+    return true;
+}
+
+// mb_pred() and sub_mb_pred() of a P macroblock (mb_type 0..4), with the
+// motion compensation of each partition as soon as its vector is known
+bool H264SliceDecoder::DecodeInterPrediction(BitReader& reader, MbInfo& mb, uint32_t mbType) {
+    memset(mb.refIdx, -2, sizeof(mb.refIdx));
+    const uint32_t numRefs = m_header->numRefIdxL0Active;
+    const uint32_t range = numRefs - 1;
+    const int mbX = m_mbX * 16;
+    const int mbY = m_mbY * 16;
+
+    if (mbType < 3) {
+        // P_L0_16x16, P_L0_L0_16x8, P_L0_L0_8x16 (Table 7-13)
+        const int parts = (mbType == 0) ? 1 : 2;
+        uint32_t refIdx[2] = { 0, 0 };
+        for (int p = 0; p < parts; p++) {
+            if (range > 0) {
+                refIdx[p] = reader.ReadTe(range);
+                if (refIdx[p] > range) return false;
+            }
+        }
+        for (int p = 0; p < parts; p++) {
+            int x = 0, y = 0, w = 4, h = 4, shape = kShapeMedian;
+            if (mbType == 1) {
+                y = 2 * p;
+                h = 2;
+                shape = p ? kShape16x8Lower : kShape16x8Upper;
+            } else if (mbType == 2) {
+                x = 2 * p;
+                w = 2;
+                shape = p ? kShape8x16Right : kShape8x16Left;
+            }
+            int mvdX = reader.ReadSe();
+            int mvdY = reader.ReadSe();
+            const H264Picture* ref = RefPicture(refIdx[p]);
+            if (!ref) return false;
+
+            int mv[2];
+            PredictMv(mb, x, y, w, h, (int)refIdx[p], shape, mv);
+            mv[0] = Clip3(-32768, 32767, mv[0] + mvdX);
+            mv[1] = Clip3(-32768, 32767, mv[1] + mvdY);
+            SetMotion(mb, x, y, w, h, (int)refIdx[p], mv);
+            for (int j = y; j < y + h; j += 2) {
+                for (int i = x; i < x + w; i += 2) {
+                    mb.refPic[(j >> 1) * 2 + (i >> 1)] = ref;
+                }
+            }
+            PredictInter(ref, mbX + x * 4, mbY + y * 4, w * 4, h * 4, mv[0], mv[1]);
+        }
+        return true;
+    }
+
+    // P_8x8 and P_8x8ref0: sub_mb_type of each 8x8 block (Table 7-17)
+    uint32_t subTypes[4];
+    for (int i = 0; i < 4; i++) {
+        subTypes[i] = reader.ReadUe();
+        if (subTypes[i] > 3) return false;
+    }
+    uint32_t refIdx[4] = { 0, 0, 0, 0 };
+    if (mbType == 3 && range > 0) {
+        for (int i = 0; i < 4; i++) {
+            refIdx[i] = reader.ReadTe(range);
+            if (refIdx[i] > range) return false;
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        const H264Picture* ref = RefPicture(refIdx[i]);
+        if (!ref) return false;
+        mb.refPic[i] = ref;
+
+        const int x8 = (i & 1) * 2;
+        const int y8 = (i >> 1) * 2;
+        const int w = (subTypes[i] == 0 || subTypes[i] == 1) ? 2 : 1;
+        const int h = (subTypes[i] == 0 || subTypes[i] == 2) ? 2 : 1;
+        for (int y = y8; y < y8 + 2; y += h) {
+            for (int x = x8; x < x8 + 2; x += w) {
+                int mvdX = reader.ReadSe();
+                int mvdY = reader.ReadSe();
+                int mv[2];
+                PredictMv(mb, x, y, w, h, (int)refIdx[i], kShapeMedian, mv);
+                mv[0] = Clip3(-32768, 32767, mv[0] + mvdX);
+                mv[1] = Clip3(-32768, 32767, mv[1] + mvdY);
+                SetMotion(mb, x, y, w, h, (int)refIdx[i], mv);
+                PredictInter(ref, mbX + x * 4, mbY + y * 4, w * 4, h * 4, mv[0], mv[1]);
+            }
+        }
+    }
+    return true;
+}
+
+// residual() (7.3.5.3) with the coefficients scaled (8.5.12.1)
+bool H264SliceDecoder::DecodeResidual(BitReader& reader, MbInfo& mb, uint32_t cbp, bool intra16x16) {
+    int16_t levels[16];
+    const int qp = m_qp;
+
+    if (intra16x16) {
+        if (ReadResidualBlock(reader, Nc(mb, 0, 0, 0, 4), 16, levels) < 0) return false;
+        int16_t dc[16];
+        for (int i = 0; i < 16; i++) {
+            dc[kZigzag4x4[i]] = levels[i];
+        }
+        H264LumaDcDequant(dc, qp);
+        for (int i = 0; i < 16; i++) {
+            m_lumaCoeffs[i][0] = dc[i];
+        }
+    }
+
+    // The AC levels of Intra16x16 blocks start at scan position 1
+    const int first = intra16x16 ? 1 : 0;
+    for (int blk = 0; blk < 16; blk++) {
+        if (!(cbp & (1u << (blk >> 2)))) {
+            blk |= 3;
+            continue;
+        }
+        int raster = kBlockRaster[blk];
+        int nC = Nc(mb, 0, raster & 3, raster >> 2, 4);
+        int total = ReadResidualBlock(reader, nC, 16 - first, levels + first);
+        if (total < 0) return false;
+        mb.totalCoeff[raster] = (uint8_t)total;
+        if (total == 0) continue;
+        int16_t* block = m_lumaCoeffs[raster];
+        for (int i = first; i < 16; i++) {
+            if (levels[i]) block[kZigzag4x4[i]] = Dequant(levels[i], qp, kZigzag4x4[i]);
+        }
+    }
+
+    const uint32_t cbpChroma = cbp >> 4;
+    if (cbpChroma == 0) return true;
+    if (cbpChroma > 2) return false;
+    // Cb and Cr have offsets of their own (second_chroma_qp_index_offset)
+    const int qpc[2] = { ChromaQp(qp, m_pps->chromaQpIndexOffset),
+                         ChromaQp(qp, m_pps->secondChromaQpIndexOffset) };
+    for (int c = 0; c < 2; c++) {
+        if (ReadResidualBlock(reader, kCavlcChromaDcNc, 4, levels) < 0) return false;
+        int16_t dc[4] = { levels[0], levels[1], levels[2], levels[3] };
+        H264ChromaDcDequant(dc, qpc[c]);
+        for (int b = 0; b < 4; b++) {
+            m_chromaCoeffs[c][b][0] = dc[b];
+        }
+    }
+    if (cbpChroma < 2) return true;
+    for (int c = 0; c < 2; c++) {
+        const int base = 16 + 4 * c;
+        for (int b = 0; b < 4; b++) {
+            int nC = Nc(mb, base, b & 1, b >> 1, 2);
+            int total = ReadResidualBlock(reader, nC, 15, levels + 1);
+            if (total < 0) return false;
+            mb.totalCoeff[base + b] = (uint8_t)total;
+            int16_t* block = m_chromaCoeffs[c][b];
+            for (int i = 1; i < 16 && total > 0; i++) {
+                if (levels[i]) block[kZigzag4x4[i]] = Dequant(levels[i], qpc[c], kZigzag4x4[i]);
+            }
+        }
+    }
+    return true;
+}
+
+// ============================================================================
+// Reconstruction
+// ============================================================================
+
+void H264SliceDecoder::ReconstructIntra(MbInfo& mb, int intra16x16Mode, int chromaMode, uint32_t cbp) {
+    const MbInfo* left = NeighbourMb(-1, 0);
+    const MbInfo* top = NeighbourMb(0, -1);
+    const MbInfo* topLeft = NeighbourMb(-1, -1);
+    const MbInfo* topRight = NeighbourMb(1, -1);
+    const bool hasLeft = IntraAvailable(left);
+    const bool hasTop = IntraAvailable(top);
+    const bool hasTopLeft = IntraAvailable(topLeft);
+    const bool hasTopRight = IntraAvailable(topRight);
+    unsigned mbNeighbours = 0;
+    if (hasLeft) mbNeighbours |= kIntraLeft;
+    if (hasTop) mbNeighbours |= kIntraTop;
+    if (hasTopLeft) mbNeighbours |= kIntraTopLeft;
+
+    const ptrdiff_t pitch = m_picture->Pitch();
+    uint8_t* luma = m_picture->Luma() + (ptrdiff_t)m_mbY * 16 * pitch + m_mbX * 16;
+    if (intra16x16Mode >= 0) {
+        PredictIntra16x16(luma, pitch, intra16x16Mode, mbNeighbours);
+        AddLumaResidual(mb);
+    } else {
+        for (int blk = 0; blk < 16; blk++) {
+            const int raster = kBlockRaster[blk];
+            const int x = raster & 3;
+            const int y = raster >> 2;
+            unsigned neighbours = 0;
+            if (x > 0 || hasLeft) neighbours |= kIntraLeft;
+            if (y > 0 || hasTop) neighbours |= kIntraTop;
+            if ((x > 0 && y > 0) || (x > 0 ? hasTop : (y > 0 ? hasLeft : hasTopLeft))) {
+                neighbours |= kIntraTopLeft;
+            }
+            bool topRightReady = (y == 0)
+                ? (x < 3 ? hasTop : hasTopRight)
+                : (x < 3 && kBlockRaster[(y - 1) * 4 + x + 1] < blk);
+            if (topRightReady) neighbours |= kIntraTopRight;
+
+            uint8_t* dst = luma + y * 4 * pitch + x * 4;
+            PredictIntra4x4(dst, pitch, mb.intraModes[raster], neighbours);
+            if (mb.totalCoeff[raster]) {
+                m_dsp.idctAdd4x4(dst, pitch, m_lumaCoeffs[raster]);
+            }
+        }
+    }
+
+    uint8_t* chroma = m_picture->Chroma() + (ptrdiff_t)m_mbY * 8 * pitch + m_mbX * 16;
+    PredictIntraChroma(chroma, pitch, chromaMode, mbNeighbours);
+    AddChromaResidual(mb, cbp);
+}
+
+void H264SliceDecoder::AddLumaResidual(const MbInfo& mb) {
+    const ptrdiff_t pitch = m_picture->Pitch();
+    uint8_t* luma = m_picture->Luma() + (ptrdiff_t)m_mbY * 16 * pitch + m_mbX * 16;
+    for (int raster = 0; raster < 16; raster++) {
+        uint8_t* dst = luma + (raster >> 2) * 4 * pitch + (raster & 3) * 4;
+        if (mb.totalCoeff[raster]) {
+            m_dsp.idctAdd4x4(dst, pitch, m_lumaCoeffs[raster]);
+        } else if (m_lumaCoeffs[raster][0]) {
+            // Intra16x16 block with only its DC
+            m_dsp.idctDcAdd4x4(dst, pitch, m_lumaCoeffs[raster]);
+        }
+    }
+}
+
+void H264SliceDecoder::AddChromaResidual(const MbInfo& mb, uint32_t cbp) {
+    if ((cbp >> 4) == 0) return;
+
+    // The transforms work on planar blocks: separate each component, add
+    // its residual and interleave it again
+    const ptrdiff_t pitch = m_picture->Pitch();
+    uint8_t* chroma = m_picture->Chroma() + (ptrdiff_t)m_mbY * 8 * pitch + m_mbX * 16;
+    for (int c = 0; c < 2; c++) {
+        uint8_t planar[64];
+        for (int y = 0; y < 8; y++) {
+            for (int x = 0; x < 8; x++) {
+                planar[y * 8 + x] = chroma[y * pitch + 2 * x + c];
+            }
+        }
+        for (int b = 0; b < 4; b++) {
+            uint8_t* dst = planar + (b >> 1) * 32 + (b & 1) * 4;
+            int16_t* block = m_chromaCoeffs[c][b];
+            if (mb.totalCoeff[16 + 4 * c + b]) {
+                m_dsp.idctAdd4x4(dst, 8, block);
+            } else if (block[0]) {
+                m_dsp.idctDcAdd4x4(dst, 8, block);
+            }
+        }
+        for (int y = 0; y < 8; y++) {
+            for (int x = 0; x < 8; x++) {
+                chroma[y * pitch + 2 * x + c] = planar[y * 8 + x];
+            }
+        }
+    }
+}
+
+// Inter prediction (8.4.2.2) of the w x h luma samples at (x, y) and the
+// chroma samples with them. Reference samples outside the picture are
+// those at its edge: within the picture's margin they are there already,
+// beyond it they are gathered into a block of their own.
+void H264SliceDecoder::PredictInter(const H264Picture* ref, int x, int y, int w, int h, int mvx, int mvy) {
+    const int pad = H264Picture::kPad;
+    const ptrdiff_t pitch = m_picture->Pitch();
+    const ptrdiff_t refPitch = ref->Pitch();
+    const int codedW = (int)ref->CodedWidth();
+    const int codedH = (int)ref->CodedHeight();
+
+    // Luma: rows -2..h + 2 and columns -2..w + 12 of the block may be read
+    int xInt = x + (mvx >> 2);
+    int yInt = y + (mvy >> 2);
+    const uint8_t* src;
+    ptrdiff_t srcStride;
+    alignas(16) uint8_t lumaEdge[21 * 64];
+    if (xInt - 2 >= -pad && xInt + w + 13 <= codedW + pad && yInt - 2 >= -pad && yInt + h + 3 <= codedH + pad) {
+        src = ref->Luma() + yInt * refPitch + xInt;
+        srcStride = refPitch;
+    } else {
+        for (int r = 0; r < h + 5; r++) {
+            const uint8_t* row = ref->Luma() + Clip3(0, codedH - 1, yInt - 2 + r) * refPitch;
+            for (int c = 0; c < w + 15; c++) {
+                lumaEdge[r * 64 + c] = row[Clip3(0, codedW - 1, xInt - 2 + c)];
+            }
+        }
+        src = lumaEdge + 2 * 64 + 2;
+        srcStride = 64;
+    }
+    m_dsp.lumaMc(m_picture->Luma() + y * pitch + x, pitch, src, srcStride, w, h, mvx & 3, mvy & 3);
+
+    // Chroma in eighth samples (8.4.1.4); rows 0..h / 2 and up to 8 bytes
+    // beyond the w bytes of CbCr pairs may be read
+    const int chromaH = codedH / 2;
+    const int cw = w / 2;
+    const int ch = h / 2;
+    int cx = x / 2 + (mvx >> 3);
+    int cy = y / 2 + (mvy >> 3);
+    alignas(16) uint8_t chromaEdge[9 * 32];
+    if (2 * cx >= -pad && 2 * cx + w + 9 <= codedW + pad && cy >= -pad / 2 && cy + ch + 1 <= chromaH + pad / 2) {
+        src = ref->Chroma() + cy * refPitch + 2 * cx;
+        srcStride = refPitch;
+    } else {
+        for (int r = 0; r <= ch; r++) {
+            const uint8_t* row = ref->Chroma() + Clip3(0, chromaH - 1, cy + r) * refPitch;
+            for (int c = 0; c < w + 9; c++) {
+                chromaEdge[r * 32 + c] = row[2 * Clip3(0, codedW / 2 - 1, cx + (c >> 1)) + (c & 1)];
+            }
+        }
+        src = chromaEdge;
+        srcStride = 32;
+    }
+    m_dsp.chromaMc(m_picture->Chroma() + (y / 2) * pitch + x, pitch, src, srcStride, cw, ch, mvx & 7, mvy & 7);
+}
+
+// ============================================================================
+// Concealment and deblocking
+// ============================================================================
+
+void H264SliceDecoder::Conceal(uint32_t mbAddr, const H264Picture* concealFrom) {
+    MbInfo& mb = m_mbs[mbAddr];
+    mb.kind = kMbConcealed;
+    const ptrdiff_t pitch = m_picture->Pitch();
+    const ptrdiff_t lumaOffset = (ptrdiff_t)(mbAddr / m_widthInMbs) * 16 * pitch + (mbAddr % m_widthInMbs) * 16;
+    const ptrdiff_t chromaOffset = (ptrdiff_t)(mbAddr / m_widthInMbs) * 8 * pitch + (mbAddr % m_widthInMbs) * 16;
+    bool copy = concealFrom && concealFrom->CodedWidth() == m_picture->CodedWidth()
+             && concealFrom->CodedHeight() == m_picture->CodedHeight();
+    for (int y = 0; y < 16; y++) {
+        uint8_t* dst = m_picture->Luma() + lumaOffset + y * pitch;
+        if (copy) memcpy(dst, concealFrom->Luma() + lumaOffset + y * pitch, 16);
+        else memset(dst, 128, 16);
+    }
+    for (int y = 0; y < 8; y++) {
+        uint8_t* dst = m_picture->Chroma() + chromaOffset + y * pitch;
+        if (copy) memcpy(dst, concealFrom->Chroma() + chromaOffset + y * pitch, 16);
+        else memset(dst, 128, 16);
+    }
+}
+
+// bS (8.7.2.1) between 4x4 blocks pBlock of p and qBlock of q
+static int BoundaryStrength(bool pIntra, bool qIntra, bool mbEdge,
+                            int pCoeffs, int qCoeffs,
+                            const void* pRef, const void* qRef,
+                            const int16_t* pMv, const int16_t* qMv) {
+    if (pIntra || qIntra) return mbEdge ? 4 : 3;
+    if (pCoeffs || qCoeffs) return 2;
+    if (pRef != qRef) return 1;
+    if (abs(pMv[0] - qMv[0]) >= 4 || abs(pMv[1] - qMv[1]) >= 4) return 1;
+    return 0;
+}
+
+void H264SliceDecoder::DeblockMacroblock(uint32_t mbAddr) {
+    const MbInfo& q = m_mbs[mbAddr];
+    if (q.kind == kMbConcealed) return;
+    const SliceParams& params = m_slices[q.slice];
+    if (params.disableDeblockingFilterIdc == 1) return;
+
+    const int mbX = (int)(mbAddr % m_widthInMbs);
+    const int mbY = (int)(mbAddr / m_widthInMbs);
+    auto Usable = [&](const MbInfo* neighbour) -> const MbInfo* {
+        if (neighbour->kind == kMbConcealed) return nullptr;
+        if (params.disableDeblockingFilterIdc == 2 && neighbour->slice != q.slice) return nullptr;
+        return neighbour;
+    };
+    const MbInfo* left = (mbX > 0) ? Usable(&m_mbs[mbAddr - 1]) : nullptr;
+    const MbInfo* top = (mbY > 0) ? Usable(&m_mbs[mbAddr - m_widthInMbs]) : nullptr;
+
+    const ptrdiff_t pitch = m_picture->Pitch();
+    uint8_t* luma = m_picture->Luma() + (ptrdiff_t)mbY * 16 * pitch + mbX * 16;
+    uint8_t* chroma = m_picture->Chroma() + (ptrdiff_t)mbY * 8 * pitch + mbX * 16;
+    const bool qIntra = IsIntra(q.kind);
+
+    // Vertical edges left to right, then horizontal edges top to bottom
+    for (int dir = 0; dir < 2; dir++) {
+        const MbInfo* outside = dir == 0 ? left : top;
+        for (int edge = 0; edge < 4; edge++) {
+            if (edge == 0 && !outside) continue;
+            const MbInfo& p = (edge == 0) ? *outside : q;
+            const bool pIntra = IsIntra(p.kind);
+
+            uint8_t bS[4];
+            bool any = false;
+            for (int i = 0; i < 4; i++) {
+                int qBlock = (dir == 0) ? i * 4 + edge : edge * 4 + i;
+                int pBlock = (dir == 0) ? i * 4 + ((edge + 3) & 3) : ((edge + 3) & 3) * 4 + i;
+                bS[i] = (uint8_t)BoundaryStrength(
+                    pIntra, qIntra, edge == 0,
+                    p.totalCoeff[pBlock], q.totalCoeff[qBlock],
+                    p.refPic[((pBlock >> 3) << 1) | ((pBlock & 3) >> 1)],
+                    q.refPic[((qBlock >> 3) << 1) | ((qBlock & 3) >> 1)],
+                    p.mv[pBlock], q.mv[qBlock]);
+                any = any || bS[i] != 0;
+            }
+            if (!any) continue;
+
+            const ptrdiff_t across = (dir == 0) ? 1 : pitch;
+            const ptrdiff_t along = (dir == 0) ? pitch : 1;
+            int qpAv = (p.qp + q.qp + 1) >> 1;
+            DeblockLumaEdge(luma + edge * 4 * across, across, along, bS,
+                            Clip3(0, 51, qpAv + params.filterOffsetA),
+                            Clip3(0, 51, qpAv + params.filterOffsetB));
+
+            // Chroma edges are those of luma edges 0 and 2, with their bS
+            if (edge & 1) continue;
+            const ptrdiff_t chromaAcross = (dir == 0) ? 2 : pitch;
+            const ptrdiff_t chromaAlong = (dir == 0) ? pitch : 2;
+            uint8_t* pix = chroma + (edge / 2) * 4 * chromaAcross;
+            for (int c = 0; c < 2; c++) {
+                const int32_t offset = params.chromaQpIndexOffset[c];
+                int chromaQpAv = (ChromaQp(p.qp, offset) + ChromaQp(q.qp, offset) + 1) >> 1;
+                int indexA = Clip3(0, 51, chromaQpAv + params.filterOffsetA);
+                int indexB = Clip3(0, 51, chromaQpAv + params.filterOffsetB);
+                DeblockChromaEdge(pix + c, chromaAcross, chromaAlong, bS, indexA, indexB);
+            }
+        }
+    }
+}
+
+} // namespace FluxMic
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "H264Bitstream.h"
+#include "H264Dsp.h"
+#include "H264ParameterSets.h"
+#include "H264Picture.h"
+
+namespace FluxMic {
+
+/// H.264 slice types (Table 7-6), after slice_type % 5
+enum H264SliceType : uint32_t {
+    kSliceP = 0,
+    kSliceB = 1,
+    kSliceI = 2,
+    kSliceSp = 3,
+    kSliceSi = 4,
+};
+
+/// Slice header (ITU-T H.264 7.3.3) of a frame, as far as I and P slices
+/// use it.
+struct H264SliceHeader {
+    static const int kMaxRefListModifications = 33;
+    static const int kMaxMmco = 66;
+
+    uint8_t nalUnitType = 0;
+    uint8_t nalRefIdc = 0;
+
+    uint32_t firstMbInSlice = 0;
+    uint32_t sliceType = 0;             // H264SliceType
+    uint32_t ppsId = 0;
+    uint32_t frameNum = 0;
+    uint32_t idrPicId = 0;
+    uint32_t picOrderCntLsb = 0;
+    int32_t deltaPicOrderCntBottom = 0;
+    int32_t deltaPicOrderCnt[2] = {};
+    uint32_t redundantPicCnt = 0;
+    uint32_t numRefIdxL0Active = 0;
+
+    /// ref_pic_list_modification() of list 0 (7.3.3.1)
+    struct RefListModification {
+        uint32_t idc;                   // modification_of_pic_nums_idc, 0..2
+        uint32_t value;                 // abs_diff_pic_num_minus1 or long_term_pic_num
+    };
+    RefListModification refListModifications[kMaxRefListModifications];
+    uint32_t numRefListModifications = 0;
+
+    /// dec_ref_pic_marking() (7.3.3.3)
+    struct Mmco {
+        uint32_t op;                    // memory_management_control_operation, 1..6
+        uint32_t differenceOfPicNumsMinus1;
+        uint32_t longTermPicNum;
+        uint32_t longTermFrameIdx;
+        uint32_t maxLongTermFrameIdxPlus1;
+    };
+    bool noOutputOfPriorPics = false;
+    bool longTermReference = false;
+    bool adaptiveRefPicMarking = false;
+    Mmco mmco[kMaxMmco];
+    uint32_t numMmco = 0;
+
+    int32_t sliceQpDelta = 0;
+    uint32_t disableDeblockingFilterIdc = 0;
+    int32_t filterOffsetA = 0;          // slice_alpha_c0_offset_div2 << 1
+    int32_t filterOffsetB = 0;          // slice_beta_offset_div2 << 1
+
+    bool IsIdr() const { return nalUnitType == 5; }
+};
+
+/// Decodes the macroblocks of I and P slices coded with CAVLC into a
+/// picture (ITU-T H.264 7.3.4, 7.3.5, clause 8), then conceals what no
+/// slice covered and runs the deblocking filter over the whole picture.
+///
+/// What the decoder supports is checked before slices get here: 8-bit
+/// 4:2:0 frames, one slice group, flat scaling matrices, no weighted
+/// prediction and no 8x8 transform.
+class H264SliceDecoder {
+public:
+    explicit H264SliceDecoder(const H264DspFunctions& dsp) : m_dsp(dsp) {}
+
+    /// Start decoding into `picture`, laid out for the SPS's coded size.
+    void StartPicture(const H264Sps& sps, H264Picture* picture);
+
+    /// Decode the slice_data() following `header`. A P slice predicts from
+    /// `refList`, which holds header.numRefIdxL0Active entries; an entry is
+    /// nullptr where the reference picture is missing.
+    /// Returns false if the data is damaged; the macroblocks decoded until
+    /// then are kept, the others are concealed by FinishPicture().
+    bool DecodeSlice(BitReader& reader, const H264SliceHeader& header, const H264Pps& pps,
+                     const H264Picture* const* refList);
+
+    /// Copy the macroblocks which no slice decoded from `concealFrom` (grey
+    /// without one), deblock, and extend the edges for use as a reference.
+    /// Returns the number of macroblocks concealed.
+    uint32_t FinishPicture(const H264Picture* concealFrom);
+
+private:
+    enum MbKind : uint8_t {
+        kMbIntra4x4,
+        kMbIntra16x16,
+        kMbPcm,
+        kMbInter,
+        kMbConcealed,
+    };
+
+    /// What the neighbours of a macroblock, and the deblocking filter,
+    /// need to know about it. 4x4 blocks are in raster order.
+    struct MbInfo {
+        int32_t slice;                  // index into m_slices, -1 until decoded
+        uint8_t kind;                   // MbKind
+        uint8_t qp;                     // QPY; 0 for I_PCM, as deblocking uses it
+        uint8_t totalCoeff[16 + 2 * 4]; // luma, then the Cb and Cr AC blocks
+        int8_t intraModes[16];          // Intra4x4PredMode; DC elsewhere
+        int8_t refIdx[16];              // -1 intra, -2 not predicted yet
+        int16_t mv[16][2];
+        const H264Picture* refPic[4];   // by 8x8 block
+    };
+
+    /// Per slice settings the deblocking filter needs after the slice
+    struct SliceParams {
+        uint32_t disableDeblockingFilterIdc;
+        int32_t filterOffsetA;
+        int32_t filterOffsetB;
+        int32_t chromaQpIndexOffset[2];     // Cb and Cr
+    };
+
+    /// A neighbouring 4x4 block for motion vector prediction
+    struct MvNeighbour {
+        bool available;
+        int refIdx;
+        int mvx;
+        int mvy;
+    };
+
+    static bool IsIntra(uint8_t kind) {
+        return kind == kMbIntra4x4 || kind == kMbIntra16x16 || kind == kMbPcm;
+    }
+
+    bool DecodeMacroblock(BitReader& reader, uint32_t mbAddr);
+    bool DecodeSkip(uint32_t mbAddr);
+    bool DecodePcm(BitReader& reader, MbInfo& mb);
+    bool DecodeInterPrediction(BitReader& reader, MbInfo& mb, uint32_t mbType);
+    bool DecodeResidual(BitReader& reader, MbInfo& mb, uint32_t cbp, bool intra16x16);
+
+    // Neighbour lookups for the current macroblock (m_mbX, m_mbY)
+    const MbInfo* NeighbourMb(int dx, int dy) const;
+    bool IntraAvailable(const MbInfo* neighbour) const;
+    int Nc(const MbInfo& mb, int base, int x, int y, int gridSize) const;
+    int PredictIntra4x4Mode(const MbInfo& mb, int x, int y) const;
+    MvNeighbour MvAt(const MbInfo& mb, int x, int y) const;
+    void PredictMv(const MbInfo& mb, int x, int y, int w, int h, int refIdx, int shape, int* mv) const;
+    void SetMotion(MbInfo& mb, int x, int y, int w, int h, int refIdx, const int* mv);
+    const H264Picture* RefPicture(uint32_t refIdx) const;
+
+    // Reconstruction
+    void ReconstructIntra(MbInfo& mb, int intra16x16Mode, int chromaMode, uint32_t cbp);
+    void AddLumaResidual(const MbInfo& mb);
+    void AddChromaResidual(const MbInfo& mb, uint32_t cbp);
+    void PredictInter(const H264Picture* ref, int x, int y, int w, int h, int mvx, int mvy);
+
+    void Conceal(uint32_t mbAddr, const H264Picture* concealFrom);
+    void DeblockMacroblock(uint32_t mbAddr);
+
+    const H264DspFunctions& m_dsp;
+
+    H264Picture* m_picture = nullptr;
+    uint32_t m_widthInMbs = 0;
+    uint32_t m_heightInMbs = 0;
+    std::vector<MbInfo> m_mbs;
+    std::vector<SliceParams> m_slices;
+
+    // The slice being decoded
+    const H264SliceHeader* m_header = nullptr;
+    const H264Pps* m_pps = nullptr;
+    const H264Picture* const* m_refList = nullptr;
+    int32_t m_slice = -1;
+    int m_qp = 0;
+
+    // The macroblock being decoded
+    int m_mbX = 0;
+    int m_mbY = 0;
+
+    // Dequantised coefficients, cleared again by the inverse transforms
+    alignas(16) int16_t m_lumaCoeffs[16][16];
+    alignas(16) int16_t m_chromaCoeffs[2][4][16];
+};
+
+} // namespace FluxMic
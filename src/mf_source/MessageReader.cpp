@@ -0,0 +1,99 @@
+#include "MessageReader.h"
+#include "FrameMessage.h"
+
+#include <chrono>
+
+namespace FluxMic {
+
+MessageReader::MessageReader(size_t slotCount, size_t initialCapacity)
+    : m_ring(slotCount, initialCapacity),
+      m_initialCapacity(initialCapacity) {
+}
+
+MessageReader::~MessageReader() {
+    Stop();
+}
+
+void MessageReader::Start(std::unique_ptr<MessageSource> source) {
+    Stop();
+    if (!source) return;
+
+    m_ring.Reset();
+    m_source = std::move(source);
+    m_running.store(true, std::memory_order_release);
+    m_thread = std::thread([this] { Run(); });
+}
+
+void MessageReader::Stop() {
+    if (m_source) {
+        m_source->Cancel();
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    m_source.reset();
+    m_running.store(false, std::memory_order_release);
+}
+
+bool MessageReader::WaitForMessage(uint32_t timeoutMs) {
+    if (m_ring.Count() > 0) return true;
+    if (timeoutMs == 0) return false;
+
+    std::unique_lock<std::mutex> lock(m_waitLock);
+    m_waitCv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] {
+        return m_ring.Count() > 0 || !IsRunning();
+    });
+    return m_ring.Count() > 0;
+}
+
+void MessageReader::Run() {
+    for (;;) {
+        std::vector<uint8_t>* buffer = m_ring.BeginWrite();
+        const bool overflow = (buffer == nullptr);
+        if (overflow) {
+            if (m_overflow.empty()) {
+                m_overflow.resize(m_initialCapacity);
+            }
+            buffer = &m_overflow;
+        }
+
+        size_t size = 0;
+        MessageSource::Result result = m_source->ReadMessage(*buffer, size);
+        if (result == MessageSource::Result::Closed ||
+            result == MessageSource::Result::Cancelled) {
+            break;
+        }
+
+        FrameHeader header;
+        if (result == MessageSource::Result::TooLarge ||
+            !ParseFrameMessage(buffer->data(), size, header)) {
+            m_invalid++;
+            continue;
+        }
+        if (overflow) {
+            // The consumer may have made room during the read; hand the
+            // spare buffer over to the free slot instead of copying.
+            std::vector<uint8_t>* slot = m_ring.BeginWrite();
+            if (!slot) {
+                m_dropped++;
+                continue;
+            }
+            slot->swap(m_overflow);
+        }
+
+        m_ring.CommitWrite(size);
+        Notify();
+    }
+
+    m_running.store(false, std::memory_order_release);
+    Notify();
+}
+
+// Taking the lock orders the publish before a waiter's predicate check,
+// so a wake-up can't slip in between the check and the wait.
+void MessageReader::Notify() {
+    { std::lock_guard<std::mutex> lock(m_waitLock); }
+    m_waitCv.notify_all();
+}
+
+} // namespace FluxMic
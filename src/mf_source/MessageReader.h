@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MessageRing.h"
+
+namespace FluxMic {
+
+/// Blocking source of whole messages, such as a message-mode pipe.
+/// ReadMessage() is called on the reader thread only; Cancel() may be called
+/// from any thread.
+class MessageSource {
+public:
+    enum class Result {
+        Message,    // one whole message was read
+        TooLarge,   // the message exceeded kMaxMessageSize and was discarded
+        Closed,     // the other end went away or the source failed
+        Cancelled,  // Cancel() was called
+    };
+
+    virtual ~MessageSource() = default;
+
+    /// Read the next message into `buffer`, growing it if the message doesn't fit
+    /// (up to kMaxMessageSize), and return its length in `size`.
+    virtual Result ReadMessage(std::vector<uint8_t>& buffer, size_t& size) = 0;
+
+    /// Make a pending or later ReadMessage() return Cancelled.
+    virtual void Cancel() = 0;
+};
+
+/// Reader thread which keeps reading frame messages from a source into a
+/// MessageRing as they arrive, so the consumer only pops what is there.
+///
+/// Messages which fail ParseFrameMessage() are discarded on the reader thread.
+/// When the consumer leaves every slot full, the next message is read into a
+/// spare buffer and dropped if no slot has been freed meanwhile, so the
+/// server is never held up by us.
+class MessageReader {
+public:
+    static const size_t kDefaultSlotCount = 8;
+    static const size_t kInitialSlotCapacity = 512 * 1024;
+
+    explicit MessageReader(size_t slotCount = kDefaultSlotCount,
+                           size_t initialCapacity = kInitialSlotCapacity);
+    ~MessageReader();
+
+    // Non-copyable
+    MessageReader(const MessageReader&) = delete;
+    MessageReader& operator=(const MessageReader&) = delete;
+
+    /// Start reading from `source`; messages left from a previous source are discarded.
+    void Start(std::unique_ptr<MessageSource> source);
+
+    /// Cancel the source, wait for the thread and release the source.
+    void Stop();
+
+    /// False before Start(), after Stop(), and once the source is closed.
+    bool IsRunning() const { return m_running.load(std::memory_order_acquire); }
+
+    /// Consumer side of the ring. Validated messages, oldest first.
+    MessageRing& Ring() { return m_ring; }
+
+    /// Wait up to `timeoutMs` until the ring has a message.
+    /// Returns false on timeout or if the source is closed with the ring empty.
+    bool WaitForMessage(uint32_t timeoutMs);
+
+    /// Messages dropped because the ring was full.
+    uint64_t DroppedMessages() const { return m_dropped.load(); }
+    /// Messages discarded because they were malformed or too large.
+    uint64_t InvalidMessages() const { return m_invalid.load(); }
+
+private:
+    void Run();
+    void Notify();
+
+    MessageRing m_ring;
+    size_t m_initialCapacity;
+    std::vector<uint8_t> m_overflow;  // spare buffer for messages we drop
+
+    std::unique_ptr<MessageSource> m_source;
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_invalid{0};
+
+    std::mutex m_waitLock;
+    std::condition_variable m_waitCv;
+};
+
+} // namespace FluxMic
@@ -0,0 +1,56 @@
+#include "MessageRing.h"
+
+namespace FluxMic {
+
+MessageRing::MessageRing(size_t slotCount, size_t initialCapacity)
+    : m_slots(slotCount > 0 ? slotCount : 1) {
+    for (auto& slot : m_slots) {
+        slot.buffer.resize(initialCapacity);
+    }
+}
+
+std::vector<uint8_t>* MessageRing::BeginWrite() {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    size_t tail = m_tail.load(std::memory_order_acquire);
+    if (head - tail >= m_slots.size()) return nullptr;
+    return &m_slots[head % m_slots.size()].buffer;
+}
+
+void MessageRing::CommitWrite(size_t size) {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    m_slots[head % m_slots.size()].size = size;
+    m_head.store(head + 1, std::memory_order_release);
+}
+
+bool MessageRing::Peek(size_t index, const uint8_t*& data, size_t& size) const {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t head = m_head.load(std::memory_order_acquire);
+    if (head - tail <= index) return false;
+    const Slot& slot = m_slots[(tail + index) % m_slots.size()];
+    data = slot.buffer.data();
+    size = slot.size;
+    return true;
+}
+
+void MessageRing::Pop() {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t head = m_head.load(std::memory_order_acquire);
+    if (head == tail) return;
+    m_tail.store(tail + 1, std::memory_order_release);
+}
+
+size_t MessageRing::Count() const {
+    size_t tail = m_tail.load(std::memory_order_acquire);
+    size_t head = m_head.load(std::memory_order_acquire);
+    return head - tail;
+}
+
+void MessageRing::Reset() {
+    m_head.store(0, std::memory_order_relaxed);
+    m_tail.store(0, std::memory_order_relaxed);
+    for (auto& slot : m_slots) {
+        slot.size = 0;
+    }
+}
+
+} // namespace FluxMic
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace FluxMic {
+
+/// Lock-free ring of message buffers shared by one producer thread and one
+/// consumer thread.
+///
+/// The buffers are allocated up front, so the producer normally writes into
+/// memory which already exists; it may grow the buffer it holds for a message
+/// larger than any before. A buffer belongs to the producer from BeginWrite()
+/// to CommitWrite(), and to the consumer from Front() to Pop(), so neither
+/// side copies the message to hand it over.
+class MessageRing {
+public:
+    MessageRing(size_t slotCount, size_t initialCapacity);
+
+    // Non-copyable
+    MessageRing(const MessageRing&) = delete;
+    MessageRing& operator=(const MessageRing&) = delete;
+
+    /// Producer: the buffer to read the next message into, or nullptr if
+    /// every slot holds a message the consumer hasn't popped yet.
+    std::vector<uint8_t>* BeginWrite();
+
+    /// Producer: publish the first `size` bytes of the buffer from BeginWrite().
+    void CommitWrite(size_t size);
+
+    /// Consumer: the oldest message, or false if the ring is empty.
+    /// The data stays valid until Pop().
+    bool Front(const uint8_t*& data, size_t& size) const { return Peek(0, data, size); }
+
+    /// Consumer: the `index`-th oldest message (0 is the front), or false if
+    /// there are fewer. The data stays valid until it is popped.
+    bool Peek(size_t index, const uint8_t*& data, size_t& size) const;
+
+    /// Consumer: release the oldest message.
+    void Pop();
+
+    /// Number of published messages (exact only on the consumer thread).
+    size_t Count() const;
+    size_t SlotCount() const { return m_slots.size(); }
+
+    /// Discard every message. Only while neither side is running.
+    void Reset();
+
+private:
+    struct Slot {
+        std::vector<uint8_t> buffer;
+        size_t size = 0;
+    };
+
+    std::vector<Slot> m_slots;
+
+    // Free-running indices; slot = index % slot count.
+    // Each is written by one side only, and kept on its own cache line.
+    alignas(64) std::atomic<size_t> m_head{0};  // next slot to publish (producer)
+    alignas(64) std::atomic<size_t> m_tail{0};  // next slot to pop (consumer)
+};
+
+} // namespace FluxMic
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace FluxMic {
+
+/// Small pool of reusable media samples, each with one buffer.
+///
+/// A sample is handed out again once nobody but the pool holds it, so a
+/// sample the decoder or a consumer still keeps is never overwritten. In the
+/// steady state every Acquire() finds an idle sample big enough and nothing
+/// is allocated; Allocations() counts the samples and buffers created, so
+/// that can be checked.
+///
+/// `Ops` supplies static functions for the sample type:
+///   Sample* Create(size_t capacity);          // nullptr on failure
+///   bool    Grow(Sample*, size_t capacity);   // replace the buffer with a bigger one
+///   size_t  Capacity(Sample*);
+///   bool    IsIdle(Sample*);                  // only the pool holds it
+///   void    Destroy(Sample*);
+/// This keeps the pool free of Media Foundation, so it is tested on any platform.
+template <typename Sample, typename Ops>
+class SamplePool {
+public:
+    SamplePool() = default;
+    ~SamplePool() { Clear(); }
+
+    // Non-copyable
+    SamplePool(const SamplePool&) = delete;
+    SamplePool& operator=(const SamplePool&) = delete;
+
+    /// An idle sample with room for at least `capacity` bytes, or nullptr if
+    /// one can't be allocated. The pool keeps its reference; the caller
+    /// takes its own for as long as it needs the sample beyond the next Acquire().
+    Sample* Acquire(size_t capacity) {
+        Sample* smallest = nullptr;
+        for (Sample* sample : m_samples) {
+            if (!Ops::IsIdle(sample)) continue;
+            if (Ops::Capacity(sample) >= capacity) return sample;
+            if (!smallest) smallest = sample;
+        }
+        if (smallest) {
+            // Grow an idle sample rather than adding another one
+            if (!Ops::Grow(smallest, capacity)) return nullptr;
+            m_allocations.fetch_add(1, std::memory_order_relaxed);
+            return smallest;
+        }
+        Sample* sample = Ops::Create(capacity);
+        if (!sample) return nullptr;
+        m_allocations.fetch_add(1, std::memory_order_relaxed);
+        m_samples.push_back(sample);
+        return sample;
+    }
+
+    /// Allocate up front, once the sample size is known, so that the first
+    /// `count` Acquire() calls of that size don't: idle samples are grown
+    /// to `capacity` and new ones added up to `count`. Returns false if an
+    /// allocation fails.
+    bool Reserve(size_t count, size_t capacity) {
+        for (Sample* sample : m_samples) {
+            if (!Ops::IsIdle(sample) || Ops::Capacity(sample) >= capacity) continue;
+            if (!Ops::Grow(sample, capacity)) return false;
+            m_allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+        while (m_samples.size() < count) {
+            Sample* sample = Ops::Create(capacity);
+            if (!sample) return false;
+            m_allocations.fetch_add(1, std::memory_order_relaxed);
+            m_samples.push_back(sample);
+        }
+        return true;
+    }
+
+    /// Release every sample (those still held elsewhere live on there).
+    void Clear() {
+        for (Sample* sample : m_samples) {
+            Ops::Destroy(sample);
+        }
+        m_samples.clear();
+    }
+
+    size_t Size() const { return m_samples.size(); }
+    /// May be read from any thread, e.g. for a log.
+    uint64_t Allocations() const { return m_allocations.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<Sample*> m_samples;
+    std::atomic<uint64_t> m_allocations{0};
+};
+
+} // namespace FluxMic
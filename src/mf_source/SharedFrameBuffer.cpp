@@ -26,6 +26,109 @@ static void PipeDbgLog(const char* fmt, ...) {
 
 namespace FluxMic {
 
+namespace {
+
+/// Message-mode pipe read with overlapped I/O, so that a pending read can be
+/// abandoned when the reader is stopped. Owns the pipe handle.
+class PipeMessageSource : public MessageSource {
+public:
+    explicit PipeMessageSource(HANDLE hPipe)
+        : m_hPipe(hPipe),
+          m_ioEvent(CreateEventW(nullptr, TRUE, FALSE, nullptr)),
+          m_cancelEvent(CreateEventW(nullptr, TRUE, FALSE, nullptr)) {
+    }
+
+    ~PipeMessageSource() override {
+        CloseHandle(m_hPipe);
+        if (m_ioEvent) CloseHandle(m_ioEvent);
+        if (m_cancelEvent) CloseHandle(m_cancelEvent);
+    }
+
+    Result ReadMessage(std::vector<uint8_t>& buffer, size_t& size) override {
+        if (!m_ioEvent || !m_cancelEvent) return Result::Closed;
+
+        size_t offset = 0;
+        bool tooLarge = false;
+        for (;;) {
+            if (offset >= buffer.size()) {
+                // Only after ERROR_MORE_DATA; make room for the rest of the message
+                DWORD bytesLeft = 0;
+                PeekNamedPipe(m_hPipe, nullptr, 0, nullptr, nullptr, &bytesLeft);
+                size_t needed = offset + (bytesLeft > 0 ? bytesLeft : 4096);
+                if (needed > kMaxMessageSize) {
+                    // Keep reading the rest into the start of the buffer and discard it
+                    tooLarge = true;
+                    offset = 0;
+                } else {
+                    buffer.resize(needed);
+                }
+            }
+
+            DWORD bytesRead = 0;
+            DWORD err = ReadOverlapped(buffer.data() + offset, (DWORD)(buffer.size() - offset), bytesRead);
+            offset += bytesRead;
+            if (err == ERROR_SUCCESS) {
+                size = offset;
+                return tooLarge ? Result::TooLarge : Result::Message;
+            }
+            if (err == ERROR_MORE_DATA) {
+                if (tooLarge) {
+                    offset = 0;
+                } else {
+                    PipeDbgLog("ReadMessage: ERROR_MORE_DATA, bytesRead=%zu, growing buffer\n", offset);
+                }
+                continue;
+            }
+            if (err == ERROR_OPERATION_ABORTED) {
+                return Result::Cancelled;
+            }
+            PipeDbgLog("ReadMessage: ReadFile failed, error=%lu\n", err);
+            return Result::Closed;
+        }
+    }
+
+    void Cancel() override {
+        if (m_cancelEvent) SetEvent(m_cancelEvent);
+    }
+
+private:
+    // Issues one ReadFile and waits for it or for Cancel().
+    // Returns the Win32 error of the read (ERROR_OPERATION_ABORTED if cancelled).
+    DWORD ReadOverlapped(uint8_t* dst, DWORD length, DWORD& bytesRead) {
+        bytesRead = 0;
+        if (WaitForSingleObject(m_cancelEvent, 0) == WAIT_OBJECT_0) {
+            return ERROR_OPERATION_ABORTED;
+        }
+
+        OVERLAPPED ov = {};
+        ov.hEvent = m_ioEvent;
+        ResetEvent(m_ioEvent);
+
+        BOOL ok = ReadFile(m_hPipe, dst, length, nullptr, &ov);
+        DWORD err = ok ? ERROR_SUCCESS : GetLastError();
+        if (!ok && err != ERROR_IO_PENDING && err != ERROR_MORE_DATA) {
+            return err;
+        }
+        if (err == ERROR_IO_PENDING) {
+            HANDLE handles[2] = { m_ioEvent, m_cancelEvent };
+            if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                CancelIoEx(m_hPipe, &ov);
+            }
+        }
+        // The OVERLAPPED must not go out of scope before the I/O completes.
+        if (!GetOverlappedResult(m_hPipe, &ov, &bytesRead, TRUE)) {
+            return GetLastError();
+        }
+        return ERROR_SUCCESS;
+    }
+
+    HANDLE m_hPipe;
+    HANDLE m_ioEvent;
+    HANDLE m_cancelEvent;
+};
+
+} // namespace
+
 SharedFrameReader::~SharedFrameReader() {
     Close();
 }
@@ -36,17 +139,17 @@ bool SharedFrameReader::Open() {
     // Connect to the named pipe created by the FluxMic Rust app.
     // GENERIC_READ for reading frames, FILE_WRITE_ATTRIBUTES needed for
     // SetNamedPipeHandleState to switch to PIPE_READMODE_MESSAGE.
-    m_hPipe = CreateFileW(
+    HANDLE hPipe = CreateFileW(
         kPipeName,
         GENERIC_READ | FILE_WRITE_ATTRIBUTES,
         0,              // no sharing
         nullptr,        // default security (pipe server sets the DACL)
         OPEN_EXISTING,
-        0,              // synchronous I/O
+        FILE_FLAG_OVERLAPPED,  // reads are cancellable by Close()
         nullptr
     );
 
-    if (m_hPipe == INVALID_HANDLE_VALUE) {
+    if (hPipe == INVALID_HANDLE_VALUE) {
         DWORD err = GetLastError();
         PipeDbgLog("Open: CreateFileW failed, error=%lu\n", err);
         return false;
@@ -54,108 +157,108 @@ bool SharedFrameReader::Open() {
 
     // Set pipe to message-read mode (must match server's PIPE_TYPE_MESSAGE)
     DWORD mode = PIPE_READMODE_MESSAGE;
-    if (!SetNamedPipeHandleState(m_hPipe, &mode, nullptr, nullptr)) {
+    if (!SetNamedPipeHandleState(hPipe, &mode, nullptr, nullptr)) {
         PipeDbgLog("Open: SetNamedPipeHandleState failed, error=%lu\n", GetLastError());
-        Close();
+        CloseHandle(hPipe);
         return false;
     }
 
-    // Pre-allocate read buffer for max message size
-    m_readBuffer.resize(kMaxMessageSize);
     m_hasFrame = false;
     m_lastSequence = 0;
+    m_reader.Start(std::unique_ptr<MessageSource>(new PipeMessageSource(hPipe)));
 
     PipeDbgLog("Open: Connected to pipe successfully\n");
     return true;
 }
 
 void SharedFrameReader::Close() {
-    if (m_hPipe != INVALID_HANDLE_VALUE) {
-        CloseHandle(m_hPipe);
-        m_hPipe = INVALID_HANDLE_VALUE;
+    m_reader.Stop();
+    m_frameData = nullptr;
+    m_hasFrame = false;
+    m_backlogCount = 0;
+    m_backlogNext = 0;
+}
+
+void SharedFrameReader::ReleaseFrame() {
+    if (m_frameData) {
+        m_reader.Ring().Pop();
+        m_frameData = nullptr;
     }
     m_hasFrame = false;
 }
 
 bool SharedFrameReader::WaitForFrame(DWORD timeoutMs) {
-    if (m_hPipe == INVALID_HANDLE_VALUE) return false;
+    ReleaseFrame();
+    if (!m_reader.IsRunning()) return false;
 
-    m_hasFrame = false;
+    // Frames of the previous backlog which weren't stepped through are released
+    MessageRing& ring = m_reader.Ring();
+    for (; m_backlogNext < m_backlogCount; m_backlogNext++) {
+        ring.Pop();
+    }
 
-    // Poll for data with timeout.
-    // Use do-while to always check at least once, even with timeoutMs=0.
-    DWORD elapsed = 0;
-    do {
-        DWORD bytesAvail = 0;
-        if (!PeekNamedPipe(m_hPipe, nullptr, 0, nullptr, &bytesAvail, nullptr)) {
-            // Pipe broken (server disconnected)
-            DWORD err = GetLastError();
-            PipeDbgLog("WaitForFrame: PeekNamedPipe failed, error=%lu (pipe broken)\n", err);
-            Close();
-            return false;
-        }
+    if (!m_reader.WaitForMessage(timeoutMs)) {
+        return false;
+    }
 
-        if (bytesAvail > 0) {
-            // Drain old messages: keep reading until we get the latest frame.
-            // The server writes at 60fps but we consume at ~30fps, so messages
-            // can queue up. Always deliver the newest frame.
-            bool readOk = false;
-            while (true) {
-                DWORD bytesRead = 0;
-                BOOL ok = ReadFile(
-                    m_hPipe,
-                    m_readBuffer.data(),
-                    (DWORD)m_readBuffer.size(),
-                    &bytesRead,
-                    nullptr
-                );
-
-                if (!ok) {
-                    DWORD err = GetLastError();
-                    if (err == ERROR_MORE_DATA) {
-                        PipeDbgLog("WaitForFrame: ERROR_MORE_DATA, bytesRead=%lu\n", bytesRead);
-                    } else {
-                        PipeDbgLog("WaitForFrame: ReadFile failed, error=%lu\n", err);
-                        Close();
-                    }
-                    return readOk; // Return true if we already read a valid frame
-                }
+    // The server writes at 60fps but we consume at ~30fps, so messages can
+    // queue up. Plan which of them must be decoded to show the newest one.
+    size_t count = ring.Count();
+    if (m_backlogInfo.size() < ring.SlotCount()) {
+        m_backlogInfo.resize(ring.SlotCount());
+        m_backlogActions.resize(ring.SlotCount());
+        m_backlogSequences.resize(ring.SlotCount());
+    }
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        ring.Peek(i, data, size);
+        FrameHeader header;
+        memcpy(&header, data, sizeof(FrameHeader));
+        m_backlogSequences[i] = header.sequence;
+        m_backlogInfo[i] = ScanAccessUnit(data + kHeaderSize, size - kHeaderSize);
+    }
+    PlanBacklog(m_backlogInfo.data(), count, kBacklogSkipThreshold, m_backlogActions.data());
 
-                if (bytesRead < kHeaderSize) {
-                    return readOk;
-                }
+    m_backlogCount = count;
+    m_backlogNext = 0;
+    return count > 0;
+}
 
-                // Parse and validate header
-                FrameHeader hdr;
-                memcpy(&hdr, m_readBuffer.data(), sizeof(FrameHeader));
+bool SharedFrameReader::NextFrame() {
+    MessageRing& ring = m_reader.Ring();
+    while (m_backlogNext < m_backlogCount) {
+        ReleaseFrame();
+        size_t index = m_backlogNext++;
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        if (!ring.Front(data, size)) break;
 
-                if (hdr.frame_size == 0 || hdr.frame_size > kMaxFrameDataSize) return readOk;
-                if (bytesRead != kHeaderSize + hdr.frame_size) return readOk;
+        if (m_backlogActions[index] == BacklogAction::Skip) {
+            ring.Pop();
+            m_skippedFrames++;
+            continue;
+        }
 
-                m_cachedHeader = hdr;
-                m_hasFrame = true;
-                readOk = true;
+        // Validated by the reader thread already
+        memcpy(&m_cachedHeader, data, sizeof(FrameHeader));
+        m_frameData = data;
+        m_payload = data + kHeaderSize;
 
-                // Check if there's another message queued (newer frame)
-                DWORD moreAvail = 0;
-                if (!PeekNamedPipe(m_hPipe, nullptr, 0, nullptr, &moreAvail, nullptr) || moreAvail == 0) {
-                    break; // No more messages — return the latest one we read
-                }
-                // More data available — loop to read the newer frame
+        if (m_backlogActions[index] == BacklogAction::ParameterSets) {
+            // The picture is skipped; the frame becomes its SPS/PPS only
+            if (m_parameterSets.size() < m_cachedHeader.frame_size) {
+                m_parameterSets.resize(m_cachedHeader.frame_size);
             }
-
-            return readOk;
-        }
-
-        // No data yet — sleep briefly and retry
-        if (elapsed < timeoutMs) {
-            Sleep(1);
-            elapsed += 1;
-        } else {
-            break;
+            m_cachedHeader.frame_size = (uint32_t)ExtractParameterSets(
+                m_payload, m_cachedHeader.frame_size, m_parameterSets.data());
+            m_payload = m_parameterSets.data();
+            m_skippedFrames++;
+            if (m_cachedHeader.frame_size == 0) continue;
         }
-    } while (true);
-
+        m_hasFrame = true;
+        return true;
+    }
     return false;
 }
 
@@ -168,9 +271,9 @@ bool SharedFrameReader::ReadHeader(FrameHeader& header) const {
 bool SharedFrameReader::ReadFrameData(void* dst, size_t dstSize, const FrameHeader& header) {
     if (!m_hasFrame || !dst) return false;
     if (header.frame_size > dstSize) return false;
-    if (header.frame_size > kMaxFrameDataSize) return false;
+    if (header.frame_size > m_cachedHeader.frame_size) return false;
 
-    memcpy(dst, m_readBuffer.data() + kHeaderSize, header.frame_size);
+    memcpy(dst, m_payload, header.frame_size);
     m_lastSequence = header.sequence;
 
     return true;
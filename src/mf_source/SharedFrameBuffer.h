@@ -1,23 +1,24 @@
 #pragma once
 
 #include <windows.h>
+#include <atomic>
 #include <cstdint>
 #include <vector>
 
+#include "BacklogPolicy.h"
+#include "FrameMessage.h"
+#include "MessageReader.h"
+
 /// Named pipe IPC for passing video frames from the FluxMic app
 /// to the Media Foundation virtual camera source DLL.
 ///
 /// The FluxMic app (Rust/Tauri) creates a named pipe server and writes
-/// H.264 NAL data as messages. This DLL (running inside Frame Server, Session 0)
-/// connects as a pipe client and reads frames on RequestSample().
-///
-/// Wire format per message:
-///   Bytes 0-3:    width       (uint32_t LE, from SPS or 0 if unknown)
-///   Bytes 4-7:    height      (uint32_t LE, from SPS or 0 if unknown)
-///   Bytes 8-15:   timestamp   (uint64_t LE, QPC ticks)
-///   Bytes 16-19:  sequence    (uint32_t LE, wrapping counter)
-///   Bytes 20-23:  data_size   (uint32_t LE, H.264 NAL data size in bytes)
-///   Bytes 24+:    Raw H.264 Annex B NAL data (with 0x00000001 start codes)
+/// H.264 NAL data as messages (see FrameMessage.h for the wire format).
+/// This DLL (running inside Frame Server, Session 0) connects as a pipe
+/// client; a reader thread receives the messages with overlapped I/O as they
+/// arrive, and RequestSample() only takes what has already been received.
+/// Frames are P-frames referencing the ones before, so a backlog is not
+/// simply skipped to the newest frame; see BacklogPolicy.h.
 
 namespace FluxMic {
 
@@ -25,31 +26,9 @@ namespace FluxMic {
 // works cross-session without SeCreateGlobalPrivilege.
 static const wchar_t* kPipeName = L"\\\\.\\pipe\\FluxMicVideoFeed";
 
-// Header size in the wire message
-static const size_t kHeaderSize = 24;
-
-// Max supported resolution
-static const uint32_t kMaxWidth  = 1920;
-static const uint32_t kMaxHeight = 1080;
-
-// Max H.264 NAL data size per message (4MB — sufficient for worst-case keyframes)
-static const size_t kMaxFrameDataSize = 4 * 1024 * 1024;
-static const size_t kMaxMessageSize = kHeaderSize + kMaxFrameDataSize;
-
-#pragma pack(push, 1)
-struct FrameHeader {
-    uint32_t width;
-    uint32_t height;
-    uint64_t timestamp;   // QPC ticks
-    uint32_t sequence;    // wrapping frame counter
-    uint32_t frame_size;  // H.264 NAL data size in bytes
-};
-#pragma pack(pop)
-
-static_assert(sizeof(FrameHeader) == kHeaderSize, "FrameHeader must be 24 bytes");
-
 /// Reader side — used by the MF source COM DLL.
-/// Connects to the named pipe created by the FluxMic app and reads frames.
+/// Connects to the named pipe created by the FluxMic app and runs the reader
+/// thread which fills the message ring.
 class SharedFrameReader {
 public:
     SharedFrameReader() = default;
@@ -59,37 +38,72 @@ public:
     SharedFrameReader(const SharedFrameReader&) = delete;
     SharedFrameReader& operator=(const SharedFrameReader&) = delete;
 
-    /// Connect to the named pipe server.
+    /// Connect to the named pipe server and start the reader thread.
     /// Returns true on success, false if pipe doesn't exist or connection fails.
     bool Open();
 
-    /// Disconnect from the pipe.
+    /// Stop the reader thread and disconnect from the pipe.
     void Close();
 
     /// Check if pipe is currently connected.
-    bool IsOpen() const { return m_hPipe != INVALID_HANDLE_VALUE; }
+    /// Becomes false when the reader thread sees the server disconnect.
+    bool IsOpen() const { return m_reader.IsRunning(); }
 
-    /// Wait for a new frame to be available on the pipe.
-    /// Reads the next message from the pipe, caches it internally.
-    /// Returns true if a frame was read, false on timeout or error.
+    /// Take the frames received so far, waiting up to `timeoutMs` if none
+    /// has arrived (0 never waits), and decide with PlanBacklog() which of
+    /// them the decoder must see. Step through those with NextFrame().
+    /// Returns true if there are frames, false on timeout or error.
     bool WaitForFrame(DWORD timeoutMs);
 
-    /// Read the cached frame header.
-    /// Only valid after WaitForFrame() returns true.
+    /// Move to the next frame to decode, oldest first, releasing the previous
+    /// one. The last one is the newest frame, and is held until the next
+    /// WaitForFrame() or Close(). Returns false when there are no more.
+    bool NextFrame();
+
+    /// The frames taken by the last WaitForFrame(), including those which
+    /// NextFrame() skips, oldest first: their sequence numbers and contents.
+    size_t BacklogCount() const { return m_backlogCount; }
+    uint32_t BacklogSequence(size_t index) const { return m_backlogSequences[index]; }
+    const AccessUnitInfo& BacklogInfo(size_t index) const { return m_backlogInfo[index]; }
+
+    /// Read the current frame header.
+    /// Only valid after NextFrame() returns true.
     bool ReadHeader(FrameHeader& header) const;
 
-    /// Read cached frame BGRA data into the provided buffer.
-    /// Only valid after WaitForFrame() returns true.
+    /// Read current frame H.264 data into the provided buffer.
+    /// Only valid after NextFrame() returns true.
     bool ReadFrameData(void* dst, size_t dstSize, const FrameHeader& header);
 
     /// Get the last sequence number we successfully read
     uint32_t LastSequence() const { return m_lastSequence; }
 
-private:
-    HANDLE m_hPipe = INVALID_HANDLE_VALUE;
+    /// Frames the reader thread dropped because the ring was full,
+    /// and malformed messages it discarded.
+    uint64_t DroppedMessages() const { return m_reader.DroppedMessages(); }
+    uint64_t InvalidMessages() const { return m_reader.InvalidMessages(); }
+
+    /// Frames of a backlog which PlanBacklog() let us skip, including those
+    /// of which only the parameter sets are read.
+    uint64_t SkippedFrames() const { return m_skippedFrames.load(std::memory_order_relaxed); }
 
-    // Cached message from last successful read
-    std::vector<uint8_t> m_readBuffer;
+private:
+    void ReleaseFrame();
+
+    MessageReader m_reader;
+
+    // Plan for the frames taken by WaitForFrame(), one per message in the ring
+    std::vector<AccessUnitInfo> m_backlogInfo;
+    std::vector<uint32_t> m_backlogSequences;
+    std::vector<BacklogAction> m_backlogActions;
+    size_t m_backlogCount = 0;
+    size_t m_backlogNext = 0;
+    std::atomic<uint64_t> m_skippedFrames{0};
+
+    // Message held in the ring by NextFrame(), and the frame data read from
+    // it: the message payload, or its SPS/PPS copied to m_parameterSets
+    const uint8_t* m_frameData = nullptr;
+    const uint8_t* m_payload = nullptr;
+    std::vector<uint8_t> m_parameterSets;
     FrameHeader m_cachedHeader = {};
     bool m_hasFrame = false;
     uint32_t m_lastSequence = 0;
@@ -0,0 +1,533 @@
+#include "SoftH264Decoder.h"
+
+#include <algorithm>
+
+namespace FluxMic {
+
+SoftH264Decoder::SoftH264Decoder(const H264DspFunctions& dsp)
+    : m_dsp(dsp), m_sliceDecoder(dsp) {
+    m_refs.reserve(kMaxRefs + 1);
+}
+
+SoftH264Decoder::~SoftH264Decoder() {
+    Shutdown();
+}
+
+bool SoftH264Decoder::Initialize() {
+    if (m_initialized) return true;
+    std::fill(m_hasSps, m_hasSps + kMaxSps, false);
+    std::fill(m_hasPps, m_hasPps + kMaxPps, false);
+    m_waitingForKeyframe = true;
+    m_lastError = nullptr;
+    m_initialized = true;
+    return true;
+}
+
+void SoftH264Decoder::Shutdown() {
+    m_current.Reset();
+    m_currentPicture = nullptr;
+    m_refs.clear();
+    std::fill(m_refList, m_refList + kMaxRefs + 1, nullptr);
+    m_lastRefFrame.Reset();
+    m_decodedFrame.Reset();
+    m_picturePool.Clear();
+    m_codedWidth = m_codedHeight = 0;
+    m_initialized = false;
+}
+
+void SoftH264Decoder::Prepare(const H264Sps& sps) {
+    if (!m_initialized || sps.chromaFormatIdc != 1 || !sps.frameMbsOnly) return;
+
+    // The reference frames, the picture being decoded and the last one
+    // output, which the stream may still be copying
+    size_t pictures = sps.maxNumRefFrames + 2;
+    m_picturePool.Reserve(pictures, H264Picture::BufferSize(sps.CodedWidth(), sps.CodedHeight()));
+}
+
+bool SoftH264Decoder::DecodeNal(const uint8_t* nalData, uint32_t nalSize) {
+    if (!m_initialized) return false;
+
+    const uint64_t picturesBefore = m_pictures;
+    const uint64_t concealedBefore = m_concealedMbs;
+    bool damaged = false;
+    NalScanner scanner(nalData, nalSize);
+    NalUnit nal;
+    while (scanner.Next(nal)) {
+        if (nal.size < 2) continue;
+
+        switch (nal.type) {
+        case kNalSps: {
+            BitReader reader = Unescape(nal);
+            H264Sps sps;
+            if (ParseSps(reader, sps)) {
+                m_sps[sps.id] = sps;
+                m_hasSps[sps.id] = true;
+            }
+            break;
+        }
+        case kNalPps: {
+            BitReader reader = Unescape(nal);
+            H264Pps pps;
+            if (ParsePps(reader, pps)) {
+                m_pps[pps.id] = pps;
+                m_hasPps[pps.id] = true;
+            }
+            break;
+        }
+        case kNalSlice:
+        case kNalSliceIdr:
+            if (!DecodeSliceNal(nal)) damaged = true;
+            break;
+        case kNalSliceDpa:
+            m_lastError = "slice data partitioning";
+            damaged = true;
+            break;
+        case kNalAud:
+        case kNalEndOfSequence:
+        case kNalEndOfStream:
+            if (m_currentPicture) FinishPicture();
+            break;
+        default:
+            break;
+        }
+    }
+
+    // One message is one access unit
+    if (m_currentPicture) FinishPicture();
+    if (damaged || m_concealedMbs != concealedBefore) {
+        m_decodeErrors.fetch_add(1, std::memory_order_relaxed);
+    }
+    return m_pictures != picturesBefore;
+}
+
+BitReader SoftH264Decoder::Unescape(const NalUnit& nal) {
+    const size_t capacity = m_rbsp.capacity();
+    size_t size = UnescapeRbsp(nal.data + 1, nal.size - 1, m_rbsp);
+    if (m_rbsp.capacity() != capacity) m_rbspAllocations.fetch_add(1, std::memory_order_relaxed);
+    return BitReader(m_rbsp.data(), size, true);
+}
+
+// ============================================================================
+// Slices
+// ============================================================================
+
+static const char* Unsupported(const H264Sps& sps, const H264Pps& pps) {
+    if (sps.chromaFormatIdc != 1) return "chroma format other than 4:2:0";
+    if (sps.bitDepthLuma != 8 || sps.bitDepthChroma != 8) return "bit depth other than 8";
+    if (!sps.frameMbsOnly) return "interlaced coding";
+    if (sps.transformBypass) return "lossless coding";
+    if (sps.scalingMatrixPresent || pps.scalingMatrixPresent) return "scaling matrices";
+    if (pps.entropyCodingMode) return "CABAC";
+    if (pps.numSliceGroups > 1) return "slice groups";
+    if (pps.weightedPred) return "weighted prediction";
+    if (pps.transform8x8Mode) return "8x8 transform";
+    return nullptr;
+}
+
+bool SoftH264Decoder::DecodeSliceNal(const NalUnit& nal) {
+    BitReader reader = Unescape(nal);
+    H264SliceHeader& header = m_sliceHeader;
+    if (!ParseSliceHeader(reader, nal, header)) return false;
+    if (header.redundantPicCnt > 0) return true;    // the primary picture is enough
+
+    if (m_currentPicture && IsNewPicture(header)) {
+        FinishPicture();
+    }
+    if (!m_currentPicture && !StartPicture(header)) return false;
+
+    const H264Pps& pps = m_pps[header.ppsId];
+    if (pps.spsId != m_activeSps.id || Unsupported(m_activeSps, pps)) {
+        m_lastError = "slices of one picture with incompatible parameter sets";
+        return false;
+    }
+    if (header.sliceType == kSliceP) {
+        if (!BuildRefList(header, m_activeSps)) return false;
+    } else {
+        m_pictureHasIntraSlice = true;
+    }
+    m_sliceDecoder.DecodeSlice(reader, header, pps, m_refList);
+    return true;
+}
+
+// slice_header() (7.3.3) of an I or P slice of a supported picture
+bool SoftH264Decoder::ParseSliceHeader(BitReader& reader, const NalUnit& nal, H264SliceHeader& header) {
+    header.nalUnitType = nal.type;
+    header.nalRefIdc = nal.refIdc;
+    header.firstMbInSlice = reader.ReadUe();
+    uint32_t sliceType = reader.ReadUe();
+    header.ppsId = reader.ReadUe();
+    if (sliceType > 9 || header.ppsId >= kMaxPps || !m_hasPps[header.ppsId]) return false;
+    header.sliceType = sliceType % 5;
+    const H264Pps& pps = m_pps[header.ppsId];
+    if (!m_hasSps[pps.spsId]) return false;
+    const H264Sps& sps = m_sps[pps.spsId];
+
+    if (const char* why = Unsupported(sps, pps)) {
+        m_lastError = why;
+        return false;
+    }
+    if (header.sliceType != kSliceP && header.sliceType != kSliceI) {
+        m_lastError = "B, SP or SI slices";
+        return false;
+    }
+    if (header.firstMbInSlice >= sps.widthInMbs * sps.heightInMbs) return false;
+
+    header.frameNum = reader.ReadBits((int)sps.log2MaxFrameNum);
+    header.idrPicId = header.IsIdr() ? reader.ReadUe() : 0;
+    header.picOrderCntLsb = 0;
+    header.deltaPicOrderCntBottom = 0;
+    header.deltaPicOrderCnt[0] = header.deltaPicOrderCnt[1] = 0;
+    if (sps.picOrderCntType == 0) {
+        header.picOrderCntLsb = reader.ReadBits((int)sps.log2MaxPocLsb);
+        if (pps.bottomFieldPicOrderInFramePresent) header.deltaPicOrderCntBottom = reader.ReadSe();
+    } else if (sps.picOrderCntType == 1 && !sps.deltaPicOrderAlwaysZero) {
+        header.deltaPicOrderCnt[0] = reader.ReadSe();
+        if (pps.bottomFieldPicOrderInFramePresent) header.deltaPicOrderCnt[1] = reader.ReadSe();
+    }
+    header.redundantPicCnt = pps.redundantPicCntPresent ? reader.ReadUe() : 0;
+
+    header.numRefIdxL0Active = 0;
+    header.numRefListModifications = 0;
+    if (header.sliceType == kSliceP) {
+        header.numRefIdxL0Active = pps.numRefIdxL0DefaultActive;
+        if (reader.ReadBit()) {
+            header.numRefIdxL0Active = reader.ReadUe() + 1;
+        }
+        if (header.numRefIdxL0Active > kMaxRefs) return false;
+
+        // ref_pic_list_modification()
+        if (reader.ReadBit()) {
+            for (;;) {
+                uint32_t idc = reader.ReadUe();
+                if (idc == 3) break;
+                if (idc > 3 || header.numRefListModifications >= H264SliceHeader::kMaxRefListModifications
+                    || reader.Overrun()) {
+                    return false;
+                }
+                header.refListModifications[header.numRefListModifications++] = { idc, reader.ReadUe() };
+            }
+        }
+    }
+
+    // dec_ref_pic_marking()
+    header.noOutputOfPriorPics = false;
+    header.longTermReference = false;
+    header.adaptiveRefPicMarking = false;
+    header.numMmco = 0;
+    if (header.nalRefIdc != 0) {
+        if (header.IsIdr()) {
+            header.noOutputOfPriorPics = reader.ReadBit() != 0;
+            header.longTermReference = reader.ReadBit() != 0;
+        } else {
+            header.adaptiveRefPicMarking = reader.ReadBit() != 0;
+            while (header.adaptiveRefPicMarking) {
+                H264SliceHeader::Mmco mmco = {};
+                mmco.op = reader.ReadUe();
+                if (mmco.op == 0) break;
+                if (mmco.op > 6 || header.numMmco >= H264SliceHeader::kMaxMmco || reader.Overrun()) {
+                    return false;
+                }
+                if (mmco.op == 1 || mmco.op == 3) mmco.differenceOfPicNumsMinus1 = reader.ReadUe();
+                if (mmco.op == 2) mmco.longTermPicNum = reader.ReadUe();
+                if (mmco.op == 3 || mmco.op == 6) mmco.longTermFrameIdx = reader.ReadUe();
+                if (mmco.op == 4) mmco.maxLongTermFrameIdxPlus1 = reader.ReadUe();
+                header.mmco[header.numMmco++] = mmco;
+            }
+        }
+    }
+
+    header.sliceQpDelta = reader.ReadSe();
+    header.disableDeblockingFilterIdc = 0;
+    header.filterOffsetA = header.filterOffsetB = 0;
+    if (pps.deblockingFilterControlPresent) {
+        header.disableDeblockingFilterIdc = reader.ReadUe();
+        if (header.disableDeblockingFilterIdc > 2) return false;
+        if (header.disableDeblockingFilterIdc != 1) {
+            int32_t alpha = reader.ReadSe();
+            int32_t beta = reader.ReadSe();
+            if (alpha < -6 || alpha > 6 || beta < -6 || beta > 6) return false;
+            header.filterOffsetA = alpha * 2;
+            header.filterOffsetB = beta * 2;
+        }
+    }
+    return !reader.Overrun();
+}
+
+// First VCL NAL unit of a new primary picture (7.4.1.2.4)
+bool SoftH264Decoder::IsNewPicture(const H264SliceHeader& header) const {
+    const H264SliceHeader& first = m_pictureHeader;
+    return header.frameNum != first.frameNum
+        || header.ppsId != first.ppsId
+        || (header.nalRefIdc == 0) != (first.nalRefIdc == 0)
+        || header.IsIdr() != first.IsIdr()
+        || (header.IsIdr() && header.idrPicId != first.idrPicId)
+        || header.picOrderCntLsb != first.picOrderCntLsb
+        || header.deltaPicOrderCntBottom != first.deltaPicOrderCntBottom
+        || header.deltaPicOrderCnt[0] != first.deltaPicOrderCnt[0]
+        || header.deltaPicOrderCnt[1] != first.deltaPicOrderCnt[1];
+}
+
+bool SoftH264Decoder::StartPicture(const H264SliceHeader& header) {
+    const H264Sps& sps = m_sps[m_pps[header.ppsId].spsId];
+
+    if (sps.CodedWidth() != m_codedWidth || sps.CodedHeight() != m_codedHeight) {
+        // Nothing predicts across a change of size
+        m_refs.clear();
+        m_lastRefFrame.Reset();
+        m_codedWidth = sps.CodedWidth();
+        m_codedHeight = sps.CodedHeight();
+        m_waitingForKeyframe = true;
+    }
+    if (header.IsIdr()) {
+        m_refs.clear();
+        m_prevRefFrameNum = 0;
+        m_maxLongTermFrameIdx = -1;
+    } else {
+        if (m_waitingForKeyframe && header.sliceType != kSliceI) {
+            m_lastError = "waiting for an IDR or I picture";
+            return false;
+        }
+        uint32_t maxFrameNum = 1u << sps.log2MaxFrameNum;
+        if (header.frameNum != m_prevRefFrameNum && header.frameNum != (m_prevRefFrameNum + 1) % maxFrameNum) {
+            FillFrameNumGap(sps, header.frameNum);
+        }
+    }
+
+    H264Picture* picture = m_picturePool.Acquire(H264Picture::BufferSize(m_codedWidth, m_codedHeight));
+    if (!picture) {
+        m_lastError = "out of memory";
+        return false;
+    }
+    picture->Configure(m_codedWidth, m_codedHeight);
+    picture->SetVisibleRect(sps.cropLeft, sps.cropTop, sps.Width(), sps.Height());
+    picture->AddRef();
+    m_current = FrameRef(picture);
+    m_currentPicture = picture;
+    m_pictureHeader = header;
+    m_activeSps = sps;
+    m_pictureHasIntraSlice = false;
+    m_sliceDecoder.StartPicture(sps, picture);
+    return true;
+}
+
+void SoftH264Decoder::FinishPicture() {
+    // Missing macroblocks are taken from the previous picture
+    const H264Picture* previous = static_cast<const H264Picture*>(m_decodedFrame.Get());
+    if (previous && (previous->CodedWidth() != m_codedWidth || previous->CodedHeight() != m_codedHeight)) {
+        previous = nullptr;
+    }
+    m_concealedMbs += m_sliceDecoder.FinishPicture(previous);
+
+    if (m_pictureHasIntraSlice) m_waitingForKeyframe = false;
+    if (m_pictureHeader.nalRefIdc != 0) {
+        MarkReferences(m_activeSps);
+    }
+    m_decodedFrame = m_current;
+    m_width = m_activeSps.Width();
+    m_height = m_activeSps.Height();
+    m_current.Reset();
+    m_currentPicture = nullptr;
+    m_pictures++;
+}
+
+// ============================================================================
+// Reference pictures
+// ============================================================================
+
+void SoftH264Decoder::UpdateFrameNumWrap(uint32_t currentFrameNum, uint32_t maxFrameNum) {
+    for (RefFrame& ref : m_refs) {
+        ref.frameNumWrap = (ref.frameNum > currentFrameNum)
+            ? (int32_t)ref.frameNum - (int32_t)maxFrameNum
+            : (int32_t)ref.frameNum;
+    }
+}
+
+// Frames missing between the previous reference frame and this one
+// (8.2.5.2) stand in for the lost ones with the last reference picture's
+// samples, so that the frame numbering of the DPB stays right
+void SoftH264Decoder::FillFrameNumGap(const H264Sps& sps, uint32_t frameNum) {
+    if (!m_lastRefFrame) return;
+    const uint32_t maxFrameNum = 1u << sps.log2MaxFrameNum;
+    uint32_t missing = (frameNum + maxFrameNum - m_prevRefFrameNum - 1) % maxFrameNum;
+    uint32_t unused = (m_prevRefFrameNum + 1) % maxFrameNum;
+    // The sliding window keeps no more than max_num_ref_frames of them
+    uint32_t keep = std::max<uint32_t>(sps.maxNumRefFrames, 1);
+    if (missing > keep) {
+        unused = (frameNum + maxFrameNum - keep) % maxFrameNum;
+    }
+    for (; unused != frameNum; unused = (unused + 1) % maxFrameNum) {
+        UpdateFrameNumWrap(unused, maxFrameNum);
+        SlidingWindow(sps);
+        m_refs.push_back({ m_lastRefFrame, static_cast<const H264Picture*>(m_lastRefFrame.Get()),
+                           unused, (int32_t)unused, 0, false });
+        m_prevRefFrameNum = unused;
+    }
+}
+
+void SoftH264Decoder::SlidingWindow(const H264Sps& sps) {
+    const size_t maxRefs = std::max<uint32_t>(sps.maxNumRefFrames, 1);
+    while (m_refs.size() >= maxRefs) {
+        // The short-term frame with the smallest FrameNumWrap, or a
+        // long-term one if a non-conforming stream left no short-term
+        auto oldest = m_refs.end();
+        for (auto it = m_refs.begin(); it != m_refs.end(); ++it) {
+            if (it->longTerm) continue;
+            if (oldest == m_refs.end() || it->frameNumWrap < oldest->frameNumWrap) oldest = it;
+        }
+        if (oldest == m_refs.end()) oldest = m_refs.begin();
+        m_refs.erase(oldest);
+    }
+}
+
+bool SoftH264Decoder::ApplyMmco(const H264SliceHeader::Mmco& mmco, bool& currentLongTerm,
+                                uint32_t& currentLongTermIdx) {
+    const int32_t currPicNum = (int32_t)m_pictureHeader.frameNum;
+    auto ShortTerm = [&](int32_t picNum) {
+        return std::find_if(m_refs.begin(), m_refs.end(), [&](const RefFrame& ref) {
+            return !ref.longTerm && ref.frameNumWrap == picNum;
+        });
+    };
+    auto LongTerm = [&](uint32_t idx) {
+        return std::find_if(m_refs.begin(), m_refs.end(), [&](const RefFrame& ref) {
+            return ref.longTerm && ref.longTermFrameIdx == idx;
+        });
+    };
+
+    switch (mmco.op) {
+    case 1: {   // short-term unused
+        auto it = ShortTerm(currPicNum - (int32_t)(mmco.differenceOfPicNumsMinus1 + 1));
+        if (it != m_refs.end()) m_refs.erase(it);
+        break;
+    }
+    case 2: {   // long-term unused
+        auto it = LongTerm(mmco.longTermPicNum);
+        if (it != m_refs.end()) m_refs.erase(it);
+        break;
+    }
+    case 3: {   // short-term to long-term
+        if ((int32_t)mmco.longTermFrameIdx > m_maxLongTermFrameIdx) return false;
+        int32_t picNum = currPicNum - (int32_t)(mmco.differenceOfPicNumsMinus1 + 1);
+        auto previous = LongTerm(mmco.longTermFrameIdx);
+        if (previous != m_refs.end()) m_refs.erase(previous);
+        auto it = ShortTerm(picNum);
+        if (it != m_refs.end()) {
+            it->longTerm = true;
+            it->longTermFrameIdx = mmco.longTermFrameIdx;
+        }
+        break;
+    }
+    case 4: {   // MaxLongTermFrameIdx
+        m_maxLongTermFrameIdx = (int32_t)mmco.maxLongTermFrameIdxPlus1 - 1;
+        m_refs.erase(std::remove_if(m_refs.begin(), m_refs.end(), [&](const RefFrame& ref) {
+            return ref.longTerm && (int32_t)ref.longTermFrameIdx > m_maxLongTermFrameIdx;
+        }), m_refs.end());
+        break;
+    }
+    case 5:     // all unused
+        m_refs.clear();
+        m_maxLongTermFrameIdx = -1;
+        break;
+    case 6: {   // the current picture long-term
+        if ((int32_t)mmco.longTermFrameIdx > m_maxLongTermFrameIdx) return false;
+        auto previous = LongTerm(mmco.longTermFrameIdx);
+        if (previous != m_refs.end()) m_refs.erase(previous);
+        currentLongTerm = true;
+        currentLongTermIdx = mmco.longTermFrameIdx;
+        break;
+    }
+    default:
+        return false;
+    }
+    return true;
+}
+
+void SoftH264Decoder::MarkReferences(const H264Sps& sps) {
+    const H264SliceHeader& header = m_pictureHeader;
+    const uint32_t maxFrameNum = 1u << sps.log2MaxFrameNum;
+    uint32_t frameNum = header.frameNum;
+    bool longTerm = false;
+    uint32_t longTermIdx = 0;
+
+    UpdateFrameNumWrap(frameNum, maxFrameNum);
+    if (header.IsIdr()) {
+        m_refs.clear();
+        if (header.longTermReference) {
+            longTerm = true;
+            m_maxLongTermFrameIdx = 0;
+        } else {
+            m_maxLongTermFrameIdx = -1;
+        }
+    } else if (header.adaptiveRefPicMarking) {
+        for (uint32_t i = 0; i < header.numMmco; i++) {
+            ApplyMmco(header.mmco[i], longTerm, longTermIdx);
+            if (header.mmco[i].op == 5) frameNum = 0;
+        }
+    }
+    // Without adaptive marking, the sliding window; with it, this only
+    // keeps the operations of a damaged stream from overflowing the DPB
+    if (!header.IsIdr()) SlidingWindow(sps);
+    m_refs.push_back({ m_current, m_currentPicture, frameNum, (int32_t)frameNum, longTermIdx, longTerm });
+    m_lastRefFrame = m_current;
+    m_prevRefFrameNum = frameNum;
+}
+
+bool SoftH264Decoder::BuildRefList(const H264SliceHeader& header, const H264Sps& sps) {
+    const uint32_t maxFrameNum = 1u << sps.log2MaxFrameNum;
+    const int32_t currPicNum = (int32_t)header.frameNum;
+    const uint32_t numActive = header.numRefIdxL0Active;
+    UpdateFrameNumWrap(header.frameNum, maxFrameNum);
+
+    // Initial list (8.2.4.2.1): short-term frames by descending PicNum,
+    // then long-term frames by ascending LongTermPicNum
+    const RefFrame* list[kMaxRefs + 1] = {};
+    uint32_t count = 0;
+    for (const RefFrame& ref : m_refs) {
+        if (count < kMaxRefs) list[count++] = &ref;
+    }
+    std::sort(list, list + count, [](const RefFrame* a, const RefFrame* b) {
+        if (a->longTerm != b->longTerm) return !a->longTerm;
+        return a->longTerm ? a->longTermFrameIdx < b->longTermFrameIdx : a->frameNumWrap > b->frameNumWrap;
+    });
+    for (uint32_t i = std::min(count, numActive); i <= kMaxRefs; i++) {
+        list[i] = nullptr;     // truncated to num_ref_idx_l0_active
+    }
+
+    // Modification (8.2.4.3)
+    int32_t picNumPred = currPicNum;
+    uint32_t refIdx = 0;
+    for (uint32_t m = 0; m < header.numRefListModifications && refIdx < numActive; m++) {
+        const H264SliceHeader::RefListModification& mod = header.refListModifications[m];
+        const RefFrame* pic = nullptr;
+        if (mod.idc < 2) {
+            int32_t absDiff = (int32_t)mod.value + 1;
+            if (absDiff > (int32_t)maxFrameNum) return false;
+            int32_t picNumNoWrap = (mod.idc == 0) ? picNumPred - absDiff : picNumPred + absDiff;
+            if (picNumNoWrap < 0) picNumNoWrap += (int32_t)maxFrameNum;
+            if (picNumNoWrap >= (int32_t)maxFrameNum) picNumNoWrap -= (int32_t)maxFrameNum;
+            picNumPred = picNumNoWrap;
+            int32_t picNum = (picNumNoWrap > currPicNum) ? picNumNoWrap - (int32_t)maxFrameNum : picNumNoWrap;
+            for (const RefFrame& ref : m_refs) {
+                if (!ref.longTerm && ref.frameNumWrap == picNum) pic = &ref;
+            }
+        } else {
+            for (const RefFrame& ref : m_refs) {
+                if (ref.longTerm && ref.longTermFrameIdx == mod.value) pic = &ref;
+            }
+        }
+        for (uint32_t c = numActive; c > refIdx; c--) {
+            list[c] = list[c - 1];
+        }
+        list[refIdx++] = pic;
+        uint32_t n = refIdx;
+        for (uint32_t c = refIdx; c <= numActive; c++) {
+            if (!pic || list[c] != pic) list[n++] = list[c];
+        }
+    }
+
+    for (uint32_t i = 0; i < numActive; i++) {
+        m_refList[i] = list[i] ? list[i]->picture : nullptr;
+    }
+    return true;
+}
+
+} // namespace FluxMic
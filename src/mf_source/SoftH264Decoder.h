@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "AnnexB.h"
+#include "H264Dsp.h"
+#include "H264ParameterSets.h"
+#include "H264Picture.h"
+#include "H264SliceDecoder.h"
+#include "SamplePool.h"
+#include "VideoDecoder.h"
+
+namespace FluxMic {
+
+/// Portable H.264 decoder for Constrained Baseline streams and the CAVLC
+/// I/P subset of Main and High, 8-bit 4:2:0 progressive.
+///
+/// Multiple slices and reference frames, reference list modification,
+/// memory management control operations and gaps in frame_num are
+/// handled. Pictures are output in decoding order, which is their display
+/// order without B slices. Pictures using anything else (CABAC, B slices,
+/// interlacing, weighted prediction, the 8x8 transform, scaling matrices)
+/// are dropped, with LastError() saying why.
+///
+/// Decoded pictures come from a pool and are handed out by reference;
+/// once the pool and the RBSP buffer have grown to the stream's needs,
+/// decoding allocates nothing.
+class SoftH264Decoder : public IVideoDecoder {
+public:
+    /// `dsp` chooses the kernels, e.g. H264DspScalar() to compare with.
+    explicit SoftH264Decoder(const H264DspFunctions& dsp = H264DspBest());
+    ~SoftH264Decoder() override;
+
+    // Non-copyable
+    SoftH264Decoder(const SoftH264Decoder&) = delete;
+    SoftH264Decoder& operator=(const SoftH264Decoder&) = delete;
+
+    bool Initialize() override;
+    void Shutdown() override;
+    bool IsInitialized() const override { return m_initialized; }
+
+    /// Fills the picture pool for the SPS's reference frames
+    void Prepare(const H264Sps& sps) override;
+
+    bool DecodeNal(const uint8_t* nalData, uint32_t nalSize) override;
+
+    FrameRef GetDecodedFrame() const override { return m_decodedFrame; }
+    uint32_t GetDecodedWidth() const override { return m_width; }
+    uint32_t GetDecodedHeight() const override { return m_height; }
+
+    /// RBSP buffer growths, and pictures allocated or grown by the pool
+    uint64_t GetInputAllocations() const override { return m_rbspAllocations.load(std::memory_order_relaxed); }
+    uint64_t GetOutputAllocations() const override { return m_picturePool.Allocations(); }
+
+    /// Access units with a slice dropped or macroblocks concealed, including
+    /// those before the first IDR or I picture
+    uint64_t DecodeErrors() const override { return m_decodeErrors.load(std::memory_order_relaxed); }
+
+    const char* Name() const override { return "software"; }
+
+    /// Why the last picture which couldn't be decoded was dropped, or nullptr
+    const char* LastError() const { return m_lastError; }
+
+    /// Macroblocks filled in from the previous picture because their slice
+    /// was missing or damaged
+    uint64_t ConcealedMacroblocks() const { return m_concealedMbs; }
+
+private:
+    /// A frame in the decoded picture buffer, marked as used for reference
+    struct RefFrame {
+        FrameRef frame;                 // keeps the picture from the pool
+        const H264Picture* picture;
+        uint32_t frameNum;
+        int32_t frameNumWrap;           // PicNum of a short-term frame
+        uint32_t longTermFrameIdx;      // LongTermPicNum of a long-term frame
+        bool longTerm;
+    };
+
+    static const int kMaxSps = 32;
+    static const int kMaxPps = 256;
+    static const int kMaxRefs = 32;
+
+    /// Reader over the RBSP of `nal`, unescaped into m_rbsp
+    BitReader Unescape(const NalUnit& nal);
+    /// Returns false if the slice was dropped
+    bool DecodeSliceNal(const NalUnit& nal);
+    bool ParseSliceHeader(BitReader& reader, const NalUnit& nal, H264SliceHeader& header);
+    bool IsNewPicture(const H264SliceHeader& header) const;
+    bool StartPicture(const H264SliceHeader& header);
+    void FinishPicture();
+
+    // Decoded reference picture marking (8.2.5)
+    void FillFrameNumGap(const H264Sps& sps, uint32_t frameNum);
+    void UpdateFrameNumWrap(uint32_t currentFrameNum, uint32_t maxFrameNum);
+    void SlidingWindow(const H264Sps& sps);
+    void MarkReferences(const H264Sps& sps);
+    bool ApplyMmco(const H264SliceHeader::Mmco& mmco, bool& currentLongTerm, uint32_t& currentLongTermIdx);
+
+    /// RefPicList0 (8.2.4) of a P slice into m_refList
+    bool BuildRefList(const H264SliceHeader& header, const H264Sps& sps);
+
+    bool m_initialized = false;
+    const H264DspFunctions& m_dsp;
+    H264SliceDecoder m_sliceDecoder;
+
+    H264Sps m_sps[kMaxSps];
+    H264Pps m_pps[kMaxPps];
+    bool m_hasSps[kMaxSps] = {};
+    bool m_hasPps[kMaxPps] = {};
+
+    std::vector<uint8_t> m_rbsp;
+    std::atomic<uint64_t> m_rbspAllocations{0};
+
+    // The picture being decoded, with the header of its first slice
+    FrameRef m_current;
+    H264Picture* m_currentPicture = nullptr;
+    H264SliceHeader m_pictureHeader;
+    H264Sps m_activeSps;
+    H264SliceHeader m_sliceHeader;
+    bool m_pictureHasIntraSlice = false;
+
+    // Decoded picture buffer
+    std::vector<RefFrame> m_refs;
+    const H264Picture* m_refList[kMaxRefs + 1] = {};
+    FrameRef m_lastRefFrame;            // pixels for frames lost in a frame_num gap
+    uint32_t m_prevRefFrameNum = 0;
+    int32_t m_maxLongTermFrameIdx = -1; // "no long-term frame indices"
+    bool m_waitingForKeyframe = true;
+    uint32_t m_codedWidth = 0;
+    uint32_t m_codedHeight = 0;
+
+    SamplePool<H264Picture, H264Picture::PoolOps> m_picturePool;
+
+    FrameRef m_decodedFrame;
+    uint64_t m_pictures = 0;            // pictures finished so far
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+
+    const char* m_lastError = nullptr;
+    uint64_t m_concealedMbs = 0;
+    std::atomic<uint64_t> m_decodeErrors{0};
+};
+
+} // namespace FluxMic
@@ -0,0 +1,33 @@
+#include "StageMetrics.h"
+
+namespace FluxMic {
+
+// There is one writer, so plain loads and stores are enough; a reader may
+// see the fields of a run half updated, which is fine for a log.
+void StageMetrics::Record(uint64_t microseconds) {
+    m_lastUs.store(microseconds, std::memory_order_relaxed);
+    m_totalUs.store(m_totalUs.load(std::memory_order_relaxed) + microseconds, std::memory_order_relaxed);
+    if (microseconds > m_maxUs.load(std::memory_order_relaxed)) {
+        m_maxUs.store(microseconds, std::memory_order_relaxed);
+    }
+    m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+StageMetrics::Summary StageMetrics::Get() const {
+    Summary summary;
+    summary.count = m_count.load(std::memory_order_acquire);
+    uint64_t total = m_totalUs.load(std::memory_order_relaxed);
+    summary.averageUs = summary.count ? total / summary.count : 0;
+    summary.maxUs = m_maxUs.load(std::memory_order_relaxed);
+    summary.lastUs = m_lastUs.load(std::memory_order_relaxed);
+    return summary;
+}
+
+void StageMetrics::Reset() {
+    m_count.store(0, std::memory_order_relaxed);
+    m_totalUs.store(0, std::memory_order_relaxed);
+    m_maxUs.store(0, std::memory_order_relaxed);
+    m_lastUs.store(0, std::memory_order_relaxed);
+}
+
+} // namespace FluxMic
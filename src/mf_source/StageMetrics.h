@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace FluxMic {
+
+/// Timing of one stage of the frame pipeline.
+///
+/// Recorded by the one thread which runs the stage, and read by any thread
+/// (for the debug log) without stopping it.
+class StageMetrics {
+public:
+    struct Summary {
+        uint64_t count;
+        uint64_t averageUs;
+        uint64_t maxUs;
+        uint64_t lastUs;
+    };
+
+    /// Add one run of the stage. Only from the thread which runs it.
+    void Record(uint64_t microseconds);
+
+    /// Counted since construction or the last Reset().
+    Summary Get() const;
+
+    /// Start counting over. Only while the stage isn't running.
+    void Reset();
+
+private:
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<uint64_t> m_totalUs{0};
+    std::atomic<uint64_t> m_maxUs{0};
+    std::atomic<uint64_t> m_lastUs{0};
+};
+
+} // namespace FluxMic
@@ -0,0 +1,34 @@
+#include "VideoDecoder.h"
+
+#include <cctype>
+
+namespace FluxMic {
+
+static bool EqualsIgnoringCase(const char* a, const char* b) {
+    for (; *a && *b; a++, b++) {
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b)) return false;
+    }
+    return *a == *b;
+}
+
+DecoderBackend ParseDecoderBackend(const char* name) {
+    if (!name) return DecoderBackend::Auto;
+    if (EqualsIgnoringCase(name, "mf") || EqualsIgnoringCase(name, "mediafoundation")) {
+        return DecoderBackend::MediaFoundation;
+    }
+    if (EqualsIgnoringCase(name, "software") || EqualsIgnoringCase(name, "sw")) {
+        return DecoderBackend::Software;
+    }
+    return DecoderBackend::Auto;
+}
+
+const char* DecoderBackendName(DecoderBackend backend) {
+    switch (backend) {
+    case DecoderBackend::MediaFoundation: return "mf";
+    case DecoderBackend::Software: return "software";
+    case DecoderBackend::Auto:
+    default: return "auto";
+    }
+}
+
+} // namespace FluxMic
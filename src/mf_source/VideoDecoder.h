@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+#include "DecodedFrame.h"
+#include "H264ParameterSets.h"
+
+namespace FluxMic {
+
+/// Decodes the H.264 access units from the sender into NV12 frames.
+///
+/// H264Decoder implements it with the Media Foundation decoder MFT,
+/// SoftH264Decoder with portable code; the stream picks one at run time.
+class IVideoDecoder {
+public:
+    virtual ~IVideoDecoder() = default;
+
+    /// Get ready to decode. Returns false if this decoder isn't available.
+    virtual bool Initialize() = 0;
+
+    /// Release everything; Initialize() may be called again.
+    virtual void Shutdown() = 0;
+
+    virtual bool IsInitialized() const = 0;
+
+    /// The stream's SPS, found before its first access unit is decoded
+    /// (see FindSps()), so buffers can be sized for it up front rather than
+    /// on the first frames. Decoding works without it.
+    virtual void Prepare(const H264Sps& sps) = 0;
+
+    /// Decode one access unit (Annex B, with start codes).
+    /// Returns true if a decoded frame is available from GetDecodedFrame().
+    virtual bool DecodeNal(const uint8_t* nalData, uint32_t nalSize) = 0;
+
+    /// The last decoded frame, shared rather than copied.
+    virtual FrameRef GetDecodedFrame() const = 0;
+    virtual uint32_t GetDecodedWidth() const = 0;
+    virtual uint32_t GetDecodedHeight() const = 0;
+
+    /// Buffers allocated so far for input and output. They stop increasing
+    /// once decoding reaches the steady state. May be read from any thread.
+    virtual uint64_t GetInputAllocations() const = 0;
+    virtual uint64_t GetOutputAllocations() const = 0;
+
+    /// Access units which failed to decode, wholly or in part, so that the
+    /// picture stays wrong until the next keyframe. May be read from any thread.
+    virtual uint64_t DecodeErrors() const = 0;
+
+    /// For the log
+    virtual const char* Name() const = 0;
+};
+
+/// Which IVideoDecoder the stream uses
+enum class DecoderBackend {
+    Auto,               // Media Foundation, or software if the MFT isn't available
+    MediaFoundation,
+    Software,
+};
+
+/// "auto", "mf" or "software" (also "mediafoundation" and "sw"), in any
+/// case. Anything else, including nullptr, is Auto.
+DecoderBackend ParseDecoderBackend(const char* name);
+
+const char* DecoderBackendName(DecoderBackend backend);
+
+} // namespace FluxMic
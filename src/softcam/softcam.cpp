@@ -11,13 +11,40 @@
 DEFINE_GUID(CLSID_FluxMicCamera,
 0x9bffea25, 0xc00a, 0x46b8, 0x93, 0x33, 0x3c, 0x3f, 0x09, 0x73, 0x32, 0x29);
 
+// {2A54B67A-90C3-4701-B36C-A5C23A66C0C8}
+DEFINE_GUID(CLSID_FluxMicCamera2,
+0x2a54b67a, 0x90c3, 0x4701, 0xb3, 0x6c, 0xa5, 0xc2, 0x3a, 0x66, 0xc0, 0xc8);
+
+// {5969FB89-05EA-4CBC-875D-F8AD30EC68B5}
+DEFINE_GUID(CLSID_FluxMicCamera3,
+0x5969fb89, 0x05ea, 0x4cbc, 0x87, 0x5d, 0xf8, 0xad, 0x30, 0xec, 0x68, 0xb5);
+
+// {B8263042-A890-4187-8674-93768D16C0DA}
+DEFINE_GUID(CLSID_FluxMicCamera4,
+0xb8263042, 0xa890, 0x4187, 0x86, 0x74, 0x93, 0x76, 0x8d, 0x16, 0xc0, 0xda);
+
 
 namespace {
 
 // Setup data
 
-const wchar_t FILTER_NAME[] = L"FluxMic Camera";
-const GUID &FILTER_CLASSID = CLSID_FluxMicCamera;
+// One filter for each camera instance
+const wchar_t* const FILTER_NAMES[] =
+{
+    L"FluxMic Camera",
+    L"FluxMic Camera 2",
+    L"FluxMic Camera 3",
+    L"FluxMic Camera 4",
+};
+const GUID* const FILTER_CLASSIDS[] =
+{
+    &CLSID_FluxMicCamera,
+    &CLSID_FluxMicCamera2,
+    &CLSID_FluxMicCamera3,
+    &CLSID_FluxMicCamera4,
+};
+const int FILTER_COUNT = sizeof(FILTER_CLASSIDS) / sizeof(FILTER_CLASSIDS[0]);
+static_assert(FILTER_COUNT == softcam::CameraRegistry::MAX_INSTANCES, "a filter is needed for each instance");
 
 const AMOVIESETUP_MEDIATYPE s_pin_types[] =
 {
@@ -50,9 +77,10 @@ const REGFILTER2 s_reg_filter2 =
     s_pins
 };
 
+template <int Instance>
 CUnknown * WINAPI CreateSoftcamInstance(LPUNKNOWN lpunk, HRESULT *phr)
 {
-    return softcam::Softcam::CreateInstance(lpunk, FILTER_CLASSID, phr);
+    return softcam::Softcam::CreateInstance(lpunk, *FILTER_CLASSIDS[Instance], phr, Instance);
 }
 
 } // namespace
@@ -61,13 +89,10 @@ CUnknown * WINAPI CreateSoftcamInstance(LPUNKNOWN lpunk, HRESULT *phr)
 
 CFactoryTemplate g_Templates[] =
 {
-    {
-        FILTER_NAME,
-        &FILTER_CLASSID,
-        &CreateSoftcamInstance,
-        NULL,
-        nullptr
-    }
+    { FILTER_NAMES[0], FILTER_CLASSIDS[0], &CreateSoftcamInstance<0>, NULL, nullptr },
+    { FILTER_NAMES[1], FILTER_CLASSIDS[1], &CreateSoftcamInstance<1>, NULL, nullptr },
+    { FILTER_NAMES[2], FILTER_CLASSIDS[2], &CreateSoftcamInstance<2>, NULL, nullptr },
+    { FILTER_NAMES[3], FILTER_CLASSIDS[3], &CreateSoftcamInstance<3>, NULL, nullptr },
 };
 int g_cTemplates = sizeof(g_Templates) / sizeof(g_Templates[0]);
 
@@ -94,17 +119,20 @@ STDAPI DllRegisterServer()
         {
             break;
         }
-        pFM2->UnregisterFilter(
-                &CLSID_VideoInputDeviceCategory,
-                0,
-                FILTER_CLASSID);
-        hr = pFM2->RegisterFilter(
-                FILTER_CLASSID,
-                FILTER_NAME,
-                0,
-                &CLSID_VideoInputDeviceCategory,
-                FILTER_NAME,
-                &s_reg_filter2);
+        for (int i = 0; i < FILTER_COUNT && SUCCEEDED(hr); i++)
+        {
+            pFM2->UnregisterFilter(
+                    &CLSID_VideoInputDeviceCategory,
+                    0,
+                    *FILTER_CLASSIDS[i]);
+            hr = pFM2->RegisterFilter(
+                    *FILTER_CLASSIDS[i],
+                    FILTER_NAMES[i],
+                    0,
+                    &CLSID_VideoInputDeviceCategory,
+                    FILTER_NAMES[i],
+                    &s_reg_filter2);
+        }
         pFM2->Release();
     } while (0);
     CoFreeUnusedLibraries();
@@ -134,10 +162,17 @@ STDAPI DllUnregisterServer()
         {
             break;
         }
-        hr = pFM2->UnregisterFilter(
-                &CLSID_VideoInputDeviceCategory,
-                FILTER_NAME,
-                FILTER_CLASSID);
+        for (int i = 0; i < FILTER_COUNT; i++)
+        {
+            HRESULT result = pFM2->UnregisterFilter(
+                    &CLSID_VideoInputDeviceCategory,
+                    FILTER_NAMES[i],
+                    *FILTER_CLASSIDS[i]);
+            if (SUCCEEDED(hr))
+            {
+                hr = result;
+            }
+        }
         pFM2->Release();
     } while (0);
     CoFreeUnusedLibraries();
@@ -162,6 +197,33 @@ extern "C" scCamera scCreateCamera(int width, int height, float framerate)
     return softcam::sender::CreateCamera(width, height, framerate);
 }
 
+extern "C" scCamera scCreateCameraEx(int width, int height, float framerate, int format)
+{
+    return scCreateCameraInstance(0, nullptr, width, height, framerate, format);
+}
+
+extern "C" scCamera scCreateCameraInstance(
+                        int instance, const char* name,
+                        int width, int height, float framerate, int format)
+{
+    auto flags = (std::uint32_t)format & ~(std::uint32_t)scPixelFormat_FormatMask;
+    auto pixel_format = (std::uint32_t)format & (std::uint32_t)scPixelFormat_FormatMask;
+    auto known_flags = (std::uint32_t)scPixelFormat_FlagDIBLayout |
+                    (std::uint32_t)scPixelFormat_FlagLargePages;
+    if (!softcam::isValidPixelFormat(pixel_format) ||
+        (flags & ~known_flags) != 0)
+    {
+        return nullptr;
+    }
+    return softcam::sender::CreateCamera(
+                    width, height, framerate,
+                    (softcam::PixelFormat)pixel_format,
+                    (flags & scPixelFormat_FlagDIBLayout) != 0,
+                    instance,
+                    name,
+                    (flags & scPixelFormat_FlagLargePages) != 0);
+}
+
 extern "C" void     scDeleteCamera(scCamera camera)
 {
     return softcam::sender::DeleteCamera(camera);
@@ -172,6 +234,33 @@ extern "C" void     scSendFrame(scCamera camera, const void* image_bits)
     return softcam::sender::SendFrame(camera, image_bits);
 }
 
+extern "C" void     scSendFrameWithTimestamp(
+                        scCamera camera, const void* image_bits,
+                        long long timestamp, long long duration)
+{
+    return softcam::sender::SendFrameWithTimestamp(
+                    camera, image_bits,
+                    0 < timestamp ? (uint64_t)timestamp : 0,
+                    0 < duration ? (uint64_t)duration : 0);
+}
+
+extern "C" bool     scSendFrameRegion(
+                        scCamera camera, const void* image_bits,
+                        int x, int y, int width, int height, int stride)
+{
+    return softcam::sender::SendFrameRegion(camera, image_bits, x, y, width, height, stride);
+}
+
+extern "C" bool     scLockFrame(scCamera camera, void** image_bits, int* stride)
+{
+    return softcam::sender::LockFrame(camera, image_bits, stride);
+}
+
+extern "C" void     scUnlockFrame(scCamera camera)
+{
+    return softcam::sender::UnlockFrame(camera);
+}
+
 extern "C" bool     scWaitForConnection(scCamera camera, float timeout)
 {
     return softcam::sender::WaitForConnection(camera, timeout);
@@ -181,3 +270,28 @@ extern "C" bool     scIsConnected(scCamera camera)
 {
     return softcam::sender::IsConnected(camera);
 }
+
+extern "C" bool     scUsesLargePages(scCamera camera)
+{
+    return softcam::sender::UsesLargePages(camera);
+}
+
+extern "C" bool     scSetSendMode(scCamera camera, int mode)
+{
+    switch (mode)
+    {
+    case scSendMode_Blocking:
+        return softcam::sender::SetSendMode(camera, softcam::sender::SendMode::BLOCKING);
+    case scSendMode_AsyncDropOldest:
+        return softcam::sender::SetSendMode(camera, softcam::sender::SendMode::ASYNC_DROP_OLDEST);
+    case scSendMode_AsyncDropNewest:
+        return softcam::sender::SetSendMode(camera, softcam::sender::SendMode::ASYNC_DROP_NEWEST);
+    default:
+        return false;
+    }
+}
+
+extern "C" long long scGetDroppedFrames(scCamera camera)
+{
+    return (long long)softcam::sender::DroppedFrames(camera);
+}
@@ -32,7 +32,8 @@ extern "C"
         If this function succeeds, it returns the handle of a new virtual
         camera instance, otherwise, it returns a null pointer.
 
-        This function fails if another instance already exists in the system.
+        This function creates instance 0 (see `scCreateCameraInstance`), and
+        fails if instance 0 already exists in the system.
 
         The new instance created by this function should be deleted with
         the `scDeleteCamera` function when it no longer is used.
@@ -42,6 +43,92 @@ extern "C"
     */
     scCamera    SOFTCAM_API scCreateCamera(int width, int height, float framerate = 60.0f);
 
+    /*
+        Pixel formats for the `scCreateCameraEx` function.
+
+        Images are always top-down, and planes follow one another without
+        any padding; the row stride of each plane is the width of the plane.
+
+        - `scPixelFormat_BGR24`: 3 bytes per pixel in B, G, R order.
+        - `scPixelFormat_BGRA32`: 4 bytes per pixel in B, G, R, A order.
+          The alpha channel is ignored.
+        - `scPixelFormat_NV12`: A Y plane (width x height) followed by an
+          interleaved U/V plane (width x height/2).
+        - `scPixelFormat_I420`: A Y plane (width x height) followed by a U
+          plane (width/2 x height/2) and a V plane (width/2 x height/2).
+        - `scPixelFormat_YUY2`: 2 bytes per pixel in Y0, U, Y1, V order.
+
+        YUV formats are interpreted as BT.601 limited range when they have to
+        be converted to RGB for an application.
+
+        `scPixelFormat_FlagDIBLayout` can be combined with a format by the
+        bitwise OR operator. With this flag, RGB images are kept in shared
+        memory bottom-up as DirectShow applications expect, so that the image
+        is flipped only once by the sender instead of once by every
+        application. Images passed to `scSendFrame` are still top-down, but
+        `scLockFrame` gives the top row of the bottom-up image with a negative
+        stride. The flag has no effect on YUV formats.
+
+        `scPixelFormat_FlagLargePages` can also be combined with a format.
+        With this flag, the shared memory for the images is backed by large
+        pages if possible, which reduces TLB misses while the images are
+        copied at high resolutions. It requires the "Lock pages in memory"
+        privilege (SeLockMemoryPrivilege) granted to the user account, and
+        falls back to normal pages silently otherwise; see the
+        `scUsesLargePages` function.
+    */
+    enum scPixelFormat
+    {
+        scPixelFormat_BGR24 = 0,
+        scPixelFormat_BGRA32 = 1,
+        scPixelFormat_NV12 = 2,
+        scPixelFormat_I420 = 3,
+        scPixelFormat_YUY2 = 4,
+
+        scPixelFormat_FormatMask = 0xffff,
+        scPixelFormat_FlagDIBLayout = 0x10000,
+        scPixelFormat_FlagLargePages = 0x20000,
+    };
+
+    /*
+        This function creates a virtual camera instance which receives images
+        in the pixel format specified by the `format` argument.
+
+        Other arguments and the behavior are the same as the `scCreateCamera`
+        function; `scCreateCamera(w, h, fps)` is equivalent to
+        `scCreateCameraEx(w, h, fps, scPixelFormat_BGR24)`.
+
+        Applications which can consume the pixel format directly receive the
+        images without any conversion. Other applications receive the images
+        converted to RGB24.
+    */
+    scCamera    SOFTCAM_API scCreateCameraEx(int width, int height, float framerate, int format);
+
+    /*
+        This function creates a virtual camera instance with the instance
+        number specified by the `instance` argument, which ranges from 0 to 3.
+
+        Each instance number corresponds to a separate virtual camera device;
+        applications find instance 0 as "FluxMic Camera", instance 1 as
+        "FluxMic Camera 2", and so on. Instances with different numbers can
+        exist at the same time, in one process or in different processes.
+
+        The `name` argument is an optional label of the instance (up to 63
+        characters; may be null), which is published with the dimension and
+        the format of the instance so that other programs can list the
+        active instances.
+
+        Other arguments and the behavior are the same as the
+        `scCreateCameraEx` function; `scCreateCameraEx(w, h, fps, format)` is
+        equivalent to `scCreateCameraInstance(0, nullptr, w, h, fps, format)`.
+
+        This function fails if the instance with the same number already
+        exists in the system.
+    */
+    scCamera    SOFTCAM_API scCreateCameraInstance(
+                                int instance, const char* name,
+                                int width, int height, float framerate, int format);
+
     /*
         This function deletes the specified virtual camera instance.
     */
@@ -50,6 +137,9 @@ extern "C"
     /*
         This function sends a new frame of the specified virtual camera.
 
+        The image pointed by the `image_bits` argument must be in the pixel
+        format of the virtual camera (BGR24 if created by `scCreateCamera`).
+
         If the framerate set to the virtual camera is not zero, this
         function tries to make the timing to deliver the new image ideal
         as much as possible by sleeping for an appropriate time inside the
@@ -62,6 +152,101 @@ extern "C"
     */
     void        SOFTCAM_API scSendFrame(scCamera camera, const void* image_bits);
 
+    /*
+        This function sends a new frame of the specified virtual camera
+        together with the time at which the image was captured.
+
+        The `timestamp` argument is the time of capture in 100-nanosecond
+        units on the clock of `QueryPerformanceCounter`, which is the same
+        clock as `MFGetSystemTime` and the sample times of Media Foundation
+        capture sources. If it is 0 or less, the current time is used.
+
+        The `duration` argument is the duration of the frame in
+        100-nanosecond units. If it is 0 or less, the duration is taken from
+        the framerate of the virtual camera.
+
+        Applications receive the frame with the sample time mapped from the
+        timestamp onto their own stream time, so that they can keep video in
+        sync with audio and drop frames which arrive too late.
+
+        Unlike the `scSendFrame` function, this function sends the new image
+        immediately regardless of the framerate, since the timestamp tells
+        the timing of the frame.
+    */
+    void        SOFTCAM_API scSendFrameWithTimestamp(
+                                scCamera camera, const void* image_bits,
+                                long long timestamp, long long duration);
+
+    /*
+        This function sends a new frame of the specified virtual camera in
+        which only a rectangular region has changed from the previous frame.
+
+        The `image_bits` argument points to the top-left pixel of the region,
+        whose size is `width` x `height` pixels and whose rows are `stride`
+        bytes apart. The `x` and `y` arguments specify the position of the
+        region in the frame. The rest of the frame is kept from the previous
+        frame.
+
+        Only the region and the rows changed by recent frames are copied,
+        so this is cheaper than `scSendFrame` when a small part of the image
+        changes, such as a mostly static screen.
+
+        This function supports BGR24, BGRA32 and YUY2 formats. For YUY2,
+        `x` and `width` must be even.
+
+        Timing control is the same as the `scSendFrame` function.
+
+        This function returns `true` if the frame is sent. It returns
+        `false` if the arguments are invalid or the format is not supported.
+    */
+    bool        SOFTCAM_API scSendFrameRegion(
+                                scCamera camera, const void* image_bits,
+                                int x, int y, int width, int height, int stride);
+
+    /*
+        This function gives the caller direct access to the shared memory
+        area which the next frame of the specified virtual camera is
+        delivered from, so that the application can render or convert the
+        image in place without the extra copy made by `scSendFrame`.
+
+        If this function succeeds, it stores the address of the image area
+        to `*image_bits` and the distance in bytes between the beginnings of
+        two consecutive rows to `*stride` (if `stride` is not null), and
+        returns `true`. The image area has the same layout as the image
+        passed to `scSendFrame`; for planar formats, `*stride` is the stride
+        of the first plane. If the camera was created with
+        `scPixelFormat_FlagDIBLayout` and an RGB format, `*stride` is negative
+        and `*image_bits` points to the top row which is the last one in
+        memory.
+        Otherwise, it returns `false`.
+
+        The image area is not visible to applications until the
+        `scUnlockFrame` function is called. The caller must not touch the
+        image area after calling `scUnlockFrame`; call this function again
+        to obtain the area for the next frame. Calling this function again
+        without calling `scUnlockFrame` returns the same image area.
+
+        The contents of the image area are undefined when it is obtained;
+        the caller is expected to fill the whole image every frame.
+
+        `scLockFrame`, `scUnlockFrame` and `scSendFrame` must not be called
+        concurrently from multiple threads for the same virtual camera.
+    */
+    bool        SOFTCAM_API scLockFrame(scCamera camera, void** image_bits, int* stride);
+
+    /*
+        This function delivers the image written into the area obtained by
+        the `scLockFrame` function as a new frame of the specified virtual
+        camera.
+
+        Timing control is the same as the `scSendFrame` function; if the
+        framerate set to the virtual camera is not zero, this function may
+        sleep before delivering the new frame.
+
+        This function does nothing if the area is not locked.
+    */
+    void        SOFTCAM_API scUnlockFrame(scCamera camera);
+
     /*
         This function waits until an application connects to the specified
         virtual camera.
@@ -82,4 +267,62 @@ extern "C"
         the virtual camera. Otherwise, it returns `false`.
     */
     bool        SOFTCAM_API scIsConnected(scCamera camera);
+
+    /*
+        This function returns `true` if the shared memory of the virtual
+        camera is backed by large pages, which can be requested by
+        `scPixelFormat_FlagLargePages`. Otherwise, it returns `false`.
+    */
+    bool        SOFTCAM_API scUsesLargePages(scCamera camera);
+
+    /*
+        Send modes for the `scSetSendMode` function.
+
+        - `scSendMode_Blocking`: `scSendFrame` and `scUnlockFrame` sleep on
+          the caller's thread until the time of the new frame (default).
+        - `scSendMode_AsyncDropOldest`: they copy the image and return
+          immediately, and a background thread delivers the frames at the
+          framerate. If a frame is still waiting when a new one comes, the
+          waiting one is dropped and the new one takes its place.
+        - `scSendMode_AsyncDropNewest`: same as above, except that the new
+          frame is dropped and the waiting one is kept.
+    */
+    enum scSendMode
+    {
+        scSendMode_Blocking = 0,
+        scSendMode_AsyncDropOldest = 1,
+        scSendMode_AsyncDropNewest = 2,
+    };
+
+    /*
+        This function changes how the frames of the specified virtual camera
+        are delivered; the `mode` argument is one of `scSendMode`.
+
+        In the asynchronous modes, the caller's thread never sleeps in
+        `scSendFrame`, `scSendFrameWithTimestamp` and `scUnlockFrame`; the
+        image is copied to a staging area and delivered later by a
+        background thread with the same timing control as the blocking mode
+        (frames with timestamps are delivered as soon as possible). At most
+        one frame waits for delivery, and the others are dropped according
+        to the mode; `scGetDroppedFrames` counts them.
+
+        In the asynchronous modes, `scLockFrame` gives a staging area in the
+        same layout as the image passed to `scSendFrame`, whose stride is
+        always positive, and `scSendFrameRegion` is not supported.
+
+        Frames waiting for delivery are delivered before the mode changes.
+        This function must not be called while the frame is locked by
+        `scLockFrame`.
+
+        This function returns `true` if the mode is changed. It returns
+        `false` if the arguments are invalid.
+    */
+    bool        SOFTCAM_API scSetSendMode(scCamera camera, int mode);
+
+    /*
+        This function returns the number of frames of the specified virtual
+        camera which have been dropped in the asynchronous modes (see
+        `scSetSendMode`).
+    */
+    long long   SOFTCAM_API scGetDroppedFrames(scCamera camera);
 }
@@ -0,0 +1,108 @@
+#include "CameraRegistry.h"
+
+#include <type_traits>
+#include <cstring>
+
+
+namespace softcam {
+
+static_assert(std::is_standard_layout<CameraRegistry>::value, "CameraRegistry must be standard layout");
+
+
+constexpr int CameraRegistry::MAX_INSTANCES;
+constexpr int CameraRegistry::MAX_NAME_LENGTH;
+
+bool CameraRegistry::checkInstance(int instance)
+{
+    return 0 <= instance && instance < MAX_INSTANCES;
+}
+
+// The caller must be the only owner of the instance, which is guaranteed
+// by having created the frame buffer of the instance. So the entry is taken
+// even if the previous owner looks alive, which happens if it has crashed
+// just before.
+void CameraRegistry::claim(int instance, std::uint64_t now)
+{
+    if (!checkInstance(instance)) return;
+    auto& entry = m_entry[instance];
+
+    // Keep the sequence odd until the description is published.
+    auto seq = entry.m_sequence.load(std::memory_order_relaxed);
+    entry.m_sequence.store(seq | 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    entry.m_heartbeat.store(now == 0 ? 1 : now, std::memory_order_release);
+}
+
+void CameraRegistry::publish(const Info& info)
+{
+    if (!checkInstance(info.instance)) return;
+    auto& entry = m_entry[info.instance];
+
+    auto seq = entry.m_sequence.load(std::memory_order_relaxed);
+    if (seq % 2 == 0)
+    {
+        entry.m_sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        seq += 1;
+    }
+    entry.m_width = (std::uint16_t)info.width;
+    entry.m_height = (std::uint16_t)info.height;
+    entry.m_framerate = info.framerate;
+    entry.m_format = (std::uint32_t)info.format;
+    std::memcpy(entry.m_name, info.name, sizeof(entry.m_name));
+    entry.m_name[MAX_NAME_LENGTH] = '\0';
+    entry.m_sequence.store(seq + 1, std::memory_order_release);
+}
+
+void CameraRegistry::touch(int instance, std::uint64_t now)
+{
+    if (!checkInstance(instance)) return;
+    m_entry[instance].m_heartbeat.store(now == 0 ? 1 : now, std::memory_order_release);
+}
+
+void CameraRegistry::release(int instance)
+{
+    if (!checkInstance(instance)) return;
+    m_entry[instance].m_heartbeat.store(0, std::memory_order_release);
+}
+
+bool CameraRegistry::read(
+                    int             instance,
+                    std::uint64_t   now,
+                    std::uint64_t   timeout,
+                    Info*           out_info) const
+{
+    if (!checkInstance(instance)) return false;
+    auto& entry = m_entry[instance];
+
+    auto heartbeat = entry.m_heartbeat.load(std::memory_order_acquire);
+    if (heartbeat == 0 || (heartbeat < now && now - heartbeat > timeout))
+    {
+        return false;
+    }
+    auto seq = entry.m_sequence.load(std::memory_order_acquire);
+    if (seq % 2 != 0)
+    {
+        return false;
+    }
+    Info info;
+    info.instance = instance;
+    info.width = entry.m_width;
+    info.height = entry.m_height;
+    info.framerate = entry.m_framerate;
+    info.format = (PixelFormat)entry.m_format;
+    std::memcpy(info.name, entry.m_name, sizeof(info.name));
+    info.name[MAX_NAME_LENGTH] = '\0';
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (entry.m_sequence.load(std::memory_order_relaxed) != seq ||
+        entry.m_heartbeat.load(std::memory_order_relaxed) == 0)
+    {
+        return false;
+    }
+    *out_info = info;
+    return true;
+}
+
+
+} //namespace softcam
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "PixelFormat.h"
+
+
+namespace softcam {
+
+
+/// Lock-free table of the camera instances shared between processes
+///
+/// This is placed in a shared memory segment which every sender maps while
+/// its camera exists, and which receivers map to enumerate the instances.
+/// The system gives the segment filled with zeros, and an all-zero table is
+/// a valid empty table, so nobody has to initialize it.
+///
+/// Entry N describes camera instance N. The sender which has created the
+/// frame buffer of the instance owns the entry, and keeps it alive by
+/// updating the heartbeat timestamp; an entry whose owner has stopped
+/// beating is regarded as empty. The description is guarded by a sequence
+/// counter (seqlock), so readers never take any lock.
+struct CameraRegistry
+{
+    static constexpr int MAX_INSTANCES = 4;
+    static constexpr int MAX_NAME_LENGTH = 63;
+
+    struct Info
+    {
+        int             instance;
+        int             width;
+        int             height;
+        float           framerate;
+        PixelFormat     format;
+        char            name[MAX_NAME_LENGTH + 1];
+    };
+
+    struct Entry
+    {
+        // 0 if the entry is empty
+        std::atomic<std::uint64_t>  m_heartbeat;
+        // odd while the owner is updating the entry
+        std::atomic<std::uint32_t>  m_sequence;
+        std::uint16_t               m_width;
+        std::uint16_t               m_height;
+        float                       m_framerate;
+        std::uint32_t               m_format;
+        char                        m_name[MAX_NAME_LENGTH + 1];
+    };
+
+    static bool     checkInstance(int instance);
+
+    // Owner side
+    void            claim(int instance, std::uint64_t now);
+    void            publish(const Info& info);
+    void            touch(int instance, std::uint64_t now);
+    void            release(int instance);
+
+    // Reader side
+    bool            read(
+                        int             instance,
+                        std::uint64_t   now,
+                        std::uint64_t   timeout,
+                        Info*           out_info) const;
+
+    Entry           m_entry[MAX_INSTANCES];
+};
+
+
+} //namespace softcam
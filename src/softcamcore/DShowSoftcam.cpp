@@ -101,7 +101,86 @@ std::size_t calcDIBSize(int width, int height)
     return stride * static_cast<unsigned>(height);
 }
 
-void fillMediaType(AM_MEDIA_TYPE* amt, int width, int height, float framerate)
+// The size of a media sample in the given format
+std::size_t calcSampleSize(softcam::PixelFormat format, int width, int height)
+{
+    if (format == softcam::PixelFormat::BGR24)
+    {
+        return calcDIBSize(width, height);
+    }
+    softcam::ImageLayout layout;
+    if (!softcam::calcImageLayout(format, width, height, &layout))
+    {
+        return 0;
+    }
+    return layout.size;
+}
+
+struct FormatInfo
+{
+    GUID    subtype;
+    DWORD   compression;
+    WORD    bit_count;
+};
+
+FormatInfo getFormatInfo(softcam::PixelFormat format)
+{
+    using softcam::PixelFormat;
+    switch (format)
+    {
+    case PixelFormat::BGRA32:
+        return { MEDIASUBTYPE_RGB32, BI_RGB, 32 };
+    case PixelFormat::NV12:
+        return { FOURCCMap(MAKEFOURCC('N','V','1','2')), MAKEFOURCC('N','V','1','2'), 12 };
+    case PixelFormat::I420:
+        return { FOURCCMap(MAKEFOURCC('I','4','2','0')), MAKEFOURCC('I','4','2','0'), 12 };
+    case PixelFormat::YUY2:
+        return { FOURCCMap(MAKEFOURCC('Y','U','Y','2')), MAKEFOURCC('Y','U','Y','2'), 16 };
+    default:
+        return { MEDIASUBTYPE_RGB24, BI_RGB, 24 };
+    }
+}
+
+// Darkens an image in place to indicate that the source is inactive.
+void darkenImage(softcam::PixelFormat format, BYTE* data, std::size_t size, int width, int height)
+{
+    using softcam::PixelFormat;
+    switch (format)
+    {
+    case PixelFormat::NV12:
+    case PixelFormat::I420:
+    {
+        // Luma moves toward black, and chroma toward neutral.
+        std::size_t luma_size = (std::min)(size, (std::size_t)width * height);
+        for (std::size_t i = 0; i < size; i++)
+        {
+            int base = i < luma_size ? 16 : 128;
+            data[i] = (BYTE)(base + (data[i] - base) / 4);
+        }
+        break;
+    }
+    case PixelFormat::YUY2:
+        for (std::size_t i = 0; i < size; i++)
+        {
+            int base = i % 2 == 0 ? 16 : 128;
+            data[i] = (BYTE)(base + (data[i] - base) / 4);
+        }
+        break;
+    default:
+        for (std::size_t i = 0; i < size; i++)
+        {
+            data[i] /= 4;
+        }
+        break;
+    }
+}
+
+void fillMediaType(
+        AM_MEDIA_TYPE*          amt,
+        int                     width,
+        int                     height,
+        float                   framerate,
+        softcam::PixelFormat    format = softcam::PixelFormat::BGR24)
 {
     BYTE *pbFormat = amt->pbFormat;
 
@@ -109,7 +188,9 @@ void fillMediaType(AM_MEDIA_TYPE* amt, int width, int height, float framerate)
     {
         framerate = 60.0f;
     }
-    const float bit_rate = (float)width * (float)height * 24 * framerate;
+    const auto info = getFormatInfo(format);
+    const auto sample_size = static_cast<uint32_t>(calcSampleSize(format, width, height));
+    const float bit_rate = (float)width * (float)height * info.bit_count * framerate;
     const float period = 10 * 1000 * 1000 / framerate;
 
     VIDEOINFOHEADER* pFormat = (VIDEOINFOHEADER*)pbFormat;
@@ -121,29 +202,33 @@ void fillMediaType(AM_MEDIA_TYPE* amt, int width, int height, float framerate)
     pFormat->bmiHeader.biWidth = width;
     pFormat->bmiHeader.biHeight = height;
     pFormat->bmiHeader.biPlanes = 1;
-    pFormat->bmiHeader.biBitCount = 24;
-    pFormat->bmiHeader.biCompression = BI_RGB;
-    pFormat->bmiHeader.biSizeImage = static_cast<uint32_t>(calcDIBSize(width, height));
+    pFormat->bmiHeader.biBitCount = info.bit_count;
+    pFormat->bmiHeader.biCompression = info.compression;
+    pFormat->bmiHeader.biSizeImage = sample_size;
 
     amt->majortype = MEDIATYPE_Video;
-    amt->subtype = MEDIASUBTYPE_RGB24;
+    amt->subtype = info.subtype;
     amt->bFixedSizeSamples = TRUE;
     amt->bTemporalCompression = FALSE;
-    amt->lSampleSize = static_cast<uint32_t>(calcDIBSize(width, height));
+    amt->lSampleSize = sample_size;
     amt->formattype = FORMAT_VideoInfo;
     amt->pUnk = nullptr;
     amt->cbFormat = sizeof(VIDEOINFOHEADER);
     amt->pbFormat = pbFormat;
 }
 
-AM_MEDIA_TYPE* makeMediaType(int width, int height, float framerate)
+AM_MEDIA_TYPE* makeMediaType(
+        int                     width,
+        int                     height,
+        float                   framerate,
+        softcam::PixelFormat    format = softcam::PixelFormat::BGR24)
 {
     AM_MEDIA_TYPE *amt = allocateMediaType();
     if (!amt)
     {
         return nullptr;
     }
-    fillMediaType(amt, width, height, framerate);
+    fillMediaType(amt, width, height, framerate, format);
     return amt;
 }
 
@@ -155,21 +240,24 @@ namespace softcam {
 CUnknown * Softcam::CreateInstance(
                     LPUNKNOWN   lpunk,
                     const GUID& clsid,
-                    HRESULT*    phr)
+                    HRESULT*    phr,
+                    int         instance)
 {
     OPEN_LOGFILE();
     LOG("===== logging started =====\n");
 
-    return new Softcam(lpunk, clsid, phr);
+    return new Softcam(lpunk, clsid, phr, instance);
 }
 
-Softcam::Softcam(LPUNKNOWN lpunk, const GUID& clsid, HRESULT *phr) :
+Softcam::Softcam(LPUNKNOWN lpunk, const GUID& clsid, HRESULT *phr, int instance) :
     CSource(NAME("FluxMic Camera"), lpunk, clsid),
-    m_frame_buffer(FrameBuffer::open()),
+    m_instance(instance),
+    m_frame_buffer(FrameBuffer::open(instance)),
     m_valid(m_frame_buffer ? true : false),
     m_width(m_frame_buffer.width()),
     m_height(m_frame_buffer.height()),
-    m_framerate(m_frame_buffer.framerate())
+    m_framerate(m_frame_buffer.framerate()),
+    m_format(m_frame_buffer.format())
 {
     // This code is okay though it may look strange as the return value is ignored.
     // Calling the SoftcamStream constructor results in calling the CBaseOutputPin
@@ -178,6 +266,14 @@ Softcam::Softcam(LPUNKNOWN lpunk, const GUID& clsid, HRESULT *phr) :
     (void)new SoftcamStream(phr, this, L"FluxMic Camera Stream");
 }
 
+Softcam::~Softcam()
+{
+    if (m_clock)
+    {
+        m_clock->Release();
+    }
+}
+
 
 STDMETHODIMP Softcam::NonDelegatingQueryInterface(REFIID riid, __deref_out void **ppv)
 {
@@ -194,6 +290,52 @@ STDMETHODIMP Softcam::NonDelegatingQueryInterface(REFIID riid, __deref_out void
     }
 }
 
+// The graph doesn't change the clock while running, so we keep the clock
+// and the start time for the streaming thread here.
+STDMETHODIMP Softcam::Run(REFERENCE_TIME tStart)
+{
+    {
+        CAutoLock lock(&m_critsec);
+        if (m_pClock)
+        {
+            m_pClock->AddRef();
+        }
+        if (m_clock)
+        {
+            m_clock->Release();
+        }
+        m_clock = m_pClock;
+        m_stream_start = tStart;
+    }
+    return CSource::Run(tStart);
+}
+
+STDMETHODIMP Softcam::Stop()
+{
+    auto result = CSource::Stop();
+
+    CAutoLock lock(&m_critsec);
+    if (m_clock)
+    {
+        m_clock->Release();
+        m_clock = nullptr;
+    }
+    return result;
+}
+
+// We offer the native format of the frame buffer first so that
+// applications which can consume it get the images without any conversion,
+// and RGB24 next for other applications.
+int Softcam::mediaTypeCount() const
+{
+    return m_format == PixelFormat::BGR24 ? 1 : 2;
+}
+
+PixelFormat Softcam::mediaTypeFormat(int index) const
+{
+    return index == 0 ? m_format : PixelFormat::BGR24;
+}
+
 HRESULT
 Softcam::SetFormat(AM_MEDIA_TYPE *mt)
 {
@@ -207,8 +349,14 @@ Softcam::SetFormat(AM_MEDIA_TYPE *mt)
         LOG("-> E_FAIL\n");
         return E_FAIL;
     }
+    int index = 0;
+    while (index < mediaTypeCount() &&
+            mt->subtype != getFormatInfo(mediaTypeFormat(index)).subtype)
+    {
+        index++;
+    }
     if (mt->majortype != MEDIATYPE_Video ||
-        mt->subtype != MEDIASUBTYPE_RGB24)
+        index >= mediaTypeCount())
     {
         LOG("-> E_FAIL (invalid media type)\n");
         return E_FAIL;
@@ -216,14 +364,15 @@ Softcam::SetFormat(AM_MEDIA_TYPE *mt)
     if (mt->formattype == FORMAT_VideoInfo && mt->pbFormat)
     {
         VIDEOINFOHEADER* pFormat = (VIDEOINFOHEADER*)mt->pbFormat;
+        const auto info = getFormatInfo(mediaTypeFormat(index));
         if (pFormat->bmiHeader.biWidth != m_width ||
             pFormat->bmiHeader.biHeight != m_height)
         {
             LOG("-> E_FAIL (invalid dimension)\n");
             return E_FAIL;
         }
-        if (pFormat->bmiHeader.biBitCount != 24 ||
-            pFormat->bmiHeader.biCompression != BI_RGB)
+        if (pFormat->bmiHeader.biBitCount != info.bit_count ||
+            pFormat->bmiHeader.biCompression != info.compression)
         {
             LOG("-> E_FAIL (invalid color format)\n");
             return E_FAIL;
@@ -246,7 +395,7 @@ Softcam::GetFormat(AM_MEDIA_TYPE **out_pmt)
         LOG("-> E_FAIL\n");
         return E_FAIL;
     }
-    AM_MEDIA_TYPE* mt = makeMediaType(m_width, m_height, m_framerate);
+    AM_MEDIA_TYPE* mt = makeMediaType(m_width, m_height, m_framerate, mediaTypeFormat(0));
     if (!mt)
     {
         LOG("-> E_OUTOFMEMORY\n");
@@ -270,7 +419,7 @@ Softcam::GetNumberOfCapabilities(int *out_count, int *out_size)
         LOG("-> E_FAIL\n");
         return E_FAIL;
     }
-    *out_count = 1;
+    *out_count = mediaTypeCount();
     *out_size = sizeof(VIDEO_STREAM_CONFIG_CAPS);
     LOG("-> S_OK\n");
     return S_OK;
@@ -289,12 +438,12 @@ Softcam::GetStreamCaps(int index, AM_MEDIA_TYPE **out_pmt, BYTE *out_scc)
         LOG("-> E_FAIL\n");
         return E_FAIL;
     }
-    if (index >= 1)
+    if (index < 0 || index >= mediaTypeCount())
     {
         LOG("-> S_FALSE (invalid index)\n");
         return S_FALSE;
     }
-    AM_MEDIA_TYPE *mt = makeMediaType(m_width, m_height, m_framerate);
+    AM_MEDIA_TYPE *mt = makeMediaType(m_width, m_height, m_framerate, mediaTypeFormat(index));
     if (!mt)
     {
         LOG("-> E_OUTOFMEMORY\n");
@@ -339,11 +488,12 @@ FrameBuffer* Softcam::getFrameBuffer()
     CAutoLock lock(&m_critsec);
     if (!m_frame_buffer)
     {
-        auto fb = FrameBuffer::open();
+        auto fb = FrameBuffer::open(m_instance);
         if (fb &&
             fb.active() &&
             fb.width() == m_width &&
-            fb.height() == m_height)
+            fb.height() == m_height &&
+            fb.format() == m_format)
         {
             m_frame_buffer = fb;
         }
@@ -365,6 +515,25 @@ Softcam::releaseFrameBuffer()
     m_frame_buffer.release();
 }
 
+// Reads the reference clock and Timer::timestamp() back to back, which
+// StreamClock takes as the same moment. Fails unless the graph is running
+// with a clock.
+bool
+Softcam::readClocks(
+                REFERENCE_TIME* out_clock_now,
+                uint64_t*       out_timestamp_now,
+                REFERENCE_TIME* out_stream_start)
+{
+    CAutoLock lock(&m_critsec);
+    if (!m_clock || FAILED(m_clock->GetTime(out_clock_now)))
+    {
+        return false;
+    }
+    *out_timestamp_now = Timer::timestamp();
+    *out_stream_start = m_stream_start;
+    return true;
+}
+
 SoftcamStream::SoftcamStream(HRESULT *phr,
                          Softcam *pParent,
                          LPCWSTR pPinName) :
@@ -413,10 +582,25 @@ HRESULT SoftcamStream::FillBuffer(IMediaSample *pms)
     long lDataLen = pms->GetSize();
     ZeroMemory(pData, (std::size_t)lDataLen);
     {
+        // Converting is needed only if the application has chosen RGB24
+        // for the frame buffer in another format.
+        const auto format = m_mt.subtype == MEDIASUBTYPE_RGB24 ?
+                PixelFormat::BGR24 : getParent()->format();
+        const std::size_t size = (std::min)(
+                calcSampleSize(format, m_width, m_height), (std::size_t)lDataLen);
+        uint64_t timestamp = 0, duration = 0;
+
         if (auto fb = getParent()->getFrameBuffer())
         {
             bool active = fb->waitForNewFrame(m_frame_counter);
-            fb->transferToDIB(pData, &m_frame_counter);
+            if (format == PixelFormat::BGR24)
+            {
+                fb->transferToDIB(pData, &m_frame_counter, &timestamp, &duration);
+            }
+            else
+            {
+                fb->transferNative(pData, &m_frame_counter, &timestamp, &duration);
+            }
 
             if (!active)
             {
@@ -425,19 +609,14 @@ HRESULT SoftcamStream::FillBuffer(IMediaSample *pms)
                 getParent()->releaseFrameBuffer();
 
                 // Save the last image for a placeholder.
-                const std::size_t size = calcDIBSize(m_width, m_height);
-                if (!m_screenshot)
+                if (!m_screenshot || m_screenshot_size != size)
                 {
                     m_screenshot.reset(new uint8_t[size]);
+                    m_screenshot_size = size;
                 }
-                {
-                    // Darken the image to indicate that the source is inactive.
-                    for (std::size_t i = 0; i < size; i++)
-                    {
-                        pData[i] /= 4;
-                    }
-                }
+                darkenImage(format, pData, size, m_width, m_height);
                 std::memcpy(m_screenshot.get(), pData, size);
+                m_discontinuity = true;
             }
         }
         else
@@ -446,14 +625,38 @@ HRESULT SoftcamStream::FillBuffer(IMediaSample *pms)
             m_frame_counter = 0;
             Timer::sleep(0.100f);
 
-            const std::size_t size = calcDIBSize(m_width, m_height);
-            std::memcpy(pData, m_screenshot.get(), size);
+            if (m_screenshot && m_screenshot_size == size)
+            {
+                std::memcpy(pData, m_screenshot.get(), size);
+            }
         }
 
+        REFERENCE_TIME clock_now, stream_start;
+        uint64_t timestamp_now;
+        bool running = getParent()->readClocks(&clock_now, &timestamp_now, &stream_start);
+
         CAutoLock lock(&m_critsec);
-        CRefTime start = m_sample_time;
-        m_sample_time += (LONG)m_interval_time_msec;
-        pms->SetTime((REFERENCE_TIME*)&start,(REFERENCE_TIME*)&m_sample_time);
+        if (running)
+        {
+            // The frames without the time of capture (from the senders of
+            // version 2 or earlier, and the placeholder) are stamped with
+            // the time of delivery.
+            auto sample = m_stream_clock.map(
+                    0 < timestamp ? timestamp : timestamp_now,
+                    duration, clock_now, timestamp_now, stream_start);
+            REFERENCE_TIME start = sample.start, stop = sample.stop;
+            pms->SetTime(&start, &stop);
+            m_sample_time = stop;
+            m_discontinuity = m_discontinuity || sample.discontinuity;
+        }
+        else
+        {
+            CRefTime start = m_sample_time;
+            m_sample_time += (LONG)m_interval_time_msec;
+            pms->SetTime((REFERENCE_TIME*)&start,(REFERENCE_TIME*)&m_sample_time);
+        }
+        pms->SetDiscontinuity(m_discontinuity ? TRUE : FALSE);
+        m_discontinuity = false;
     }
     pms->SetSyncPoint(TRUE);
     //LOG("-> NOERROR\n");
@@ -491,12 +694,62 @@ HRESULT SoftcamStream::GetMediaType(CMediaType *pmt)
         return E_OUTOFMEMORY;
     }
 
-    fillMediaType(pmt, getParent()->width(), getParent()->height(), getParent()->framerate());
+    fillMediaType(pmt, getParent()->width(), getParent()->height(), getParent()->framerate(),
+                    getParent()->mediaTypeFormat(0));
 
     LOG("-> NOERROR\n");
     return NOERROR;
 }
 
+HRESULT SoftcamStream::GetMediaType(int iPosition, CMediaType *pmt)
+{
+    CheckPointer(pmt,E_POINTER);
+
+    if (!m_valid)
+    {
+        LOG("-> E_FAIL\n");
+        return E_FAIL;
+    }
+    if (iPosition < 0)
+    {
+        LOG("-> E_INVALIDARG\n");
+        return E_INVALIDARG;
+    }
+    if (iPosition >= getParent()->mediaTypeCount())
+    {
+        LOG("-> VFW_S_NO_MORE_ITEMS\n");
+        return VFW_S_NO_MORE_ITEMS;
+    }
+
+    VIDEOINFOHEADER *pvi = (VIDEOINFOHEADER*)pmt->AllocFormatBuffer(sizeof(VIDEOINFOHEADER));
+    if (pvi == nullptr)
+    {
+        LOG("-> E_OUTOFMEMORY\n");
+        return E_OUTOFMEMORY;
+    }
+
+    fillMediaType(pmt, getParent()->width(), getParent()->height(), getParent()->framerate(),
+                    getParent()->mediaTypeFormat(iPosition));
+
+    LOG("-> NOERROR\n");
+    return NOERROR;
+}
+
+HRESULT SoftcamStream::CheckMediaType(const CMediaType *pmt)
+{
+    CheckPointer(pmt,E_POINTER);
+
+    for (int i = 0; i < getParent()->mediaTypeCount(); i++)
+    {
+        CMediaType mt;
+        if (SUCCEEDED(GetMediaType(i, &mt)) && mt == *pmt)
+        {
+            return NOERROR;
+        }
+    }
+    return E_FAIL;
+}
+
 HRESULT SoftcamStream::DecideBufferSize(IMemAllocator *pAlloc,
                                         ALLOCATOR_PROPERTIES *pProperties)
 {
@@ -537,6 +790,8 @@ HRESULT SoftcamStream::OnThreadCreate()
     }
     framerate = (std::min)((std::max)(framerate, 1.0f), 1000.0f);
     m_interval_time_msec = (long)std::round(1000.0f / framerate);
+    m_stream_clock.reset((std::int64_t)std::round(10000000.0f / framerate));
+    m_discontinuity = true;
 
     LOG("-> NOERROR\n");
     return NOERROR;
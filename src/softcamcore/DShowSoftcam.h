@@ -3,6 +3,7 @@
 #include <memory>
 #include <baseclasses/streams.h>
 #include "FrameBuffer.h"
+#include "StreamClock.h"
 
 
 namespace softcam {
@@ -14,34 +15,55 @@ public:
     static CUnknown* CreateInstance(
                     LPUNKNOWN   lpunk,
                     const GUID& clsid,
-                    HRESULT*    phr);
+                    HRESULT*    phr,
+                    int         instance = 0);
 
     // IUnknown Methods
     DECLARE_IUNKNOWN
     STDMETHODIMP NonDelegatingQueryInterface(REFIID riid, __deref_out void **ppv) override;
 
+    // IMediaFilter
+    STDMETHODIMP Run(REFERENCE_TIME tStart) override;
+    STDMETHODIMP Stop() override;
+
     // IAMStreamConfig
     HRESULT STDMETHODCALLTYPE SetFormat(AM_MEDIA_TYPE *mt) override;
     HRESULT STDMETHODCALLTYPE GetFormat(AM_MEDIA_TYPE **out_pmt) override;
     HRESULT STDMETHODCALLTYPE GetNumberOfCapabilities(int *out_count, int *out_size) override;
     HRESULT STDMETHODCALLTYPE GetStreamCaps(int index, AM_MEDIA_TYPE **out_pmt, BYTE *out_scc) override;
 
+    ~Softcam();
+
     FrameBuffer*    getFrameBuffer();
+    int             instance() const { return m_instance; }
     bool            valid() const { return m_valid; }
     int             width() const { return m_width; }
     int             height() const { return m_height; }
     float           framerate() const { return m_framerate; }
+    PixelFormat     format() const { return m_format; }
+    int             mediaTypeCount() const;
+    PixelFormat     mediaTypeFormat(int index) const;
     void            releaseFrameBuffer();
+    bool            readClocks(
+                        REFERENCE_TIME* out_clock_now,
+                        uint64_t*       out_timestamp_now,
+                        REFERENCE_TIME* out_stream_start);
 
 private:
     CCritSec    m_critsec;
+    const int   m_instance;
     FrameBuffer m_frame_buffer;
     const bool  m_valid;
     const int   m_width;
     const int   m_height;
     const float m_framerate;
+    const PixelFormat m_format;
+    // The clock and the start time of the running graph, kept apart from
+    // the filter lock which the streaming thread must not take.
+    IReferenceClock*    m_clock = nullptr;
+    REFERENCE_TIME      m_stream_start = 0;
 
-    Softcam(LPUNKNOWN lpunk, const GUID& clsid, HRESULT *phr);
+    Softcam(LPUNKNOWN lpunk, const GUID& clsid, HRESULT *phr, int instance);
 };
 
 
@@ -66,6 +88,8 @@ class SoftcamStream : public CSourceStream, public IKsPropertySet, public IAMStr
     // CSourceStream
     HRESULT FillBuffer(IMediaSample *pms) override;
     HRESULT GetMediaType(CMediaType *pMediaType) override;
+    HRESULT GetMediaType(int iPosition, CMediaType *pMediaType) override;
+    HRESULT CheckMediaType(const CMediaType *pMediaType) override;
     HRESULT OnThreadCreate(void) override;
 
     //  IKsPropertySet
@@ -90,10 +114,13 @@ private:
     const int   m_height;
     uint64_t    m_frame_counter = 0;
     std::unique_ptr<uint8_t[]>  m_screenshot;
+    std::size_t                 m_screenshot_size = 0;
 
     CCritSec m_critsec;
     CRefTime m_sample_time;
     long m_interval_time_msec = 10;
+    StreamClock m_stream_clock;
+    bool m_discontinuity = true;
 
     Softcam*        getParent();
 };
@@ -1,7 +1,12 @@
 #include "FrameBuffer.h"
 
-#include <windows.h>
 #include <mutex> // lock_guard
+#include <thread>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <type_traits>
 
 
 namespace softcam {
@@ -9,39 +14,127 @@ namespace softcam {
 
 const char NamedMutexName[] = "FluxMic Camera/NamedMutex";
 const char SharedMemoryName[] = "FluxMic Camera/SharedMemory";
-const uint8_t ProtocolVersion = 2;
+const char NamedEventName[] = "FluxMic Camera/NamedEvent";
+const char RegistryName[] = "FluxMic Camera/Registry";
+const uint8_t ProtocolVersion = 3;
+const uint32_t SlotAlignment = 64;
+
+enum HeaderFlags : uint32_t
+{
+    HeaderFlag_LargePages = 0x1,    // the memory is backed by large pages
+};
+const uint64_t CursorTimeout = (uint64_t)(FrameBuffer::WATCHDOG_TIMEOUT * Timer::TIMESTAMP_FREQUENCY);
+const uint64_t LivenessTimeout = (uint64_t)(FrameBuffer::LIVENESS_TIMEOUT * Timer::TIMESTAMP_FREQUENCY);
 
 
 struct FrameBuffer::Header
 {
+    // The fields up to m_frame_counter are shared with the receivers of
+    // version 1 and 2, so their layout must not be changed.
+    // Those receivers access the mutable fields under the mutex, while
+    // the others access them as atomics without the mutex.
     uint32_t    m_image_offset;
     uint16_t    m_width;
     uint16_t    m_height;
     float       m_framerate;
-    uint8_t     m_is_active;
-    uint8_t     m_connected_min_version; // 0 or 1 or 2
-    uint8_t     m_watchdog_sender_heartbeat;
-    uint8_t     m_watchdog_receiver_heartbeat;
-    uint64_t    m_frame_counter;
+    std::atomic<uint8_t>    m_is_active;
+    std::atomic<uint8_t>    m_connected_min_version; // 0 or 1 or 2 or 3
+    std::atomic<uint8_t>    m_watchdog_sender_heartbeat;
+    std::atomic<uint8_t>    m_watchdog_receiver_heartbeat;
+    std::atomic<uint64_t>   m_frame_counter;
+
+    // Version 3 or later
+    uint32_t    m_sender_version;
+    uint32_t    m_slot_offset;
+    uint32_t    m_slot_stride;
+    uint32_t    m_pixel_format; // PixelFormat
+    uint32_t    m_slot_layout;  // SlotLayout
+    uint32_t    m_flags;        // HeaderFlags
+    // Timer::timestamp() at which each side was last seen alive. They
+    // are on separate cache lines, apart from the fields above which the
+    // sender writes on every frame.
+    alignas(FrameSlots::CACHE_LINE_SIZE)
+    std::atomic<uint64_t>   m_sender_seen;
+    alignas(FrameSlots::CACHE_LINE_SIZE)
+    std::atomic<uint64_t>   m_receiver_seen;
+    alignas(FrameSlots::CACHE_LINE_SIZE)
+    FrameSlots  m_slots;
+    NamedEvent::State   m_frame_event;
 
     uint8_t*    imageData();
+    uint8_t*    slotData(uint32_t slot);
 };
 
-
 uint8_t* FrameBuffer::Header::imageData()
 {
     uint8_t *image = reinterpret_cast<uint8_t*>(this) + m_image_offset;
     return image;
 }
 
+uint8_t* FrameBuffer::Header::slotData(uint32_t slot)
+{
+    uint8_t *image = reinterpret_cast<uint8_t*>(this) + m_slot_offset + m_slot_stride * slot;
+    return image;
+}
+
+
+namespace {
+
+uint32_t alignSlot(uint32_t size)
+{
+    return (size + SlotAlignment - 1) & ~(SlotAlignment - 1);
+}
+
+int calcDIBStride(int width)
+{
+    return (width * 3 + 3) & ~3;
+}
+
+bool isFresh(uint64_t last_seen, uint64_t now)
+{
+    return last_seen != 0 && (now < last_seen || now - last_seen <= LivenessTimeout);
+}
+
+// Several receivers publish their timestamps to the same field, so it
+// is only moved forward.
+void publishSeen(std::atomic<uint64_t>& last_seen, uint64_t now)
+{
+    auto value = last_seen.load(std::memory_order_relaxed);
+    while (value < now &&
+            !last_seen.compare_exchange_weak(value, now, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+}
+
+std::string instanceName(const char* name, int instance)
+{
+    if (instance == 0)
+    {
+        return name;
+    }
+    return std::string(name) + "/" + std::to_string(instance);
+}
+
+} //namespace
+
 
 FrameBuffer FrameBuffer::create(
                         int             width,
                         int             height,
-                        float           framerate)
+                        float           framerate,
+                        int             slot_count,
+                        PixelFormat     format,
+                        SlotLayout      slot_layout,
+                        int             instance,
+                        const char*     name,
+                        bool            large_pages)
 {
-    FrameBuffer fb(NamedMutexName);
+    FrameBuffer fb(instanceName(NamedMutexName, instance).c_str(), instance);
 
+    if (!CameraRegistry::checkInstance(instance))
+    {
+        return fb;
+    }
     if (!checkDimensions(width, height))
     {
         return fb;
@@ -50,49 +143,123 @@ FrameBuffer FrameBuffer::create(
     {
         return fb;
     }
+    if (slot_count < 0 || !FrameSlots::checkSlotCount((uint32_t)slot_count))
+    {
+        return fb;
+    }
+    ImageLayout layout;
+    if (!calcImageLayout(format, width, height, &layout))
+    {
+        return fb;
+    }
+    if (slot_layout != SlotLayout::TOP_DOWN && slot_layout != SlotLayout::DIB)
+    {
+        return fb;
+    }
 
-    auto shmem_size = calcMemorySize((uint16_t)width, (uint16_t)height);
-    fb.m_shmem = SharedMemory::create(SharedMemoryName, shmem_size);
+    auto shmem_size = calcMemorySize((uint16_t)width, (uint16_t)height, (uint32_t)slot_count, layout.size);
+    if (shmem_size > UINT32_MAX)
+    {
+        return fb;
+    }
+    fb.m_shmem = SharedMemory::create(
+                    instanceName(SharedMemoryName, instance).c_str(),
+                    (unsigned long)shmem_size,
+                    large_pages);
     if (fb.m_shmem)
     {
         std::lock_guard<NamedMutex> lock(fb.m_mutex);
 
+        auto image_size = (uint32_t)width * (uint32_t)height * 3;
         auto frame = fb.header();
         frame->m_image_offset = sizeof(Header);
         frame->m_width = (uint16_t)width;
         frame->m_height = (uint16_t)height;
         frame->m_framerate = framerate;
-        frame->m_is_active = 1;
-        frame->m_connected_min_version = 0;
-        frame->m_watchdog_sender_heartbeat = 0;
-        frame->m_watchdog_receiver_heartbeat = 0;
-        frame->m_frame_counter = 0;
+        frame->m_is_active.store(1, std::memory_order_relaxed);
+        frame->m_connected_min_version.store(0, std::memory_order_relaxed);
+        frame->m_watchdog_sender_heartbeat.store(0, std::memory_order_relaxed);
+        frame->m_watchdog_receiver_heartbeat.store(0, std::memory_order_relaxed);
+        frame->m_frame_counter.store(0, std::memory_order_relaxed);
+        frame->m_sender_version = ProtocolVersion;
+        frame->m_slot_offset = alignSlot(frame->m_image_offset + image_size);
+        frame->m_slot_stride = alignSlot(layout.size);
+        frame->m_pixel_format = (uint32_t)format;
+        frame->m_slot_layout = (uint32_t)slot_layout;
+        frame->m_flags = fb.m_shmem.largePages() ? (uint32_t)HeaderFlag_LargePages : 0u;
+        frame->m_sender_seen.store(Timer::timestamp(), std::memory_order_relaxed);
+        frame->m_receiver_seen.store(0, std::memory_order_relaxed);
+        frame->m_slots.init((uint32_t)slot_count);
+        NamedEvent::initState(&frame->m_frame_event);
+        fb.m_has_slots = true;
+        fb.takeSnapshot();
+        fb.m_frame_event = NamedEvent(
+                    instanceName(NamedEventName, instance).c_str(),
+                    &frame->m_frame_event);
+
+        // The registry is only for enumerating the instances, so the
+        // camera works without it.
+        CameraRegistry* registry = nullptr;
+        auto registry_shmem = SharedMemory::openOrCreate(RegistryName, sizeof(CameraRegistry));
+        if (registry_shmem)
+        {
+            registry = static_cast<CameraRegistry*>(registry_shmem.get());
+            CameraRegistry::Info info{};
+            info.instance = instance;
+            info.width = width;
+            info.height = height;
+            info.framerate = framerate;
+            info.format = format;
+            if (name)
+            {
+                std::strncpy(info.name, name, CameraRegistry::MAX_NAME_LENGTH);
+            }
+            registry->claim(instance, Timer::timestamp());
+            registry->publish(info);
+            fb.m_registry_owner = std::shared_ptr<void>(
+                registry,
+                [registry_shmem, instance](void* ptr) mutable
+                {
+                    // The captured copy keeps the memory mapped until here.
+                    static_cast<CameraRegistry*>(ptr)->release(instance);
+                    registry_shmem = {};
+                });
+        }
 
-        auto mutex = fb.m_mutex;
+        // The counter is still updated for the receivers of version 1 and 2.
         fb.m_sender_watchdog = Watchdog::createHeartbeat(
             WATCHDOG_HEARTBEAT_INTERVAL,
-            [mutex, frame]() mutable
+            [frame, registry, instance]()
             {
-                std::lock_guard<NamedMutex> lock(mutex);
-                frame->m_watchdog_sender_heartbeat += 1;
+                auto now = Timer::timestamp();
+                if (registry)
+                {
+                    registry->touch(instance, now);
+                }
+                frame->m_sender_seen.store(now, std::memory_order_release);
+                frame->m_watchdog_sender_heartbeat.fetch_add(1, std::memory_order_relaxed);
             });
-        fb.m_receiver_watchdog = Watchdog::createMonitor(
-            WATCHDOG_MONITOR_INTERVAL,
+        // Only for the receivers of version 1 and 2; the others are seen
+        // by the timestamp.
+        fb.m_receiver_watchdog = Watchdog::createLazyMonitor(
             WATCHDOG_TIMEOUT,
-            [mutex, frame]() mutable
+            [frame]()
             {
-                std::lock_guard<NamedMutex> lock(mutex);
-                return frame->m_watchdog_receiver_heartbeat;
+                return frame->m_watchdog_receiver_heartbeat.load(std::memory_order_relaxed);
             });
     }
     return fb;
 }
 
-FrameBuffer FrameBuffer::open()
+FrameBuffer FrameBuffer::open(int instance)
 {
-    FrameBuffer fb(NamedMutexName);
+    FrameBuffer fb(instanceName(NamedMutexName, instance).c_str(), instance);
 
-    fb.m_shmem = SharedMemory::open(SharedMemoryName);
+    if (!CameraRegistry::checkInstance(instance))
+    {
+        return fb;
+    }
+    fb.m_shmem = SharedMemory::open(instanceName(SharedMemoryName, instance).c_str());
     if (fb.m_shmem)
     {
         std::lock_guard<NamedMutex> lock(fb.m_mutex);
@@ -117,43 +284,147 @@ FrameBuffer FrameBuffer::open()
             fb.m_shmem = {};
             return fb;
         }
+        // The senders of version 2 or earlier put the image right after
+        // the version 2 header, which is smaller than the current one.
+        if (sizeof(Header) <= frame->m_image_offset &&
+            3 <= frame->m_sender_version)
+        {
+            auto slot_count = frame->m_slots.slotCount();
+            uint64_t slots_end = (uint64_t)frame->m_slot_offset +
+                    (uint64_t)frame->m_slot_stride * slot_count;
+            ImageLayout layout;
+            if (!FrameSlots::checkSlotCount(slot_count) ||
+                !isValidPixelFormat(frame->m_pixel_format) ||
+                frame->m_slot_layout > (uint32_t)SlotLayout::DIB ||
+                !calcImageLayout((PixelFormat)frame->m_pixel_format, frame->m_width, frame->m_height, &layout) ||
+                frame->m_slot_stride < layout.size ||
+                size < slots_end)
+            {
+                fb.m_shmem = {};
+                return fb;
+            }
+            fb.m_has_slots = true;
+            fb.m_frame_event = NamedEvent(
+                    instanceName(NamedEventName, instance).c_str(),
+                    &frame->m_frame_event);
+
+            // A cursor is optional; without it, reading falls back to the
+            // latest frame and the sender doesn't see our progress.
+            auto cursor = frame->m_slots.registerCursor(Timer::timestamp(), CursorTimeout);
+            if (0 <= cursor)
+            {
+                auto shmem = fb.m_shmem;
+                fb.m_cursor = cursor;
+                fb.m_cursor_owner = std::shared_ptr<void>(
+                    &frame->m_slots,
+                    [shmem, cursor](void* ptr) mutable
+                    {
+                        // The captured copy keeps the memory mapped until here.
+                        static_cast<FrameSlots*>(ptr)->unregisterCursor(cursor);
+                        shmem = {};
+                    });
+            }
+        }
 
+        fb.takeSnapshot();
+
+        // The senders of version 2 or earlier publish no timestamp but
+        // the heartbeat counter in the version 2 header, and watch only
+        // the counter which their receivers update under the mutex.
         auto mutex = fb.m_mutex;
-        fb.m_sender_watchdog = Watchdog::createMonitor(
-            WATCHDOG_MONITOR_INTERVAL,
-            WATCHDOG_TIMEOUT,
-            [mutex, frame]() mutable
-            {
-                std::lock_guard<NamedMutex> lock(mutex);
-                return frame->m_watchdog_sender_heartbeat;
-            });
+        bool has_slots = fb.m_has_slots;
+        if (!has_slots)
+        {
+            fb.m_sender_watchdog = Watchdog::createLazyMonitor(
+                WATCHDOG_TIMEOUT,
+                [frame]()
+                {
+                    return frame->m_watchdog_sender_heartbeat.load(std::memory_order_relaxed);
+                });
+        }
+        auto cursor = fb.m_cursor;
         fb.m_receiver_watchdog = Watchdog::createHeartbeat(
             WATCHDOG_HEARTBEAT_INTERVAL,
-            [mutex, frame]() mutable
+            [mutex, frame, cursor, has_slots]() mutable
             {
+                if (has_slots)
+                {
+                    auto now = Timer::timestamp();
+                    frame->m_slots.touchCursor(cursor, now);
+                    publishSeen(frame->m_receiver_seen, now);
+                    return;
+                }
                 std::lock_guard<NamedMutex> lock(mutex);
-                frame->m_watchdog_receiver_heartbeat += 1;
+                frame->m_watchdog_receiver_heartbeat.fetch_add(1, std::memory_order_relaxed);
             });
-        if (0 == frame->m_connected_min_version ||
-            ProtocolVersion <= frame->m_connected_min_version)
+
+        // The version only goes down to the lowest one connected, so the
+        // receivers of version 1 and 2, which update it under the mutex,
+        // can't undo our change.
+        uint8_t ver = 0;
+        while ((0 == ver || ProtocolVersion <= ver) &&
+                !frame->m_connected_min_version.compare_exchange_weak(ver, ProtocolVersion))
         {
-            frame->m_connected_min_version = ProtocolVersion;
         }
-        frame->m_watchdog_receiver_heartbeat += 1;
+        if (has_slots)
+        {
+            publishSeen(frame->m_receiver_seen, Timer::timestamp());
+        }
+        else
+        {
+            frame->m_watchdog_receiver_heartbeat.fetch_add(1, std::memory_order_relaxed);
+        }
     }
 
     return fb;
 }
 
+std::vector<CameraRegistry::Info> FrameBuffer::listInstances()
+{
+    std::vector<CameraRegistry::Info> list;
+    auto shmem = SharedMemory::open(RegistryName);
+    if (shmem && sizeof(CameraRegistry) <= shmem.size())
+    {
+        auto registry = static_cast<const CameraRegistry*>(shmem.get());
+        auto now = Timer::timestamp();
+        for (int i = 0; i < CameraRegistry::MAX_INSTANCES; i++)
+        {
+            CameraRegistry::Info info;
+            if (registry->read(i, now, CursorTimeout, &info))
+            {
+                list.push_back(info);
+            }
+        }
+    }
+    return list;
+}
+
 FrameBuffer&
 FrameBuffer::operator =(const FrameBuffer& fb)
 {
     m_receiver_watchdog = {};
     m_sender_watchdog = {};
+    m_cursor_owner = {};
+    m_registry_owner = {};
     m_shmem = {};
+    m_mutex = fb.m_mutex;
+    m_instance = fb.m_instance;
     m_shmem = fb.m_shmem;
+    m_registry_owner = fb.m_registry_owner;
+    m_cursor_owner = fb.m_cursor_owner;
+    m_cursor = fb.m_cursor;
+    m_read_mode = fb.m_read_mode;
     m_sender_watchdog = fb.m_sender_watchdog;
     m_receiver_watchdog = fb.m_receiver_watchdog;
+    m_has_slots = fb.m_has_slots;
+    m_width = fb.m_width;
+    m_height = fb.m_height;
+    m_framerate = fb.m_framerate;
+    m_slot_layout = fb.m_slot_layout;
+    m_layout = fb.m_layout;
+    m_bottom_up = fb.m_bottom_up;
+    m_frame_event = fb.m_frame_event;
+    m_locked_slot = -1;
     return *this;
 }
 
@@ -162,42 +433,62 @@ void* FrameBuffer::handle() const
     return const_cast<void*>(m_shmem.get());
 }
 
+// The fields which never change are taken from the snapshot, and the
+// others are read as atomics, so none of the getters takes the mutex.
 int FrameBuffer::width() const
 {
-    std::lock_guard<NamedMutex> lock(m_mutex);
-    return m_shmem ? header()->m_width : 0;
+    return m_shmem ? m_width : 0;
 }
 
 int FrameBuffer::height() const
 {
-    std::lock_guard<NamedMutex> lock(m_mutex);
-    return m_shmem ? header()->m_height : 0;
+    return m_shmem ? m_height : 0;
 }
 
 float FrameBuffer::framerate() const
 {
-    std::lock_guard<NamedMutex> lock(m_mutex);
-    return m_shmem ? header()->m_framerate : 0.0f;
+    return m_shmem ? m_framerate : 0.0f;
+}
+
+PixelFormat FrameBuffer::format() const
+{
+    return m_shmem ? m_layout.format : PixelFormat::BGR24;
+}
+
+FrameBuffer::SlotLayout FrameBuffer::slotLayout() const
+{
+    return m_shmem ? m_slot_layout : SlotLayout::TOP_DOWN;
+}
+
+bool FrameBuffer::imageLayout(ImageLayout* out_layout) const
+{
+    if (!m_shmem)
+    {
+        return false;
+    }
+    *out_layout = m_layout;
+    return true;
 }
 
 uint64_t FrameBuffer::frameCounter() const
 {
-    std::lock_guard<NamedMutex> lock(m_mutex);
-    return m_shmem ? header()->m_frame_counter : 0;
+    if (m_shmem && m_has_slots)
+    {
+        return header()->m_slots.latestFrameCounter();
+    }
+    return m_shmem ? header()->m_frame_counter.load(std::memory_order_acquire) : 0;
 }
 
 bool FrameBuffer::active() const
 {
-    std::lock_guard<NamedMutex> lock(m_mutex);
-    return m_shmem && header()->m_is_active;
+    return m_shmem && header()->m_is_active.load(std::memory_order_acquire);
 }
 
 bool FrameBuffer::connected() const
 {
-    std::lock_guard<NamedMutex> lock(m_mutex);
     if (m_shmem)
     {
-        auto ver = header()->m_connected_min_version;
+        auto ver = header()->m_connected_min_version.load(std::memory_order_relaxed);
         if (0 == ver)
         {
             // No receivers connected
@@ -210,67 +501,409 @@ bool FrameBuffer::connected() const
             // we won't know their disconnection.
             return true;
         }
-        return m_receiver_watchdog.alive();
+        // Receivers of version 3 publish the timestamp, and the others
+        // increment the counter.
+        if (m_has_slots &&
+            isFresh(header()->m_receiver_seen.load(std::memory_order_acquire), Timer::timestamp()))
+        {
+            return true;
+        }
+        return ver < ProtocolVersion && m_receiver_watchdog.alive();
+    }
+    return false;
+}
+
+bool FrameBuffer::senderAlive() const
+{
+    if (m_has_slots)
+    {
+        return isFresh(header()->m_sender_seen.load(std::memory_order_acquire), Timer::timestamp());
+    }
+    return m_sender_watchdog.alive();
+}
+
+int FrameBuffer::slotCount() const
+{
+    return m_shmem && m_has_slots ? (int)header()->m_slots.slotCount() : 0;
+}
+
+// The sender records the mode it has been granted, since the receivers
+// can't always tell it from their mapping.
+bool FrameBuffer::largePages() const
+{
+    if (m_shmem && m_has_slots)
+    {
+        return (header()->m_flags & HeaderFlag_LargePages) != 0;
     }
     return false;
 }
 
+uint64_t FrameBuffer::receiverLag() const
+{
+    if (m_shmem && m_has_slots)
+    {
+        return header()->m_slots.slowestCursorLag(Timer::timestamp(), CursorTimeout);
+    }
+    return 0;
+}
+
+uint64_t FrameBuffer::droppedFrames() const
+{
+    if (m_shmem && m_has_slots)
+    {
+        return header()->m_slots.cursorDroppedFrames(m_cursor);
+    }
+    return 0;
+}
+
 void FrameBuffer::deactivate()
 {
     if (!m_shmem) return;
-    std::lock_guard<NamedMutex> lock(m_mutex);
-    header()->m_is_active = 0;
+    header()->m_is_active.store(0, std::memory_order_release);
+    m_frame_event.notify();
 }
 
-void FrameBuffer::write(const void* image_bits)
+void FrameBuffer::write(const void* image_bits, uint64_t timestamp, uint64_t duration)
 {
-    if (!m_shmem) return;
-    std::lock_guard<NamedMutex> lock(m_mutex);
+    if (!m_shmem || !m_has_slots) return;
+    auto frame = header();
+
+    // In the DIB layout, the image is flipped here once so that every
+    // receiver can take it with a single copy.
+    if (lockFrame(nullptr))
+    {
+        copyImage(
+                m_layout,
+                image_bits,
+                frame->slotData((uint32_t)m_locked_slot),
+                m_bottom_up);
+        unlockFrame(timestamp, duration);
+    }
+}
+
+// Only packed formats are supported, since a region of a planar image
+// would need a pointer for each plane.
+bool FrameBuffer::checkRegion(int x, int y, int width, int height, int stride) const
+{
+    if (!m_shmem || !m_has_slots) return false;
+    auto& layout = m_layout;
+    if (layout.plane_count != 1) return false;
+
+    int align = layout.format == PixelFormat::YUY2 ? 2 : 1;
+    int pixel_size = (int)layout.planes[0].stride / layout.width;
+    return 0 <= x && 0 < width && width <= layout.width - x &&
+            0 <= y && 0 < height && height <= layout.height - y &&
+            x % align == 0 && width % align == 0 &&
+            (int64_t)width * pixel_size <= stride;
+}
+
+// Copies only the specified rectangle of the image into the frame buffer,
+// and records the rows as the changed rows of the new frame.
+bool FrameBuffer::writeRegion(
+                        const void*     image_bits,
+                        int             x,
+                        int             y,
+                        int             width,
+                        int             height,
+                        int             stride)
+{
+    if (!image_bits || !checkRegion(x, y, width, height, stride)) return false;
+    auto frame = header();
+    auto& slots = frame->m_slots;
+    auto& layout = m_layout;
+    auto latest_slot = slots.latestSlot();
+    auto latest_frame = slots.latestFrameCounter();
+    if (!lockFrame(nullptr)) return false;
+
+    auto slot = (uint32_t)m_locked_slot;
+    auto dest = frame->slotData(slot);
+    auto src = frame->slotData(latest_slot);
+    auto row_size = (std::size_t)layout.planes[0].stride;
+    auto h = (uint32_t)layout.height;
+    bool bottom_up = m_bottom_up;
+    auto rowOffset = [&](uint32_t row)
+    {
+        return row_size * (bottom_up ? h - 1 - row : row);
+    };
+
+    // The slot still holds an older frame, so the rows which have changed
+    // since then are brought from the latest frame first.
+    if (0 < latest_frame)
+    {
+        auto slot_frame = slots.m_slot[slot].m_frame_counter.load(std::memory_order_relaxed);
+        uint32_t first = 0, end = h;
+        slots.changedRows(slot_frame, latest_frame, h, &first, &end);
+        if (first < end)
+        {
+            auto top = rowOffset(bottom_up ? end - 1 : first);
+            std::memcpy(dest + top, src + top, row_size * (end - first));
+        }
+    }
+
+    auto pixel_size = row_size / (std::size_t)layout.width;
+    auto bits = static_cast<const uint8_t*>(image_bits);
+    for (int i = 0; i < height; i++)
+    {
+        std::memcpy(dest + rowOffset((uint32_t)(y + i)) + pixel_size * x,
+                    bits + (std::size_t)stride * i,
+                    pixel_size * width);
+    }
+    publishFrame(FrameSlots::packRows((uint32_t)y, (uint32_t)(y + height)), 0, 0);
+    return true;
+}
+
+void* FrameBuffer::lockFrame(int* out_stride)
+{
+    if (!m_shmem || !m_has_slots) return nullptr;
     auto frame = header();
-    std::memcpy(
-            frame->imageData(),
-            image_bits,
-            (std::size_t)3 * frame->m_width * frame->m_height);
-    frame->m_frame_counter += 1;
+
+    // The new image goes to a free slot without any lock.
+    if (m_locked_slot < 0)
+    {
+        m_locked_slot = (int)frame->m_slots.beginWrite();
+    }
+    auto data = frame->slotData((uint32_t)m_locked_slot);
+    int stride = (int)m_layout.planes[0].stride;
+    if (m_bottom_up)
+    {
+        // Give the top row, which is the last one in memory.
+        data += (std::size_t)stride * (m_layout.height - 1);
+        stride = -stride;
+    }
+    if (out_stride)
+    {
+        *out_stride = stride;
+    }
+    return data;
+}
+
+void FrameBuffer::unlockFrame(uint64_t timestamp, uint64_t duration)
+{
+    publishFrame(FrameSlots::ALL_ROWS, timestamp, duration);
+}
+
+void FrameBuffer::publishFrame(uint32_t dirty_rows, uint64_t timestamp, uint64_t duration)
+{
+    if (!m_shmem || m_locked_slot < 0) return;
+    auto frame = header();
+    auto slot = (uint32_t)m_locked_slot;
+    auto frame_counter = frame->m_slots.latestFrameCounter() + 1;
+    if (timestamp == 0)
+    {
+        timestamp = Timer::timestamp();
+    }
+    frame->m_slots.endWrite(slot, frame_counter, timestamp, dirty_rows, duration);
+    m_locked_slot = -1;
+
+    // Receivers of version 1 and 2 read the single image under the mutex,
+    // so we keep it up to date, taking the mutex, only while any of them
+    // is connected. The counter is updated after the image, so they
+    // never take the new counter with the old image.
+    auto ver = frame->m_connected_min_version.load(std::memory_order_relaxed);
+    if (0 < ver && ver < 3)
+    {
+        std::lock_guard<NamedMutex> lock(m_mutex);
+        convertToBGR24(
+                m_layout,
+                frame->slotData(slot),
+                frame->imageData(),
+                3 * m_width,
+                m_bottom_up);
+    }
+    frame->m_frame_counter.store(frame_counter, std::memory_order_release);
+    m_frame_event.notify();
 }
 
-void FrameBuffer::transferToDIB(void* image_bits, uint64_t* out_frame_counter)
+void FrameBuffer::transferToDIB(
+                        void*           image_bits,
+                        uint64_t*       out_frame_counter,
+                        uint64_t*       out_timestamp,
+                        uint64_t*       out_duration)
 {
+    transfer(image_bits, false, 0, out_frame_counter, out_timestamp, out_duration);
+}
+
+void FrameBuffer::transferNative(
+                        void*           image_bits,
+                        uint64_t*       out_frame_counter,
+                        uint64_t*       out_timestamp,
+                        uint64_t*       out_duration)
+{
+    transfer(image_bits, true, 0, out_frame_counter, out_timestamp, out_duration);
+}
+
+void FrameBuffer::updateDIB(
+                        void*           image_bits,
+                        uint64_t*       inout_frame_counter,
+                        uint64_t*       out_timestamp,
+                        uint64_t*       out_duration)
+{
+    transfer(image_bits, false, *inout_frame_counter, inout_frame_counter, out_timestamp, out_duration);
+}
+
+void FrameBuffer::updateNative(
+                        void*           image_bits,
+                        uint64_t*       inout_frame_counter,
+                        uint64_t*       out_timestamp,
+                        uint64_t*       out_duration)
+{
+    transfer(image_bits, true, *inout_frame_counter, inout_frame_counter, out_timestamp, out_duration);
+}
+
+// The destination is in the DirectShow convention; RGB images are
+// bottom-up and YUV images are top-down.
+void FrameBuffer::transfer(
+                        void*           image_bits,
+                        bool            native,
+                        uint64_t        base_frame_counter,
+                        uint64_t*       out_frame_counter,
+                        uint64_t*       out_timestamp,
+                        uint64_t*       out_duration)
+{
+    if (out_timestamp)
+    {
+        *out_timestamp = 0;
+    }
+    if (out_duration)
+    {
+        *out_duration = 0;
+    }
     if (!m_shmem)
     {
         *out_frame_counter = 0;
         return;
     }
-    std::lock_guard<NamedMutex> lock(m_mutex);
-
     auto frame = header();
+    auto& layout = m_layout;
+    bool flip = !m_bottom_up;
+    // Without flipping, both functions end up with a single memcpy
+    // for the native format.
+    auto copy = [&](const uint8_t* image)
+    {
+        if (native)
+        {
+            copyImage(layout, image, image_bits, flip);
+        }
+        else
+        {
+            convertToBGR24(layout, image, image_bits, calcDIBStride(m_width), flip);
+        }
+    };
+    // The rows are in the order of the source image, which is bottom-up
+    // if it's not to be flipped for a bottom-up destination.
+    auto copyRows = [&](const uint8_t* image, uint32_t first, uint32_t end)
+    {
+        if (first == 0 && end == (uint32_t)layout.height)
+        {
+            copy(image);
+            return;
+        }
+        if (!flip && isPackedRGB(layout.format))
+        {
+            auto h = (uint32_t)layout.height;
+            auto bottom_first = h - end;
+            end = h - first;
+            first = bottom_first;
+        }
+        if (native)
+        {
+            copyImageRows(layout, image, image_bits, flip, (int)first, (int)end);
+        }
+        else
+        {
+            convertRowsToBGR24(layout, image, image_bits, calcDIBStride(m_width), flip, (int)first, (int)end);
+        }
+    };
+    if (m_has_slots)
     {
-        int w = frame->m_width;
-        int h = frame->m_height;
-        int gap = ((w * 3 + 3) & ~3) - w * 3;
-        const std::uint8_t* image = frame->imageData();
-        std::uint8_t* dest = (std::uint8_t*)image_bits;
-        for (int y = 0; y < h; y++)
+        // Lock-free read of a slot. The copy is retried only if the sender
+        // has overwritten the slot in the meantime, which requires the
+        // sender to go around the ring during our copy.
+        auto& slots = frame->m_slots;
+        bool every_frame = m_read_mode == ReadMode::EVERY_FRAME && 0 <= m_cursor;
+        uint64_t last_frame_counter = slots.cursorFrameCounter(m_cursor);
+        FrameSlots::ReadTicket ticket{};
+        bool succeeded = false;
+        for (int retry = 0; retry < MAX_READ_RETRY && !succeeded; retry++)
+        {
+            bool began = every_frame ?
+                    slots.beginReadNext(last_frame_counter, &ticket) :
+                    slots.beginRead(&ticket);
+            if (began)
+            {
+                auto h = (uint32_t)layout.height;
+                uint32_t first = 0, end = h;
+                if (0 < base_frame_counter)
+                {
+                    slots.changedRows(base_frame_counter, ticket.frame_counter, h, &first, &end);
+                }
+                copyRows(frame->slotData(ticket.slot), first, end);
+                succeeded = slots.endRead(ticket);
+            }
+            if (!succeeded)
+            {
+                std::this_thread::yield();
+            }
+        }
+        if (succeeded && 0 <= m_cursor)
         {
-            const std::uint8_t* src = image + 3 * w * (h - 1 - y);
-            std::memcpy(dest, src, 3 * (uint32_t)w);
-            dest += 3 * w + gap;
+            uint64_t dropped_frames = 0;
+            if (every_frame && last_frame_counter + 1 < ticket.frame_counter)
+            {
+                dropped_frames = ticket.frame_counter - last_frame_counter - 1;
+            }
+            slots.advanceCursor(m_cursor, ticket.frame_counter, dropped_frames);
         }
-        *out_frame_counter = frame->m_frame_counter;
+        *out_frame_counter = ticket.frame_counter;
+        if (out_timestamp)
+        {
+            *out_timestamp = ticket.timestamp;
+        }
+        if (out_duration)
+        {
+            *out_duration = ticket.duration;
+        }
+        return;
     }
+
+    // The senders of version 2 or earlier write the image under the mutex.
+    std::lock_guard<NamedMutex> lock(m_mutex);
+    copy(frame->imageData());
+    *out_frame_counter = frame->m_frame_counter.load(std::memory_order_relaxed);
 }
 
 bool FrameBuffer::waitForNewFrame(uint64_t frame_counter, float time_out)
 {
     if (!m_shmem) return false;
     Timer timer;
-    while (active() && m_sender_watchdog.alive())
+    while (active() && senderAlive())
     {
+        // The count must be taken before checking the frame counter so
+        // that a frame which arrives in between wakes us up immediately.
+        auto event_count = m_frame_event.count();
         if (frameCounter() > frame_counter)
         {
             return true;
         }
-        Timer::sleep(0.001f);
+        if (m_frame_event)
+        {
+            // A sender which has died doesn't notify us, so we wake up
+            // periodically anyway to look at its timestamp.
+            float wait_time = WATCHDOG_MONITOR_INTERVAL;
+            if (0.0f < time_out)
+            {
+                wait_time = (std::min)(wait_time, time_out - timer.get());
+            }
+            if (0.0f < wait_time)
+            {
+                m_frame_event.wait(event_count, wait_time);
+            }
+        }
+        else
+        {
+            // The sender of version 2 or earlier doesn't notify us.
+            Timer::sleep(0.001f);
+        }
         if (0.0f < time_out && time_out <= timer.get())
         {
             return true;
@@ -283,7 +916,34 @@ void FrameBuffer::release()
 {
     m_receiver_watchdog.stop();
     m_sender_watchdog.stop();
+    m_cursor_owner = {};
+    m_registry_owner = {};
+    m_cursor = -1;
     m_shmem = SharedMemory{};
+    m_has_slots = false;
+    m_frame_event = NamedEvent{};
+    m_locked_slot = -1;
+}
+
+void FrameBuffer::takeSnapshot()
+{
+    auto frame = header();
+    m_width = frame->m_width;
+    m_height = frame->m_height;
+    m_framerate = frame->m_framerate;
+    if (m_has_slots)
+    {
+        m_slot_layout = (SlotLayout)frame->m_slot_layout;
+        calcImageLayout((PixelFormat)frame->m_pixel_format, m_width, m_height, &m_layout);
+    }
+    else
+    {
+        // The senders of version 2 or earlier give only BGR24 images.
+        m_slot_layout = SlotLayout::TOP_DOWN;
+        calcImageLayout(PixelFormat::BGR24, m_width, m_height, &m_layout);
+    }
+    // YUV images are top-down even in the DIB layout, as DirectShow expects.
+    m_bottom_up = m_slot_layout == SlotLayout::DIB && isPackedRGB(m_layout.format);
 }
 
 FrameBuffer::Header* FrameBuffer::header()
@@ -312,13 +972,24 @@ bool FrameBuffer::checkDimensions(
     return true;
 }
 
-uint32_t FrameBuffer::calcMemorySize(
+uint64_t FrameBuffer::calcMemorySize(
                         uint16_t width,
-                        uint16_t height)
+                        uint16_t height,
+                        uint32_t slot_count,
+                        uint32_t image_size)
 {
+    static_assert(std::is_standard_layout<Header>::value, "Header must be standard layout");
+    static_assert(sizeof(std::atomic<uint8_t>) == 1 && sizeof(std::atomic<uint64_t>) == 8,
+                    "atomics must have the same size as plain integers");
+    static_assert(offsetof(Header, m_is_active) == 12 && offsetof(Header, m_frame_counter) == 16,
+                    "the layout of version 2 must be kept");
+
+    // The single image area for the receivers of version 1 and 2 is
+    // always in BGR24.
     uint32_t header_size = sizeof(Header);
-    uint32_t image_size = (uint32_t)width * height * 3;
-    uint32_t shmem_size = header_size + image_size;
+    uint32_t legacy_image_size = (uint32_t)width * height * 3;
+    uint64_t slots_size = (uint64_t)alignSlot(image_size) * slot_count;
+    uint64_t shmem_size = alignSlot(header_size + legacy_image_size) + slots_size;
     return shmem_size;
 }
 
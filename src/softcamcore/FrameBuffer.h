@@ -2,8 +2,13 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <memory>
+#include <vector>
 #include "Misc.h"
 #include "Watchdog.h"
+#include "FrameSlots.h"
+#include "PixelFormat.h"
+#include "CameraRegistry.h"
 
 
 namespace softcam {
@@ -15,29 +20,99 @@ using std::uint16_t;
 
 
 /// Shared frame buffer between processes (sender and receiver)
+///
+/// Each frame buffer belongs to a camera instance, whose id decides the
+/// names of the inter-process objects. Instance 0 uses the same names as
+/// earlier versions.
 class FrameBuffer
 {
  public:
+    enum class ReadMode
+    {
+        LATEST_ONLY,    // every read gives the latest frame
+        EVERY_FRAME,    // every read gives the frame next to the last one read
+    };
+
+    // Memory layout of the image slots
+    enum class SlotLayout : uint32_t
+    {
+        TOP_DOWN = 0,   // as the sender gives
+        DIB = 1,        // as DirectShow expects; RGB images are stored bottom-up
+    };
+
     static FrameBuffer create(
                         int             width,
                         int             height,
-                        float           framerate = 0.0f);
-    static FrameBuffer open();
+                        float           framerate = 0.0f,
+                        int             slot_count = FrameSlots::DEFAULT_SLOT_COUNT,
+                        PixelFormat     format = PixelFormat::BGR24,
+                        SlotLayout      slot_layout = SlotLayout::TOP_DOWN,
+                        int             instance = 0,
+                        const char*     name = nullptr,
+                        bool            large_pages = false);
+    static FrameBuffer open(int instance = 0);
+    static std::vector<CameraRegistry::Info> listInstances();
 
     FrameBuffer& operator =(const FrameBuffer&);
     explicit operator bool() const { return handle() != nullptr; }
 
     void*           handle() const;
+    int             instance() const { return m_instance; }
     int             width() const;
     int             height() const;
     float           framerate() const;
+    PixelFormat     format() const;
+    SlotLayout      slotLayout() const;
+    bool            imageLayout(ImageLayout* out_layout) const;
     uint64_t        frameCounter() const;
     bool            active() const;
     bool            connected() const;
+    int             slotCount() const;
+    bool            largePages() const;
+    uint64_t        receiverLag() const;
+    uint64_t        droppedFrames() const;
 
     void            deactivate();
-    void            write(const void* image_bits);
-    void            transferToDIB(void* image_bits, uint64_t* out_frame_counter);
+    // `timestamp` is the time of capture in Timer::timestamp() units, or 0
+    // for now, and `duration` is 0 if unknown.
+    void            write(
+                        const void*     image_bits,
+                        uint64_t        timestamp = 0,
+                        uint64_t        duration = 0);
+    bool            checkRegion(int x, int y, int width, int height, int stride) const;
+    bool            writeRegion(
+                        const void*     image_bits,
+                        int             x,
+                        int             y,
+                        int             width,
+                        int             height,
+                        int             stride);
+    void*           lockFrame(int* out_stride);
+    void            unlockFrame(uint64_t timestamp = 0, uint64_t duration = 0);
+    void            setReadMode(ReadMode mode) { m_read_mode = mode; }
+    void            transferToDIB(
+                        void*           image_bits,
+                        uint64_t*       out_frame_counter,
+                        uint64_t*       out_timestamp = nullptr,
+                        uint64_t*       out_duration = nullptr);
+    void            transferNative(
+                        void*           image_bits,
+                        uint64_t*       out_frame_counter,
+                        uint64_t*       out_timestamp = nullptr,
+                        uint64_t*       out_duration = nullptr);
+    // Same as above but `image_bits` must hold the image of the frame
+    // `*inout_frame_counter` (or anything if 0), and only the rows changed
+    // since that frame are copied if they are known.
+    void            updateDIB(
+                        void*           image_bits,
+                        uint64_t*       inout_frame_counter,
+                        uint64_t*       out_timestamp = nullptr,
+                        uint64_t*       out_duration = nullptr);
+    void            updateNative(
+                        void*           image_bits,
+                        uint64_t*       inout_frame_counter,
+                        uint64_t*       out_timestamp = nullptr,
+                        uint64_t*       out_duration = nullptr);
     bool            waitForNewFrame(uint64_t frame_counter, float time_out = 0.5f);
 
     void            release();
@@ -45,26 +120,58 @@ class FrameBuffer
     static constexpr float WATCHDOG_HEARTBEAT_INTERVAL = 0.02f;
     static constexpr float WATCHDOG_MONITOR_INTERVAL = 0.02f;
     static constexpr float WATCHDOG_TIMEOUT = 0.5f;
+    // For the peers which publish the timestamp (version 3 or later)
+    static constexpr float LIVENESS_TIMEOUT = 0.2f;
+    static constexpr int   MAX_READ_RETRY = 100;
 
  private:
     struct Header;
 
     mutable NamedMutex      m_mutex;
+    int                     m_instance;
     SharedMemory            m_shmem;
+    std::shared_ptr<void>   m_registry_owner;
+    std::shared_ptr<void>   m_cursor_owner;
+    int                     m_cursor = -1;
+    ReadMode                m_read_mode = ReadMode::LATEST_ONLY;
     Watchdog                m_sender_watchdog;
     Watchdog                m_receiver_watchdog;
-
-    explicit FrameBuffer(const char* mutex_name) : m_mutex(mutex_name) {}
+    bool                    m_has_slots = false;
+    // Snapshot of the fields which never change after creation
+    int                     m_width = 0;
+    int                     m_height = 0;
+    float                   m_framerate = 0.0f;
+    SlotLayout              m_slot_layout = SlotLayout::TOP_DOWN;
+    ImageLayout             m_layout{};
+    bool                    m_bottom_up = false;
+    NamedEvent              m_frame_event;
+    int                     m_locked_slot = -1;
+
+    FrameBuffer(const char* mutex_name, int instance) :
+        m_mutex(mutex_name), m_instance(instance) {}
 
     Header*         header();
     const Header*   header() const;
+    void            takeSnapshot();
+    bool            senderAlive() const;
 
     static bool     checkDimensions(
                         int width,
                         int height);
-    static uint32_t calcMemorySize(
+    void            publishFrame(uint32_t dirty_rows, uint64_t timestamp, uint64_t duration);
+    void            transfer(
+                        void*           image_bits,
+                        bool            native,
+                        uint64_t        base_frame_counter,
+                        uint64_t*       out_frame_counter,
+                        uint64_t*       out_timestamp,
+                        uint64_t*       out_duration);
+
+    static uint64_t calcMemorySize(
                         uint16_t width,
-                        uint16_t height);
+                        uint16_t height,
+                        uint32_t slot_count,
+                        uint32_t image_size);
 };
 
 
@@ -0,0 +1,236 @@
+#include "FramePacer.h"
+
+#include <cstring>
+#include "FrameBuffer.h"
+#include "Misc.h"
+
+
+namespace softcam {
+
+
+constexpr int FramePacer::DEFAULT_QUEUE_DEPTH;
+
+
+// Besides the waiting ones, one buffer is being filled by the caller and
+// one is being delivered by the pacer thread, so the caller always finds a
+// free one without waiting for the delivery.
+FramePacer::FramePacer(
+                    FrameBuffer*            frame_buffer,
+                    DropPolicy              policy,
+                    int                     queue_depth,
+                    FrameSchedule::CatchUp  catch_up) :
+    m_frame_buffer(frame_buffer),
+    m_policy(policy),
+    m_queue_depth(0 < queue_depth ? queue_depth : DEFAULT_QUEUE_DEPTH),
+    m_schedule(
+        Timer::tickFrequency(),
+        FrameSchedule::rateFromFramerate(frame_buffer->framerate()),
+        catch_up)
+{
+    ImageLayout layout;
+    if (frame_buffer->imageLayout(&layout))
+    {
+        m_stride = (int)layout.planes[0].stride;
+        m_staging.resize((std::size_t)m_queue_depth + 2);
+        for (auto& staging : m_staging)
+        {
+            staging.m_bits.reset(new std::uint8_t[layout.size]);
+        }
+    }
+    m_thread = std::thread([this] { run(); });
+}
+
+FramePacer::~FramePacer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+void FramePacer::push(const void* image_bits, std::uint64_t timestamp, std::uint64_t duration)
+{
+    int stride;
+    if (void* bits = lockFrame(&stride))
+    {
+        ImageLayout layout;
+        m_frame_buffer->imageLayout(&layout);
+        std::memcpy(bits, image_bits, layout.size);
+        unlockFrame(timestamp, duration);
+    }
+}
+
+// The staging buffer has the layout of the images given to write(), so the
+// stride is positive regardless of the slot layout.
+void* FramePacer::lockFrame(int* out_stride)
+{
+    if (m_staging.empty())
+    {
+        return nullptr;
+    }
+    if (!m_filling)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& staging : m_staging)
+        {
+            if (staging.m_state == State::FREE)
+            {
+                staging.m_state = State::FILLING;
+                m_filling = &staging;
+                break;
+            }
+        }
+        if (!m_filling)
+        {
+            return nullptr;
+        }
+    }
+    if (out_stride)
+    {
+        *out_stride = m_stride;
+    }
+    return m_filling->m_bits.get();
+}
+
+void FramePacer::unlockFrame(std::uint64_t timestamp, std::uint64_t duration)
+{
+    if (!m_filling)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto staging = m_filling;
+        m_filling = nullptr;
+        if (m_queue_depth <= countQueued())
+        {
+            m_dropped++;
+            if (m_policy == DropPolicy::DROP_NEWEST)
+            {
+                staging->m_state = State::FREE;
+                return;
+            }
+            oldestQueued()->m_state = State::FREE;
+        }
+        staging->m_state = State::QUEUED;
+        staging->m_order = m_next_order++;
+        staging->m_timestamp = timestamp;
+        staging->m_duration = duration;
+    }
+    m_wake.notify_all();
+}
+
+void FramePacer::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_flushing = true;
+    m_wake.notify_all();
+    m_done.wait(lock, [this]
+    {
+        for (auto& staging : m_staging)
+        {
+            if (staging.m_state == State::QUEUED || staging.m_state == State::SENDING)
+            {
+                return false;
+            }
+        }
+        return true;
+    });
+    m_flushing = false;
+}
+
+int FramePacer::queuedFrames() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return countQueued();
+}
+
+void FramePacer::setCatchUp(FrameSchedule::CatchUp catch_up)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_schedule.setPolicy(catch_up);
+}
+
+FrameSchedule::Stats FramePacer::pacingStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_schedule.stats();
+}
+
+FramePacer::Staging* FramePacer::oldestQueued()
+{
+    Staging* oldest = nullptr;
+    for (auto& staging : m_staging)
+    {
+        if (staging.m_state == State::QUEUED &&
+            (!oldest || staging.m_order < oldest->m_order))
+        {
+            oldest = &staging;
+        }
+    }
+    return oldest;
+}
+
+int FramePacer::countQueued() const
+{
+    int count = 0;
+    for (auto& staging : m_staging)
+    {
+        if (staging.m_state == State::QUEUED)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+// The timing control is the same as sender::SendFrame(); only the sleep
+// happens on this thread instead of the caller's. The lock is not held
+// while sleeping or copying, so the caller is never kept waiting for them.
+void FramePacer::run()
+{
+    bool scheduled = false;
+    std::uint64_t deadline = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_quit)
+    {
+        auto next = oldestQueued();
+        if (!next)
+        {
+            m_wake.wait(lock);
+            continue;
+        }
+        // The frames with the time of capture go out as soon as they come.
+        if (next->m_timestamp == 0 && !m_flushing)
+        {
+            if (!scheduled)
+            {
+                deadline = m_schedule.schedule(Timer::ticks());
+                scheduled = true;
+            }
+            if (Timer::ticks() < deadline)
+            {
+                // A frame may be dropped meanwhile, so we look again.
+                lock.unlock();
+                Timer::sleepUntil(deadline);
+                lock.lock();
+                continue;
+            }
+            m_schedule.sent(Timer::ticks());
+        }
+        scheduled = false;
+
+        next->m_state = State::SENDING;
+        lock.unlock();
+        m_frame_buffer->write(next->m_bits.get(), next->m_timestamp, next->m_duration);
+        lock.lock();
+        next->m_state = State::FREE;
+        m_sent++;
+        m_done.notify_all();
+    }
+}
+
+
+} //namespace softcam
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "FrameSchedule.h"
+
+
+namespace softcam {
+
+
+class FrameBuffer;
+
+
+/// Background delivery of the frames of a sender
+///
+/// The caller's thread only copies the image into a free staging buffer and
+/// returns; the pacer thread writes the staged frames into the frame buffer
+/// on the FrameSchedule of the framerate, as the blocking sender does (or as
+/// soon as they come if the framerate is zero or they have their own
+/// timestamps).
+///
+/// At most `queue_depth` frames wait for delivery. When another one comes,
+/// the drop policy decides which one is given up.
+class FramePacer
+{
+ public:
+    enum class DropPolicy
+    {
+        DROP_OLDEST,    // the waiting frame is replaced by the new one
+        DROP_NEWEST,    // the new frame is discarded
+    };
+
+    static constexpr int DEFAULT_QUEUE_DEPTH = 1;
+
+    // The frame buffer must outlive the pacer, and nothing else may write
+    // into it while the pacer exists.
+    FramePacer(
+                    FrameBuffer*            frame_buffer,
+                    DropPolicy              policy,
+                    int                     queue_depth = DEFAULT_QUEUE_DEPTH,
+                    FrameSchedule::CatchUp  catch_up = FrameSchedule::CatchUp::REBASE);
+    // Frames still waiting are discarded.
+    ~FramePacer();
+
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator =(const FramePacer&) = delete;
+
+    DropPolicy      dropPolicy() const { return m_policy; }
+
+    // These are called from one thread at a time, and never sleep.
+    void            push(const void* image_bits, std::uint64_t timestamp = 0, std::uint64_t duration = 0);
+    void*           lockFrame(int* out_stride);
+    void            unlockFrame(std::uint64_t timestamp = 0, std::uint64_t duration = 0);
+
+    // Waits until every waiting frame is delivered, without the timing control.
+    void            flush();
+
+    std::uint64_t   sentFrames() const { return m_sent.load(); }
+    std::uint64_t   droppedFrames() const { return m_dropped.load(); }
+    int             queuedFrames() const;
+
+    void                    setCatchUp(FrameSchedule::CatchUp catch_up);
+    FrameSchedule::Stats    pacingStats() const;
+
+ private:
+    enum class State { FREE, FILLING, QUEUED, SENDING };
+
+    struct Staging
+    {
+        std::unique_ptr<std::uint8_t[]>    m_bits;
+        State                               m_state = State::FREE;
+        std::uint64_t                       m_order = 0;
+        std::uint64_t                       m_timestamp = 0;
+        std::uint64_t                       m_duration = 0;
+    };
+
+    FrameBuffer*                m_frame_buffer;
+    DropPolicy                  m_policy;
+    int                         m_queue_depth;
+    int                         m_stride = 0;
+    FrameSchedule               m_schedule;
+    std::vector<Staging>        m_staging;
+    Staging*                    m_filling = nullptr;
+    std::uint64_t               m_next_order = 0;
+
+    mutable std::mutex          m_mutex;
+    std::condition_variable     m_wake;
+    std::condition_variable     m_done;
+    bool                        m_quit = false;
+    bool                        m_flushing = false;
+    std::atomic<std::uint64_t>  m_sent{0};
+    std::atomic<std::uint64_t>  m_dropped{0};
+    std::thread                 m_thread;
+
+    Staging*        oldestQueued();
+    int             countQueued() const;
+    void            run();
+};
+
+
+} //namespace softcam
@@ -0,0 +1,142 @@
+#include "FrameSchedule.h"
+
+#include <cmath>
+
+
+namespace softcam {
+
+
+constexpr int FrameSchedule::JITTER_BUCKETS;
+
+
+FrameSchedule::FrameSchedule(std::uint64_t frequency, Rate rate, CatchUp policy) :
+    m_frequency(frequency),
+    m_rate(rate),
+    m_policy(policy)
+{
+    if (0 < m_rate.numerator && 0 < m_rate.denominator)
+    {
+        auto ticks_per_frame = m_frequency * m_rate.denominator;
+        m_period_ticks = ticks_per_frame / m_rate.numerator;
+        m_period_remainder = ticks_per_frame % m_rate.numerator;
+    }
+    else
+    {
+        m_rate = Rate{ 0, 1 };
+    }
+}
+
+FrameSchedule::Rate FrameSchedule::rateFromFramerate(float framerate)
+{
+    if (!(0.0f < framerate))
+    {
+        return Rate{ 0, 1 };
+    }
+    double value = framerate;
+    double integer = std::round(value);
+    if (0.0 < integer && std::fabs(value - integer) < 1e-4 * value)
+    {
+        return Rate{ (std::uint32_t)integer, 1 };
+    }
+    double ntsc = std::round(value * 1.001);
+    if (0.0 < ntsc && std::fabs(value * 1.001 - ntsc) < 1e-4 * value)
+    {
+        return Rate{ (std::uint32_t)ntsc * 1000, 1001 };
+    }
+    return Rate{ (std::uint32_t)std::llround(value * 1000.0), 1000 };
+}
+
+std::uint64_t FrameSchedule::schedule(std::uint64_t now)
+{
+    m_stats.frames++;
+    if (m_rate.numerator == 0)
+    {
+        m_deadline = now;
+        return m_deadline;
+    }
+    if (!m_started)
+    {
+        m_started = true;
+        m_base = now;
+        m_index = 0;
+        m_deadline = now;
+        return m_deadline;
+    }
+
+    m_index++;
+    m_deadline = deadline(m_index);
+    if (now <= m_deadline)
+    {
+        return m_deadline;
+    }
+    m_stats.late_frames++;
+    switch (m_policy)
+    {
+    case CatchUp::SKIP:
+        {
+            auto index = lastIndexBefore(now);
+            m_stats.skipped_periods += index - m_index;
+            m_index = index;
+            m_deadline = deadline(m_index);
+        }
+        break;
+    case CatchUp::BURST:
+        break;
+    case CatchUp::REBASE:
+        if (m_period_ticks / 2 <= now - m_deadline)
+        {
+            m_stats.rebases++;
+            m_base = now;
+            m_index = 0;
+            m_deadline = now;
+        }
+        break;
+    }
+    return m_deadline;
+}
+
+void FrameSchedule::sent(std::uint64_t now)
+{
+    auto error = now < m_deadline ? m_deadline - now : now - m_deadline;
+    auto usec = error * 1000000 / m_frequency;
+    int bucket = 0;
+    while (usec != 0 && bucket < JITTER_BUCKETS - 1)
+    {
+        usec >>= 1;
+        bucket++;
+    }
+    m_stats.jitter_histogram[bucket]++;
+}
+
+// n * period is split so that it doesn't overflow; the remainder is less
+// than the numerator.
+std::uint64_t FrameSchedule::deadline(std::uint64_t index) const
+{
+    return m_base + index * m_period_ticks +
+            index * m_period_remainder / m_rate.numerator;
+}
+
+// The largest index whose deadline is not after `now`, and not less than
+// the current one. The estimate in floating point is corrected exactly.
+std::uint64_t FrameSchedule::lastIndexBefore(std::uint64_t now) const
+{
+    auto elapsed = (double)(now - m_base);
+    auto period = (double)m_frequency * m_rate.denominator / m_rate.numerator;
+    auto index = (std::uint64_t)(elapsed / period);
+    if (index < m_index)
+    {
+        index = m_index;
+    }
+    while (deadline(index + 1) <= now)
+    {
+        index++;
+    }
+    while (m_index < index && now < deadline(index))
+    {
+        index--;
+    }
+    return index;
+}
+
+
+} //namespace softcam
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+
+
+namespace softcam {
+
+
+/// Deadlines of the frames of a sender on an abstract clock
+///
+/// Like TimerSchedule, this only computes; the caller supplies the current
+/// time in integer ticks, sleeps until the deadline it is given and sends
+/// the frame, so the logic can be tested with a fake clock.
+///
+/// The deadline of frame n is `base + n * period`, computed exactly from a
+/// rational framerate (such as 30000/1001), so the schedule doesn't drift
+/// however long it runs. A frame which comes after its deadline is sent at
+/// once, and the catch-up policy decides what happens to the schedule:
+///
+/// - SKIP keeps the phase and gives up the periods which have passed.
+/// - BURST keeps the phase and the periods, so the following frames go out
+///   back-to-back until the schedule is caught up.
+/// - REBASE keeps the phase if the frame is less than half a period late,
+///   and otherwise starts a new schedule from the frame.
+class FrameSchedule
+{
+ public:
+    enum class CatchUp { SKIP, BURST, REBASE };
+
+    // Frames per second as a fraction; zero means the frames are not paced.
+    struct Rate
+    {
+        std::uint32_t   numerator;
+        std::uint32_t   denominator;
+    };
+
+    static constexpr int JITTER_BUCKETS = 16;
+
+    struct Stats
+    {
+        std::uint64_t   frames;
+        std::uint64_t   late_frames;        // came after their deadline
+        std::uint64_t   skipped_periods;    // given up by SKIP
+        std::uint64_t   rebases;            // new schedules started by REBASE
+        // [0] counts the frames sent within 1 usec of their deadline, and
+        // [i] those off by 2^(i-1) to 2^i usec; the last one has the rest.
+        std::uint64_t   jitter_histogram[JITTER_BUCKETS];
+    };
+
+    // `frequency` is the number of ticks per second.
+    FrameSchedule(std::uint64_t frequency, Rate rate, CatchUp policy = CatchUp::REBASE);
+
+    // The exact fraction of a framerate given as a float; NTSC rates such
+    // as 29.97 become n * 1000 / 1001.
+    static Rate     rateFromFramerate(float framerate);
+
+    Rate            rate() const { return m_rate; }
+    CatchUp         policy() const { return m_policy; }
+    void            setPolicy(CatchUp policy) { m_policy = policy; }
+    const Stats&    stats() const { return m_stats; }
+
+    // Returns when the frame which has come at `now` should be sent; it is
+    // `now` or earlier if the frame is due already.
+    std::uint64_t   schedule(std::uint64_t now);
+    // Tells when the last scheduled frame was actually sent.
+    void            sent(std::uint64_t now);
+    // The next frame starts a new schedule.
+    void            reset() { m_started = false; }
+
+ private:
+    std::uint64_t   m_frequency;
+    Rate            m_rate;
+    CatchUp         m_policy;
+    // The period is m_period_ticks + m_period_remainder / numerator ticks.
+    std::uint64_t   m_period_ticks = 0;
+    std::uint64_t   m_period_remainder = 0;
+    std::uint64_t   m_base = 0;
+    std::uint64_t   m_index = 0;
+    std::uint64_t   m_deadline = 0;
+    bool            m_started = false;
+    Stats           m_stats{};
+
+    std::uint64_t   deadline(std::uint64_t index) const;
+    std::uint64_t   lastIndexBefore(std::uint64_t now) const;
+};
+
+
+} //namespace softcam
@@ -0,0 +1,294 @@
+#include "FrameSlots.h"
+
+#include <type_traits>
+#include <algorithm>
+
+
+namespace softcam {
+
+// The control block is shared between processes, so the atomics must not
+// depend on any process-local lock.
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "64-bit atomics must be lock-free");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "32-bit atomics must be lock-free");
+static_assert(std::is_standard_layout<FrameSlots>::value, "FrameSlots must be standard layout");
+
+
+namespace {
+
+const std::uint64_t SlotMask = 0xff;
+const int FrameCounterShift = 8;
+
+} //namespace
+
+
+constexpr std::uint32_t FrameSlots::MIN_SLOT_COUNT;
+constexpr std::uint32_t FrameSlots::MAX_SLOT_COUNT;
+constexpr std::uint32_t FrameSlots::DEFAULT_SLOT_COUNT;
+constexpr int FrameSlots::MAX_CURSORS;
+constexpr std::size_t FrameSlots::CACHE_LINE_SIZE;
+constexpr std::uint32_t FrameSlots::ALL_ROWS;
+
+bool FrameSlots::checkSlotCount(std::uint32_t slot_count)
+{
+    return MIN_SLOT_COUNT <= slot_count && slot_count <= MAX_SLOT_COUNT;
+}
+
+std::uint32_t FrameSlots::packRows(std::uint32_t first_row, std::uint32_t end_row)
+{
+    return ((first_row & 0xffff) << 16) | (end_row & 0xffff);
+}
+
+void FrameSlots::unpackRows(
+                    std::uint32_t rows,
+                    std::uint32_t height,
+                    std::uint32_t* out_first_row,
+                    std::uint32_t* out_end_row)
+{
+    auto end_row = (std::min)(rows & 0xffff, height);
+    *out_first_row = (std::min)(rows >> 16, end_row);
+    *out_end_row = end_row;
+}
+
+void FrameSlots::init(std::uint32_t slot_count)
+{
+    m_slot_count = slot_count;
+    m_reserved = 0;
+    m_latest.store(0, std::memory_order_relaxed);
+    for (auto& slot : m_slot)
+    {
+        slot.m_sequence.store(0, std::memory_order_relaxed);
+        slot.m_dirty_rows.store(ALL_ROWS, std::memory_order_relaxed);
+        slot.m_frame_counter.store(0, std::memory_order_relaxed);
+        slot.m_timestamp.store(0, std::memory_order_relaxed);
+        slot.m_duration.store(0, std::memory_order_relaxed);
+    }
+    for (auto& cursor : m_cursor)
+    {
+        cursor.m_heartbeat.store(0, std::memory_order_relaxed);
+        cursor.m_frame_counter.store(0, std::memory_order_relaxed);
+        cursor.m_dropped_frames.store(0, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+std::uint32_t FrameSlots::beginWrite()
+{
+    auto latest = m_latest.load(std::memory_order_relaxed);
+    auto slot = (std::uint32_t)((latest & SlotMask) + 1) % m_slot_count;
+
+    // Make the sequence odd before touching the image so that readers
+    // which are still copying this slot notice the overwrite.
+    auto& sequence = m_slot[slot].m_sequence;
+    auto seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return slot;
+}
+
+void FrameSlots::endWrite(
+                    std::uint32_t slot,
+                    std::uint64_t frame_counter,
+                    std::uint64_t timestamp,
+                    std::uint32_t dirty_rows,
+                    std::uint64_t duration)
+{
+    m_slot[slot].m_frame_counter.store(frame_counter, std::memory_order_relaxed);
+    m_slot[slot].m_timestamp.store(timestamp, std::memory_order_relaxed);
+    m_slot[slot].m_duration.store(duration, std::memory_order_relaxed);
+    m_slot[slot].m_dirty_rows.store(dirty_rows, std::memory_order_relaxed);
+    m_slot[slot].m_sequence.fetch_add(1, std::memory_order_release);
+    m_latest.store(
+            (frame_counter << FrameCounterShift) | slot,
+            std::memory_order_release);
+}
+
+std::uint64_t FrameSlots::slowestCursorLag(std::uint64_t now, std::uint64_t timeout) const
+{
+    auto latest = latestFrameCounter();
+    std::uint64_t lag = 0;
+    for (auto& cursor : m_cursor)
+    {
+        auto heartbeat = cursor.m_heartbeat.load(std::memory_order_acquire);
+        if (heartbeat == 0 || (heartbeat < now && now - heartbeat > timeout))
+        {
+            continue;
+        }
+        auto frame_counter = cursor.m_frame_counter.load(std::memory_order_acquire);
+        if (frame_counter < latest)
+        {
+            lag = (std::max)(lag, latest - frame_counter);
+        }
+    }
+    return lag;
+}
+
+std::uint64_t FrameSlots::latestFrameCounter() const
+{
+    return m_latest.load(std::memory_order_acquire) >> FrameCounterShift;
+}
+
+std::uint32_t FrameSlots::latestSlot() const
+{
+    return (std::uint32_t)(m_latest.load(std::memory_order_acquire) & SlotMask);
+}
+
+bool FrameSlots::beginRead(ReadTicket* ticket) const
+{
+    auto latest = m_latest.load(std::memory_order_acquire);
+    auto slot = (std::uint32_t)(latest & SlotMask);
+    return beginReadFrame(slot, latest >> FrameCounterShift, ticket);
+}
+
+bool FrameSlots::beginReadNext(std::uint64_t last_frame_counter, ReadTicket* ticket) const
+{
+    // The frames which are still in the ring are the latest one and the
+    // preceding ones except the oldest slot, which the writer may be
+    // overwriting right now.
+    auto latest = m_latest.load(std::memory_order_acquire);
+    auto latest_frame = latest >> FrameCounterShift;
+    auto frame_counter = (std::min)(last_frame_counter + 1, latest_frame);
+    if (latest_frame >= m_slot_count - 2 &&
+        frame_counter < latest_frame - (m_slot_count - 2))
+    {
+        frame_counter = latest_frame - (m_slot_count - 2);
+    }
+    auto slot = (std::uint32_t)(frame_counter % m_slot_count);
+    return beginReadFrame(slot, frame_counter, ticket);
+}
+
+bool FrameSlots::beginReadFrame(
+                    std::uint32_t slot_index,
+                    std::uint64_t frame_counter,
+                    ReadTicket* ticket) const
+{
+    if (slot_index >= m_slot_count)
+    {
+        return false;
+    }
+    ticket->slot = slot_index;
+    auto& slot = m_slot[slot_index];
+    ticket->sequence = slot.m_sequence.load(std::memory_order_acquire);
+    if (ticket->sequence % 2 != 0)
+    {
+        return false;
+    }
+    // If the writer has already reused the slot for a newer frame, the
+    // ticket would not describe the image in the slot.
+    ticket->frame_counter = slot.m_frame_counter.load(std::memory_order_relaxed);
+    ticket->timestamp = slot.m_timestamp.load(std::memory_order_relaxed);
+    ticket->duration = slot.m_duration.load(std::memory_order_relaxed);
+    ticket->dirty_rows = slot.m_dirty_rows.load(std::memory_order_relaxed);
+    return ticket->frame_counter == frame_counter;
+}
+
+bool FrameSlots::endRead(const ReadTicket& ticket) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return m_slot[ticket.slot].m_sequence.load(std::memory_order_relaxed) == ticket.sequence;
+}
+
+// Gives the union of the rows changed in the frames after the base frame
+// up to the specified frame. This fails if the base frame is unknown (0)
+// or if any of the frames in between has already left the ring, in which
+// case the outputs are left untouched and the caller should take the whole
+// image.
+bool FrameSlots::changedRows(
+                    std::uint64_t base_frame_counter,
+                    std::uint64_t frame_counter,
+                    std::uint32_t height,
+                    std::uint32_t* out_first_row,
+                    std::uint32_t* out_end_row) const
+{
+    if (base_frame_counter == 0 || frame_counter < base_frame_counter ||
+        frame_counter - base_frame_counter > m_slot_count)
+    {
+        return false;
+    }
+    std::uint32_t first_row = height;
+    std::uint32_t end_row = 0;
+    for (auto i = base_frame_counter + 1; i <= frame_counter; i++)
+    {
+        ReadTicket ticket;
+        if (!beginReadFrame((std::uint32_t)(i % m_slot_count), i, &ticket) ||
+            !endRead(ticket))
+        {
+            return false;
+        }
+        std::uint32_t first, end;
+        unpackRows(ticket.dirty_rows, height, &first, &end);
+        if (first < end)
+        {
+            first_row = (std::min)(first_row, first);
+            end_row = (std::max)(end_row, end);
+        }
+    }
+    *out_first_row = (std::min)(first_row, end_row);
+    *out_end_row = end_row;
+    return true;
+}
+
+int FrameSlots::registerCursor(std::uint64_t now, std::uint64_t timeout)
+{
+    for (int i = 0; i < MAX_CURSORS; i++)
+    {
+        auto& cursor = m_cursor[i];
+        auto heartbeat = cursor.m_heartbeat.load(std::memory_order_acquire);
+        bool vacant = heartbeat == 0 || (heartbeat < now && now - heartbeat > timeout);
+        if (vacant && cursor.m_heartbeat.compare_exchange_strong(heartbeat, now))
+        {
+            cursor.m_frame_counter.store(latestFrameCounter(), std::memory_order_release);
+            cursor.m_dropped_frames.store(0, std::memory_order_relaxed);
+            return i;
+        }
+    }
+    return -1;
+}
+
+void FrameSlots::unregisterCursor(int cursor)
+{
+    if (0 <= cursor && cursor < MAX_CURSORS)
+    {
+        m_cursor[cursor].m_heartbeat.store(0, std::memory_order_release);
+    }
+}
+
+void FrameSlots::touchCursor(int cursor, std::uint64_t now)
+{
+    if (0 <= cursor && cursor < MAX_CURSORS)
+    {
+        m_cursor[cursor].m_heartbeat.store(now, std::memory_order_release);
+    }
+}
+
+void FrameSlots::advanceCursor(int cursor, std::uint64_t frame_counter, std::uint64_t dropped_frames)
+{
+    if (0 <= cursor && cursor < MAX_CURSORS)
+    {
+        m_cursor[cursor].m_frame_counter.store(frame_counter, std::memory_order_release);
+        if (0 < dropped_frames)
+        {
+            m_cursor[cursor].m_dropped_frames.fetch_add(dropped_frames, std::memory_order_relaxed);
+        }
+    }
+}
+
+std::uint64_t FrameSlots::cursorFrameCounter(int cursor) const
+{
+    if (0 <= cursor && cursor < MAX_CURSORS)
+    {
+        return m_cursor[cursor].m_frame_counter.load(std::memory_order_acquire);
+    }
+    return 0;
+}
+
+std::uint64_t FrameSlots::cursorDroppedFrames(int cursor) const
+{
+    if (0 <= cursor && cursor < MAX_CURSORS)
+    {
+        return m_cursor[cursor].m_dropped_frames.load(std::memory_order_relaxed);
+    }
+    return 0;
+}
+
+
+} //namespace softcam
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+
+namespace softcam {
+
+
+/// Lock-free ring of image slots shared between a writer and readers
+///
+/// This is a control block of a ring buffer which is placed in shared
+/// memory. A single writer fills the slot next to the latest published
+/// one and publishes it, so the writer never waits for readers.
+/// Frame N always goes to slot (N % slot count), and each slot remembers
+/// the frame counter, the timestamp and the duration of the frame it holds.
+/// The timestamp is the time of capture if the sender knows it.
+///
+/// Readers pick up a published slot without taking any lock, and detect
+/// an overwrite that happened during their copy by comparing the sequence
+/// counter of the slot before and after the copy (seqlock).
+/// A reader can either take the latest frame or the frame next to the one
+/// it has read last, as long as the frame is still in the ring.
+///
+/// Each slot also records the range of rows which have changed from the
+/// previous frame, so that a reader which still has an older frame can
+/// update only those rows, and the writer can bring a reused slot up to
+/// date by copying only the rows changed since the frame it holds.
+///
+/// Each reader may register a cursor which records the last frame it has
+/// consumed, so that the writer can see how far behind the slowest reader
+/// is. Cursors are kept alive by a heartbeat timestamp; a cursor whose
+/// owner has stopped beating is ignored and can be taken over.
+struct FrameSlots
+{
+    static constexpr std::uint32_t MIN_SLOT_COUNT = 3;
+    static constexpr std::uint32_t MAX_SLOT_COUNT = 16;
+    static constexpr std::uint32_t DEFAULT_SLOT_COUNT = 3;
+    static constexpr int MAX_CURSORS = 8;
+    static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+    // (first row << 16) | end row; the end row is clamped to the height
+    static constexpr std::uint32_t ALL_ROWS = 0x0000ffff;
+
+    struct ReadTicket
+    {
+        std::uint32_t   slot;
+        std::uint32_t   sequence;
+        std::uint64_t   frame_counter;
+        std::uint64_t   timestamp;
+        std::uint64_t   duration;
+        std::uint32_t   dirty_rows;
+    };
+
+    struct Slot
+    {
+        // odd while the writer is writing the slot
+        std::atomic<std::uint32_t>  m_sequence;
+        // rows changed from the previous frame
+        std::atomic<std::uint32_t>  m_dirty_rows;
+        std::atomic<std::uint64_t>  m_frame_counter;
+        std::atomic<std::uint64_t>  m_timestamp;
+        // 0 if unknown
+        std::atomic<std::uint64_t>  m_duration;
+    };
+
+    // Each cursor is written by a different reader, so it has a cache
+    // line of its own apart from the slots written by the writer.
+    struct alignas(CACHE_LINE_SIZE) Cursor
+    {
+        // 0 if the cursor is free
+        std::atomic<std::uint64_t>  m_heartbeat;
+        std::atomic<std::uint64_t>  m_frame_counter;
+        std::atomic<std::uint64_t>  m_dropped_frames;
+    };
+
+    static bool     checkSlotCount(std::uint32_t slot_count);
+    static std::uint32_t packRows(std::uint32_t first_row, std::uint32_t end_row);
+    static void     unpackRows(
+                        std::uint32_t rows,
+                        std::uint32_t height,
+                        std::uint32_t* out_first_row,
+                        std::uint32_t* out_end_row);
+
+    void            init(std::uint32_t slot_count = DEFAULT_SLOT_COUNT);
+    std::uint32_t   slotCount() const { return m_slot_count; }
+
+    // Writer side (only one writer is allowed)
+    std::uint32_t   beginWrite();
+    void            endWrite(
+                        std::uint32_t slot,
+                        std::uint64_t frame_counter,
+                        std::uint64_t timestamp = 0,
+                        std::uint32_t dirty_rows = ALL_ROWS,
+                        std::uint64_t duration = 0);
+    std::uint64_t   slowestCursorLag(std::uint64_t now, std::uint64_t timeout) const;
+
+    // Reader side
+    std::uint64_t   latestFrameCounter() const;
+    std::uint32_t   latestSlot() const;
+    bool            beginRead(ReadTicket* ticket) const;
+    bool            beginReadNext(std::uint64_t last_frame_counter, ReadTicket* ticket) const;
+    bool            endRead(const ReadTicket& ticket) const;
+    bool            changedRows(
+                        std::uint64_t base_frame_counter,
+                        std::uint64_t frame_counter,
+                        std::uint32_t height,
+                        std::uint32_t* out_first_row,
+                        std::uint32_t* out_end_row) const;
+
+    int             registerCursor(std::uint64_t now, std::uint64_t timeout);
+    void            unregisterCursor(int cursor);
+    void            touchCursor(int cursor, std::uint64_t now);
+    void            advanceCursor(int cursor, std::uint64_t frame_counter, std::uint64_t dropped_frames);
+    std::uint64_t   cursorFrameCounter(int cursor) const;
+    std::uint64_t   cursorDroppedFrames(int cursor) const;
+
+    std::uint32_t   m_slot_count;
+    std::uint32_t   m_reserved;
+    // (frame counter << 8) | slot index of the latest published slot
+    std::atomic<std::uint64_t>  m_latest;
+    Slot            m_slot[MAX_SLOT_COUNT];
+    Cursor          m_cursor[MAX_CURSORS];
+
+ private:
+    bool            beginReadFrame(std::uint32_t slot, std::uint64_t frame_counter, ReadTicket* ticket) const;
+};
+
+
+} //namespace softcam
@@ -1,19 +1,118 @@
 #include "Misc.h"
 
 #include <windows.h>
+#include "SleepCalibration.h"
 #include <cmath>
 #include <cassert>
+#include <climits>
+#include <algorithm>
+
+
+#ifndef FILE_MAP_LARGE_PAGES
+#define FILE_MAP_LARGE_PAGES    0x20000000
+#endif
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION   0x00000002
+#endif
 
 
 namespace softcam {
 
 
+namespace {
+
+bool enablePrivilege(const char* privilege_name)
+{
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+    {
+        return false;
+    }
+    TOKEN_PRIVILEGES privileges{};
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    // AdjustTokenPrivileges() succeeds even if the account doesn't have
+    // the privilege, which is told only by the last error.
+    bool ok = LookupPrivilegeValueA(nullptr, privilege_name, &privileges.Privileges[0].Luid) &&
+            AdjustTokenPrivileges(token, false, &privileges, 0, nullptr, nullptr) &&
+            GetLastError() == ERROR_SUCCESS;
+    CloseHandle(token);
+    return ok;
+}
+
+// A waitable timer for each thread which sleeps, so that sleeping doesn't
+// create kernel objects every time. A high resolution timer (Windows 10
+// 1803 or later) wakes up within a millisecond without raising the timer
+// resolution of the whole system. Otherwise the resolution is raised only
+// while sleeping.
+class ThreadTimer
+{
+ public:
+    ThreadTimer()
+    {
+        m_handle = CreateWaitableTimerExW(
+                        nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        m_high_resolution = m_handle != nullptr;
+        if (!m_handle)
+        {
+            m_handle = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+        }
+    }
+
+    ~ThreadTimer()
+    {
+        if (m_handle)
+        {
+            CloseHandle(m_handle);
+        }
+    }
+
+    // `delay` is in 100-nanosecond units.
+    void wait(std::uint64_t delay)
+    {
+        if (!m_high_resolution)
+        {
+            timeBeginPeriod(1);
+        }
+        LARGE_INTEGER due_time;
+        due_time.QuadPart = -(LONGLONG)delay;   // negative for relative time
+        if (m_handle && SetWaitableTimer(m_handle, &due_time, 0, nullptr, nullptr, false))
+        {
+            WaitForSingleObject(m_handle, INFINITE);
+        }
+        else
+        {
+            // fallback to older API
+            Sleep((DWORD)((delay + 9999) / 10000));
+        }
+        if (!m_high_resolution)
+        {
+            timeEndPeriod(1);
+        }
+    }
+
+ private:
+    HANDLE  m_handle = nullptr;
+    bool    m_high_resolution = false;
+};
+
+thread_local ThreadTimer        t_thread_timer;
+thread_local SleepCalibration   t_sleep_calibration(Timer::tickFrequency());
+
+} //namespace
+
+
 Timer::Timer()
 {
     QueryPerformanceCounter((LARGE_INTEGER*)&m_clock);
     QueryPerformanceFrequency((LARGE_INTEGER*)&m_frequency);
 }
 
+std::uint64_t Timer::tickAt(float elapsed) const
+{
+    return m_clock + (std::uint64_t)std::llround((double)elapsed * (double)m_frequency);
+}
+
 float Timer::get()
 {
     std::uint64_t now;
@@ -39,33 +138,55 @@ void Timer::sleep(float seconds)
     {
         return;
     }
-    unsigned delay_msec = (unsigned)std::round(seconds * 1000.0f);
-    if (delay_msec == 0)
+    auto delay = (std::uint64_t)std::llround((double)seconds * (double)TIMESTAMP_FREQUENCY);
+    t_thread_timer.wait(std::max<std::uint64_t>(delay, 1));
+}
+
+void Timer::sleepUntil(std::uint64_t tick)
+{
+    auto now = ticks();
+    auto margin = t_sleep_calibration.margin();
+    if (now + margin < tick)
     {
-        delay_msec = 1;
+        auto target = tick - margin;
+        t_thread_timer.wait((target - now) * TIMESTAMP_FREQUENCY / tickFrequency());
+        now = ticks();
+        t_sleep_calibration.update(target < now ? now - target : 0);
     }
-    HANDLE e = CreateEventA(nullptr, false, false, nullptr);
-    if (e == nullptr)
+    while (ticks() < tick)
     {
-        // fallback to older API
-        Sleep(delay_msec);
-        return;
-    }
-    MMRESULT ret = timeSetEvent(
-                    delay_msec,
-                    1,
-                    (LPTIMECALLBACK)e,
-                    0,
-                    TIME_ONESHOT | TIME_CALLBACK_EVENT_SET);
-    if (ret == 0)
-    {
-        // fallback to older API
-        CloseHandle(e);
-        Sleep(delay_msec);
-        return;
+        YieldProcessor();
     }
-    WaitForSingleObject(e, INFINITE);
-    CloseHandle(e);
+}
+
+std::uint64_t Timer::ticks()
+{
+    std::uint64_t now;
+    QueryPerformanceCounter((LARGE_INTEGER*)&now);
+    return now;
+}
+
+// The frequency is fixed at boot.
+std::uint64_t Timer::tickFrequency()
+{
+    static const std::uint64_t frequency = []
+    {
+        std::uint64_t value;
+        QueryPerformanceFrequency((LARGE_INTEGER*)&value);
+        return value;
+    }();
+    return frequency;
+}
+
+constexpr std::uint64_t Timer::TIMESTAMP_FREQUENCY;
+
+std::uint64_t Timer::timestamp()
+{
+    std::uint64_t now, frequency;
+    QueryPerformanceCounter((LARGE_INTEGER*)&now);
+    QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+    return now / frequency * TIMESTAMP_FREQUENCY +
+            now % frequency * TIMESTAMP_FREQUENCY / frequency;
 }
 
 
@@ -105,10 +226,76 @@ void NamedMutex::closeHandle(void* ptr)
     }
 }
 
+NamedEvent::NamedEvent(const char* name, State* state) :
+    m_handle(CreateSemaphoreA(nullptr, 0, LONG_MAX, name), closeHandle)
+{
+    if (m_handle)
+    {
+        m_state = state;
+    }
+}
+
+std::uint32_t NamedEvent::count() const
+{
+    return m_state ? m_state->m_count.load() : 0;
+}
+
+void NamedEvent::notify()
+{
+    if (!m_state) return;
+
+    // The waiters register themselves before checking the count, and we
+    // check the registrations after updating the count. So at least one of
+    // both sides sees the other.
+    m_state->m_count.fetch_add(1);
+    auto waiters = m_state->m_waiters.exchange(0);
+    if (0 < waiters)
+    {
+        ReleaseSemaphore(m_handle.get(), (LONG)(std::min)(waiters, (std::uint32_t)LONG_MAX), nullptr);
+    }
+}
+
+bool NamedEvent::wait(std::uint32_t last_count, float timeout)
+{
+    if (!m_state) return false;
+
+    // A registration which is not consumed by notify() (because we return
+    // early or time out) only causes a spurious wake-up of a later waiter.
+    m_state->m_waiters.fetch_add(1);
+    if (m_state->m_count.load() != last_count)
+    {
+        return true;
+    }
+    DWORD timeout_msec = INFINITE;
+    if (0.0f < timeout)
+    {
+        timeout_msec = (std::max)((DWORD)std::ceil(timeout * 1000.0f), (DWORD)1);
+    }
+    WaitForSingleObject(m_handle.get(), timeout_msec);
+    return m_state->m_count.load() != last_count;
+}
+
+void NamedEvent::initState(State* state)
+{
+    state->m_count = 0;
+    state->m_waiters = 0;
+}
+
+void NamedEvent::closeHandle(void* ptr)
+{
+    if (ptr)
+    {
+        bool ret = CloseHandle(ptr);
+
+        assert( ret == true && "CloseHandle() for a semaphore failed" );
+        (void)ret;
+    }
+}
+
 SharedMemory
-SharedMemory::create(const char* name, unsigned long size)
+SharedMemory::create(const char* name, unsigned long size, bool large_pages)
 {
-    return SharedMemory(name, size);
+    return SharedMemory(name, size, false, large_pages);
 }
 
 SharedMemory
@@ -117,20 +304,39 @@ SharedMemory::open(const char* name)
     return SharedMemory(name);
 }
 
-SharedMemory::SharedMemory(const char* name, unsigned long size)
+// A new shared memory is filled with zeros.
+SharedMemory
+SharedMemory::openOrCreate(const char* name, unsigned long size)
 {
+    return SharedMemory(name, size, true, false);
+}
+
+SharedMemory::SharedMemory(const char* name, unsigned long size, bool may_exist, bool large_pages)
+{
+    if (large_pages && !may_exist && createLargePages(name, size))
+    {
+        return;
+    }
     m_handle.reset(
         CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, size, name),
         closeHandle);
-    if (m_handle && GetLastError() != ERROR_ALREADY_EXISTS)
+    bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+    if (m_handle && (may_exist || !existed))
     {
         m_address.reset(
             MapViewOfFile(m_handle.get(), FILE_MAP_WRITE, 0, 0, 0),
             unmap);
         if (m_address)
         {
-            m_size = size;
-            return;
+            // An existing one might have been created smaller by someone else.
+            MEMORY_BASIC_INFORMATION meminfo;
+            if (!existed ||
+                (0 < VirtualQuery(m_address.get(), &meminfo, sizeof(meminfo)) &&
+                 size <= meminfo.RegionSize))
+            {
+                m_size = size;
+                return;
+            }
         }
     }
     release();
@@ -146,6 +352,14 @@ SharedMemory::SharedMemory(const char* name)
         m_address.reset(
             MapViewOfFile(m_handle.get(), FILE_MAP_WRITE, 0, 0, 0),
             unmap);
+        if (!m_address)
+        {
+            // Newer systems require the flag to map a large-page section.
+            m_address.reset(
+                MapViewOfFile(m_handle.get(), FILE_MAP_WRITE | FILE_MAP_LARGE_PAGES, 0, 0, 0),
+                unmap);
+            m_large_pages = (bool)m_address;
+        }
         if (m_address)
         {
             MEMORY_BASIC_INFORMATION meminfo;
@@ -163,10 +377,54 @@ void
 SharedMemory::release()
 {
     m_size = 0;
+    m_large_pages = false;
     m_address.reset();
     m_handle.reset();
 }
 
+// Creating a large-page section requires SeLockMemoryPrivilege, which the
+// account must have been granted, and the size must be a multiple of the
+// large page size. If anything is missing, nothing is left behind so that
+// the caller can fall back to normal pages with the same name.
+bool
+SharedMemory::createLargePages(const char* name, unsigned long size)
+{
+    SIZE_T page_size = GetLargePageMinimum();
+    if (page_size == 0 || !enablePrivilege("SeLockMemoryPrivilege"))
+    {
+        return false;
+    }
+    auto rounded = ((std::uint64_t)size + page_size - 1) / page_size * page_size;
+    m_handle.reset(
+        CreateFileMappingA(
+            INVALID_HANDLE_VALUE, nullptr,
+            PAGE_READWRITE | SEC_COMMIT | SEC_LARGE_PAGES,
+            (DWORD)(rounded >> 32), (DWORD)rounded,
+            name),
+        closeHandle);
+    if (m_handle && GetLastError() != ERROR_ALREADY_EXISTS)
+    {
+        m_address.reset(
+            MapViewOfFile(m_handle.get(), FILE_MAP_WRITE | FILE_MAP_LARGE_PAGES, 0, 0, (SIZE_T)rounded),
+            unmap);
+        if (!m_address)
+        {
+            // Older systems don't know the flag, but map it with large pages.
+            m_address.reset(
+                MapViewOfFile(m_handle.get(), FILE_MAP_WRITE, 0, 0, (SIZE_T)rounded),
+                unmap);
+        }
+        if (m_address)
+        {
+            m_size = size;
+            m_large_pages = true;
+            return true;
+        }
+    }
+    release();
+    return false;
+}
+
 void
 SharedMemory::closeHandle(void* ptr)
 {
@@ -2,10 +2,13 @@
 
 #include <memory>
 #include <cstdint>
+#include <atomic>
 
 
 namespace softcam {
 
+// Implemented with Win32 API in Misc.cpp and with POSIX API in MiscPosix.cpp.
+
 
 /// Time Measurement and Sleep
 class Timer
@@ -16,8 +19,23 @@ class Timer
     float   get();
     void    rewind(float delta);
     void    reset();
+    // The tick at which get() returns `elapsed`
+    std::uint64_t   tickAt(float elapsed) const;
 
+    // Waits in the kernel, which may wake up later by its timer resolution.
     static void     sleep(float seconds);
+    // Waits in the kernel until a little before `tick` and spins for the
+    // rest, so that it returns within microseconds after the deadline.
+    static void     sleepUntil(std::uint64_t tick);
+
+    // The monotonic clock on which the timers run, in tickFrequency() units
+    static std::uint64_t    ticks();
+    static std::uint64_t    tickFrequency();
+
+    // System-wide monotonic clock in 100-nanosecond units, which is
+    // comparable between processes.
+    static std::uint64_t    timestamp();
+    static constexpr std::uint64_t TIMESTAMP_FREQUENCY = 10000000;
 
  private:
     std::uint64_t   m_clock;
@@ -41,17 +59,57 @@ class NamedMutex
 };
 
 
+/// Inter-process Wake-up Event
+///
+/// `notify()` wakes up every thread and process blocked in `wait()`.
+/// The event count lives in shared memory provided by the caller, and
+/// `wait()` returns as soon as the count differs from the value the caller
+/// has seen, so a notification between checking a condition and waiting
+/// is never lost. Spurious wake-ups are possible.
+class NamedEvent
+{
+ public:
+    struct State
+    {
+        std::atomic<std::uint32_t>  m_count;
+        std::atomic<std::uint32_t>  m_waiters;
+    };
+
+    NamedEvent() {}
+    NamedEvent(const char* name, State* state);
+
+    explicit operator bool() const { return m_state != nullptr; }
+
+    std::uint32_t   count() const;
+    void            notify();
+    bool            wait(std::uint32_t last_count, float timeout = 0.0f);
+
+    static void     initState(State* state);
+
+ private:
+    std::shared_ptr<void>   m_handle;
+    State*                  m_state = nullptr;
+
+    static void closeHandle(void*);
+};
+
+
 /// Inter-process Shared Memory
 class SharedMemory
 {
  public:
     SharedMemory() {}
-    static SharedMemory create(const char* name, unsigned long size);
+    // With `large_pages`, the memory is backed by large pages if the
+    // system and the privileges of the process allow, otherwise by normal
+    // pages. largePages() tells which one has been granted.
+    static SharedMemory create(const char* name, unsigned long size, bool large_pages = false);
     static SharedMemory open(const char* name);
+    static SharedMemory openOrCreate(const char* name, unsigned long size);
 
     explicit operator bool() const { return get() != nullptr; }
 
     unsigned long   size() const { return m_size; }
+    bool            largePages() const { return m_large_pages; }
     void*           get() { return m_address.get(); }
     const void*     get() const { return m_address.get(); }
 
@@ -59,10 +117,12 @@ class SharedMemory
     std::shared_ptr<void>   m_handle;
     std::shared_ptr<void>   m_address;
     unsigned long           m_size = 0;
+    bool                    m_large_pages = false;
 
-    explicit SharedMemory(const char* name, unsigned long size);
+    explicit SharedMemory(const char* name, unsigned long size, bool may_exist, bool large_pages);
     explicit SharedMemory(const char* name);
     void    release();
+    bool    createLargePages(const char* name, unsigned long size);
 
     static void closeHandle(void*);
     static void unmap(void* ptr);
@@ -0,0 +1,666 @@
+#include "Misc.h"
+#include "SleepCalibration.h"
+
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#ifdef __linux__
+#include <sys/vfs.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <linux/magic.h>
+#endif
+#include <cmath>
+#include <cassert>
+#include <climits>
+#include <cstdio>
+#include <string>
+
+
+namespace softcam {
+
+
+namespace {
+
+constexpr std::uint64_t NANOSECONDS = 1000000000;
+
+#ifdef __linux__
+// Where hugetlbfs is mounted by default
+const char HugePagesDirectory[] = "/dev/hugepages";
+#endif
+
+std::uint64_t monotonicNanoseconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (std::uint64_t)ts.tv_sec * NANOSECONDS + (std::uint64_t)ts.tv_nsec;
+}
+
+timespec toTimespec(std::uint64_t nanoseconds)
+{
+    timespec ts;
+    ts.tv_sec = (time_t)(nanoseconds / NANOSECONDS);
+    ts.tv_nsec = (long)(nanoseconds % NANOSECONDS);
+    return ts;
+}
+
+void cpuRelax()
+{
+    #if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+    #elif defined(__aarch64__)
+    asm volatile("yield");
+    #endif
+}
+
+// Each thread learns how late the kernel wakes it up, which depends on
+// its timer slack (50 usec by default on Linux) as well as the system.
+thread_local SleepCalibration t_sleep_calibration(NANOSECONDS);
+
+// A named object of Windows is alive while any process has a handle to it,
+// whereas a file in the shared memory file system stays until it is
+// unlinked. To behave the same, every handle holds a shared lock on the
+// file, and whoever takes the exclusive lock knows that no other handle
+// exists; the last one unlinks the file, and a file left behind by a
+// crashed process is unlinked by the next one which finds it.
+struct SharedFile
+{
+    std::string path;
+    bool        huge_pages = false;
+    int         fd = -1;
+    void*       address = nullptr;
+    std::size_t length = 0;
+
+    ~SharedFile();
+};
+
+enum class Access { Create, Open, OpenOrCreate };
+
+// A Windows name may contain any character but backslash, while a POSIX
+// name is a single path component, so the other characters are escaped.
+// `kind` separates the namespaces of the different objects.
+bool makePath(const char* name, const char* kind, bool huge_pages, std::string* path)
+{
+    if (name == nullptr || *name == '\0')
+    {
+        return false;
+    }
+    std::string escaped;
+    for (const char* p = name; *p; p++)
+    {
+        unsigned char c = (unsigned char)*p;
+        if (c == '\\')
+        {
+            return false;
+        }
+        if (('0' <= c && c <= '9') || ('A' <= c && c <= 'Z') ||
+            ('a' <= c && c <= 'z') || c == '-' || c == '_' || c == '.')
+        {
+            escaped += (char)c;
+        }
+        else
+        {
+            char hex[4];
+            std::snprintf(hex, sizeof(hex), "%%%02X", c);
+            escaped += hex;
+        }
+    }
+    std::string component = std::string("softcam.") + kind + "." + escaped;
+    if (NAME_MAX < component.size())
+    {
+        return false;
+    }
+    #ifdef __linux__
+    *path = (huge_pages ? std::string(HugePagesDirectory) : std::string()) + "/" + component;
+    #else
+    if (huge_pages)
+    {
+        return false;
+    }
+    *path = "/" + component;
+    #endif
+    return true;
+}
+
+int openFile(const SharedFile& file, int flags)
+{
+    if (file.huge_pages)
+    {
+        return ::open(file.path.c_str(), flags | O_CLOEXEC, 0600);
+    }
+    return shm_open(file.path.c_str(), flags, 0600);
+}
+
+void unlinkFile(const SharedFile& file)
+{
+    if (file.huge_pages)
+    {
+        ::unlink(file.path.c_str());
+    }
+    else
+    {
+        shm_unlink(file.path.c_str());
+    }
+}
+
+// Whether the name still refers to the file we have opened
+bool isSameFile(const SharedFile& file)
+{
+    int fd = openFile(file, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat ours, theirs;
+    bool same = fstat(file.fd, &ours) == 0 && fstat(fd, &theirs) == 0 &&
+            ours.st_dev == theirs.st_dev && ours.st_ino == theirs.st_ino;
+    ::close(fd);
+    return same;
+}
+
+SharedFile::~SharedFile()
+{
+    if (address)
+    {
+        munmap(address, length);
+    }
+    if (0 <= fd)
+    {
+        if (flock(fd, LOCK_EX | LOCK_NB) == 0 && isSameFile(*this))
+        {
+            unlinkFile(*this);
+        }
+        ::close(fd);
+    }
+}
+
+// Opens the file with a shared lock held; `created` tells whether the
+// file is a new one, which is still empty.
+bool acquire(SharedFile* file, Access access, bool* created)
+{
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        if (access != Access::Open)
+        {
+            int fd = openFile(*file, O_RDWR | O_CREAT | O_EXCL);
+            if (0 <= fd)
+            {
+                flock(fd, LOCK_SH);
+                file->fd = fd;
+                *created = true;
+                return true;
+            }
+            if (errno != EEXIST)
+            {
+                return false;
+            }
+        }
+        int fd = openFile(*file, O_RDWR);
+        if (fd < 0)
+        {
+            if (errno == ENOENT && access != Access::Open)
+            {
+                continue;   // unlinked in the meantime
+            }
+            return false;
+        }
+        if (flock(fd, LOCK_EX | LOCK_NB) == 0)
+        {
+            // Nobody has it. Unless it is just being created (still empty),
+            // it has been left behind by a process which crashed.
+            struct stat st;
+            if (fstat(fd, &st) == 0 && 0 < st.st_size)
+            {
+                unlinkFile(*file);
+            }
+            ::close(fd);
+            if (access == Access::Open)
+            {
+                return false;
+            }
+            continue;
+        }
+        if (access == Access::Create || flock(fd, LOCK_SH | LOCK_NB) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        file->fd = fd;
+        if (!isSameFile(*file))
+        {
+            return false;
+        }
+        *created = false;
+        return true;
+    }
+    return false;
+}
+
+// Whether a file of the name is held by anyone
+bool isHeld(const char* name, const char* kind, bool huge_pages)
+{
+    SharedFile file;
+    file.huge_pages = huge_pages;
+    bool created;
+    return makePath(name, kind, huge_pages, &file.path) &&
+            acquire(&file, Access::Open, &created);
+}
+
+// Maps the whole file. A new file gets `size` (filled with zeros), while an
+// existing one has to be at least that large.
+bool mapFile(SharedFile* file, Access access, std::size_t size)
+{
+    bool created = false;
+    if (size == 0 || !acquire(file, access, &created))
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(file->fd, &st) != 0)
+    {
+        return false;
+    }
+    // An empty one is being created by someone else; whoever goes first
+    // gives the size.
+    if ((created || (st.st_size == 0 && access == Access::OpenOrCreate)) &&
+        ftruncate(file->fd, (off_t)size) == 0)
+    {
+        st.st_size = (off_t)size;
+    }
+    if (st.st_size == 0 || (std::size_t)st.st_size < size)
+    {
+        return false;
+    }
+    void* address = mmap(nullptr, (std::size_t)st.st_size,
+                        PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+    if (address == MAP_FAILED)
+    {
+        return false;
+    }
+    file->address = address;
+    file->length = (std::size_t)st.st_size;
+    return true;
+}
+
+
+// The mutex lives in a small shared file of its own.
+struct SharedMutex
+{
+    enum : std::uint32_t { UNINITIALIZED, INITIALIZING, READY };
+
+    std::atomic<std::uint32_t>  m_state;
+    pthread_mutex_t             m_mutex;
+};
+
+pthread_mutex_t* sharedMutex(void* handle)
+{
+    auto file = static_cast<SharedFile*>(handle);
+    return &static_cast<SharedMutex*>(file->address)->m_mutex;
+}
+
+} //namespace
+
+
+Timer::Timer() :
+    m_clock(monotonicNanoseconds()),
+    m_frequency(NANOSECONDS)
+{
+}
+
+std::uint64_t Timer::tickAt(float elapsed) const
+{
+    return m_clock + (std::uint64_t)std::llround((double)elapsed * (double)m_frequency);
+}
+
+float Timer::get()
+{
+    std::uint64_t now = monotonicNanoseconds();
+    float elapsed = (float)((double)int64_t(now - m_clock) / (double)m_frequency);
+    return elapsed;
+}
+
+void Timer::rewind(float delta)
+{
+    uint64_t delta_clock = (uint64_t)std::round(delta * (double)m_frequency);
+    m_clock += delta_clock;
+}
+
+void Timer::reset()
+{
+    m_clock = monotonicNanoseconds();
+}
+
+void Timer::sleep(float seconds)
+{
+    if (seconds <= 0.0f)
+    {
+        return;
+    }
+    auto delay = (std::uint64_t)std::llround((double)seconds * (double)NANOSECONDS);
+    timespec ts = toTimespec(delay);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+    {
+    }
+}
+
+// Waiting for an absolute time doesn't add up the delays of being woken
+// up and of being interrupted.
+void Timer::sleepUntil(std::uint64_t tick)
+{
+    auto now = monotonicNanoseconds();
+    auto margin = t_sleep_calibration.margin();
+    if (now + margin < tick)
+    {
+        auto target = tick - margin;
+        #ifdef TIMER_ABSTIME
+        timespec ts = toTimespec(target);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+        {
+        }
+        #else
+        sleep((float)((double)(target - now) / (double)NANOSECONDS));
+        #endif
+        now = monotonicNanoseconds();
+        t_sleep_calibration.update(target < now ? now - target : 0);
+    }
+    while (monotonicNanoseconds() < tick)
+    {
+        cpuRelax();
+    }
+}
+
+std::uint64_t Timer::ticks()
+{
+    return monotonicNanoseconds();
+}
+
+std::uint64_t Timer::tickFrequency()
+{
+    return NANOSECONDS;
+}
+
+constexpr std::uint64_t Timer::TIMESTAMP_FREQUENCY;
+
+// CLOCK_MONOTONIC is shared by all the processes of the system.
+std::uint64_t Timer::timestamp()
+{
+    return monotonicNanoseconds() / (NANOSECONDS / TIMESTAMP_FREQUENCY);
+}
+
+
+// Like the mutex of Windows, the mutex is recursive, and is given to the
+// next one if the owner dies with it locked.
+NamedMutex::NamedMutex(const char* name) :
+    m_handle(new SharedFile(), closeHandle)
+{
+    auto file = static_cast<SharedFile*>(m_handle.get());
+    if (!makePath(name, "mutex", false, &file->path) ||
+        !mapFile(file, Access::OpenOrCreate, sizeof(SharedMutex)))
+    {
+        m_handle.reset();
+    }
+    assert( m_handle.get() != nullptr && "Creating a named mutex failed" );
+    if (!m_handle)
+    {
+        return;
+    }
+
+    auto shared = static_cast<SharedMutex*>(file->address);
+    std::uint32_t expected = SharedMutex::UNINITIALIZED;
+    if (shared->m_state.compare_exchange_strong(expected, SharedMutex::INITIALIZING))
+    {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&shared->m_mutex, &attr);
+        pthread_mutexattr_destroy(&attr);
+        shared->m_state = SharedMutex::READY;
+    }
+    else
+    {
+        while (shared->m_state.load() != SharedMutex::READY)
+        {
+            sched_yield();
+        }
+    }
+}
+
+void NamedMutex::lock()
+{
+    auto mutex = sharedMutex(m_handle.get());
+    if (pthread_mutex_lock(mutex) == EOWNERDEAD)
+    {
+        // Windows tells the same as WAIT_ABANDONED, which we ignore too.
+        pthread_mutex_consistent(mutex);
+    }
+}
+
+void NamedMutex::unlock()
+{
+    int ret = pthread_mutex_unlock(sharedMutex(m_handle.get()));
+
+    assert( ret == 0 && "Tried to release a mutex that is not locked" );
+    (void)ret;
+}
+
+void NamedMutex::closeHandle(void* ptr)
+{
+    if (ptr)
+    {
+        #ifndef NDEBUG
+        // checks for the error of closing still owned mutex
+        if (static_cast<SharedFile*>(ptr)->address)
+        {
+            int ret = pthread_mutex_unlock(sharedMutex(ptr));
+            assert( ret != 0 && "Tried to delete a mutex that is locked" );
+        }
+        #endif
+
+        delete static_cast<SharedFile*>(ptr);
+    }
+}
+
+
+// The count itself is the futex word, so no named object is needed.
+// Elsewhere than Linux, the waiters poll the count.
+NamedEvent::NamedEvent(const char* /*name*/, State* state) :
+    m_state(state)
+{
+    static_assert(sizeof(state->m_count) == sizeof(std::uint32_t), "futex word must be 32-bit");
+}
+
+std::uint32_t NamedEvent::count() const
+{
+    return m_state ? m_state->m_count.load() : 0;
+}
+
+void NamedEvent::notify()
+{
+    if (!m_state) return;
+
+    // The waiters register themselves before checking the count, and we
+    // check the registrations after updating the count. So at least one of
+    // both sides sees the other.
+    m_state->m_count.fetch_add(1);
+    auto waiters = m_state->m_waiters.exchange(0);
+    if (0 < waiters)
+    {
+        #ifdef __linux__
+        syscall(SYS_futex, &m_state->m_count, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+        #endif
+    }
+}
+
+bool NamedEvent::wait(std::uint32_t last_count, float timeout)
+{
+    if (!m_state) return false;
+
+    // A registration which is not consumed by notify() (because we return
+    // early or time out) only causes a spurious wake-up of a later waiter.
+    m_state->m_waiters.fetch_add(1);
+    if (m_state->m_count.load() != last_count)
+    {
+        return true;
+    }
+    timespec ts{};
+    if (0.0f < timeout)
+    {
+        auto delay = (std::uint64_t)std::ceil((double)timeout * (double)NANOSECONDS);
+        ts.tv_sec = (time_t)(delay / NANOSECONDS);
+        ts.tv_nsec = (long)(delay % NANOSECONDS);
+    }
+    #ifdef __linux__
+    // The kernel checks the count again, so a notification after our check
+    // is not missed.
+    syscall(SYS_futex, &m_state->m_count, FUTEX_WAIT, last_count,
+            0.0f < timeout ? &ts : nullptr, nullptr, 0);
+    #else
+    Timer timer;
+    while (m_state->m_count.load() == last_count &&
+           (timeout <= 0.0f || timer.get() < timeout))
+    {
+        Timer::sleep(0.001f);
+    }
+    #endif
+    return m_state->m_count.load() != last_count;
+}
+
+void NamedEvent::initState(State* state)
+{
+    state->m_count = 0;
+    state->m_waiters = 0;
+}
+
+void NamedEvent::closeHandle(void*)
+{
+}
+
+
+SharedMemory
+SharedMemory::create(const char* name, unsigned long size, bool large_pages)
+{
+    return SharedMemory(name, size, false, large_pages);
+}
+
+SharedMemory
+SharedMemory::open(const char* name)
+{
+    return SharedMemory(name);
+}
+
+// A new shared memory is filled with zeros.
+SharedMemory
+SharedMemory::openOrCreate(const char* name, unsigned long size)
+{
+    return SharedMemory(name, size, true, false);
+}
+
+SharedMemory::SharedMemory(const char* name, unsigned long size, bool may_exist, bool large_pages)
+{
+    if (large_pages && !may_exist && createLargePages(name, size))
+    {
+        return;
+    }
+    auto file = new SharedFile();
+    m_handle.reset(file, closeHandle);
+    // Windows has a single namespace for both kinds of pages.
+    if (makePath(name, "shm", false, &file->path) &&
+        (may_exist || !isHeld(name, "shm", true)) &&
+        mapFile(file, may_exist ? Access::OpenOrCreate : Access::Create, size))
+    {
+        m_address = std::shared_ptr<void>(m_handle, file->address);
+        m_size = size;
+        return;
+    }
+    release();
+}
+
+SharedMemory::SharedMemory(const char* name)
+{
+    for (bool huge_pages : { false, true })
+    {
+        auto file = new SharedFile();
+        file->huge_pages = huge_pages;
+        m_handle.reset(file, closeHandle);
+        if (makePath(name, "shm", huge_pages, &file->path) &&
+            mapFile(file, Access::Open, 1))
+        {
+            m_address = std::shared_ptr<void>(m_handle, file->address);
+            m_size = (unsigned long)file->length;
+            m_large_pages = huge_pages;
+            return;
+        }
+    }
+    release();
+}
+
+void
+SharedMemory::release()
+{
+    m_size = 0;
+    m_large_pages = false;
+    m_address.reset();
+    m_handle.reset();
+}
+
+// MAP_HUGETLB works only for anonymous mappings, and a memfd can't be
+// opened by name from other processes, so the large pages come from a file
+// on hugetlbfs. The size must be a multiple of the huge page size, and
+// mapping fails if the pool doesn't have enough free pages, in which case
+// nothing is left behind so that the caller can fall back to normal pages.
+bool
+SharedMemory::createLargePages(const char* name, unsigned long size)
+{
+    #ifdef __linux__
+    struct statfs fs;
+    if (size == 0 ||
+        statfs(HugePagesDirectory, &fs) != 0 ||
+        (unsigned long)fs.f_type != (unsigned long)HUGETLBFS_MAGIC ||
+        fs.f_bsize <= 0)
+    {
+        return false;
+    }
+    auto page_size = (std::uint64_t)fs.f_bsize;
+    auto rounded = ((std::uint64_t)size + page_size - 1) / page_size * page_size;
+
+    auto file = new SharedFile();
+    file->huge_pages = true;
+    m_handle.reset(file, closeHandle);
+    if (makePath(name, "shm", true, &file->path) &&
+        !isHeld(name, "shm", false) &&
+        mapFile(file, Access::Create, (std::size_t)rounded))
+    {
+        m_address = std::shared_ptr<void>(m_handle, file->address);
+        m_size = size;
+        m_large_pages = true;
+        return true;
+    }
+    release();
+    #else
+    (void)name;
+    (void)size;
+    #endif
+    return false;
+}
+
+void
+SharedMemory::closeHandle(void* ptr)
+{
+    delete static_cast<SharedFile*>(ptr);
+}
+
+// The mapping is owned by the handle.
+void
+SharedMemory::unmap(void*)
+{
+}
+
+} //namespace softcam
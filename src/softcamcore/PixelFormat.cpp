@@ -0,0 +1,271 @@
+#include "PixelFormat.h"
+
+#include <cstring>
+
+
+namespace softcam {
+
+
+namespace {
+
+std::uint8_t clamp8(int value)
+{
+    return (std::uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+// BT.601 limited range, 8-bit fixed point
+void yuvToBGR(int y, int u, int v, std::uint8_t* bgr)
+{
+    int c = 298 * (y - 16) + 128;
+    int d = u - 128;
+    int e = v - 128;
+    bgr[0] = clamp8((c + 516 * d) >> 8);
+    bgr[1] = clamp8((c - 100 * d - 208 * e) >> 8);
+    bgr[2] = clamp8((c + 409 * e) >> 8);
+}
+
+} //namespace
+
+
+constexpr int ImageLayout::MAX_PLANES;
+
+bool isValidPixelFormat(std::uint32_t value)
+{
+    switch ((PixelFormat)value)
+    {
+    case PixelFormat::BGR24:
+    case PixelFormat::BGRA32:
+    case PixelFormat::NV12:
+    case PixelFormat::I420:
+    case PixelFormat::YUY2:
+        return true;
+    }
+    return false;
+}
+
+bool isPackedRGB(PixelFormat format)
+{
+    return format == PixelFormat::BGR24 || format == PixelFormat::BGRA32;
+}
+
+bool checkFormatDimensions(PixelFormat format, int width, int height)
+{
+    if (!isValidPixelFormat((std::uint32_t)format) || width < 1 || height < 1)
+    {
+        return false;
+    }
+    switch (format)
+    {
+    case PixelFormat::NV12:
+    case PixelFormat::I420:
+        return width % 2 == 0 && height % 2 == 0;
+    case PixelFormat::YUY2:
+        return width % 2 == 0;
+    default:
+        return true;
+    }
+}
+
+bool calcImageLayout(PixelFormat format, int width, int height, ImageLayout* out_layout)
+{
+    if (!checkFormatDimensions(format, width, height))
+    {
+        return false;
+    }
+    auto w = (std::uint64_t)width;
+    auto h = (std::uint64_t)height;
+    ImageLayout layout{};
+    layout.format = format;
+    layout.width = width;
+    layout.height = height;
+    std::uint64_t size = 0;
+    auto addPlane = [&](std::uint64_t stride, std::uint64_t rows)
+    {
+        auto& plane = layout.planes[layout.plane_count++];
+        plane.offset = (std::uint32_t)size;
+        plane.stride = (std::uint32_t)stride;
+        plane.rows = (std::uint32_t)rows;
+        size += stride * rows;
+    };
+    switch (format)
+    {
+    case PixelFormat::BGR24:
+        addPlane(w * 3, h);
+        break;
+    case PixelFormat::BGRA32:
+        addPlane(w * 4, h);
+        break;
+    case PixelFormat::NV12:
+        addPlane(w, h);
+        addPlane(w, h / 2);
+        break;
+    case PixelFormat::I420:
+        addPlane(w, h);
+        addPlane(w / 2, h / 2);
+        addPlane(w / 2, h / 2);
+        break;
+    case PixelFormat::YUY2:
+        addPlane(w * 2, h);
+        break;
+    }
+    if (size > UINT32_MAX)
+    {
+        return false;
+    }
+    layout.size = (std::uint32_t)size;
+    *out_layout = layout;
+    return true;
+}
+
+void copyImage(
+                    const ImageLayout&  layout,
+                    const void*         src,
+                    void*               dest,
+                    bool                bottom_up)
+{
+    if (!bottom_up || !isPackedRGB(layout.format))
+    {
+        std::memcpy(dest, src, layout.size);
+        return;
+    }
+    auto& plane = layout.planes[0];
+    auto s = static_cast<const std::uint8_t*>(src);
+    auto d = static_cast<std::uint8_t*>(dest);
+    for (std::uint32_t y = 0; y < plane.rows; y++)
+    {
+        std::memcpy(d + (std::size_t)plane.stride * (plane.rows - 1 - y),
+                    s + (std::size_t)plane.stride * y,
+                    plane.stride);
+    }
+}
+
+void copyImageRows(
+                    const ImageLayout&  layout,
+                    const void*         src,
+                    void*               dest,
+                    bool                bottom_up,
+                    int                 first_row,
+                    int                 end_row)
+{
+    if (first_row < 0 || end_row > layout.height || first_row >= end_row)
+    {
+        return;
+    }
+    auto s = static_cast<const std::uint8_t*>(src);
+    auto d = static_cast<std::uint8_t*>(dest);
+    if (bottom_up && isPackedRGB(layout.format))
+    {
+        auto& plane = layout.planes[0];
+        for (auto y = (std::uint32_t)first_row; y < (std::uint32_t)end_row; y++)
+        {
+            std::memcpy(d + (std::size_t)plane.stride * (plane.rows - 1 - y),
+                        s + (std::size_t)plane.stride * y,
+                        plane.stride);
+        }
+        return;
+    }
+    for (int i = 0; i < layout.plane_count; i++)
+    {
+        // Subsampled planes have fewer rows; round the range outward.
+        auto& plane = layout.planes[i];
+        auto h = (std::uint64_t)layout.height;
+        auto first = (std::size_t)((std::uint64_t)first_row * plane.rows / h);
+        auto end = (std::size_t)(((std::uint64_t)end_row * plane.rows + h - 1) / h);
+        auto offset = plane.offset + plane.stride * first;
+        std::memcpy(d + offset, s + offset, plane.stride * (end - first));
+    }
+}
+
+void convertToBGR24(
+                    const ImageLayout&  layout,
+                    const void*         src,
+                    void*               dest,
+                    int                 dest_stride,
+                    bool                bottom_up)
+{
+    if (layout.format == PixelFormat::BGR24 && !bottom_up &&
+        (std::uint32_t)dest_stride == layout.planes[0].stride)
+    {
+        std::memcpy(dest, src, layout.size);
+        return;
+    }
+    convertRowsToBGR24(layout, src, dest, dest_stride, bottom_up, 0, layout.height);
+}
+
+void convertRowsToBGR24(
+                    const ImageLayout&  layout,
+                    const void*         src,
+                    void*               dest,
+                    int                 dest_stride,
+                    bool                bottom_up,
+                    int                 first_row,
+                    int                 end_row)
+{
+    const int w = layout.width;
+    const int h = layout.height;
+    if (first_row < 0 || end_row > h)
+    {
+        return;
+    }
+    auto base = static_cast<const std::uint8_t*>(src);
+    auto plane = [&](int i, int row)
+    {
+        return base + layout.planes[i].offset + (std::size_t)layout.planes[i].stride * row;
+    };
+    for (int y = first_row; y < end_row; y++)
+    {
+        auto d = static_cast<std::uint8_t*>(dest) +
+                (std::size_t)dest_stride * (bottom_up ? h - 1 - y : y);
+        switch (layout.format)
+        {
+        case PixelFormat::BGR24:
+            std::memcpy(d, plane(0, y), (std::size_t)w * 3);
+            break;
+        case PixelFormat::BGRA32:
+        {
+            auto s = plane(0, y);
+            for (int x = 0; x < w; x++, s += 4, d += 3)
+            {
+                d[0] = s[0];
+                d[1] = s[1];
+                d[2] = s[2];
+            }
+            break;
+        }
+        case PixelFormat::NV12:
+        {
+            auto luma = plane(0, y);
+            auto chroma = plane(1, y / 2);
+            for (int x = 0; x < w; x++, d += 3)
+            {
+                yuvToBGR(luma[x], chroma[x & ~1], chroma[x | 1], d);
+            }
+            break;
+        }
+        case PixelFormat::I420:
+        {
+            auto luma = plane(0, y);
+            auto cb = plane(1, y / 2);
+            auto cr = plane(2, y / 2);
+            for (int x = 0; x < w; x++, d += 3)
+            {
+                yuvToBGR(luma[x], cb[x / 2], cr[x / 2], d);
+            }
+            break;
+        }
+        case PixelFormat::YUY2:
+        {
+            auto s = plane(0, y);
+            for (int x = 0; x < w; x += 2, s += 4, d += 6)
+            {
+                yuvToBGR(s[0], s[1], s[3], d);
+                yuvToBGR(s[2], s[1], s[3], d + 3);
+            }
+            break;
+        }
+        }
+    }
+}
+
+
+} //namespace softcam
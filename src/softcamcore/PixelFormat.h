@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+
+
+namespace softcam {
+
+
+/// Pixel formats of the images in the frame buffer
+///
+/// The numbers are stored in shared memory, so they must not be changed.
+enum class PixelFormat : std::uint32_t
+{
+    BGR24   = 0,    // packed B, G, R
+    BGRA32  = 1,    // packed B, G, R, A
+    NV12    = 2,    // Y plane, then interleaved U/V plane (2x2 subsampled)
+    I420    = 3,    // Y plane, U plane, V plane (2x2 subsampled)
+    YUY2    = 4,    // packed Y0, U, Y1, V (2x1 subsampled)
+};
+
+
+/// Memory layout of an image, whose planes are placed one after another
+/// from the top row to the bottom row without padding
+struct ImageLayout
+{
+    static constexpr int MAX_PLANES = 3;
+
+    struct Plane
+    {
+        std::uint32_t   offset;
+        std::uint32_t   stride;
+        std::uint32_t   rows;
+    };
+
+    PixelFormat     format;
+    int             width;
+    int             height;
+    int             plane_count;
+    Plane           planes[MAX_PLANES];
+    std::uint32_t   size;
+};
+
+
+bool            isValidPixelFormat(std::uint32_t value);
+bool            isPackedRGB(PixelFormat format);
+bool            checkFormatDimensions(PixelFormat format, int width, int height);
+bool            calcImageLayout(PixelFormat format, int width, int height, ImageLayout* out_layout);
+
+// Copies an image as it is, optionally turning it upside down.
+// Planar formats are never turned upside down.
+void            copyImage(
+                    const ImageLayout&  layout,
+                    const void*         src,
+                    void*               dest,
+                    bool                bottom_up);
+
+// Same as copyImage() but only for the source rows [first_row, end_row).
+// The rows of subsampled planes which cover those rows are copied.
+void            copyImageRows(
+                    const ImageLayout&  layout,
+                    const void*         src,
+                    void*               dest,
+                    bool                bottom_up,
+                    int                 first_row,
+                    int                 end_row);
+
+// Converts an image to BGR24 whose rows are `dest_stride` bytes apart.
+// YUV formats are interpreted as BT.601 limited range.
+void            convertToBGR24(
+                    const ImageLayout&  layout,
+                    const void*         src,
+                    void*               dest,
+                    int                 dest_stride,
+                    bool                bottom_up);
+
+// Same as convertToBGR24() but only for the source rows [first_row, end_row).
+void            convertRowsToBGR24(
+                    const ImageLayout&  layout,
+                    const void*         src,
+                    void*               dest,
+                    int                 dest_stride,
+                    bool                bottom_up,
+                    int                 first_row,
+                    int                 end_row);
+
+
+} //namespace softcam
@@ -1,8 +1,10 @@
 #include "SenderAPI.h"
 
 #include <atomic>
+#include <memory>
 
 #include "FrameBuffer.h"
+#include "FramePacer.h"
 #include "Misc.h"
 
 
@@ -11,10 +13,31 @@ namespace {
 struct Camera
 {
     softcam::FrameBuffer    m_frame_buffer;
-    softcam::Timer          m_timer;
+    softcam::FrameSchedule  m_schedule;
+    // Exists in the async modes; released before the frame buffer
+    std::unique_ptr<softcam::FramePacer>    m_pacer;
+    std::uint64_t           m_dropped = 0;  // by the pacers released so far
 };
 
-std::atomic<Camera*>    s_camera;
+// One camera for each instance; several instances can be used at once.
+std::atomic<Camera*>    s_cameras[softcam::CameraRegistry::MAX_INSTANCES];
+
+// The handle may be anything the application passes, so it's never
+// dereferenced before it's found here.
+bool IsValidCamera(Camera* target)
+{
+    if (target)
+    {
+        for (auto& camera : s_cameras)
+        {
+            if (camera.load() == target)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
 
 } //namespace
 
@@ -22,13 +45,32 @@ std::atomic<Camera*>    s_camera;
 namespace softcam {
 namespace sender {
 
-CameraHandle    CreateCamera(int width, int height, float framerate)
+CameraHandle    CreateCamera(
+                    int         width,
+                    int         height,
+                    float       framerate,
+                    PixelFormat format,
+                    bool        dib_layout,
+                    int         instance,
+                    const char* name,
+                    bool        large_pages)
 {
-    if (auto fb = FrameBuffer::create(width, height, framerate))
+    if (!CameraRegistry::checkInstance(instance))
     {
-        Camera* camera = new Camera{ fb, Timer() };
+        return nullptr;
+    }
+    auto slot_layout = dib_layout ?
+                    FrameBuffer::SlotLayout::DIB :
+                    FrameBuffer::SlotLayout::TOP_DOWN;
+    if (auto fb = FrameBuffer::create(
+                    width, height, framerate, FrameSlots::DEFAULT_SLOT_COUNT, format, slot_layout,
+                    instance, name, large_pages))
+    {
+        FrameSchedule schedule(
+                    Timer::tickFrequency(), FrameSchedule::rateFromFramerate(framerate));
+        Camera* camera = new Camera{ fb, schedule, nullptr };
         Camera* expected = nullptr;
-        if (s_camera.compare_exchange_strong(expected, camera))
+        if (s_cameras[instance].compare_exchange_strong(expected, camera))
         {
             return camera;
         }
@@ -40,62 +82,128 @@ CameraHandle    CreateCamera(int width, int height, float framerate)
 void            DeleteCamera(CameraHandle camera)
 {
     Camera* target = static_cast<Camera*>(camera);
-    if (target && s_camera.compare_exchange_strong(target, nullptr))
+    for (auto& slot : s_cameras)
     {
-        target->m_frame_buffer.deactivate();
-        delete target;
+        Camera* expected = target;
+        if (target && slot.compare_exchange_strong(expected, nullptr))
+        {
+            target->m_pacer.reset();
+            target->m_frame_buffer.deactivate();
+            delete target;
+            return;
+        }
     }
 }
 
+namespace {
+
+// To deliver frames in the regular period, we sleep here a bit
+// before we deliver the new frame if it's not the time yet.
+// If it's already the time, we deliver it immediately, and the
+// catch-up policy of the schedule decides the following deadlines
+// (by default the schedule starts over if the delay is greater
+// than 50 percent of the period).
+void            WaitForNextFrameTime(Camera* target)
+{
+    auto deadline = target->m_schedule.schedule(Timer::ticks());
+    Timer::sleepUntil(deadline);
+    target->m_schedule.sent(Timer::ticks());
+}
+
+} //namespace
+
 void            SendFrame(CameraHandle camera, const void* image_bits)
 {
     Camera* target = static_cast<Camera*>(camera);
-    if (target && s_camera.load() == target && image_bits)
-    {
-        auto framerate = target->m_frame_buffer.framerate();
-        auto frame_counter = target->m_frame_buffer.frameCounter();
-
-        // To deliver frames in the regular period, we sleep here a bit
-        // before we deliver the new frame if it's not the time yet.
-        // If it's already the time, we deliver it immediately and
-        // let the timer keep running so that if the next frame comes
-        // in time the constant delivery recovers.
-        // However if the delay grew too much (greater than 50 percent
-        // of the period), we reset the timer to avoid continuing
-        // irregular delivery.
-        if (0.0f < framerate)
+    if (IsValidCamera(target) && image_bits)
+    {
+        if (target->m_pacer)
         {
-            if (0 == frame_counter) // the first frame
-            {
-                target->m_timer.reset();
-            }
-            else
-            {
-                auto ref_delta = 1.0f / framerate;
-                auto time = target->m_timer.get();
-                if (time < ref_delta)
-                {
-                    Timer::sleep(ref_delta - time);
-                }
-                if (time < ref_delta * 1.5f)
-                {
-                    target->m_timer.rewind(ref_delta);
-                }
-                else
-                {
-                    target->m_timer.reset();
-                }
-            }
+            target->m_pacer->push(image_bits);
+            return;
         }
-
+        WaitForNextFrameTime(target);
         target->m_frame_buffer.write(image_bits);
     }
 }
 
+// The timestamp tells when the frame was captured, so the frame goes out
+// as soon as it comes without the timing control.
+void            SendFrameWithTimestamp(
+                    CameraHandle    camera,
+                    const void*     image_bits,
+                    std::uint64_t   timestamp,
+                    std::uint64_t   duration)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    if (IsValidCamera(target) && image_bits)
+    {
+        if (target->m_pacer)
+        {
+            target->m_pacer->push(image_bits, timestamp, duration);
+            return;
+        }
+        target->m_frame_buffer.write(image_bits, timestamp, duration);
+    }
+}
+
+// The staging buffers of the pacer hold whole images, so the regions are
+// sent only in the blocking mode.
+bool            SendFrameRegion(
+                    CameraHandle camera,
+                    const void* image_bits,
+                    int         x,
+                    int         y,
+                    int         width,
+                    int         height,
+                    int         stride)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    if (IsValidCamera(target) && image_bits && !target->m_pacer &&
+        target->m_frame_buffer.checkRegion(x, y, width, height, stride))
+    {
+        WaitForNextFrameTime(target);
+        return target->m_frame_buffer.writeRegion(image_bits, x, y, width, height, stride);
+    }
+    return false;
+}
+
+bool            LockFrame(CameraHandle camera, void** image_bits, int* stride)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    if (IsValidCamera(target) && image_bits)
+    {
+        void* bits = target->m_pacer ?
+                    target->m_pacer->lockFrame(stride) :
+                    target->m_frame_buffer.lockFrame(stride);
+        if (bits)
+        {
+            *image_bits = bits;
+            return true;
+        }
+    }
+    return false;
+}
+
+void            UnlockFrame(CameraHandle camera)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    if (IsValidCamera(target))
+    {
+        if (target->m_pacer)
+        {
+            target->m_pacer->unlockFrame();
+            return;
+        }
+        WaitForNextFrameTime(target);
+        target->m_frame_buffer.unlockFrame();
+    }
+}
+
 bool            WaitForConnection(CameraHandle camera, float timeout)
 {
     Camera* target = static_cast<Camera*>(camera);
-    if (target && s_camera.load() == target)
+    if (IsValidCamera(target))
     {
         Timer timer;
         while (!target->m_frame_buffer.connected())
@@ -114,12 +222,97 @@ bool            WaitForConnection(CameraHandle camera, float timeout)
 bool            IsConnected(CameraHandle camera)
 {
     Camera* target = static_cast<Camera*>(camera);
-    if (target && s_camera.load() == target)
+    if (IsValidCamera(target))
     {
         return target->m_frame_buffer.connected();
     }
     return false;
 }
 
+bool            UsesLargePages(CameraHandle camera)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    if (IsValidCamera(target))
+    {
+        return target->m_frame_buffer.largePages();
+    }
+    return false;
+}
+
+// The frames waiting in the old pacer are delivered before the mode
+// changes, so that none of them is lost or goes out of order.
+bool            SetSendMode(CameraHandle camera, SendMode mode)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    if (!IsValidCamera(target) ||
+        (mode != SendMode::BLOCKING &&
+         mode != SendMode::ASYNC_DROP_OLDEST &&
+         mode != SendMode::ASYNC_DROP_NEWEST))
+    {
+        return false;
+    }
+    if (target->m_pacer)
+    {
+        target->m_pacer->flush();
+        target->m_dropped += target->m_pacer->droppedFrames();
+        target->m_pacer.reset();
+    }
+    target->m_schedule.reset();
+    if (mode != SendMode::BLOCKING)
+    {
+        auto policy = mode == SendMode::ASYNC_DROP_OLDEST ?
+                    FramePacer::DropPolicy::DROP_OLDEST :
+                    FramePacer::DropPolicy::DROP_NEWEST;
+        target->m_pacer.reset(new FramePacer(
+                    &target->m_frame_buffer, policy,
+                    FramePacer::DEFAULT_QUEUE_DEPTH, target->m_schedule.policy()));
+    }
+    return true;
+}
+
+std::uint64_t   DroppedFrames(CameraHandle camera)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    if (IsValidCamera(target))
+    {
+        return target->m_dropped +
+                    (target->m_pacer ? target->m_pacer->droppedFrames() : 0);
+    }
+    return 0;
+}
+
+bool            SetCatchUpPolicy(CameraHandle camera, FrameSchedule::CatchUp policy)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    if (IsValidCamera(target) &&
+        (policy == FrameSchedule::CatchUp::SKIP ||
+         policy == FrameSchedule::CatchUp::BURST ||
+         policy == FrameSchedule::CatchUp::REBASE))
+    {
+        target->m_schedule.setPolicy(policy);
+        if (target->m_pacer)
+        {
+            target->m_pacer->setCatchUp(policy);
+        }
+        return true;
+    }
+    return false;
+}
+
+// In the async modes, the statistics are of the pacer thread, which is
+// created anew when the mode changes.
+bool            GetPacingStats(CameraHandle camera, FrameSchedule::Stats* stats)
+{
+    Camera* target = static_cast<Camera*>(camera);
+    if (IsValidCamera(target) && stats)
+    {
+        *stats = target->m_pacer ?
+                    target->m_pacer->pacingStats() :
+                    target->m_schedule.stats();
+        return true;
+    }
+    return false;
+}
+
 } //namespace sender
 } //namespace softcam
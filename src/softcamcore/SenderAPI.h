@@ -1,16 +1,55 @@
 #pragma once
 
+#include <cstdint>
+#include "PixelFormat.h"
+#include "CameraRegistry.h"
+#include "FrameSchedule.h"
 
 namespace softcam {
 namespace sender {
 
 using CameraHandle = void*;
 
-CameraHandle    CreateCamera(int width, int height, float framerate = 60.0f);
+enum class SendMode
+{
+    BLOCKING,           // the caller sleeps until the time of the frame
+    ASYNC_DROP_OLDEST,  // a pacer thread delivers; a waiting frame is replaced
+    ASYNC_DROP_NEWEST,  // a pacer thread delivers; a new frame is discarded
+};
+
+CameraHandle    CreateCamera(
+                    int         width,
+                    int         height,
+                    float       framerate = 60.0f,
+                    PixelFormat format = PixelFormat::BGR24,
+                    bool        dib_layout = false,
+                    int         instance = 0,
+                    const char* name = nullptr,
+                    bool        large_pages = false);
 void            DeleteCamera(CameraHandle camera);
 void            SendFrame(CameraHandle camera, const void* image_bits);
+void            SendFrameWithTimestamp(
+                    CameraHandle    camera,
+                    const void*     image_bits,
+                    std::uint64_t   timestamp,
+                    std::uint64_t   duration);
+bool            SendFrameRegion(
+                    CameraHandle camera,
+                    const void* image_bits,
+                    int         x,
+                    int         y,
+                    int         width,
+                    int         height,
+                    int         stride);
+bool            LockFrame(CameraHandle camera, void** image_bits, int* stride);
+void            UnlockFrame(CameraHandle camera);
 bool            WaitForConnection(CameraHandle camera, float timeout = 0.0f);
 bool            IsConnected(CameraHandle camera);
+bool            UsesLargePages(CameraHandle camera);
+bool            SetSendMode(CameraHandle camera, SendMode mode);
+std::uint64_t   DroppedFrames(CameraHandle camera);
+bool            SetCatchUpPolicy(CameraHandle camera, FrameSchedule::CatchUp policy);
+bool            GetPacingStats(CameraHandle camera, FrameSchedule::Stats* stats);
 
 } //namespace sender
 } //namespace softcam
@@ -0,0 +1,52 @@
+#include "SleepCalibration.h"
+
+
+namespace softcam {
+
+
+constexpr std::uint64_t SleepCalibration::INITIAL_MARGIN_US;
+constexpr std::uint64_t SleepCalibration::MIN_MARGIN_US;
+constexpr std::uint64_t SleepCalibration::MAX_MARGIN_US;
+constexpr int SleepCalibration::DECAY_SHIFT;
+
+
+namespace {
+
+std::uint64_t microsecondsToTicks(std::uint64_t us, std::uint64_t frequency)
+{
+    return us * frequency / 1000000;
+}
+
+} //namespace
+
+
+SleepCalibration::SleepCalibration(std::uint64_t frequency) :
+    m_min_margin(microsecondsToTicks(MIN_MARGIN_US, frequency)),
+    m_max_margin(microsecondsToTicks(MAX_MARGIN_US, frequency)),
+    m_margin(microsecondsToTicks(INITIAL_MARGIN_US, frequency))
+{
+}
+
+void SleepCalibration::update(std::uint64_t lateness)
+{
+    if (m_margin < lateness)
+    {
+        m_margin = lateness;
+    }
+    else
+    {
+        // Rounded up so that it reaches the lateness in the end
+        m_margin -= (m_margin - lateness + (1u << DECAY_SHIFT) - 1) >> DECAY_SHIFT;
+    }
+    if (m_margin < m_min_margin)
+    {
+        m_margin = m_min_margin;
+    }
+    if (m_max_margin < m_margin)
+    {
+        m_margin = m_max_margin;
+    }
+}
+
+
+} //namespace softcam
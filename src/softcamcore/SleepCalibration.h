@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+
+namespace softcam {
+
+
+/// Estimate of how late the kernel wakes up a sleeping thread
+///
+/// Timer::sleepUntil() asks the kernel to wake it up `margin()` before the
+/// deadline and spins for the rest. The margin jumps to a wake-up later
+/// than it and decays slowly otherwise, so that it covers the tail of the
+/// wake-up latency rather than the average, while the spinning shrinks on
+/// a system with a precise timer.
+class SleepCalibration
+{
+ public:
+    // Limits of the margin in microseconds
+    static constexpr std::uint64_t INITIAL_MARGIN_US = 500;
+    static constexpr std::uint64_t MIN_MARGIN_US = 20;
+    static constexpr std::uint64_t MAX_MARGIN_US = 2000;
+    // The margin moves by 1/(2^DECAY_SHIFT) of the difference every sleep
+    static constexpr int DECAY_SHIFT = 5;
+
+    // `frequency` is the number of clock ticks per second.
+    explicit SleepCalibration(std::uint64_t frequency);
+
+    std::uint64_t   margin() const { return m_margin; }
+    // `lateness` is how long after the requested time the kernel woke up.
+    void            update(std::uint64_t lateness);
+
+ private:
+    std::uint64_t   m_min_margin;
+    std::uint64_t   m_max_margin;
+    std::uint64_t   m_margin;
+};
+
+
+} //namespace softcam
@@ -0,0 +1,57 @@
+#include "StreamClock.h"
+
+
+namespace softcam {
+
+
+constexpr std::int64_t StreamClock::MAX_OFFSET_ERROR;
+constexpr int StreamClock::SMOOTHING_SHIFT;
+
+
+void StreamClock::reset(std::int64_t default_duration)
+{
+    m_default_duration = default_duration;
+    m_offset = 0;
+    m_last_start = 0;
+    m_started = false;
+}
+
+StreamClock::Sample StreamClock::map(
+                        std::uint64_t   timestamp,
+                        std::uint64_t   duration,
+                        std::int64_t    clock_now,
+                        std::uint64_t   timestamp_now,
+                        std::int64_t    stream_start)
+{
+    Sample sample{};
+    auto measured = clock_now - (std::int64_t)timestamp_now;
+    auto error = measured - m_offset;
+    if (!m_started || error < -MAX_OFFSET_ERROR || MAX_OFFSET_ERROR < error)
+    {
+        m_offset = measured;
+        sample.discontinuity = true;
+    }
+    else
+    {
+        // The division rounds towards zero, so a small error is ignored
+        // rather than making the offset oscillate.
+        m_offset += error / (1 << SMOOTHING_SHIFT);
+    }
+
+    auto start = (std::int64_t)timestamp + m_offset - stream_start;
+    if (m_started && start <= m_last_start)
+    {
+        start = m_last_start + 1;
+        sample.discontinuity = true;
+    }
+    auto length = 0 < duration ? (std::int64_t)duration : m_default_duration;
+    sample.start = start;
+    sample.stop = start + (0 < length ? length : 1);
+
+    m_last_start = start;
+    m_started = true;
+    return sample;
+}
+
+
+} //namespace softcam
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+
+namespace softcam {
+
+
+/// Mapping of the capture timestamps of frames onto the stream time
+///
+/// A frame is stamped by the sender with Timer::timestamp(), while a
+/// DirectShow graph runs on its own reference clock. Both are in
+/// 100-nanosecond units, but they have different origins and may drift
+/// apart. The caller reads both clocks at the same moment for every frame,
+/// and the offset between them follows the measurement slowly, so that
+/// the jitter of reading two clocks doesn't move the sample times while
+/// a drift is corrected within a few dozen frames.
+///
+/// The sample times never go backwards. The first sample, a jump of the
+/// offset and a timestamp older than the previous one are reported as a
+/// discontinuity.
+class StreamClock
+{
+ public:
+    struct Sample
+    {
+        std::int64_t    start;
+        std::int64_t    stop;
+        bool            discontinuity;
+    };
+
+    // An offset error beyond this is taken as a jump of either clock
+    static constexpr std::int64_t MAX_OFFSET_ERROR = 1000000;   // 100 msec
+    // The offset moves by 1/(2^SMOOTHING_SHIFT) of the error every frame
+    static constexpr int SMOOTHING_SHIFT = 4;
+
+    // `default_duration` is used for the frames without their own duration.
+    void            reset(std::int64_t default_duration);
+
+    // `clock_now` and `timestamp_now` are the reference clock and
+    // Timer::timestamp() read at the same moment, and `stream_start` is
+    // the reference time at which the stream time is zero.
+    Sample          map(
+                        std::uint64_t   timestamp,
+                        std::uint64_t   duration,
+                        std::int64_t    clock_now,
+                        std::uint64_t   timestamp_now,
+                        std::int64_t    stream_start);
+
+    std::int64_t    offset() const { return m_offset; }
+
+ private:
+    std::int64_t    m_default_duration = 0;
+    std::int64_t    m_offset = 0;
+    std::int64_t    m_last_start = 0;
+    bool            m_started = false;
+};
+
+
+} //namespace softcam
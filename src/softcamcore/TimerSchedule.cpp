@@ -0,0 +1,78 @@
+#include "TimerSchedule.h"
+
+#include <algorithm>
+#include <utility>
+
+
+namespace softcam {
+
+
+constexpr std::uint64_t TimerSchedule::NEVER;
+
+int TimerSchedule::add(std::uint64_t now, std::uint64_t interval, Callback callback)
+{
+    // Ids are never reused while the counter lasts, so a stale id can't
+    // remove another timer.
+    m_last_id = m_last_id == INT32_MAX ? 1 : m_last_id + 1;
+
+    Timer timer;
+    timer.m_id = m_last_id;
+    timer.m_interval = (std::max)(interval, (std::uint64_t)1);
+    timer.m_deadline = now + timer.m_interval;
+    timer.m_callback = std::make_shared<Callback>(std::move(callback));
+    m_timers.push_back(std::move(timer));
+    return m_last_id;
+}
+
+bool TimerSchedule::remove(int id)
+{
+    auto it = std::find_if(m_timers.begin(), m_timers.end(),
+                    [id](const Timer& timer) { return timer.m_id == id; });
+    if (it == m_timers.end())
+    {
+        return false;
+    }
+    m_timers.erase(it);
+    return true;
+}
+
+std::uint64_t TimerSchedule::nextDeadline() const
+{
+    std::uint64_t deadline = NEVER;
+    for (auto& timer : m_timers)
+    {
+        deadline = (std::min)(deadline, timer.m_deadline);
+    }
+    return deadline;
+}
+
+bool TimerSchedule::takeDue(std::uint64_t now, Due* out_due)
+{
+    auto it = earliest();
+    if (it == m_timers.end() || now < it->m_deadline)
+    {
+        return false;
+    }
+    it->m_deadline += it->m_interval;
+    if (it->m_deadline <= now)
+    {
+        it->m_deadline = now + it->m_interval;
+    }
+    out_due->id = it->m_id;
+    out_due->callback = it->m_callback;
+    return true;
+}
+
+// There are only a few timers in a process (two for each frame buffer),
+// so a linear scan is cheaper than keeping them sorted.
+std::vector<TimerSchedule::Timer>::iterator TimerSchedule::earliest()
+{
+    return std::min_element(m_timers.begin(), m_timers.end(),
+                    [](const Timer& a, const Timer& b)
+                    {
+                        return a.m_deadline < b.m_deadline;
+                    });
+}
+
+
+} //namespace softcam
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+namespace softcam {
+
+
+/// Schedule of periodic callbacks on an abstract clock
+///
+/// This only keeps the deadlines; the caller supplies the current time
+/// in arbitrary integer ticks and runs what is due. So a single thread
+/// can serve any number of periodic timers, and the logic can be tested
+/// with a fake clock.
+///
+/// Each timer is due every `interval` ticks from when it was added.
+/// A timer which has fallen behind by more than one interval skips the
+/// missed periods instead of running back-to-back to catch up.
+class TimerSchedule
+{
+ public:
+    using Callback = std::function<void()>;
+    static constexpr std::uint64_t NEVER = UINT64_MAX;
+
+    struct Due
+    {
+        int                         id;
+        std::shared_ptr<Callback>   callback;
+    };
+
+    // Returns a positive id of the new timer.
+    int             add(std::uint64_t now, std::uint64_t interval, Callback callback);
+    bool            remove(int id);
+    bool            empty() const { return m_timers.empty(); }
+    std::size_t     size() const { return m_timers.size(); }
+
+    // The earliest deadline, or NEVER if there are no timers.
+    std::uint64_t   nextDeadline() const;
+
+    // Takes the timer with the earliest deadline if it's due at `now`,
+    // and schedules its next period.
+    bool            takeDue(std::uint64_t now, Due* out_due);
+
+ private:
+    struct Timer
+    {
+        int                         m_id;
+        std::uint64_t               m_interval;
+        std::uint64_t               m_deadline;
+        std::shared_ptr<Callback>   m_callback;
+    };
+
+    std::vector<Timer>  m_timers;
+    int                 m_last_id = 0;
+
+    std::vector<Timer>::iterator    earliest();
+};
+
+
+} //namespace softcam
@@ -0,0 +1,166 @@
+#include "TimerService.h"
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cmath>
+#include "TimerSchedule.h"
+
+
+namespace softcam {
+
+
+namespace {
+
+std::mutex                  s_instance_mutex;
+std::weak_ptr<TimerService> s_instance;
+
+// Nanoseconds of the monotonic clock
+std::uint64_t now()
+{
+    return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} //namespace
+
+
+struct TimerService::State
+{
+    std::mutex              m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    TimerSchedule           m_schedule;
+    int                     m_running_id = 0;
+    bool                    m_quit = false;
+    std::thread::id         m_thread_id;
+
+    int     add(float interval, std::function<void()> callback);
+    void    remove(int id);
+    void    run();
+};
+
+
+int TimerService::State::add(float interval, std::function<void()> callback)
+{
+    auto ticks = (std::uint64_t)std::llround((double)interval * 1e9);
+    int id;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        id = m_schedule.add(now(), ticks, std::move(callback));
+    }
+    // The new deadline may be earlier than the one being waited for.
+    m_wake.notify_all();
+    return id;
+}
+
+void TimerService::State::remove(int id)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_schedule.remove(id);
+    if (m_thread_id != std::this_thread::get_id())
+    {
+        m_done.wait(lock, [&] { return m_running_id != id; });
+    }
+}
+
+void TimerService::State::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_thread_id = std::this_thread::get_id();
+    while (!m_quit)
+    {
+        auto t = now();
+        TimerSchedule::Due due;
+        if (m_schedule.takeDue(t, &due))
+        {
+            // The callback runs without the lock so that it can take as
+            // long as it needs, and can even release timers.
+            m_running_id = due.id;
+            lock.unlock();
+            (*due.callback)();
+            due.callback = {};
+            lock.lock();
+            m_running_id = 0;
+            m_done.notify_all();
+            continue;
+        }
+        auto deadline = m_schedule.nextDeadline();
+        if (deadline == TimerSchedule::NEVER)
+        {
+            m_wake.wait(lock);
+        }
+        else
+        {
+            m_wake.wait_for(lock, std::chrono::nanoseconds(deadline - t));
+        }
+    }
+}
+
+
+TimerService::Handle TimerService::schedule(float interval, std::function<void()> callback)
+{
+    auto service = get(true);
+    int id = service->m_state->add(interval, std::move(callback));
+
+    // The handle keeps the service alive while the timer exists.
+    return Handle(
+        service.get(),
+        [service, id](void*) mutable
+        {
+            service->m_state->remove(id);
+            service = {};
+        });
+}
+
+std::size_t TimerService::timerCount()
+{
+    auto service = get(false);
+    if (!service)
+    {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(service->m_state->m_mutex);
+    return service->m_state->m_schedule.size();
+}
+
+TimerService::TimerService() :
+    m_state(std::make_shared<State>())
+{
+    auto state = m_state;
+    m_thread = std::thread([state] { state->run(); });
+}
+
+TimerService::~TimerService()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_state->m_mutex);
+        m_state->m_quit = true;
+    }
+    m_state->m_wake.notify_all();
+    if (m_thread.get_id() == std::this_thread::get_id())
+    {
+        // The last handle has been released by a callback; the thread ends
+        // by itself as soon as the callback returns.
+        m_thread.detach();
+    }
+    else
+    {
+        m_thread.join();
+    }
+}
+
+std::shared_ptr<TimerService> TimerService::get(bool create)
+{
+    std::lock_guard<std::mutex> lock(s_instance_mutex);
+    auto service = s_instance.lock();
+    if (!service && create)
+    {
+        service = std::shared_ptr<TimerService>(new TimerService());
+        s_instance = service;
+    }
+    return service;
+}
+
+
+} //namespace softcam
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <functional>
+#include <thread>
+
+
+namespace softcam {
+
+
+/// Process-wide thread which runs periodic callbacks
+///
+/// All the timers in a process share one thread, which sleeps until the
+/// earliest deadline (see TimerSchedule). The thread is started by the
+/// first timer and ends when the last timer is released, so no thread is
+/// left running when the module is unloaded.
+class TimerService
+{
+ public:
+    using Handle = std::shared_ptr<void>;
+
+    // Calls `callback` every `interval` seconds on the service thread until
+    // the returned handle is released. Once the handle is released, the
+    // callback is never called again and is not running, unless the handle
+    // is released by the callback itself.
+    static Handle       schedule(float interval, std::function<void()> callback);
+
+    // The number of timers currently scheduled in this process.
+    static std::size_t  timerCount();
+
+    ~TimerService();
+
+ private:
+    struct State;
+
+    // The state is shared with the thread, which may outlive this object
+    // if the last handle is released by a callback.
+    std::shared_ptr<State>  m_state;
+    std::thread             m_thread;
+
+    TimerService();
+
+    static std::shared_ptr<TimerService> get(bool create);
+};
+
+
+} //namespace softcam
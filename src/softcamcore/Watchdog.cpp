@@ -1,39 +1,29 @@
 #include "Watchdog.h"
 
-#include <thread>
 #include <atomic>
-#include "Misc.h"
+#include <chrono>
+#include <mutex>
+#include "TimerService.h"
 
 
 namespace softcam {
 
+// The callbacks run on the thread of TimerService, which is shared by all
+// the watchdogs in the process. Releasing the timer handle waits for a
+// running callback, so a stopped watchdog never calls back afterwards.
+
 Watchdog Watchdog::createHeartbeat(
                             float                       interval,
                             std::function<void()>       increment)
 {
     struct Heartbeat
     {
-        std::atomic<bool>   m_quit = false;
-        std::atomic<bool>   m_alive = true; // dummy
-        std::thread         m_thread;
-        ~Heartbeat()
-        {
-            m_quit = true;
-            m_thread.join();
-        }
+        std::atomic<bool>       m_alive{true}; // dummy
+        TimerService::Handle    m_timer;
     };
 
     auto heartbeat = std::make_shared<Heartbeat>();
-    auto quit = &heartbeat->m_quit;
-
-    heartbeat->m_thread = std::thread([quit, interval, increment]
-    {
-        while (!quit->load())
-        {
-            Timer::sleep(interval);
-            increment();
-        }
-    });
+    heartbeat->m_timer = TimerService::schedule(interval, increment);
 
     std::shared_ptr<std::atomic<bool>> holder(heartbeat, &heartbeat->m_alive);
 
@@ -47,39 +37,37 @@ Watchdog Watchdog::createMonitor(
                             float                       timeout,
                             std::function<unsigned()>   read)
 {
+    using Clock = std::chrono::steady_clock;
+
     struct Monitor
     {
-        std::atomic<bool>   m_quit = false;
-        std::atomic<bool>   m_alive = true;
-        std::thread         m_thread;
-        ~Monitor()
-        {
-            m_quit = true;
-            m_thread.join();
-        }
+        std::atomic<bool>       m_alive{true};
+        unsigned                m_last_value = 0;
+        Clock::time_point       m_last_change;
+        // Released first, so the callback never sees the members destroyed.
+        TimerService::Handle    m_timer;
     };
 
     auto monitor = std::make_shared<Monitor>();
     auto ptr = monitor.get();
+    ptr->m_last_value = read();
+    ptr->m_last_change = Clock::now();
 
-    monitor->m_thread = std::thread([ptr, interval, timeout, read]
+    auto limit = std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<float>(timeout));
+    monitor->m_timer = TimerService::schedule(interval, [ptr, limit, read]
     {
-        unsigned last_value = read();
-        Timer timer;
-        while (!ptr->m_quit.load())
+        unsigned value = read();
+        auto now = Clock::now();
+        if (ptr->m_last_value != value)
         {
-            Timer::sleep(interval);
-            unsigned value = read();
-            if (last_value != value)
-            {
-                last_value = value;
-                ptr->m_alive = true;
-                timer.reset();
-            }
-            if (timeout < timer.get())
-            {
-                ptr->m_alive = false;
-            }
+            ptr->m_last_value = value;
+            ptr->m_alive = true;
+            ptr->m_last_change = now;
+        }
+        if (limit < now - ptr->m_last_change)
+        {
+            ptr->m_alive = false;
         }
     });
 
@@ -90,13 +78,61 @@ Watchdog Watchdog::createMonitor(
     return wd;
 }
 
+// Since the counter is looked at only on demand, a change seen after a
+// long pause proves only that the peer was alive at some point in the
+// pause. We give it the benefit of the doubt, and the following calls
+// detect its death within the timeout.
+Watchdog Watchdog::createLazyMonitor(
+                            float                       timeout,
+                            std::function<unsigned()>   read)
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Monitor
+    {
+        std::atomic<bool>       m_alive{true}; // dummy
+        std::mutex              m_mutex;
+        unsigned                m_last_value = 0;
+        Clock::time_point       m_last_change;
+    };
+
+    auto monitor = std::make_shared<Monitor>();
+    auto ptr = monitor.get();
+    ptr->m_last_value = read();
+    ptr->m_last_change = Clock::now();
+
+    auto limit = std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<float>(timeout));
+
+    Watchdog wd;
+    wd.m_flag_holder = std::shared_ptr<std::atomic<bool>>(monitor, &monitor->m_alive);
+    wd.m_check = [ptr, limit, read]
+    {
+        std::lock_guard<std::mutex> lock(ptr->m_mutex);
+        unsigned value = read();
+        auto now = Clock::now();
+        if (ptr->m_last_value != value)
+        {
+            ptr->m_last_value = value;
+            ptr->m_last_change = now;
+        }
+        return now - ptr->m_last_change <= limit;
+    };
+    return wd;
+}
+
 void Watchdog::stop()
 {
     m_flag_holder.reset();
+    m_check = {};
 }
 
 bool Watchdog::alive() const
 {
+    if (m_flag_holder && m_check)
+    {
+        return m_check();
+    }
     if (m_flag_holder)
     {
         std::atomic<bool> *flag = static_cast<std::atomic<bool>*>(m_flag_holder.get());
@@ -17,12 +17,18 @@ class Watchdog
                             float                       interval,
                             float                       timeout,
                             std::function<unsigned()>   read);
+    // Same as createMonitor() but without a timer; the counter is read and
+    // the timeout is evaluated only when alive() is called.
+    static Watchdog     createLazyMonitor(
+                            float                       timeout,
+                            std::function<unsigned()>   read);
 
     void    stop();
     bool    alive() const;
 
  private:
     std::shared_ptr<void>   m_flag_holder;
+    std::function<bool()>   m_check;
 };
 
 } //namespace softcam
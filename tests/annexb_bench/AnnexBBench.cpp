@@ -0,0 +1,142 @@
+// Times the Annex B scanning the MF source does for every pipe message
+// (start code search, NAL unit iteration and the SPS lookup), for
+// profiling off Windows:
+//
+//   annexb_bench [stream.h264] [--repeat N]
+//
+// Without a file it scans a synthetic 720p stream: an SPS, then slices of
+// random bytes between 2 and 64 KB. The start code search is timed with
+// both the scalar and the SSE2 kernel to compare them.
+
+#include <mf_source/AnnexB.h>
+#include <mf_source/H264ParameterSets.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace fm = FluxMic;
+
+namespace {
+
+// 1280x720 Constrained Baseline, one reference frame, 30 fps VUI timing
+const uint8_t kSps[] = {
+    0, 0, 0, 1, 0x67, 0x42, 0xC0, 0x1F, 0xDA, 0x01, 0x40, 0x16, 0xE8, 0x40, 0x00,
+    0x00, 0x03, 0x00, 0x40, 0x00, 0x00, 0x0F, 0x20, 0x80,
+};
+
+bool ReadFile(const char* path, std::vector<uint8_t>& data) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    uint8_t buffer[65536];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        data.insert(data.end(), buffer, buffer + read);
+    }
+    fclose(f);
+    return true;
+}
+
+// Slice payloads are random bytes with the start code emulations an
+// encoder would have escaped taken out
+std::vector<uint8_t> SyntheticStream(size_t pictures) {
+    std::mt19937 random(1);
+    std::vector<uint8_t> data(kSps, kSps + sizeof(kSps));
+    for (size_t i = 0; i < pictures; i++) {
+        data.insert(data.end(), { 0, 0, 0, 1, (uint8_t)(i == 0 ? 0x65 : 0x41) });
+        size_t size = 2048 + random() % (62 * 1024);
+        int zeros = 0;
+        for (size_t j = 0; j < size; j++) {
+            uint8_t byte = (uint8_t)(random() % 4 == 0 ? 0 : random());
+            if (zeros >= 2 && byte <= 3) byte = 0x80;
+            zeros = (byte == 0) ? zeros + 1 : 0;
+            data.push_back(byte);
+        }
+        if (zeros > 0) data.push_back(0x80);    // rbsp_trailing_bits
+    }
+    return data;
+}
+
+using Clock = std::chrono::steady_clock;
+
+double ElapsedUs(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+template <typename Find>
+void TimeSearch(const char* name, const std::vector<uint8_t>& data, int repeat, Find find) {
+    size_t found = 0;
+    Clock::time_point start = Clock::now();
+    for (int pass = 0; pass < repeat; pass++) {
+        for (size_t pos = find(data.data(), data.size(), 0); pos < data.size();
+             pos = find(data.data(), data.size(), pos + 3)) {
+            found++;
+        }
+    }
+    double us = ElapsedUs(start);
+    printf("%-24s %8.1f MB/s  (%zu start codes)\n", name, data.size() * (double)repeat / us,
+           found / repeat);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* input = nullptr;
+    int repeat = 20;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+            repeat = std::max(1, atoi(argv[++i]));
+        } else if (!input) {
+            input = argv[i];
+        }
+    }
+
+    std::vector<uint8_t> data;
+    if (input) {
+        if (!ReadFile(input, data)) {
+            fprintf(stderr, "cannot read %s\n", input);
+            return 1;
+        }
+    } else {
+        data = SyntheticStream(300);
+    }
+    printf("%s: %.1f MB x %d\n", input ? input : "synthetic stream", data.size() / 1e6, repeat);
+
+    TimeSearch("FindStartCodeScalar", data, repeat, fm::FindStartCodeScalar);
+    TimeSearch("FindStartCode", data, repeat, fm::FindStartCode);
+
+    // The iteration ScanAccessUnit() and the decoders do, over the whole buffer
+    uint64_t nals = 0;
+    Clock::time_point start = Clock::now();
+    for (int pass = 0; pass < repeat; pass++) {
+        fm::NalScanner scanner(data.data(), data.size());
+        fm::NalUnit nal;
+        while (scanner.Next(nal)) {
+            nals++;
+        }
+    }
+    double us = ElapsedUs(start);
+    printf("%-24s %8.1f MB/s  (%llu NAL units)\n", "NalScanner",
+           data.size() * (double)repeat / us, (unsigned long long)(nals / repeat));
+
+    fm::H264Sps sps;
+    const int lookups = 100000;
+    bool found = false;
+    start = Clock::now();
+    for (int i = 0; i < lookups; i++) {
+        found = fm::FindSps(data.data(), data.size(), sps);
+    }
+    us = ElapsedUs(start);
+    if (found) {
+        printf("%-24s %8.3f us     (%ux%u, profile %u level %u, %u ref frames, %.2f fps)\n", "FindSps",
+               us / lookups, sps.Width(), sps.Height(), sps.profileIdc, sps.levelIdc,
+               sps.maxNumRefFrames, sps.FrameRate());
+    } else {
+        printf("%-24s %8.3f us     (no SPS before the first slice)\n", "FindSps", us / lookups);
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include <softcamcore/CameraRegistry.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <cstring>
+
+
+namespace CameraRegistryTest {
+namespace sc = softcam;
+using sc::PixelFormat;
+
+const uint64_t TIMEOUT = 100;
+
+sc::CameraRegistry::Info makeInfo(int instance, int width, int height, const char* name)
+{
+    sc::CameraRegistry::Info info{};
+    info.instance = instance;
+    info.width = width;
+    info.height = height;
+    info.framerate = 30.0f;
+    info.format = PixelFormat::NV12;
+    std::strncpy(info.name, name, sc::CameraRegistry::MAX_NAME_LENGTH);
+    return info;
+}
+
+
+TEST(CameraRegistry, ZeroFilledTableIsEmpty) {
+    // as the system gives a new shared memory
+    sc::CameraRegistry registry{};
+
+    for (int i = 0; i < sc::CameraRegistry::MAX_INSTANCES; i++)
+    {
+        sc::CameraRegistry::Info info;
+        EXPECT_FALSE( registry.read(i, 1000, TIMEOUT, &info) );
+    }
+}
+
+TEST(CameraRegistry, CheckInstance) {
+    EXPECT_TRUE( sc::CameraRegistry::checkInstance(0) );
+    EXPECT_TRUE( sc::CameraRegistry::checkInstance(sc::CameraRegistry::MAX_INSTANCES - 1) );
+    EXPECT_FALSE( sc::CameraRegistry::checkInstance(-1) );
+    EXPECT_FALSE( sc::CameraRegistry::checkInstance(sc::CameraRegistry::MAX_INSTANCES) );
+}
+
+TEST(CameraRegistry, PublishAndRead) {
+    sc::CameraRegistry registry{};
+
+    registry.claim(1, 1000);
+    sc::CameraRegistry::Info info;
+    EXPECT_FALSE( registry.read(1, 1000, TIMEOUT, &info) );  // not published yet
+
+    registry.publish(makeInfo(1, 320, 240, "Slides"));
+    ASSERT_TRUE( registry.read(1, 1000, TIMEOUT, &info) );
+    EXPECT_EQ( info.instance, 1 );
+    EXPECT_EQ( info.width, 320 );
+    EXPECT_EQ( info.height, 240 );
+    EXPECT_EQ( info.framerate, 30.0f );
+    EXPECT_EQ( info.format, PixelFormat::NV12 );
+    EXPECT_STREQ( info.name, "Slides" );
+
+    EXPECT_FALSE( registry.read(0, 1000, TIMEOUT, &info) );
+    EXPECT_FALSE( registry.read(2, 1000, TIMEOUT, &info) );
+}
+
+TEST(CameraRegistry, ReleaseEmptiesEntry) {
+    sc::CameraRegistry registry{};
+
+    registry.claim(0, 1000);
+    registry.publish(makeInfo(0, 320, 240, "Main"));
+    registry.release(0);
+
+    sc::CameraRegistry::Info info;
+    EXPECT_FALSE( registry.read(0, 1000, TIMEOUT, &info) );
+
+    // Claimed again; the old description must not be visible.
+    registry.claim(0, 2000);
+    EXPECT_FALSE( registry.read(0, 2000, TIMEOUT, &info) );
+    registry.publish(makeInfo(0, 640, 480, "Main2"));
+    ASSERT_TRUE( registry.read(0, 2000, TIMEOUT, &info) );
+    EXPECT_EQ( info.width, 640 );
+    EXPECT_STREQ( info.name, "Main2" );
+}
+
+TEST(CameraRegistry, StaleEntryIsIgnored) {
+    sc::CameraRegistry registry{};
+
+    registry.claim(2, 1000);
+    registry.publish(makeInfo(2, 320, 240, "Feed"));
+
+    sc::CameraRegistry::Info info;
+    EXPECT_TRUE( registry.read(2, 1000 + TIMEOUT, TIMEOUT, &info) );
+    EXPECT_FALSE( registry.read(2, 1000 + TIMEOUT + 1, TIMEOUT, &info) );
+
+    registry.touch(2, 1200);
+    EXPECT_TRUE( registry.read(2, 1250, TIMEOUT, &info) );
+}
+
+TEST(CameraRegistry, LongNameIsTruncated) {
+    sc::CameraRegistry registry{};
+
+    auto src = makeInfo(3, 320, 240, "");
+    std::memset(src.name, 'x', sizeof(src.name));    // not terminated
+    registry.claim(3, 1000);
+    registry.publish(src);
+
+    sc::CameraRegistry::Info info;
+    ASSERT_TRUE( registry.read(3, 1000, TIMEOUT, &info) );
+    EXPECT_EQ( std::strlen(info.name), (size_t)sc::CameraRegistry::MAX_NAME_LENGTH );
+}
+
+TEST(CameraRegistry, ReadersNeverSeeTornEntries) {
+    sc::CameraRegistry registry{};
+    registry.claim(0, 1000);
+    registry.publish(makeInfo(0, 1, 1, "1"));
+
+    std::atomic<bool> stop{false};
+    std::atomic<int> failures{0};
+    std::thread reader([&]
+    {
+        while (!stop)
+        {
+            sc::CameraRegistry::Info info;
+            if (registry.read(0, 1000, TIMEOUT, &info))
+            {
+                // The fields are always written together.
+                if (info.width != info.height || info.name[0] - '0' != info.width % 10)
+                {
+                    failures++;
+                }
+            }
+        }
+    });
+    for (int i = 1; i <= 100000; i++)
+    {
+        char name[2] = { (char)('0' + i % 10), '\0' };
+        registry.publish(makeInfo(0, i % 1000, i % 1000, name));
+    }
+    stop = true;
+    reader.join();
+    EXPECT_EQ( failures, 0 );
+}
+
+} //namespace CameraRegistryTest
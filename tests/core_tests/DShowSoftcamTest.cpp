@@ -129,6 +129,26 @@ TEST_F(Softcam, AttributesNormal)
     EXPECT_EQ( m_softcam->framerate(), 60.0f );
 }
 
+TEST_F(Softcam, AttributesOtherInstance)
+{
+    auto fb0 = createFrameBufer(320, 240, 60);
+    auto fb2 = std::make_unique<sc::FrameBuffer>(sc::FrameBuffer::create(
+                    640, 480, 30, 3, sc::PixelFormat::BGR24, sc::FrameBuffer::SlotLayout::TOP_DOWN, 2));
+
+    HRESULT hr = 555;
+    m_softcam = (sc::Softcam*)sc::Softcam::CreateInstance(nullptr, SOME_GUID, &hr, 2);
+    ASSERT_NE( m_softcam, nullptr );
+    m_softcam->AddRef();
+
+    EXPECT_EQ( m_softcam->instance(), 2 );
+    EXPECT_EQ( m_softcam->valid(), true );
+    EXPECT_EQ( m_softcam->width(), 640 );
+    EXPECT_EQ( m_softcam->height(), 480 );
+    EXPECT_EQ( m_softcam->framerate(), 30.0f );
+    ASSERT_NE( m_softcam->getFrameBuffer(), nullptr );
+    EXPECT_EQ( m_softcam->getFrameBuffer()->instance(), 2 );
+}
+
 TEST_F(Softcam, AttributesDeactivatedServer)
 {
     auto fb = createFrameBufer(320, 240, 60);
@@ -372,6 +392,50 @@ TEST_F(Softcam, IAMStreamConfigNormal)
     pmt = nullptr;
 }
 
+TEST_F(Softcam, IAMStreamConfigNativeFormat)
+{
+    auto fb = std::make_unique<sc::FrameBuffer>(sc::FrameBuffer::create(
+                    320, 240, 60, sc::FrameSlots::DEFAULT_SLOT_COUNT, sc::PixelFormat::NV12));
+
+    HRESULT hr = 555;
+    m_softcam = (sc::Softcam*)sc::Softcam::CreateInstance(nullptr, SOME_GUID, &hr);
+    ASSERT_NE( m_softcam, nullptr );
+    m_softcam->AddRef();
+    EXPECT_EQ( m_softcam->format(), sc::PixelFormat::NV12 );
+
+    IAMStreamConfig *amsc = m_softcam;
+    int count = 55, size = 77;
+    hr = amsc->GetNumberOfCapabilities(&count, &size);
+    EXPECT_EQ( hr, S_OK );
+    EXPECT_EQ( count, 2 );
+
+    // The native format comes first.
+    std::unique_ptr<BYTE[]> scc(new BYTE[(std::max)((int)sizeof(VIDEO_STREAM_CONFIG_CAPS), size)]);
+    AM_MEDIA_TYPE *pmt = nullptr;
+    hr = amsc->GetStreamCaps(0, &pmt, scc.get());
+    EXPECT_EQ( hr, S_OK );
+    ASSERT_NE( pmt, nullptr );
+    EXPECT_EQ( pmt->subtype, (GUID)FOURCCMap(MAKEFOURCC('N','V','1','2')) );
+    EXPECT_EQ( pmt->lSampleSize, 320 * 240 * 3 / 2u );
+    VIDEOINFOHEADER* pFormat = (VIDEOINFOHEADER*)pmt->pbFormat;
+    EXPECT_EQ( pFormat->bmiHeader.biBitCount, 12 );
+    EXPECT_EQ( pFormat->bmiHeader.biCompression, (DWORD)MAKEFOURCC('N','V','1','2') );
+    EXPECT_EQ( amsc->SetFormat(pmt), S_OK );
+    DeleteMediaType(pmt);
+
+    // RGB24 is offered for applications which need conversion.
+    pmt = nullptr;
+    hr = amsc->GetStreamCaps(1, &pmt, scc.get());
+    EXPECT_EQ( hr, S_OK );
+    checkMediaType320x240( pmt );
+    EXPECT_EQ( amsc->SetFormat(pmt), S_OK );
+    DeleteMediaType(pmt);
+
+    pmt = nullptr;
+    hr = amsc->GetStreamCaps(2, &pmt, scc.get());
+    EXPECT_EQ( hr, S_FALSE );
+}
+
 TEST_F(Softcam, IBaseFilterEnumPins)
 {
     HRESULT hr = 555;
@@ -921,6 +985,33 @@ TEST_F(SoftcamStream, CSourceStreamGetMediaTypeNormal)
     checkMediaType320x240(&mt);
 }
 
+TEST_F(SoftcamStream, CSourceStreamGetMediaTypeByPosition)
+{
+    auto fb = std::make_unique<sc::FrameBuffer>(sc::FrameBuffer::create(
+                    320, 240, 60, sc::FrameSlots::DEFAULT_SLOT_COUNT, sc::PixelFormat::YUY2));
+    SetUpSoftcamStream();
+    ASSERT_NE( m_stream, nullptr );
+    HRESULT hr;
+
+    CMediaType mt0, mt1, mt2;
+    hr = m_stream->GetMediaType(0, &mt0);
+    EXPECT_EQ( hr, NOERROR );
+    EXPECT_EQ( *mt0.Subtype(), (GUID)FOURCCMap(MAKEFOURCC('Y','U','Y','2')) );
+    EXPECT_EQ( mt0.GetSampleSize(), 320 * 240 * 2u );
+
+    hr = m_stream->GetMediaType(1, &mt1);
+    EXPECT_EQ( hr, NOERROR );
+    checkMediaType320x240(&mt1);
+
+    hr = m_stream->GetMediaType(2, &mt2);
+    EXPECT_EQ( hr, VFW_S_NO_MORE_ITEMS );
+
+    EXPECT_EQ( m_stream->CheckMediaType(&mt0), NOERROR );
+    EXPECT_EQ( m_stream->CheckMediaType(&mt1), NOERROR );
+    mt1.SetSubtype(&MEDIASUBTYPE_RGB32);
+    EXPECT_NE( m_stream->CheckMediaType(&mt1), NOERROR );
+}
+
 TEST_F(SoftcamStream, getFrameBuffer_must_not_lock_the_filter_state)
 {
     auto fb = createFrameBufer(320, 240, 60);
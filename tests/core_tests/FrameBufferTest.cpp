@@ -4,6 +4,11 @@
 #include <vector>
 #include <atomic>
 #include <thread>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <softcamcore/TimerService.h>
 
 
 namespace FrameBufferTest {
@@ -80,6 +85,14 @@ TEST(FrameBuffer, InvalidArgs) {
         auto fb = sc::FrameBuffer::create(320, 240, -60);
         EXPECT_FALSE( fb );
         EXPECT_EQ( fb.handle(), nullptr );
+    }{
+        auto fb = sc::FrameBuffer::create(320, 240, 60, 2);
+        EXPECT_FALSE( fb );
+        EXPECT_EQ( fb.handle(), nullptr );
+    }{
+        auto fb = sc::FrameBuffer::create(320, 240, 60, 17);
+        EXPECT_FALSE( fb );
+        EXPECT_EQ( fb.handle(), nullptr );
     }
 }
 
@@ -92,9 +105,443 @@ TEST(FrameBuffer, TooLarge) {
         auto fb = sc::FrameBuffer::create(320, 24000);
         EXPECT_FALSE( fb );
         EXPECT_EQ( fb.handle(), nullptr );
+    }{
+        // The whole ring wouldn't fit in 4GB.
+        auto fb = sc::FrameBuffer::create(16384, 16384, 60, 16);
+        EXPECT_FALSE( fb );
+        EXPECT_EQ( fb.handle(), nullptr );
+    }
+}
+
+TEST(FrameBuffer, PixelFormat) {
+    {
+        auto fb = sc::FrameBuffer::create(320, 240, 60);
+        EXPECT_EQ( fb.format(), sc::PixelFormat::BGR24 );
+    }{
+        auto fb = sc::FrameBuffer::create(320, 240, 60, 3, sc::PixelFormat::NV12);
+        ASSERT_TRUE( fb );
+        EXPECT_EQ( fb.format(), sc::PixelFormat::NV12 );
+        auto receiver = sc::FrameBuffer::open();
+        EXPECT_EQ( receiver.format(), sc::PixelFormat::NV12 );
+
+        sc::ImageLayout layout;
+        ASSERT_TRUE( receiver.imageLayout(&layout) );
+        EXPECT_EQ( layout.plane_count, 2 );
+        EXPECT_EQ( layout.size, 320u * 240 * 3 / 2 );
+
+        int stride = 0;
+        EXPECT_NE( fb.lockFrame(&stride), nullptr );
+        EXPECT_EQ( stride, 320 );
+    }{
+        auto fb = sc::FrameBuffer::create(320, 240, 60, 3, (sc::PixelFormat)99);
+        EXPECT_FALSE( fb );
+    }
+}
+
+TEST(FrameBuffer, WriteNativeAndConvert) {
+    auto fb = sc::FrameBuffer::create(320, 240, 60, 3, sc::PixelFormat::BGRA32);
+    auto receiver = sc::FrameBuffer::open();
+
+    std::vector<uint8_t> src(320 * 240 * 4);
+    for (std::size_t i = 0; i < src.size(); i++)
+    {
+        src[i] = (uint8_t)(i / 4 / 320);    // the row number in every channel
+    }
+    fb.write(src.data());
+
+    // Native: bottom-up BGRA
+    std::vector<uint8_t> native(320 * 240 * 4);
+    uint64_t frame_counter = 0;
+    receiver.transferNative(native.data(), &frame_counter);
+    EXPECT_EQ( frame_counter, 1u );
+    EXPECT_EQ( native[0], 239 );
+    EXPECT_EQ( native[native.size() - 1], 0 );
+
+    // Converted: bottom-up BGR24
+    std::vector<uint8_t> dib(320 * 240 * 3);
+    receiver.transferToDIB(dib.data(), &frame_counter);
+    EXPECT_EQ( dib[0], 239 );
+    EXPECT_EQ( dib[dib.size() - 1], 0 );
+}
+
+TEST(FrameBuffer, DIBLayoutGivesTheSameImages) {
+    const int W = 320, H = 240;
+    std::vector<uint8_t> src(W * H * 3);
+    for (std::size_t i = 0; i < src.size(); i++)
+    {
+        src[i] = (uint8_t)(i * 7 + i / (W * 3));
+    }
+
+    std::vector<uint8_t> expected(W * H * 3);
+    uint64_t frame_counter = 0;
+    {
+        auto fb = sc::FrameBuffer::create(W, H, 60);
+        auto receiver = sc::FrameBuffer::open();
+        EXPECT_EQ( fb.slotLayout(), sc::FrameBuffer::SlotLayout::TOP_DOWN );
+        fb.write(src.data());
+        receiver.transferToDIB(expected.data(), &frame_counter);
+    }
+    {
+        auto fb = sc::FrameBuffer::create(
+                    W, H, 60, 3, sc::PixelFormat::BGR24, sc::FrameBuffer::SlotLayout::DIB);
+        auto receiver = sc::FrameBuffer::open();
+        EXPECT_EQ( fb.slotLayout(), sc::FrameBuffer::SlotLayout::DIB );
+        EXPECT_EQ( receiver.slotLayout(), sc::FrameBuffer::SlotLayout::DIB );
+        fb.write(src.data());
+
+        std::vector<uint8_t> dib(W * H * 3);
+        receiver.transferToDIB(dib.data(), &frame_counter);
+        EXPECT_EQ( dib, expected );
+        std::vector<uint8_t> native(W * H * 3);
+        receiver.transferNative(native.data(), &frame_counter);
+        EXPECT_EQ( native, expected );
+    }
+}
+
+TEST(FrameBuffer, DIBLayoutLockFrameGivesNegativeStride) {
+    const int W = 320, H = 240;
+    auto fb = sc::FrameBuffer::create(
+                    W, H, 60, 3, sc::PixelFormat::BGRA32, sc::FrameBuffer::SlotLayout::DIB);
+    auto receiver = sc::FrameBuffer::open();
+
+    int stride = 0;
+    auto top = static_cast<uint8_t*>(fb.lockFrame(&stride));
+    ASSERT_NE( top, nullptr );
+    EXPECT_EQ( stride, -W * 4 );
+    for (int y = 0; y < H; y++)
+    {
+        std::memset(top + (std::ptrdiff_t)stride * y, y, W * 4);
+    }
+    fb.unlockFrame();
+
+    // Native: bottom-up BGRA
+    std::vector<uint8_t> native(W * H * 4);
+    uint64_t frame_counter = 0;
+    receiver.transferNative(native.data(), &frame_counter);
+    EXPECT_EQ( native[0], H - 1 );
+    EXPECT_EQ( native[native.size() - 1], 0 );
+}
+
+TEST(FrameBuffer, DIBLayoutKeepsYUVTopDown) {
+    auto fb = sc::FrameBuffer::create(
+                    320, 240, 60, 3, sc::PixelFormat::NV12, sc::FrameBuffer::SlotLayout::DIB);
+    auto receiver = sc::FrameBuffer::open();
+
+    int stride = 0;
+    EXPECT_NE( fb.lockFrame(&stride), nullptr );
+    EXPECT_EQ( stride, 320 );
+    fb.unlockFrame();
+}
+
+TEST(FrameBuffer, WriteRegion) {
+    const int W = 320, H = 240;
+    for (auto slot_layout : { sc::FrameBuffer::SlotLayout::TOP_DOWN, sc::FrameBuffer::SlotLayout::DIB })
+    {
+        auto fb = sc::FrameBuffer::create(W, H, 60, 3, sc::PixelFormat::BGR24, slot_layout);
+        auto receiver = sc::FrameBuffer::open();
+
+        std::vector<uint8_t> image(W * H * 3);
+        for (std::size_t i = 0; i < image.size(); i++)
+        {
+            image[i] = (uint8_t)(i % 251);
+        }
+        fb.write(image.data());
+
+        // Enough regions to go around the ring
+        for (int i = 0; i < 5; i++)
+        {
+            const int x = 8 * i, y = 10 * i, w = 16, h = 20;
+            std::vector<uint8_t> region(w * 3 * h, (uint8_t)(200 + i));
+            EXPECT_TRUE( fb.writeRegion(region.data(), x, y, w, h, w * 3) );
+            for (int row = y; row < y + h; row++)
+            {
+                std::memset(&image[(row * W + x) * 3], 200 + i, w * 3);
+            }
+        }
+        EXPECT_EQ( fb.frameCounter(), 6u );
+
+        std::vector<uint8_t> actual(W * H * 3);
+        std::vector<uint8_t> expected(W * H * 3);
+        uint64_t frame_counter = 0;
+        receiver.transferToDIB(actual.data(), &frame_counter);
+        fb.write(image.data());
+        receiver.transferToDIB(expected.data(), &frame_counter);
+        EXPECT_EQ( actual, expected );
+    }
+}
+
+TEST(FrameBuffer, WriteRegionInvalidArgs) {
+    std::vector<uint8_t> region(64 * 64 * 4);
+    {
+        auto fb = sc::FrameBuffer::create(320, 240, 60);
+        EXPECT_FALSE( fb.writeRegion(nullptr, 0, 0, 16, 16, 48) );
+        EXPECT_FALSE( fb.writeRegion(region.data(), -1, 0, 16, 16, 48) );
+        EXPECT_FALSE( fb.writeRegion(region.data(), 0, 0, 0, 16, 48) );
+        EXPECT_FALSE( fb.writeRegion(region.data(), 310, 0, 16, 16, 48) );
+        EXPECT_FALSE( fb.writeRegion(region.data(), 0, 230, 16, 16, 48) );
+        EXPECT_FALSE( fb.writeRegion(region.data(), 0, 0, 16, 16, 47) );
+        EXPECT_TRUE( fb.writeRegion(region.data(), 304, 224, 16, 16, 48) );
+        EXPECT_EQ( fb.frameCounter(), 1u );
+    }{
+        auto fb = sc::FrameBuffer::create(320, 240, 60, 3, sc::PixelFormat::YUY2);
+        EXPECT_FALSE( fb.writeRegion(region.data(), 1, 0, 16, 16, 32) );
+        EXPECT_FALSE( fb.writeRegion(region.data(), 0, 0, 15, 16, 32) );
+        EXPECT_TRUE( fb.writeRegion(region.data(), 2, 0, 16, 16, 32) );
+    }{
+        auto fb = sc::FrameBuffer::create(320, 240, 60, 3, sc::PixelFormat::NV12);
+        EXPECT_FALSE( fb.writeRegion(region.data(), 0, 0, 16, 16, 16) );
+    }
+}
+
+TEST(FrameBuffer, UpdateDIBCopiesOnlyChangedRows) {
+    const int W = 320, H = 240;
+    auto fb = sc::FrameBuffer::create(W, H, 60);
+    auto receiver = sc::FrameBuffer::open();
+
+    std::vector<uint8_t> image(W * H * 3, 1);
+    fb.write(image.data());
+    std::vector<uint8_t> dib(W * H * 3);
+    uint64_t frame_counter = 0;
+    receiver.updateDIB(dib.data(), &frame_counter);
+    EXPECT_EQ( frame_counter, 1u );
+    EXPECT_EQ( dib[0], 1 );
+
+    // Rows other than the changed ones must not be touched.
+    std::vector<uint8_t> region(16 * 3 * 10, 2);
+    EXPECT_TRUE( fb.writeRegion(region.data(), 0, 100, 16, 10, 16 * 3) );
+    std::fill(dib.begin(), dib.end(), 0);
+    receiver.updateDIB(dib.data(), &frame_counter);
+    EXPECT_EQ( frame_counter, 2u );
+    auto dibRow = [&](int y) { return &dib[(H - 1 - y) * W * 3]; };
+    EXPECT_EQ( dibRow(99)[0], 0 );
+    EXPECT_EQ( dibRow(100)[0], 2 );
+    EXPECT_EQ( dibRow(100)[16 * 3], 1 );
+    EXPECT_EQ( dibRow(109)[0], 2 );
+    EXPECT_EQ( dibRow(110)[0], 0 );
+
+    // Nothing to copy if the frame is the same.
+    std::fill(dib.begin(), dib.end(), 0);
+    receiver.updateDIB(dib.data(), &frame_counter);
+    EXPECT_EQ( frame_counter, 2u );
+    EXPECT_EQ( dibRow(100)[0], 0 );
+
+    // Everything is copied if the frame is unknown.
+    frame_counter = 0;
+    receiver.updateDIB(dib.data(), &frame_counter);
+    EXPECT_EQ( dibRow(0)[0], 1 );
+    EXPECT_EQ( dibRow(100)[0], 2 );
+}
+
+TEST(FrameBuffer, DISABLED_BenchmarkTransferToDIB) {
+    struct Size { int width, height; };
+    for (auto size : { Size{1280, 720}, Size{1920, 1080}, Size{3840, 2160} })
+    {
+        for (auto slot_layout : { sc::FrameBuffer::SlotLayout::TOP_DOWN, sc::FrameBuffer::SlotLayout::DIB })
+        {
+            const int W = size.width, H = size.height;
+            const int COUNT = 100;
+            auto fb = sc::FrameBuffer::create(W, H, 0, 3, sc::PixelFormat::BGR24, slot_layout);
+            auto receiver = sc::FrameBuffer::open();
+            std::vector<uint8_t> src(W * H * 3, 128);
+            std::vector<uint8_t> dest(W * H * 3);
+
+            uint64_t frame_counter = 0;
+            std::chrono::nanoseconds write_time{}, transfer_time{};
+            for (int i = 0; i < COUNT; i++)
+            {
+                auto t0 = std::chrono::steady_clock::now();
+                fb.write(src.data());
+                auto t1 = std::chrono::steady_clock::now();
+                receiver.transferToDIB(dest.data(), &frame_counter);
+                auto t2 = std::chrono::steady_clock::now();
+                write_time += t1 - t0;
+                transfer_time += t2 - t1;
+            }
+            std::printf("%4dx%-4d %-8s write %8.1f us, transferToDIB %8.1f us\n",
+                    W, H,
+                    slot_layout == sc::FrameBuffer::SlotLayout::DIB ? "DIB" : "TOP_DOWN",
+                    write_time.count() / 1000.0 / COUNT,
+                    transfer_time.count() / 1000.0 / COUNT);
+        }
+    }
+}
+
+TEST(FrameBuffer, LargePagesFallBackGracefully) {
+    // Whether large pages are granted depends on the account, but the
+    // frame buffer works either way and both sides agree on the mode.
+    auto fb = sc::FrameBuffer::create(
+                    1920, 1080, 60, 3, sc::PixelFormat::BGR24, sc::FrameBuffer::SlotLayout::TOP_DOWN,
+                    0, nullptr, true);
+    ASSERT_TRUE( fb );
+    auto receiver = sc::FrameBuffer::open();
+    ASSERT_TRUE( receiver );
+    EXPECT_EQ( receiver.largePages(), fb.largePages() );
+
+    std::vector<uint8_t> image(1920 * 1080 * 3, 77);
+    std::vector<uint8_t> dest(1920 * 1080 * 3, 0);
+    uint64_t frame_counter = 0;
+    fb.write(image.data());
+    receiver.transferToDIB(dest.data(), &frame_counter);
+    EXPECT_EQ( frame_counter, 1u );
+    EXPECT_EQ( dest, image );
+}
+
+TEST(FrameBuffer, NormalPagesByDefault) {
+    auto fb = sc::FrameBuffer::create(320, 240, 60);
+    EXPECT_FALSE( fb.largePages() );
+    EXPECT_FALSE( sc::FrameBuffer::open().largePages() );
+}
+
+// Shows the copy throughput with and without large pages. Large pages
+// need the "Lock pages in memory" privilege; the mode granted is printed.
+TEST(FrameBuffer, DISABLED_BenchmarkLargePages) {
+    struct Size { int width, height; };
+    for (auto size : { Size{1920, 1080}, Size{3840, 2160} })
+    {
+        for (bool large_pages : { false, true })
+        {
+            const int W = size.width, H = size.height;
+            const int COUNT = 200;
+            auto fb = sc::FrameBuffer::create(
+                    W, H, 0, 3, sc::PixelFormat::BGR24, sc::FrameBuffer::SlotLayout::DIB,
+                    0, nullptr, large_pages);
+            auto receiver = sc::FrameBuffer::open();
+            std::vector<uint8_t> src(W * H * 3, 128);
+            std::vector<uint8_t> dest(W * H * 3);
+
+            uint64_t frame_counter = 0;
+            std::chrono::nanoseconds write_time{}, transfer_time{};
+            for (int i = 0; i < COUNT; i++)
+            {
+                auto t0 = std::chrono::steady_clock::now();
+                fb.write(src.data());
+                auto t1 = std::chrono::steady_clock::now();
+                receiver.transferToDIB(dest.data(), &frame_counter);
+                auto t2 = std::chrono::steady_clock::now();
+                write_time += t1 - t0;
+                transfer_time += t2 - t1;
+            }
+            double bytes = (double)W * H * 3 * COUNT;
+            std::printf("%4dx%-4d %-13s write %6.2f GB/s, transferToDIB %6.2f GB/s\n",
+                    W, H,
+                    !large_pages ? "normal pages" :
+                    fb.largePages() ? "large pages" : "(not granted)",
+                    bytes / write_time.count(),
+                    bytes / transfer_time.count());
+        }
+    }
+}
+
+TEST(FrameBuffer, SlotCount) {
+    {
+        auto fb = sc::FrameBuffer::create(320, 240, 60);
+        EXPECT_EQ( fb.slotCount(), (int)sc::FrameSlots::DEFAULT_SLOT_COUNT );
+    }{
+        auto fb = sc::FrameBuffer::create(320, 240, 60, 8);
+        EXPECT_EQ( fb.slotCount(), 8 );
+        auto receiver = sc::FrameBuffer::open();
+        EXPECT_EQ( receiver.slotCount(), 8 );
     }
 }
 
+TEST(FrameBuffer, MultipleInstances) {
+    auto main = sc::FrameBuffer::create(
+                    320, 240, 60, 3, sc::PixelFormat::BGR24, sc::FrameBuffer::SlotLayout::TOP_DOWN, 0);
+    auto slides = sc::FrameBuffer::create(
+                    640, 480, 30, 3, sc::PixelFormat::BGR24, sc::FrameBuffer::SlotLayout::TOP_DOWN, 1);
+    ASSERT_TRUE( main );
+    ASSERT_TRUE( slides );
+    EXPECT_EQ( main.instance(), 0 );
+    EXPECT_EQ( slides.instance(), 1 );
+
+    auto receiver0 = sc::FrameBuffer::open();
+    auto receiver1 = sc::FrameBuffer::open(1);
+    auto receiver2 = sc::FrameBuffer::open(2);
+    EXPECT_TRUE( receiver0 );
+    EXPECT_TRUE( receiver1 );
+    EXPECT_FALSE( receiver2 );
+    EXPECT_EQ( receiver0.width(), 320 );
+    EXPECT_EQ( receiver1.width(), 640 );
+
+    std::vector<uint8_t> image(640 * 480 * 3, 99);
+    slides.write(image.data());
+    EXPECT_EQ( receiver1.frameCounter(), 1u );
+    EXPECT_EQ( receiver0.frameCounter(), 0u );
+}
+
+TEST(FrameBuffer, InvalidInstance) {
+    auto fb1 = sc::FrameBuffer::create(
+                    320, 240, 60, 3, sc::PixelFormat::BGR24, sc::FrameBuffer::SlotLayout::TOP_DOWN, -1);
+    auto fb2 = sc::FrameBuffer::create(
+                    320, 240, 60, 3, sc::PixelFormat::BGR24, sc::FrameBuffer::SlotLayout::TOP_DOWN,
+                    sc::CameraRegistry::MAX_INSTANCES);
+    EXPECT_FALSE( fb1 );
+    EXPECT_FALSE( fb2 );
+    EXPECT_FALSE( sc::FrameBuffer::open(-1) );
+    EXPECT_FALSE( sc::FrameBuffer::open(sc::CameraRegistry::MAX_INSTANCES) );
+}
+
+TEST(FrameBuffer, ListInstances) {
+    EXPECT_TRUE( sc::FrameBuffer::listInstances().empty() );
+    {
+        auto main = sc::FrameBuffer::create(
+                    320, 240, 60, 3, sc::PixelFormat::BGR24, sc::FrameBuffer::SlotLayout::TOP_DOWN, 0, "Main");
+        auto slides = sc::FrameBuffer::create(
+                    640, 480, 30, 3, sc::PixelFormat::NV12, sc::FrameBuffer::SlotLayout::TOP_DOWN, 3, "Slides");
+
+        auto list = sc::FrameBuffer::listInstances();
+        ASSERT_EQ( list.size(), 2u );
+        EXPECT_EQ( list[0].instance, 0 );
+        EXPECT_EQ( list[0].width, 320 );
+        EXPECT_STREQ( list[0].name, "Main" );
+        EXPECT_EQ( list[1].instance, 3 );
+        EXPECT_EQ( list[1].height, 480 );
+        EXPECT_EQ( list[1].framerate, 30.0f );
+        EXPECT_EQ( list[1].format, sc::PixelFormat::NV12 );
+        EXPECT_STREQ( list[1].name, "Slides" );
+
+        slides.release();
+        list = sc::FrameBuffer::listInstances();
+        ASSERT_EQ( list.size(), 1u );
+        EXPECT_EQ( list[0].instance, 0 );
+    }
+    EXPECT_TRUE( sc::FrameBuffer::listInstances().empty() );
+}
+
+TEST(FrameBuffer, GettersDoNotTakeMutex) {
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    auto receiver = sc::FrameBuffer::open();
+    ASSERT_TRUE( sender );
+    ASSERT_TRUE( receiver );
+
+    // Someone holds the mutex for a long time.
+    sc::NamedMutex mutex("FluxMic Camera/NamedMutex");
+    std::atomic<bool> locked{false}, release{false};
+    std::thread holder([&]
+    {
+        mutex.lock();
+        locked = true;
+        while (!release) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+        mutex.unlock();
+    });
+    while (!locked) { std::this_thread::yield(); }
+
+    std::vector<uint8_t> image(320 * 240 * 3, 0);
+    sender.write(image.data());
+    EXPECT_EQ( receiver.width(), 320 );
+    EXPECT_EQ( receiver.height(), 240 );
+    EXPECT_EQ( receiver.framerate(), 60.0f );
+    EXPECT_EQ( receiver.format(), sc::PixelFormat::BGR24 );
+    EXPECT_EQ( receiver.frameCounter(), 1u );
+    EXPECT_TRUE( receiver.active() );
+    EXPECT_TRUE( sender.connected() );
+    sender.deactivate();
+    EXPECT_FALSE( receiver.active() );
+
+    release = true;
+    holder.join();
+}
+
 TEST(FrameBuffer, OpenBeforeCreateFails) {
     auto receiver = sc::FrameBuffer::open();
     auto sender = sc::FrameBuffer::create(320, 240);
@@ -213,6 +660,203 @@ TEST(FrameBuffer, WriteAndRead) {
     EXPECT_EQ( error_count, 0 );
 }
 
+TEST(FrameBuffer, WriteWithCaptureTimestamp) {
+    auto fb = sc::FrameBuffer::create(320, 240, 60);
+    auto receiver = sc::FrameBuffer::open();
+    std::vector<uint8_t> image(320 * 240 * 3, 1);
+    std::vector<uint8_t> dest(320 * 240 * 3);
+
+    auto captured = sc::Timer::timestamp() - 50000;
+    fb.write(image.data(), captured, 166667);
+
+    uint64_t frame_counter = 0, timestamp = 0, duration = 0;
+    receiver.transferToDIB(dest.data(), &frame_counter, &timestamp, &duration);
+    EXPECT_EQ( frame_counter, 1u );
+    EXPECT_EQ( timestamp, captured );
+    EXPECT_EQ( duration, 166667u );
+
+    // Without the timestamp, the time of writing is recorded.
+    auto before = sc::Timer::timestamp();
+    fb.write(image.data());
+    receiver.transferNative(dest.data(), &frame_counter, &timestamp, &duration);
+    EXPECT_EQ( frame_counter, 2u );
+    EXPECT_GE( timestamp, before );
+    EXPECT_LE( timestamp, sc::Timer::timestamp() );
+    EXPECT_EQ( duration, 0u );
+
+    // The same goes for the frames drawn in place.
+    ASSERT_NE( fb.lockFrame(nullptr), nullptr );
+    fb.unlockFrame(captured + 166667, 166667);
+    receiver.transferToDIB(dest.data(), &frame_counter, &timestamp, &duration);
+    EXPECT_EQ( frame_counter, 3u );
+    EXPECT_EQ( timestamp, captured + 166667 );
+    EXPECT_EQ( duration, 166667u );
+}
+
+TEST(FrameBuffer, WriteAndReadEveryFrame) {
+    auto fb = sc::FrameBuffer::create(320, 240, 60, 5);
+    auto receiver = sc::FrameBuffer::open();
+    receiver.setReadMode(sc::FrameBuffer::ReadMode::EVERY_FRAME);
+
+    std::vector<uint8_t> image(320 * 240 * 3);
+    for (int i = 1; i <= 3; i++)
+    {
+        std::fill(image.begin(), image.end(), (uint8_t)i);
+        fb.write(image.data());
+    }
+
+    std::vector<uint8_t> dest(320 * 240 * 3);
+    uint64_t last_timestamp = 0;
+    for (int i = 1; i <= 3; i++)
+    {
+        uint64_t frame_counter = 0, timestamp = 0;
+        receiver.transferToDIB(dest.data(), &frame_counter, &timestamp);
+        EXPECT_EQ( frame_counter, (uint64_t)i );
+        EXPECT_EQ( dest[0], (uint8_t)i );
+        EXPECT_GE( timestamp, last_timestamp );
+        EXPECT_NE( timestamp, 0u );
+        last_timestamp = timestamp;
+    }
+    EXPECT_EQ( receiver.droppedFrames(), 0u );
+
+    // A receiver reading only the latest frame
+    auto receiver2 = sc::FrameBuffer::open();
+    fb.write(image.data());
+    fb.write(image.data());
+    uint64_t frame_counter = 0;
+    receiver2.transferToDIB(dest.data(), &frame_counter);
+    EXPECT_EQ( frame_counter, 5u );
+}
+
+TEST(FrameBuffer, EveryFrameReaderCountsDroppedFrames) {
+    auto fb = sc::FrameBuffer::create(320, 240, 60, 4);
+    auto receiver = sc::FrameBuffer::open();
+    receiver.setReadMode(sc::FrameBuffer::ReadMode::EVERY_FRAME);
+
+    std::vector<uint8_t> image(320 * 240 * 3, 0);
+    for (int i = 1; i <= 10; i++)
+    {
+        fb.write(image.data());
+    }
+
+    // Frames 8 to 10 are still in the ring.
+    std::vector<uint8_t> dest(320 * 240 * 3);
+    uint64_t frame_counter = 0;
+    receiver.transferToDIB(dest.data(), &frame_counter);
+    EXPECT_EQ( frame_counter, 8u );
+    EXPECT_EQ( receiver.droppedFrames(), 7u );
+}
+
+TEST(FrameBuffer, SenderSeesSlowestReceiver) {
+    auto fb = sc::FrameBuffer::create(320, 240, 60, 8);
+    EXPECT_EQ( fb.receiverLag(), 0u );
+
+    auto fast = sc::FrameBuffer::open();
+    auto slow = sc::FrameBuffer::open();
+    std::vector<uint8_t> image(320 * 240 * 3, 0);
+    std::vector<uint8_t> dest(320 * 240 * 3);
+    uint64_t frame_counter = 0;
+
+    fb.write(image.data());
+    fast.transferToDIB(dest.data(), &frame_counter);
+    slow.transferToDIB(dest.data(), &frame_counter);
+    EXPECT_EQ( fb.receiverLag(), 0u );
+
+    for (int i = 0; i < 5; i++)
+    {
+        fb.write(image.data());
+        fast.transferToDIB(dest.data(), &frame_counter);
+    }
+    EXPECT_EQ( fb.receiverLag(), 5u );
+
+    // A receiver which has gone away doesn't count.
+    slow.release();
+    EXPECT_EQ( fb.receiverLag(), 0u );
+}
+
+TEST(FrameBuffer, LockFrameAndUnlockFrame) {
+    auto fb = sc::FrameBuffer::create(320, 240, 60);
+    auto receiver = sc::FrameBuffer::open();
+
+    int stride = 0;
+    auto bits = static_cast<uint8_t*>(fb.lockFrame(&stride));
+    ASSERT_NE( bits, nullptr );
+    EXPECT_EQ( stride, 320 * 3 );
+    EXPECT_EQ( fb.lockFrame(nullptr), bits );   // locking twice gives the same area
+    std::memset(bits, 77, (std::size_t)stride * 240);
+
+    // The frame is not delivered until it is unlocked.
+    EXPECT_EQ( fb.frameCounter(), 0 );
+    fb.unlockFrame();
+    EXPECT_EQ( fb.frameCounter(), 1 );
+    fb.unlockFrame();   // no effect
+    EXPECT_EQ( fb.frameCounter(), 1 );
+
+    std::vector<uint8_t> dest(320 * 240 * 3, 0);
+    uint64_t frame_counter = 0;
+    receiver.transferToDIB(dest.data(), &frame_counter);
+    EXPECT_EQ( frame_counter, 1 );
+    EXPECT_EQ( std::count(dest.begin(), dest.end(), 77), (std::ptrdiff_t)dest.size() );
+
+    // The next lock gives another slot than the one just published.
+    auto bits2 = static_cast<uint8_t*>(fb.lockFrame(&stride));
+    ASSERT_NE( bits2, nullptr );
+    EXPECT_NE( bits2, bits );
+    fb.unlockFrame();
+}
+
+TEST(FrameBuffer, LockFrameFailsAfterRelease) {
+    auto fb = sc::FrameBuffer::create(320, 240, 60);
+    ASSERT_NE( fb.lockFrame(nullptr), nullptr );
+    fb.release();
+
+    int stride = -1;
+    EXPECT_EQ( fb.lockFrame(&stride), nullptr );
+    EXPECT_EQ( stride, -1 );
+    EXPECT_NO_THROW({ fb.unlockFrame(); });
+}
+
+TEST(FrameBuffer, ReadersGetIntactFramesWhileWriting) {
+    const int NUM_FRAMES = 200;
+    auto sender = sc::FrameBuffer::create(320, 240, 0);
+    std::atomic<bool> done = false;
+    std::atomic<int> torn_frames = 0;
+
+    std::vector<std::thread> receivers;
+    for (int i = 0; i < 2; i++)
+    {
+        receivers.emplace_back([&]
+        {
+            auto receiver = sc::FrameBuffer::open();
+            std::vector<uint8_t> dest(320 * 240 * 3);
+            while (!done)
+            {
+                uint64_t frame_counter = 0;
+                receiver.transferToDIB(dest.data(), &frame_counter);
+                if (std::count(dest.begin(), dest.end(), (uint8_t)frame_counter) != (long)dest.size())
+                {
+                    torn_frames += 1;
+                }
+            }
+        });
+    }
+
+    std::vector<uint8_t> image(320 * 240 * 3);
+    for (int i = 1; i <= NUM_FRAMES; i++)
+    {
+        std::fill(image.begin(), image.end(), (uint8_t)i);
+        sender.write(image.data());
+    }
+    done = true;
+    for (auto& th : receivers)
+    {
+        th.join();
+    }
+
+    EXPECT_EQ( torn_frames, 0 );
+    EXPECT_EQ( sender.frameCounter(), (uint64_t)NUM_FRAMES );
+}
+
 TEST(FrameBuffer, DeactivateTurnsActiveFlagOff) {
     auto sender = sc::FrameBuffer::create(320, 240, 60);
     auto receiver = sc::FrameBuffer::open();
@@ -269,6 +913,32 @@ TEST(FrameBuffer, WaitForNewFrameStopsAfterNewFrameArrived) {
     th.join();
 }
 
+TEST(FrameBuffer, WaitForNewFrameWakesUpPromptly) {
+    const float TIMEOUT_TIME = 2.0f;
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    auto receiver = sc::FrameBuffer::open();
+
+    std::atomic<int> pos = 0;
+    sc::Timer timer;
+    std::atomic<float> wake_time = 0.0f;
+    std::thread th([&]{
+        pos = 1;
+        bool ret = receiver.waitForNewFrame(0, TIMEOUT_TIME);
+        wake_time = timer.get();
+        EXPECT_EQ( ret, true );
+    });
+
+    while (pos == 0) { sc::Timer::sleep(0.001f); }
+    sc::Timer::sleep(0.1f);
+
+    std::vector<uint8_t> image(320 * 240 * 3, 255);
+    auto send_time = timer.get();
+    sender.write(image.data());
+    th.join();
+
+    EXPECT_LT( wake_time - send_time, 0.010f );
+}
+
 TEST(FrameBuffer, WaitForNewFrameStopsWhenDeactivated) {
     const float TIMEOUT_TIME = 2.0f;
     auto fb = sc::FrameBuffer::create(320, 240, 60);
@@ -363,4 +1033,39 @@ TEST(FrameBuffer, SenderDetectsReceiversDisconnection) {
     EXPECT_FALSE( sender.connected() );
 }
 
+TEST(FrameBuffer, SenderDetectsReceiversDisconnectionByTimestamp) {
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    auto receiver = sc::FrameBuffer::open();
+    EXPECT_TRUE( sender.connected() );
+    receiver.release();
+
+    sc::Timer::sleep(sc::FrameBuffer::LIVENESS_TIMEOUT + 0.05f);
+
+    EXPECT_FALSE( sender.connected() );
+}
+
+TEST(FrameBuffer, ReceiverDetectsSendersDeathByTimestamp) {
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    auto receiver = sc::FrameBuffer::open();
+    sender.release();
+
+    sc::Timer timer;
+    EXPECT_FALSE( receiver.waitForNewFrame(0, 2.0f) );
+    EXPECT_LT( timer.get(), sc::FrameBuffer::LIVENESS_TIMEOUT + 0.1f );
+}
+
+TEST(FrameBuffer, OnlyHeartbeatsUseTimers) {
+    // Liveness is evaluated when asked, so there are no monitor timers.
+    auto sender = sc::FrameBuffer::create(320, 240, 60);
+    EXPECT_EQ( sc::TimerService::timerCount(), 1u );
+    auto receiver1 = sc::FrameBuffer::open();
+    auto receiver2 = sc::FrameBuffer::open();
+    EXPECT_EQ( sc::TimerService::timerCount(), 3u );
+
+    receiver1.release();
+    receiver2.release();
+    sender.release();
+    EXPECT_EQ( sc::TimerService::timerCount(), 0u );
+}
+
 } //namespace FrameBufferTest
@@ -0,0 +1,92 @@
+#include <softcamcore/FramePacer.h>
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <softcamcore/FrameBuffer.h>
+#include <softcamcore/Misc.h>
+
+
+namespace FramePacerTest {
+namespace sc = softcam;
+
+const int WIDTH = 320;
+const int HEIGHT = 240;
+
+
+TEST(FramePacer, QueueDepthLimitsWaitingFrames) {
+    auto fb = sc::FrameBuffer::create(WIDTH, HEIGHT, 10.0f);
+    unsigned char image[WIDTH * HEIGHT * 3] = {};
+    {
+        sc::FramePacer pacer(&fb, sc::FramePacer::DropPolicy::DROP_NEWEST, 2);
+        pacer.push(image);
+        sc::Timer timer;
+        while (pacer.sentFrames() < 1 && timer.get() < 1.0f) { sc::Timer::sleep(0.001f); }
+
+        pacer.push(image);
+        pacer.push(image);
+        pacer.push(image);
+        EXPECT_EQ( pacer.queuedFrames(), 2 );
+        EXPECT_EQ( pacer.droppedFrames(), 1u );
+    }
+    // The waiting ones are discarded.
+    EXPECT_EQ( fb.frameCounter(), 1 );
+}
+
+TEST(FramePacer, FlushDeliversWithoutWaiting) {
+    auto fb = sc::FrameBuffer::create(WIDTH, HEIGHT, 1.0f);
+    unsigned char image[WIDTH * HEIGHT * 3] = {};
+    sc::FramePacer pacer(&fb, sc::FramePacer::DropPolicy::DROP_OLDEST, 2);
+
+    sc::Timer timer;
+    pacer.push(image);
+    pacer.push(image);
+    pacer.flush();
+    EXPECT_LT( timer.get(), 0.5f );
+    EXPECT_EQ( pacer.queuedFrames(), 0 );
+    EXPECT_EQ( pacer.sentFrames() + pacer.droppedFrames(), 2u );
+    EXPECT_EQ( fb.frameCounter(), pacer.sentFrames() );
+}
+
+TEST(FramePacer, TimestampedFramesAreNotPaced) {
+    auto fb = sc::FrameBuffer::create(WIDTH, HEIGHT, 1.0f);
+    unsigned char image[WIDTH * HEIGHT * 3] = {};
+    sc::FramePacer pacer(&fb, sc::FramePacer::DropPolicy::DROP_NEWEST, 4);
+
+    sc::Timer timer;
+    auto now = sc::Timer::timestamp();
+    for (int i = 0; i < 3; i++)
+    {
+        std::memset(image, i + 1, sizeof(image));
+        pacer.push(image, now + (std::uint64_t)i * 100000, 100000);
+    }
+    while (pacer.sentFrames() < 3 && timer.get() < 1.0f) { sc::Timer::sleep(0.001f); }
+    EXPECT_LT( timer.get(), 0.5f );
+    EXPECT_EQ( fb.frameCounter(), 3 );
+
+    unsigned char dest[WIDTH * HEIGHT * 3];
+    std::uint64_t frame_counter = 0, timestamp = 0;
+    fb.transferToDIB(dest, &frame_counter, &timestamp);
+    EXPECT_EQ( dest[0], 3 );
+    EXPECT_EQ( timestamp, now + 200000 );
+}
+
+TEST(FramePacer, LockFrameTwiceReturnsSameArea) {
+    auto fb = sc::FrameBuffer::create(WIDTH, HEIGHT, 10.0f);
+    sc::FramePacer pacer(&fb, sc::FramePacer::DropPolicy::DROP_OLDEST);
+
+    int stride = 0;
+    void* bits1 = pacer.lockFrame(&stride);
+    void* bits2 = pacer.lockFrame(nullptr);
+    EXPECT_NE( bits1, nullptr );
+    EXPECT_EQ( bits1, bits2 );
+    EXPECT_EQ( stride, WIDTH * 3 );
+    pacer.unlockFrame();
+    pacer.flush();
+    EXPECT_EQ( fb.frameCounter(), 1 );
+
+    pacer.unlockFrame();    // not locked. no effect
+    pacer.flush();
+    EXPECT_EQ( fb.frameCounter(), 1 );
+}
+
+} //namespace FramePacerTest
@@ -0,0 +1,146 @@
+#include <softcamcore/FrameSchedule.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+
+namespace FrameScheduleTest {
+namespace sc = softcam;
+
+using CatchUp = sc::FrameSchedule::CatchUp;
+
+const std::uint64_t FREQUENCY = 10000000;   // 100 nsec ticks
+const std::uint64_t ORIGIN = 123456789;
+
+
+TEST(FrameSchedule, FirstFrameGoesAtOnce) {
+    sc::FrameSchedule schedule(FREQUENCY, { 30, 1 });
+    EXPECT_EQ( schedule.schedule(ORIGIN), ORIGIN );
+    EXPECT_EQ( schedule.schedule(ORIGIN + 10), ORIGIN + FREQUENCY / 30 );
+}
+
+TEST(FrameSchedule, ZeroRateIsNotPaced) {
+    sc::FrameSchedule schedule(FREQUENCY, { 0, 1 });
+    EXPECT_EQ( schedule.schedule(ORIGIN), ORIGIN );
+    EXPECT_EQ( schedule.schedule(ORIGIN + 1), ORIGIN + 1 );
+    EXPECT_EQ( schedule.stats().frames, 2u );
+    EXPECT_EQ( schedule.stats().late_frames, 0u );
+}
+
+TEST(FrameSchedule, RationalRateDoesNotDrift) {
+    // 30000/1001 fps: a period is 333666.33... ticks
+    sc::FrameSchedule schedule(FREQUENCY, { 30000, 1001 });
+    auto now = ORIGIN;
+    std::uint64_t deadline = schedule.schedule(now);
+    const std::uint64_t FRAMES = 30000 * 60 * 60;   // about 10 hours
+    for (std::uint64_t i = 1; i <= FRAMES; i++)
+    {
+        deadline = schedule.schedule(deadline);
+    }
+    // Exactly 1001 * 3600 seconds later
+    EXPECT_EQ( deadline - ORIGIN, 1001u * 60 * 60 * FREQUENCY );
+    EXPECT_EQ( schedule.stats().late_frames, 0u );
+}
+
+TEST(FrameSchedule, EarlyFramesWaitForDeadline) {
+    sc::FrameSchedule schedule(FREQUENCY, { 20, 1 });
+    const std::uint64_t PERIOD = FREQUENCY / 20;
+    schedule.schedule(ORIGIN);
+    EXPECT_EQ( schedule.schedule(ORIGIN + 1), ORIGIN + PERIOD );
+    EXPECT_EQ( schedule.schedule(ORIGIN + PERIOD + 1), ORIGIN + 2 * PERIOD );
+    EXPECT_EQ( schedule.stats().late_frames, 0u );
+}
+
+TEST(FrameSchedule, SkipKeepsPhase) {
+    sc::FrameSchedule schedule(FREQUENCY, { 20, 1 }, CatchUp::SKIP);
+    const std::uint64_t PERIOD = FREQUENCY / 20;
+    schedule.schedule(ORIGIN);
+
+    // Comes 3.5 periods later; periods 1 and 2 are given up.
+    auto late = ORIGIN + PERIOD * 7 / 2;
+    EXPECT_EQ( schedule.schedule(late), ORIGIN + 3 * PERIOD );
+    EXPECT_EQ( schedule.schedule(late), ORIGIN + 4 * PERIOD );
+    EXPECT_EQ( schedule.stats().late_frames, 1u );
+    EXPECT_EQ( schedule.stats().skipped_periods, 2u );
+    EXPECT_EQ( schedule.stats().rebases, 0u );
+}
+
+TEST(FrameSchedule, BurstCatchesUp) {
+    sc::FrameSchedule schedule(FREQUENCY, { 20, 1 }, CatchUp::BURST);
+    const std::uint64_t PERIOD = FREQUENCY / 20;
+    schedule.schedule(ORIGIN);
+
+    auto late = ORIGIN + PERIOD * 7 / 2;
+    EXPECT_EQ( schedule.schedule(late), ORIGIN + PERIOD );
+    EXPECT_EQ( schedule.schedule(late), ORIGIN + 2 * PERIOD );
+    EXPECT_EQ( schedule.schedule(late), ORIGIN + 3 * PERIOD );
+    EXPECT_EQ( schedule.schedule(late), ORIGIN + 4 * PERIOD );
+    EXPECT_EQ( schedule.stats().late_frames, 3u );
+    EXPECT_EQ( schedule.stats().skipped_periods, 0u );
+}
+
+TEST(FrameSchedule, RebaseStartsOverIfMuchLate) {
+    sc::FrameSchedule schedule(FREQUENCY, { 20, 1 }, CatchUp::REBASE);
+    const std::uint64_t PERIOD = FREQUENCY / 20;
+    schedule.schedule(ORIGIN);
+
+    // Less than half a period late: the phase is kept.
+    EXPECT_EQ( schedule.schedule(ORIGIN + PERIOD * 5 / 4), ORIGIN + PERIOD );
+    EXPECT_EQ( schedule.schedule(ORIGIN + PERIOD * 3 / 2), ORIGIN + 2 * PERIOD );
+    EXPECT_EQ( schedule.stats().rebases, 0u );
+
+    // More than half a period late: a new schedule from the frame.
+    auto late = ORIGIN + PERIOD * 37 / 10;
+    EXPECT_EQ( schedule.schedule(late), late );
+    EXPECT_EQ( schedule.schedule(late + 1), late + PERIOD );
+    EXPECT_EQ( schedule.stats().late_frames, 2u );
+    EXPECT_EQ( schedule.stats().rebases, 1u );
+}
+
+TEST(FrameSchedule, ResetStartsOver) {
+    sc::FrameSchedule schedule(FREQUENCY, { 20, 1 });
+    schedule.schedule(ORIGIN);
+    schedule.reset();
+    EXPECT_EQ( schedule.schedule(ORIGIN + 5), ORIGIN + 5 );
+}
+
+TEST(FrameSchedule, JitterHistogram) {
+    sc::FrameSchedule schedule(FREQUENCY, { 20, 1 });
+    auto deadline = schedule.schedule(ORIGIN);
+    schedule.sent(deadline);            // on time
+    deadline = schedule.schedule(deadline);
+    schedule.sent(deadline + 30);       // 3 usec late
+    deadline = schedule.schedule(deadline + 30);
+    schedule.sent(deadline - 10000);    // 1 msec early
+    deadline = schedule.schedule(deadline);
+    schedule.sent(deadline + FREQUENCY); // 1 sec late
+
+    auto& histogram = schedule.stats().jitter_histogram;
+    EXPECT_EQ( histogram[0], 1u );
+    EXPECT_EQ( histogram[2], 1u );      // 2 to 4 usec
+    EXPECT_EQ( histogram[10], 1u );     // 512 to 1024 usec
+    EXPECT_EQ( histogram[sc::FrameSchedule::JITTER_BUCKETS - 1], 1u );
+}
+
+TEST(FrameSchedule, RateFromFramerate) {
+    auto rate = sc::FrameSchedule::rateFromFramerate(60.0f);
+    EXPECT_EQ( rate.numerator, 60u );
+    EXPECT_EQ( rate.denominator, 1u );
+
+    rate = sc::FrameSchedule::rateFromFramerate(29.97f);
+    EXPECT_EQ( rate.numerator, 30000u );
+    EXPECT_EQ( rate.denominator, 1001u );
+
+    rate = sc::FrameSchedule::rateFromFramerate(23.976f);
+    EXPECT_EQ( rate.numerator, 24000u );
+    EXPECT_EQ( rate.denominator, 1001u );
+
+    rate = sc::FrameSchedule::rateFromFramerate(12.5f);
+    EXPECT_EQ( rate.numerator, 12500u );
+    EXPECT_EQ( rate.denominator, 1000u );
+
+    rate = sc::FrameSchedule::rateFromFramerate(0.0f);
+    EXPECT_EQ( rate.numerator, 0u );
+}
+
+} //namespace FrameScheduleTest
@@ -0,0 +1,436 @@
+#include <softcamcore/FrameSlots.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <cstddef>
+
+
+namespace FrameSlotsTest {
+namespace sc = softcam;
+
+
+TEST(FrameSlots, InitialState) {
+    sc::FrameSlots slots;
+    slots.init();
+
+    EXPECT_EQ( slots.latestFrameCounter(), 0u );
+
+    sc::FrameSlots::ReadTicket ticket;
+    EXPECT_TRUE( slots.beginRead(&ticket) );
+    EXPECT_EQ( ticket.frame_counter, 0u );
+    EXPECT_TRUE( slots.endRead(ticket) );
+}
+
+TEST(FrameSlots, CursorsDoNotShareCacheLines) {
+    EXPECT_EQ( alignof(sc::FrameSlots::Cursor), sc::FrameSlots::CACHE_LINE_SIZE );
+    EXPECT_EQ( sizeof(sc::FrameSlots::Cursor) % sc::FrameSlots::CACHE_LINE_SIZE, 0u );
+    EXPECT_EQ( offsetof(sc::FrameSlots, m_cursor) % sc::FrameSlots::CACHE_LINE_SIZE, 0u );
+}
+
+TEST(FrameSlots, WriterNeverUsesLatestSlot) {
+    sc::FrameSlots slots;
+    slots.init();
+
+    for (uint64_t i = 1; i <= 10; i++)
+    {
+        sc::FrameSlots::ReadTicket ticket;
+        ASSERT_TRUE( slots.beginRead(&ticket) );
+
+        auto slot = slots.beginWrite();
+        EXPECT_LT( slot, slots.slotCount() );
+        if (i > 1)
+        {
+            EXPECT_NE( slot, ticket.slot );
+        }
+        slots.endWrite(slot, i);
+
+        EXPECT_EQ( slots.latestFrameCounter(), i );
+    }
+}
+
+TEST(FrameSlots, ReaderSeesLatestFrame) {
+    sc::FrameSlots slots;
+    slots.init();
+
+    auto slot = slots.beginWrite();
+    slots.endWrite(slot, 1);
+
+    sc::FrameSlots::ReadTicket ticket;
+    ASSERT_TRUE( slots.beginRead(&ticket) );
+    EXPECT_EQ( ticket.slot, slot );
+    EXPECT_EQ( ticket.frame_counter, 1u );
+    EXPECT_TRUE( slots.endRead(ticket) );
+}
+
+TEST(FrameSlots, ReaderDetectsOverwrite) {
+    sc::FrameSlots slots;
+    slots.init();
+
+    auto slot = slots.beginWrite();
+    slots.endWrite(slot, 1);
+
+    sc::FrameSlots::ReadTicket ticket;
+    ASSERT_TRUE( slots.beginRead(&ticket) );
+
+    // One more frame doesn't touch the slot being read.
+    auto slot2 = slots.beginWrite();
+    slots.endWrite(slot2, 2);
+    EXPECT_TRUE( slots.endRead(ticket) );
+
+    // The writer comes back to the slot after going around the other slots.
+    for (uint64_t i = 3; i <= 1 + slots.slotCount(); i++)
+    {
+        auto s = slots.beginWrite();
+        slots.endWrite(s, i);
+    }
+    EXPECT_FALSE( slots.endRead(ticket) );
+}
+
+TEST(FrameSlots, ReaderRejectsSlotBeingWritten) {
+    sc::FrameSlots slots;
+    slots.init();
+
+    for (uint64_t i = 1; i <= slots.slotCount() - 1; i++)
+    {
+        auto s = slots.beginWrite();
+        slots.endWrite(s, i);
+    }
+    auto in_progress = slots.beginWrite();
+
+    // Pretend the writer has already published the slot being written.
+    sc::FrameSlots::ReadTicket ticket;
+    uint64_t latest = slots.m_latest.load();
+    slots.m_latest.store((latest & ~0xffull) | in_progress);
+    EXPECT_FALSE( slots.beginRead(&ticket) );
+    slots.m_latest.store(latest);
+
+    slots.endWrite(in_progress, slots.slotCount());
+    EXPECT_TRUE( slots.beginRead(&ticket) );
+    EXPECT_EQ( ticket.slot, in_progress );
+}
+
+TEST(FrameSlots, SlotCount) {
+    EXPECT_FALSE( sc::FrameSlots::checkSlotCount(2) );
+    EXPECT_TRUE( sc::FrameSlots::checkSlotCount(3) );
+    EXPECT_TRUE( sc::FrameSlots::checkSlotCount(16) );
+    EXPECT_FALSE( sc::FrameSlots::checkSlotCount(17) );
+
+    sc::FrameSlots slots;
+    slots.init();
+    EXPECT_EQ( slots.slotCount(), sc::FrameSlots::DEFAULT_SLOT_COUNT );
+    slots.init(8);
+    EXPECT_EQ( slots.slotCount(), 8u );
+}
+
+TEST(FrameSlots, SlotsHoldFrameCounterAndTimestamp) {
+    sc::FrameSlots slots;
+    slots.init(5);
+
+    for (uint64_t i = 1; i <= 12; i++)
+    {
+        auto slot = slots.beginWrite();
+        EXPECT_EQ( slot, i % 5 );
+        slots.endWrite(slot, i, 1000 + i);
+
+        sc::FrameSlots::ReadTicket ticket;
+        ASSERT_TRUE( slots.beginRead(&ticket) );
+        EXPECT_EQ( ticket.slot, slot );
+        EXPECT_EQ( ticket.frame_counter, i );
+        EXPECT_EQ( ticket.timestamp, 1000 + i );
+    }
+}
+
+TEST(FrameSlots, SlotsHoldDuration) {
+    sc::FrameSlots slots;
+    slots.init();
+
+    slots.endWrite(slots.beginWrite(), 1, 1000);
+    slots.endWrite(slots.beginWrite(), 2, 2000, sc::FrameSlots::ALL_ROWS, 333333);
+
+    sc::FrameSlots::ReadTicket ticket;
+    ASSERT_TRUE( slots.beginReadNext(0, &ticket) );
+    EXPECT_EQ( ticket.duration, 0u );   // unknown
+    ASSERT_TRUE( slots.beginReadNext(1, &ticket) );
+    EXPECT_EQ( ticket.timestamp, 2000u );
+    EXPECT_EQ( ticket.duration, 333333u );
+}
+
+TEST(FrameSlots, ReadNextGivesEveryFrame) {
+    sc::FrameSlots slots;
+    slots.init(5);
+
+    for (uint64_t i = 1; i <= 3; i++)
+    {
+        slots.endWrite(slots.beginWrite(), i, 1000 + i);
+    }
+
+    sc::FrameSlots::ReadTicket ticket;
+    for (uint64_t i = 1; i <= 3; i++)
+    {
+        ASSERT_TRUE( slots.beginReadNext(i - 1, &ticket) );
+        EXPECT_EQ( ticket.frame_counter, i );
+        EXPECT_EQ( ticket.timestamp, 1000 + i );
+        EXPECT_TRUE( slots.endRead(ticket) );
+    }
+
+    // Nothing new; the latest frame again.
+    ASSERT_TRUE( slots.beginReadNext(3, &ticket) );
+    EXPECT_EQ( ticket.frame_counter, 3u );
+}
+
+TEST(FrameSlots, ReadNextSkipsFramesGoneFromRing) {
+    sc::FrameSlots slots;
+    slots.init(5);
+
+    for (uint64_t i = 1; i <= 20; i++)
+    {
+        slots.endWrite(slots.beginWrite(), i);
+    }
+
+    // Frames 17 to 20 are still there, and the slot of frame 16 is the
+    // next one to be overwritten.
+    sc::FrameSlots::ReadTicket ticket;
+    ASSERT_TRUE( slots.beginReadNext(2, &ticket) );
+    EXPECT_EQ( ticket.frame_counter, 17u );
+    ASSERT_TRUE( slots.beginReadNext(16, &ticket) );
+    EXPECT_EQ( ticket.frame_counter, 17u );
+    ASSERT_TRUE( slots.beginReadNext(18, &ticket) );
+    EXPECT_EQ( ticket.frame_counter, 19u );
+}
+
+TEST(FrameSlots, ReadNextDetectsOverwrite) {
+    sc::FrameSlots slots;
+    slots.init(4);
+
+    for (uint64_t i = 1; i <= 4; i++)
+    {
+        slots.endWrite(slots.beginWrite(), i);
+    }
+    sc::FrameSlots::ReadTicket ticket;
+    ASSERT_TRUE( slots.beginReadNext(1, &ticket) );
+    EXPECT_EQ( ticket.frame_counter, 2u );
+
+    // Frame 5 goes to the slot of frame 1, and frame 6 to the one being read.
+    slots.endWrite(slots.beginWrite(), 5);
+    EXPECT_TRUE( slots.endRead(ticket) );
+    auto slot = slots.beginWrite();
+    EXPECT_EQ( slot, ticket.slot );
+    EXPECT_FALSE( slots.endRead(ticket) );
+    slots.endWrite(slot, 6);
+    EXPECT_FALSE( slots.endRead(ticket) );
+}
+
+TEST(FrameSlots, PackRows) {
+    uint32_t first = 0, end = 0;
+    sc::FrameSlots::unpackRows(sc::FrameSlots::packRows(10, 20), 240, &first, &end);
+    EXPECT_EQ( first, 10u );
+    EXPECT_EQ( end, 20u );
+
+    sc::FrameSlots::unpackRows(sc::FrameSlots::ALL_ROWS, 240, &first, &end);
+    EXPECT_EQ( first, 0u );
+    EXPECT_EQ( end, 240u );
+
+    // Clamped to the height
+    sc::FrameSlots::unpackRows(sc::FrameSlots::packRows(300, 400), 240, &first, &end);
+    EXPECT_EQ( first, 240u );
+    EXPECT_EQ( end, 240u );
+}
+
+TEST(FrameSlots, ChangedRows) {
+    sc::FrameSlots slots;
+    slots.init(4);
+
+    auto write = [&](uint64_t frame_counter, uint32_t first, uint32_t end)
+    {
+        auto slot = slots.beginWrite();
+        slots.endWrite(slot, frame_counter, 0, sc::FrameSlots::packRows(first, end));
+    };
+    write(1, 0, 240);
+    write(2, 10, 20);
+    write(3, 50, 60);
+    write(4, 15, 30);
+
+    uint32_t first = 999, end = 999;
+    EXPECT_TRUE( slots.changedRows(1, 2, 240, &first, &end) );
+    EXPECT_EQ( first, 10u );
+    EXPECT_EQ( end, 20u );
+    EXPECT_TRUE( slots.changedRows(1, 4, 240, &first, &end) );
+    EXPECT_EQ( first, 10u );
+    EXPECT_EQ( end, 60u );
+    EXPECT_TRUE( slots.changedRows(3, 4, 240, &first, &end) );
+    EXPECT_EQ( first, 15u );
+    EXPECT_EQ( end, 30u );
+
+    // Nothing has changed
+    EXPECT_TRUE( slots.changedRows(4, 4, 240, &first, &end) );
+    EXPECT_EQ( first, end );
+
+    // Unknown base frame
+    first = end = 999;
+    EXPECT_FALSE( slots.changedRows(0, 4, 240, &first, &end) );
+    EXPECT_EQ( first, 999u );
+
+    // Frame 5 overwrites frame 1, so frames after 1 are still known
+    // but frames after 0 are not.
+    write(5, 100, 101);
+    EXPECT_TRUE( slots.changedRows(1, 5, 240, &first, &end) );
+    EXPECT_EQ( first, 10u );
+    EXPECT_EQ( end, 101u );
+    EXPECT_FALSE( slots.changedRows(1, 6, 240, &first, &end) );
+    write(6, 0, 1);
+    EXPECT_FALSE( slots.changedRows(1, 6, 240, &first, &end) );
+    EXPECT_TRUE( slots.changedRows(2, 6, 240, &first, &end) );
+    EXPECT_EQ( first, 0u );
+    EXPECT_EQ( end, 101u );
+}
+
+TEST(FrameSlots, CursorRegistration) {
+    const uint64_t TIMEOUT = 100;
+    sc::FrameSlots slots;
+    slots.init();
+
+    std::vector<int> cursors;
+    for (int i = 0; i < sc::FrameSlots::MAX_CURSORS; i++)
+    {
+        auto cursor = slots.registerCursor(1000, TIMEOUT);
+        EXPECT_EQ( cursor, i );
+        cursors.push_back(cursor);
+    }
+    EXPECT_EQ( slots.registerCursor(1000, TIMEOUT), -1 );
+
+    // A cursor released can be reused.
+    slots.unregisterCursor(cursors[3]);
+    EXPECT_EQ( slots.registerCursor(1000, TIMEOUT), cursors[3] );
+
+    // A cursor whose owner has stopped beating can be taken over.
+    for (int i = 0; i < sc::FrameSlots::MAX_CURSORS; i++)
+    {
+        if (i != 5)
+        {
+            slots.touchCursor(cursors[i], 1100);
+        }
+    }
+    EXPECT_EQ( slots.registerCursor(1100, TIMEOUT), -1 );
+    EXPECT_EQ( slots.registerCursor(1101, TIMEOUT), cursors[5] );
+}
+
+TEST(FrameSlots, NewCursorStartsAtLatestFrame) {
+    sc::FrameSlots slots;
+    slots.init();
+
+    for (uint64_t i = 1; i <= 7; i++)
+    {
+        slots.endWrite(slots.beginWrite(), i);
+    }
+    auto cursor = slots.registerCursor(1000, 100);
+    EXPECT_EQ( slots.cursorFrameCounter(cursor), 7u );
+    EXPECT_EQ( slots.cursorDroppedFrames(cursor), 0u );
+    EXPECT_EQ( slots.slowestCursorLag(1000, 100), 0u );
+}
+
+TEST(FrameSlots, SlowestCursorLag) {
+    const uint64_t TIMEOUT = 100;
+    sc::FrameSlots slots;
+    slots.init(8);
+
+    auto fast = slots.registerCursor(1000, TIMEOUT);
+    auto slow = slots.registerCursor(1000, TIMEOUT);
+    EXPECT_EQ( slots.slowestCursorLag(1000, TIMEOUT), 0u );
+
+    for (uint64_t i = 1; i <= 10; i++)
+    {
+        slots.endWrite(slots.beginWrite(), i);
+    }
+    slots.advanceCursor(fast, 10, 0);
+    slots.advanceCursor(slow, 4, 3);
+    EXPECT_EQ( slots.slowestCursorLag(1000, TIMEOUT), 6u );
+    EXPECT_EQ( slots.cursorDroppedFrames(slow), 3u );
+
+    // A dead cursor doesn't count.
+    slots.touchCursor(fast, 1200);
+    EXPECT_EQ( slots.slowestCursorLag(1200, TIMEOUT), 0u );
+
+    slots.touchCursor(slow, 1200);
+    slots.unregisterCursor(slow);
+    EXPECT_EQ( slots.slowestCursorLag(1200, TIMEOUT), 0u );
+}
+
+TEST(FrameSlots, StressManyReaders) {
+    const int NUM_READERS = 8;
+    const uint64_t NUM_FRAMES = 20000;
+    const std::size_t IMAGE_SIZE = 4096;
+
+    sc::FrameSlots slots;
+    slots.init();
+    std::vector<std::vector<uint8_t>> images(
+            slots.slotCount(), std::vector<uint8_t>(IMAGE_SIZE, 0));
+
+    std::atomic<bool> done{false};
+    std::atomic<int> torn_frames{0};
+    std::atomic<int> backward_frames{0};
+    std::atomic<int> good_frames{0};
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < NUM_READERS; i++)
+    {
+        readers.emplace_back([&]
+        {
+            std::vector<uint8_t> copy(IMAGE_SIZE);
+            uint64_t last = 0;
+            while (!done.load())
+            {
+                sc::FrameSlots::ReadTicket ticket;
+                if (!slots.beginRead(&ticket))
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                std::memcpy(copy.data(), images[ticket.slot].data(), IMAGE_SIZE);
+                if (!slots.endRead(ticket))
+                {
+                    continue;
+                }
+                // Every byte of a frame holds the low byte of its frame counter.
+                uint8_t expected = (uint8_t)ticket.frame_counter;
+                for (auto b : copy)
+                {
+                    if (b != expected)
+                    {
+                        ++torn_frames;
+                        break;
+                    }
+                }
+                if (ticket.frame_counter < last)
+                {
+                    ++backward_frames;
+                }
+                last = ticket.frame_counter;
+                ++good_frames;
+                std::this_thread::yield();
+            }
+        });
+    }
+
+    for (uint64_t i = 1; i <= NUM_FRAMES; i++)
+    {
+        auto slot = slots.beginWrite();
+        std::memset(images[slot].data(), (uint8_t)i, IMAGE_SIZE);
+        slots.endWrite(slot, i);
+        std::this_thread::yield();
+    }
+    done = true;
+    for (auto& th : readers)
+    {
+        th.join();
+    }
+
+    EXPECT_EQ( torn_frames.load(), 0 );
+    EXPECT_EQ( backward_frames.load(), 0 );
+    EXPECT_GT( good_frames.load(), 0 );
+    EXPECT_EQ( slots.latestFrameCounter(), NUM_FRAMES );
+}
+
+} //namespace FrameSlotsTest
@@ -2,6 +2,9 @@
 #include <gtest/gtest.h>
 
 #include <cstring>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
 #include <thread>
 #include <atomic>
 #include <cmath>
@@ -12,6 +15,7 @@ namespace sc = softcam;
 
 const char SHMEM_NAME[] = "shmemtest";
 const char MUTEX_NAME[] = "shmemtest_mutex";
+const char EVENT_NAME[] = "shmemtest_event";
 const char ANOTHER_NAME[] = "shmemtest2";
 const unsigned long SHMEM_SIZE = 888;
 const char SOME_DATA[] = "Hello, world!";
@@ -83,6 +87,84 @@ TEST(Timer, Reset) {
     EXPECT_LT( t2, t1 );
 }
 
+TEST(Timer, TickAt) {
+    sc::Timer timer;
+    auto frequency = sc::Timer::tickFrequency();
+    auto start = timer.tickAt(0.0f);
+    EXPECT_LE( start, sc::Timer::ticks() );
+    EXPECT_EQ( timer.tickAt(0.5f) - start, frequency / 2 );
+
+    timer.rewind(0.25f);
+    EXPECT_EQ( timer.tickAt(0.0f) - start, frequency / 4 );
+}
+
+TEST(Timer, SleepUntil) {
+    auto frequency = sc::Timer::tickFrequency();
+    for (int i = 0; i < 10; i++)
+    {
+        auto deadline = sc::Timer::ticks() + frequency * 5 / 1000;
+        sc::Timer::sleepUntil(deadline);
+        auto now = sc::Timer::ticks();
+
+        EXPECT_GE( now, deadline );
+        EXPECT_LT( now - deadline, frequency * 2 / 1000 );
+    }
+
+    // A deadline in the past returns immediately.
+    sc::Timer timer;
+    sc::Timer::sleepUntil(sc::Timer::ticks() - frequency);
+    EXPECT_LT( timer.get(), 0.001f );
+}
+
+// Reports how late sleep() and sleepUntil() wake up for the intervals of
+// common framerates. Run with --gtest_also_run_disabled_tests.
+TEST(Timer, DISABLED_SleepJitterBenchmark) {
+    const int COUNT = 120;
+    const float INTERVALS[] = { 1.0f / 30, 1.0f / 60, 1.0f / 120, 1.0f / 240, 0.001f };
+    auto frequency = (double)sc::Timer::tickFrequency();
+
+    auto report = [&](const char* label, float interval, std::vector<double>& lateness)
+    {
+        std::sort(lateness.begin(), lateness.end());
+        auto percentile = [&](double p)
+        {
+            return lateness[(std::size_t)(p * (double)(lateness.size() - 1))];
+        };
+        std::printf("%-10s %7.3f ms: p50 %8.1f us, p90 %8.1f us, p99 %8.1f us, max %8.1f us\n",
+                    label, interval * 1000.0f,
+                    percentile(0.5), percentile(0.9), percentile(0.99), lateness.back());
+    };
+    for (float interval : INTERVALS)
+    {
+        auto period = (std::uint64_t)std::llround(interval * frequency);
+        std::vector<double> lateness;
+
+        // Deadlines accumulate the period, as the sender paces frames.
+        auto deadline = sc::Timer::ticks();
+        for (int i = 0; i < COUNT; i++)
+        {
+            deadline += period;
+            auto now = sc::Timer::ticks();
+            sc::Timer::sleep(deadline <= now ? 0.0f : (float)((double)(deadline - now) / frequency));
+            now = sc::Timer::ticks();
+            lateness.push_back(deadline < now ? (double)(now - deadline) * 1e6 / frequency : 0.0);
+            if (deadline < now) deadline = now;
+        }
+        report("sleep", interval, lateness);
+
+        lateness.clear();
+        deadline = sc::Timer::ticks();
+        for (int i = 0; i < COUNT; i++)
+        {
+            deadline += period;
+            sc::Timer::sleepUntil(deadline);
+            auto now = sc::Timer::ticks();
+            lateness.push_back(deadline < now ? (double)(now - deadline) * 1e6 / frequency : 0.0);
+        }
+        report("sleepUntil", interval, lateness);
+    }
+}
+
 TEST(NamedMutex, Basic)
 {
     std::atomic<int> signal = 0;
@@ -117,6 +199,126 @@ TEST(NamedMutex, Basic)
     th2.join();
 }
 
+TEST(NamedMutex, Recursive)
+{
+    sc::NamedMutex mutex1(MUTEX_NAME);
+    sc::NamedMutex mutex2(MUTEX_NAME);
+    mutex1.lock();
+    mutex2.lock();
+    mutex2.unlock();
+
+    std::atomic<int> signal = 0;
+    std::thread th([&]
+    {
+        sc::NamedMutex mutex(MUTEX_NAME);
+        mutex.lock();
+        signal = 1;
+        mutex.unlock();
+    });
+    sc::Timer::sleep(0.1f);
+    EXPECT_EQ( signal.load(), 0 );
+
+    mutex1.unlock();
+    th.join();
+    EXPECT_EQ( signal.load(), 1 );
+}
+
+TEST(NamedEvent, Basic)
+{
+    sc::NamedEvent::State state;
+    sc::NamedEvent::initState(&state);
+    std::atomic<int> signal = 0;
+
+    std::thread th([&]
+    {
+        sc::NamedEvent event(EVENT_NAME, &state);
+        auto count = event.count();
+        signal = 1;
+        bool ret = event.wait(count);
+        EXPECT_EQ( ret, true );
+        signal = 2;
+    });
+
+    sc::NamedEvent event(EVENT_NAME, &state);
+    EXPECT_TRUE( event );
+    WAIT_FOR( signal >= 1 );
+    sc::Timer::sleep(0.1f);
+    EXPECT_EQ( signal.load(), 1 );
+
+    event.notify();
+    WAIT_FOR( signal >= 2 );
+    EXPECT_EQ( signal.load(), 2 );
+    EXPECT_EQ( event.count(), 1u );
+
+    th.join();
+}
+
+TEST(NamedEvent, WakesAllWaiters)
+{
+    sc::NamedEvent::State state;
+    sc::NamedEvent::initState(&state);
+    sc::NamedEvent event(EVENT_NAME, &state);
+    std::atomic<int> waiting = 0;
+    std::atomic<int> woken = 0;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++)
+    {
+        threads.emplace_back([&]
+        {
+            sc::NamedEvent event2(EVENT_NAME, &state);
+            auto count = event2.count();
+            ++waiting;
+            while (!event2.wait(count)) {}
+            ++woken;
+        });
+    }
+
+    WAIT_FOR( waiting >= 4 );
+    event.notify();
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    EXPECT_EQ( woken.load(), 4 );
+}
+
+TEST(NamedEvent, DoesNotMissEarlierNotification)
+{
+    sc::NamedEvent::State state;
+    sc::NamedEvent::initState(&state);
+    sc::NamedEvent event(EVENT_NAME, &state);
+
+    auto count = event.count();
+    event.notify();
+
+    sc::Timer timer;
+    EXPECT_EQ( event.wait(count, 1.0f), true );
+    EXPECT_LT( timer.get(), 0.1f );
+}
+
+TEST(NamedEvent, WaitTimesOut)
+{
+    sc::NamedEvent::State state;
+    sc::NamedEvent::initState(&state);
+    sc::NamedEvent event(EVENT_NAME, &state);
+
+    sc::Timer timer;
+    EXPECT_EQ( event.wait(event.count(), 0.1f), false );
+    auto t = timer.get();
+    EXPECT_GE( t, 0.09f );
+    EXPECT_LT( t, 0.5f );
+}
+
+TEST(NamedEvent, DefaultConstructedIsInvalid)
+{
+    sc::NamedEvent event;
+    EXPECT_FALSE( event );
+    EXPECT_EQ( event.count(), 0u );
+    EXPECT_EQ( event.wait(0, 0.01f), false );
+    EXPECT_NO_THROW({ event.notify(); });
+}
+
 TEST(SharedMemory, Basic1) {
     auto shmem = sc::SharedMemory::create(SHMEM_NAME, SHMEM_SIZE);
 
@@ -218,4 +420,25 @@ TEST(SharedMemory, MultipleOpenSucceeds) {
     EXPECT_GE( view3.size(), SHMEM_SIZE );
 }
 
+TEST(SharedMemory, AliveWhileAnyHandleExists) {
+    auto view1 = sc::SharedMemory::create(SHMEM_NAME, SHMEM_SIZE);
+    auto view2 = sc::SharedMemory::open(SHMEM_NAME);
+    ASSERT_TRUE( view1 );
+    ASSERT_TRUE( view2 );
+    std::memcpy(view1.get(), SOME_DATA, sizeof(SOME_DATA));
+
+    view1 = {};
+    auto view3 = sc::SharedMemory::open(SHMEM_NAME);
+    ASSERT_TRUE( view3 );
+    EXPECT_EQ( std::memcmp(view3.get(), SOME_DATA, sizeof(SOME_DATA)), 0 );
+    EXPECT_FALSE( sc::SharedMemory::create(SHMEM_NAME, SHMEM_SIZE) );
+
+    view2 = {};
+    view3 = {};
+    EXPECT_FALSE( sc::SharedMemory::open(SHMEM_NAME) );
+    auto view4 = sc::SharedMemory::create(SHMEM_NAME, SHMEM_SIZE);
+    ASSERT_TRUE( view4 );
+    EXPECT_NE( std::memcmp(view4.get(), SOME_DATA, sizeof(SOME_DATA)), 0 );
+}
+
 } //namespace MiscTest
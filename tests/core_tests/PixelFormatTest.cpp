@@ -0,0 +1,229 @@
+#include <softcamcore/PixelFormat.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+
+namespace PixelFormatTest {
+namespace sc = softcam;
+using sc::PixelFormat;
+
+
+TEST(PixelFormat, IsValidPixelFormat) {
+    EXPECT_TRUE( sc::isValidPixelFormat(0) );   // BGR24
+    EXPECT_TRUE( sc::isValidPixelFormat(1) );   // BGRA32
+    EXPECT_TRUE( sc::isValidPixelFormat(2) );   // NV12
+    EXPECT_TRUE( sc::isValidPixelFormat(3) );   // I420
+    EXPECT_TRUE( sc::isValidPixelFormat(4) );   // YUY2
+    EXPECT_FALSE( sc::isValidPixelFormat(5) );
+    EXPECT_FALSE( sc::isValidPixelFormat(0xffffffff) );
+}
+
+TEST(PixelFormat, CheckFormatDimensions) {
+    EXPECT_TRUE( sc::checkFormatDimensions(PixelFormat::BGR24, 1, 1) );
+    EXPECT_TRUE( sc::checkFormatDimensions(PixelFormat::BGRA32, 3, 5) );
+    EXPECT_FALSE( sc::checkFormatDimensions(PixelFormat::BGR24, 0, 1) );
+    EXPECT_FALSE( sc::checkFormatDimensions(PixelFormat::BGR24, 1, -1) );
+
+    EXPECT_TRUE( sc::checkFormatDimensions(PixelFormat::NV12, 2, 2) );
+    EXPECT_FALSE( sc::checkFormatDimensions(PixelFormat::NV12, 3, 2) );
+    EXPECT_FALSE( sc::checkFormatDimensions(PixelFormat::NV12, 2, 3) );
+    EXPECT_TRUE( sc::checkFormatDimensions(PixelFormat::I420, 2, 2) );
+    EXPECT_FALSE( sc::checkFormatDimensions(PixelFormat::I420, 2, 1) );
+
+    EXPECT_TRUE( sc::checkFormatDimensions(PixelFormat::YUY2, 2, 1) );
+    EXPECT_FALSE( sc::checkFormatDimensions(PixelFormat::YUY2, 1, 2) );
+
+    EXPECT_FALSE( sc::checkFormatDimensions((PixelFormat)5, 2, 2) );
+}
+
+TEST(PixelFormat, CalcImageLayoutPackedFormats) {
+    sc::ImageLayout layout;
+
+    ASSERT_TRUE( sc::calcImageLayout(PixelFormat::BGR24, 320, 240, &layout) );
+    EXPECT_EQ( layout.plane_count, 1 );
+    EXPECT_EQ( layout.planes[0].offset, 0u );
+    EXPECT_EQ( layout.planes[0].stride, 960u );
+    EXPECT_EQ( layout.planes[0].rows, 240u );
+    EXPECT_EQ( layout.size, 320u * 240 * 3 );
+
+    ASSERT_TRUE( sc::calcImageLayout(PixelFormat::BGRA32, 320, 240, &layout) );
+    EXPECT_EQ( layout.plane_count, 1 );
+    EXPECT_EQ( layout.planes[0].stride, 1280u );
+    EXPECT_EQ( layout.size, 320u * 240 * 4 );
+
+    ASSERT_TRUE( sc::calcImageLayout(PixelFormat::YUY2, 320, 240, &layout) );
+    EXPECT_EQ( layout.plane_count, 1 );
+    EXPECT_EQ( layout.planes[0].stride, 640u );
+    EXPECT_EQ( layout.size, 320u * 240 * 2 );
+}
+
+TEST(PixelFormat, CalcImageLayoutPlanarFormats) {
+    sc::ImageLayout layout;
+
+    ASSERT_TRUE( sc::calcImageLayout(PixelFormat::NV12, 320, 240, &layout) );
+    EXPECT_EQ( layout.plane_count, 2 );
+    EXPECT_EQ( layout.planes[0].offset, 0u );
+    EXPECT_EQ( layout.planes[0].stride, 320u );
+    EXPECT_EQ( layout.planes[0].rows, 240u );
+    EXPECT_EQ( layout.planes[1].offset, 320u * 240 );
+    EXPECT_EQ( layout.planes[1].stride, 320u );
+    EXPECT_EQ( layout.planes[1].rows, 120u );
+    EXPECT_EQ( layout.size, 320u * 240 * 3 / 2 );
+
+    ASSERT_TRUE( sc::calcImageLayout(PixelFormat::I420, 320, 240, &layout) );
+    EXPECT_EQ( layout.plane_count, 3 );
+    EXPECT_EQ( layout.planes[1].offset, 320u * 240 );
+    EXPECT_EQ( layout.planes[1].stride, 160u );
+    EXPECT_EQ( layout.planes[1].rows, 120u );
+    EXPECT_EQ( layout.planes[2].offset, 320u * 240 + 160 * 120 );
+    EXPECT_EQ( layout.planes[2].stride, 160u );
+    EXPECT_EQ( layout.size, 320u * 240 * 3 / 2 );
+}
+
+TEST(PixelFormat, CalcImageLayoutInvalidArgs) {
+    sc::ImageLayout layout{};
+    layout.size = 12345;
+    EXPECT_FALSE( sc::calcImageLayout(PixelFormat::NV12, 321, 240, &layout) );
+    EXPECT_FALSE( sc::calcImageLayout(PixelFormat::BGR24, 0, 240, &layout) );
+    EXPECT_FALSE( sc::calcImageLayout((PixelFormat)99, 320, 240, &layout) );
+    EXPECT_EQ( layout.size, 12345u );  // untouched
+
+    // Too large for 32-bit
+    EXPECT_FALSE( sc::calcImageLayout(PixelFormat::BGRA32, 65536, 16384, &layout) );
+}
+
+TEST(PixelFormat, CopyImageFlipsOnlyPackedRGB) {
+    sc::ImageLayout layout;
+    ASSERT_TRUE( sc::calcImageLayout(PixelFormat::BGRA32, 2, 2, &layout) );
+    std::vector<uint8_t> src = { 1,1,1,1, 2,2,2,2, 3,3,3,3, 4,4,4,4 };
+    std::vector<uint8_t> dest(src.size());
+
+    sc::copyImage(layout, src.data(), dest.data(), true);
+    EXPECT_EQ( dest, std::vector<uint8_t>({ 3,3,3,3, 4,4,4,4, 1,1,1,1, 2,2,2,2 }) );
+    sc::copyImage(layout, src.data(), dest.data(), false);
+    EXPECT_EQ( dest, src );
+
+    ASSERT_TRUE( sc::calcImageLayout(PixelFormat::NV12, 2, 2, &layout) );
+    std::vector<uint8_t> nv12 = { 1, 2, 3, 4, 5, 6 };
+    std::vector<uint8_t> dest2(nv12.size());
+    sc::copyImage(layout, nv12.data(), dest2.data(), true);
+    EXPECT_EQ( dest2, nv12 );
+}
+
+TEST(PixelFormat, IsPackedRGB) {
+    EXPECT_TRUE( sc::isPackedRGB(PixelFormat::BGR24) );
+    EXPECT_TRUE( sc::isPackedRGB(PixelFormat::BGRA32) );
+    EXPECT_FALSE( sc::isPackedRGB(PixelFormat::NV12) );
+    EXPECT_FALSE( sc::isPackedRGB(PixelFormat::I420) );
+    EXPECT_FALSE( sc::isPackedRGB(PixelFormat::YUY2) );
+}
+
+TEST(PixelFormat, ConvertToBGR24FromBGR24) {
+    sc::ImageLayout layout;
+    ASSERT_TRUE( sc::calcImageLayout(PixelFormat::BGR24, 2, 2, &layout) );
+    std::vector<uint8_t> src = { 1,2,3, 4,5,6, 7,8,9, 10,11,12 };
+
+    std::vector<uint8_t> dest(src.size());
+    sc::convertToBGR24(layout, src.data(), dest.data(), 6, false);
+    EXPECT_EQ( dest, src );
+    sc::convertToBGR24(layout, src.data(), dest.data(), 6, true);
+    EXPECT_EQ( dest, std::vector<uint8_t>({ 7,8,9, 10,11,12, 1,2,3, 4,5,6 }) );
+}
+
+TEST(PixelFormat, CopyImageRows) {
+    sc::ImageLayout layout;
+    ASSERT_TRUE( sc::calcImageLayout(PixelFormat::BGRA32, 1, 4, &layout) );
+    std::vector<uint8_t> src = { 1,1,1,1, 2,2,2,2, 3,3,3,3, 4,4,4,4 };
+    std::vector<uint8_t> dest(src.size(), 0);
+
+    sc::copyImageRows(layout, src.data(), dest.data(), true, 1, 3);
+    EXPECT_EQ( dest, std::vector<uint8_t>({ 0,0,0,0, 3,3,3,3, 2,2,2,2, 0,0,0,0 }) );
+    std::fill(dest.begin(), dest.end(), 0);
+    sc::copyImageRows(layout, src.data(), dest.data(), false, 3, 4);
+    EXPECT_EQ( dest, std::vector<uint8_t>({ 0,0,0,0, 0,0,0,0, 0,0,0,0, 4,4,4,4 }) );
+
+    // The chroma row which covers the luma rows is copied too.
+    ASSERT_TRUE( sc::calcImageLayout(PixelFormat::NV12, 2, 4, &layout) );
+    std::vector<uint8_t> nv12 = { 1,1, 2,2, 3,3, 4,4, 5,5, 6,6 };
+    std::vector<uint8_t> dest2(nv12.size(), 0);
+    sc::copyImageRows(layout, nv12.data(), dest2.data(), true, 1, 2);
+    EXPECT_EQ( dest2, std::vector<uint8_t>({ 0,0, 2,2, 0,0, 0,0, 5,5, 0,0 }) );
+}
+
+TEST(PixelFormat, ConvertRowsToBGR24) {
+    sc::ImageLayout layout;
+    ASSERT_TRUE( sc::calcImageLayout(PixelFormat::BGRA32, 1, 3, &layout) );
+    std::vector<uint8_t> src = { 1,2,3,255, 4,5,6,255, 7,8,9,255 };
+
+    // 1 byte of padding per row, bottom-up
+    std::vector<uint8_t> dest(4 * 3, 0);
+    sc::convertRowsToBGR24(layout, src.data(), dest.data(), 4, true, 0, 1);
+    EXPECT_EQ( dest, std::vector<uint8_t>({ 0,0,0,0, 0,0,0,0, 1,2,3,0 }) );
+}
+
+TEST(PixelFormat, ConvertToBGR24FromBGRA32) {
+    sc::ImageLayout layout;
+    ASSERT_TRUE( sc::calcImageLayout(PixelFormat::BGRA32, 2, 2, &layout) );
+    std::vector<uint8_t> src = { 1,2,3,255, 4,5,6,255, 7,8,9,255, 10,11,12,255 };
+
+    // 2 bytes of padding per row, bottom-up
+    std::vector<uint8_t> dest(8 * 2, 0);
+    sc::convertToBGR24(layout, src.data(), dest.data(), 8, true);
+    EXPECT_EQ( dest, std::vector<uint8_t>({ 7,8,9, 10,11,12, 0,0, 1,2,3, 4,5,6, 0,0 }) );
+}
+
+TEST(PixelFormat, ConvertToBGR24FromYUV) {
+    // Black, white and mid gray in BT.601 limited range
+    const uint8_t Y[] = { 16, 235, 126, 126 };
+    const uint8_t EXPECTED[] = { 0, 255, 128, 128 };
+    const int W = 4, H = 2;
+
+    std::vector<uint8_t> nv12(W * H * 3 / 2, 128);
+    std::vector<uint8_t> i420(W * H * 3 / 2, 128);
+    std::vector<uint8_t> yuy2(W * H * 2, 128);
+    for (int y = 0; y < H; y++)
+    {
+        for (int x = 0; x < W; x++)
+        {
+            nv12[y * W + x] = Y[x];
+            i420[y * W + x] = Y[x];
+            yuy2[y * W * 2 + x * 2] = Y[x];
+        }
+    }
+
+    for (auto format : { PixelFormat::NV12, PixelFormat::I420, PixelFormat::YUY2 })
+    {
+        sc::ImageLayout layout;
+        ASSERT_TRUE( sc::calcImageLayout(format, W, H, &layout) );
+        const auto& src =
+                format == PixelFormat::NV12 ? nv12 :
+                format == PixelFormat::I420 ? i420 : yuy2;
+        std::vector<uint8_t> dest(W * H * 3);
+        sc::convertToBGR24(layout, src.data(), dest.data(), W * 3, false);
+        for (int i = 0; i < W * H * 3; i++)
+        {
+            int expected = EXPECTED[(i / 3) % W];
+            EXPECT_LE( std::abs(dest[i] - expected), 1 ) << "format=" << (int)format << " i=" << i;
+        }
+    }
+}
+
+TEST(PixelFormat, ConvertToBGR24FromNV12Chroma) {
+    // Pure red in BT.601 limited range: Y=81, U=90, V=240
+    sc::ImageLayout layout;
+    ASSERT_TRUE( sc::calcImageLayout(PixelFormat::NV12, 2, 2, &layout) );
+    std::vector<uint8_t> src = { 81, 81, 81, 81, 90, 240 };
+    std::vector<uint8_t> dest(2 * 2 * 3);
+    sc::convertToBGR24(layout, src.data(), dest.data(), 6, false);
+    for (int i = 0; i < 4; i++)
+    {
+        EXPECT_LE( dest[i * 3 + 0], 2 );
+        EXPECT_LE( dest[i * 3 + 1], 2 );
+        EXPECT_GE( dest[i * 3 + 2], 253 );
+    }
+}
+
+} //namespace PixelFormatTest
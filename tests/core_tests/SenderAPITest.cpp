@@ -2,9 +2,11 @@
 #include <gtest/gtest.h>
 
 #include <atomic>
+#include <vector>
 #include <thread>
 #include <chrono>
 #include <cmath>
+#include <cstring>
 #include <softcamcore/FrameBuffer.h>
 #include <softcamcore/Misc.h>
 
@@ -92,6 +94,64 @@ TEST(SenderCreateCamera, InvalidArgs) {
     }
 }
 
+TEST(SenderCreateCamera, PixelFormat)
+{
+    auto handle = sender::CreateCamera(320, 240, 60.0f, sc::PixelFormat::I420);
+    ASSERT_NE( handle, nullptr );
+
+    auto fb = sc::FrameBuffer::open();
+    EXPECT_EQ( fb.format(), sc::PixelFormat::I420 );
+
+    std::vector<unsigned char> image(320 * 240 * 3 / 2, 200);
+    sender::SendFrame(handle, image.data());
+    EXPECT_EQ( fb.frameCounter(), 1 );
+
+    std::vector<unsigned char> dest(320 * 240 * 3 / 2, 0);
+    uint64_t frame_counter = 0;
+    fb.transferNative(dest.data(), &frame_counter);
+    EXPECT_EQ( dest, image );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderCreateCamera, MultipleInstances)
+{
+    auto main = sender::CreateCamera(320, 240, 60.0f, sc::PixelFormat::BGR24, false, 0, "Main");
+    auto slides = sender::CreateCamera(640, 480, 30.0f, sc::PixelFormat::BGR24, false, 1, "Slides");
+    ASSERT_NE( main, nullptr );
+    ASSERT_NE( slides, nullptr );
+
+    // each instance can be taken only once
+    EXPECT_EQ( sender::CreateCamera(320, 240, 60.0f, sc::PixelFormat::BGR24, false, 1), nullptr );
+    EXPECT_EQ( sender::CreateCamera(320, 240, 60.0f, sc::PixelFormat::BGR24, false, -1), nullptr );
+    EXPECT_EQ( sender::CreateCamera(320, 240, 60.0f, sc::PixelFormat::BGR24, false,
+                    sc::CameraRegistry::MAX_INSTANCES), nullptr );
+
+    auto fb0 = sc::FrameBuffer::open(0);
+    EXPECT_EQ( fb0.width(), 320 );
+
+    std::vector<unsigned char> image(640 * 480 * 3, 50);
+    {
+        // released before the camera is deleted, so nobody keeps it alive
+        auto fb1 = sc::FrameBuffer::open(1);
+        EXPECT_EQ( fb1.width(), 640 );
+
+        sender::SendFrame(slides, image.data());
+        EXPECT_EQ( fb0.frameCounter(), 0 );
+        EXPECT_EQ( fb1.frameCounter(), 1 );
+    }
+
+    sender::DeleteCamera(slides);
+    EXPECT_FALSE( sc::FrameBuffer::open(1) );
+    EXPECT_TRUE( sc::FrameBuffer::open(0) );
+
+    // a deleted handle must not be accepted even if another camera is alive
+    EXPECT_NO_THROW({ sender::SendFrame(slides, image.data()); });
+    EXPECT_EQ( fb0.frameCounter(), 0 );
+
+    sender::DeleteCamera(main);
+}
+
 TEST(SenderDeleteCamera, InvalidArgs)
 {
     auto handle = sender::CreateCamera(320, 240);
@@ -281,6 +341,197 @@ TEST(SenderSendFrame, InvalidArgs)
     EXPECT_EQ( fb.frameCounter(), 1 );
 }
 
+TEST(SenderSendFrame, CollectsPacingStats)
+{
+    const float FRAMERATE = 50.0f;
+    auto handle = sender::CreateCamera(320, 240, FRAMERATE);
+    unsigned char image[320 * 240 * 3] = {};
+    EXPECT_TRUE( sender::SetCatchUpPolicy(handle, sc::FrameSchedule::CatchUp::SKIP) );
+
+    sender::SendFrame(handle, image);
+    sender::SendFrame(handle, image);
+    SLEEP_MS(70);   // 3.5 periods
+    sender::SendFrame(handle, image);
+
+    sc::FrameSchedule::Stats stats{};
+    ASSERT_TRUE( sender::GetPacingStats(handle, &stats) );
+    EXPECT_EQ( stats.frames, 3u );
+    EXPECT_EQ( stats.late_frames, 1u );
+    EXPECT_GE( stats.skipped_periods, 1u );
+    EXPECT_EQ( stats.rebases, 0u );
+    std::uint64_t histogram_total = 0;
+    for (auto count : stats.jitter_histogram)
+    {
+        histogram_total += count;
+    }
+    EXPECT_EQ( histogram_total, 3u );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderSendFrame, PacingInvalidArgs)
+{
+    sc::FrameSchedule::Stats stats{};
+    EXPECT_FALSE( sender::GetPacingStats(nullptr, &stats) );
+    EXPECT_FALSE( sender::SetCatchUpPolicy(nullptr, sc::FrameSchedule::CatchUp::BURST) );
+
+    auto handle = sender::CreateCamera(320, 240);
+    EXPECT_FALSE( sender::GetPacingStats(handle, nullptr) );
+    EXPECT_FALSE( sender::SetCatchUpPolicy(handle, (sc::FrameSchedule::CatchUp)99) );
+    sender::DeleteCamera(handle);
+
+    EXPECT_FALSE( sender::GetPacingStats(handle, &stats) );
+}
+
+TEST(SenderSendFrameWithTimestamp, Basic)
+{
+    auto handle = sender::CreateCamera(320, 240, 20.0f);
+    unsigned char image[320 * 240 * 3] = {};
+    auto fb = sc::FrameBuffer::open();
+    std::vector<unsigned char> dest(320 * 240 * 3);
+
+    // The frames go out without waiting for the interval.
+    sc::Timer timer;
+    auto captured = sc::Timer::timestamp();
+    sender::SendFrameWithTimestamp(handle, image, captured, 500000);
+    sender::SendFrameWithTimestamp(handle, image, captured + 500000, 500000);
+    sender::SendFrameWithTimestamp(handle, image, captured + 1000000, 500000);
+    EXPECT_LT( timer.get(), 0.04f );
+    EXPECT_EQ( fb.frameCounter(), 3 );
+
+    uint64_t frame_counter = 0, timestamp = 0, duration = 0;
+    fb.transferToDIB(dest.data(), &frame_counter, &timestamp, &duration);
+    EXPECT_EQ( timestamp, captured + 1000000 );
+    EXPECT_EQ( duration, 500000u );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderSendFrameWithTimestamp, InvalidArgs)
+{
+    auto handle = sender::CreateCamera(320, 240);
+    unsigned char image[320 * 240 * 3] = {};
+    auto fb = sc::FrameBuffer::open();
+
+    EXPECT_NO_THROW({ sender::SendFrameWithTimestamp(nullptr, image, 1, 1); });
+    EXPECT_NO_THROW({ sender::SendFrameWithTimestamp(handle, nullptr, 1, 1); });
+    EXPECT_EQ( fb.frameCounter(), 0 );
+
+    sender::DeleteCamera(handle);
+    EXPECT_NO_THROW({ sender::SendFrameWithTimestamp(handle, image, 1, 1); });
+    EXPECT_EQ( fb.frameCounter(), 0 );
+}
+
+TEST(SenderSendFrameRegion, Basic)
+{
+    auto handle = sender::CreateCamera(320, 240);
+    auto fb = sc::FrameBuffer::open();
+
+    unsigned char image[320 * 240 * 3] = {};
+    sender::SendFrame(handle, image);
+    unsigned char region[16 * 3 * 8];
+    std::memset(region, 77, sizeof(region));
+    EXPECT_TRUE( sender::SendFrameRegion(handle, region, 32, 0, 16, 8, 16 * 3) );
+    EXPECT_EQ( fb.frameCounter(), 2 );
+
+    unsigned char dib[320 * 240 * 3];
+    uint64_t frame_counter = 0;
+    fb.transferToDIB(dib, &frame_counter);
+    EXPECT_EQ( dib[(239 * 320 + 32) * 3], 77 );    // the top row
+    EXPECT_EQ( dib[(239 * 320 + 31) * 3], 0 );
+    EXPECT_EQ( dib[(231 * 320 + 32) * 3], 0 );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderSendFrameRegion, InvalidArgs)
+{
+    auto handle = sender::CreateCamera(320, 240);
+    unsigned char region[16 * 3 * 8] = {};
+
+    EXPECT_FALSE( sender::SendFrameRegion(nullptr, region, 0, 0, 16, 8, 48) );
+    EXPECT_FALSE( sender::SendFrameRegion(handle, nullptr, 0, 0, 16, 8, 48) );
+    EXPECT_FALSE( sender::SendFrameRegion(handle, region, 320, 0, 16, 8, 48) );
+
+    auto fb = sc::FrameBuffer::open();
+    EXPECT_EQ( fb.frameCounter(), 0 );
+
+    sender::DeleteCamera(handle);
+    EXPECT_FALSE( sender::SendFrameRegion(handle, region, 0, 0, 16, 8, 48) );
+}
+
+TEST(SenderLockFrame, Basic)
+{
+    const unsigned char COLOR_VALUE = 45;
+
+    auto handle = sender::CreateCamera(320, 240);
+    auto fb = sc::FrameBuffer::open();
+
+    void* bits = nullptr;
+    int stride = 0;
+    ASSERT_TRUE( sender::LockFrame(handle, &bits, &stride) );
+    ASSERT_NE( bits, nullptr );
+    EXPECT_EQ( stride, 320 * 3 );
+    std::memset(bits, COLOR_VALUE, (std::size_t)stride * 240);
+    EXPECT_EQ( fb.frameCounter(), 0 );
+
+    sender::UnlockFrame(handle);
+    EXPECT_EQ( fb.frameCounter(), 1 );
+
+    unsigned char image[320 * 240 * 3];
+    uint64_t frame_counter = 0;
+    fb.transferToDIB(image, &frame_counter);
+    EXPECT_EQ( image[0], COLOR_VALUE );
+    EXPECT_EQ( image[320 * 240 * 3 - 1], COLOR_VALUE );
+    EXPECT_EQ( frame_counter, 1 );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderLockFrame, KeepsProperInterval)
+{
+    const float FRAMERATE = 30.0f;
+    const float INTERVAL = 1.0f / FRAMERATE;
+    auto handle = sender::CreateCamera(320, 240, FRAMERATE);
+    void* bits = nullptr;
+
+    sc::Timer timer;
+    ASSERT_TRUE( sender::LockFrame(handle, &bits, nullptr) );
+    sender::UnlockFrame(handle);    // first
+    auto lap1 = timer.get();
+    ASSERT_TRUE( sender::LockFrame(handle, &bits, nullptr) );
+    sender::UnlockFrame(handle);    // second
+    auto lap2 = timer.get();
+
+    EXPECT_LE( lap1, 0.002f );
+    EXPECT_GE( lap2, INTERVAL - 0.010f );
+    EXPECT_LE( lap2, INTERVAL + 0.010f );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderLockFrame, InvalidArgs)
+{
+    auto handle = sender::CreateCamera(320, 240);
+    void* bits = nullptr;
+    int stride = 0;
+
+    EXPECT_FALSE( sender::LockFrame(nullptr, &bits, &stride) );
+    EXPECT_FALSE( sender::LockFrame(handle, nullptr, &stride) );
+    EXPECT_NO_THROW({ sender::UnlockFrame(nullptr); });
+
+    auto fb = sc::FrameBuffer::open();
+    sender::UnlockFrame(handle);    // not locked. no effect
+    EXPECT_EQ( fb.frameCounter(), 0 );
+
+    EXPECT_TRUE( sender::LockFrame(handle, &bits, nullptr) ); // stride is optional
+    sender::DeleteCamera(handle);
+
+    EXPECT_FALSE( sender::LockFrame(handle, &bits, &stride) );
+    EXPECT_NO_THROW({ sender::UnlockFrame(handle); });
+    EXPECT_EQ( fb.frameCounter(), 0 );
+}
+
 TEST(SenderWaitForConnection, ShouldBlockUntilReceiverConnected)
 {
     auto handle = sender::CreateCamera(320, 240);
@@ -396,4 +647,130 @@ TEST(SenderIsConnected, InvalidArgs)
     EXPECT_EQ( ret, false );
 }
 
+TEST(SenderSetSendMode, AsyncSendFrameNeverBlocks)
+{
+    const float FRAMERATE = 20.0f;
+    auto handle = sender::CreateCamera(320, 240, FRAMERATE);
+    auto fb = sc::FrameBuffer::open();
+    ASSERT_TRUE( sender::SetSendMode(handle, sender::SendMode::ASYNC_DROP_OLDEST) );
+    unsigned char image[320 * 240 * 3] = {};
+
+    sc::Timer timer;
+    std::memset(image, 1, sizeof(image));
+    sender::SendFrame(handle, image);
+    while (fb.frameCounter() < 1 && timer.get() < 1.0f) { SLEEP_MS(1); }
+    for (int i = 2; i <= 5; i++)
+    {
+        std::memset(image, i, sizeof(image));
+        sender::SendFrame(handle, image);
+    }
+    EXPECT_LE( timer.get(), 0.010f );
+
+    // The first frame went out at once, and the last one replaces those
+    // waiting for the next period.
+    while (fb.frameCounter() < 2 && timer.get() < 1.0f) { SLEEP_MS(1); }
+    EXPECT_EQ( fb.frameCounter(), 2 );
+    EXPECT_GE( timer.get(), 1.0f / FRAMERATE - 0.010f );
+    EXPECT_EQ( sender::DroppedFrames(handle), 3u );
+
+    unsigned char dest[320 * 240 * 3];
+    uint64_t frame_counter = 0;
+    fb.transferToDIB(dest, &frame_counter);
+    EXPECT_EQ( dest[0], 5 );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderSetSendMode, AsyncDropNewestKeepsWaitingFrame)
+{
+    auto handle = sender::CreateCamera(320, 240, 20.0f);
+    auto fb = sc::FrameBuffer::open();
+    ASSERT_TRUE( sender::SetSendMode(handle, sender::SendMode::ASYNC_DROP_NEWEST) );
+    unsigned char image[320 * 240 * 3] = {};
+
+    sc::Timer timer;
+    std::memset(image, 1, sizeof(image));
+    sender::SendFrame(handle, image);
+    while (fb.frameCounter() < 1 && timer.get() < 1.0f) { SLEEP_MS(1); }
+    for (int i = 2; i <= 5; i++)
+    {
+        std::memset(image, i, sizeof(image));
+        sender::SendFrame(handle, image);
+    }
+    while (fb.frameCounter() < 2 && timer.get() < 1.0f) { SLEEP_MS(1); }
+    EXPECT_EQ( sender::DroppedFrames(handle), 3u );
+
+    unsigned char dest[320 * 240 * 3];
+    uint64_t frame_counter = 0;
+    fb.transferToDIB(dest, &frame_counter);
+    EXPECT_EQ( dest[0], 2 );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderSetSendMode, AsyncLockFrame)
+{
+    auto handle = sender::CreateCamera(320, 240, 20.0f, sc::PixelFormat::BGR24, true);
+    auto fb = sc::FrameBuffer::open();
+    ASSERT_TRUE( sender::SetSendMode(handle, sender::SendMode::ASYNC_DROP_OLDEST) );
+
+    // The staging area is top-down even if the slots are in DIB layout.
+    void* bits = nullptr;
+    int stride = 0;
+    ASSERT_TRUE( sender::LockFrame(handle, &bits, &stride) );
+    EXPECT_EQ( stride, 320 * 3 );
+    std::memset(bits, 0, (std::size_t)stride * 240);
+    std::memset(bits, 99, (std::size_t)stride);     // the top row
+
+    sc::Timer timer;
+    sender::UnlockFrame(handle);
+    EXPECT_LE( timer.get(), 0.002f );
+    while (fb.frameCounter() < 1 && timer.get() < 1.0f) { SLEEP_MS(1); }
+
+    unsigned char dest[320 * 240 * 3];
+    uint64_t frame_counter = 0;
+    fb.transferToDIB(dest, &frame_counter);
+    EXPECT_EQ( dest[239 * 320 * 3], 99 );
+    EXPECT_EQ( dest[0], 0 );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderSetSendMode, BlockingModeDeliversWaitingFrames)
+{
+    auto handle = sender::CreateCamera(320, 240, 20.0f);
+    auto fb = sc::FrameBuffer::open();
+    ASSERT_TRUE( sender::SetSendMode(handle, sender::SendMode::ASYNC_DROP_NEWEST) );
+    unsigned char image[320 * 240 * 3] = {};
+
+    sc::Timer timer;
+    sender::SendFrame(handle, image);
+    while (fb.frameCounter() < 1 && timer.get() < 1.0f) { SLEEP_MS(1); }
+    sender::SendFrame(handle, image);   // waits for the next period
+    EXPECT_TRUE( sender::SetSendMode(handle, sender::SendMode::BLOCKING) );
+    EXPECT_EQ( fb.frameCounter(), 2 );
+    EXPECT_EQ( sender::DroppedFrames(handle), 0u );
+
+    // Regions are sent only in the blocking mode.
+    unsigned char region[16 * 3 * 8] = {};
+    EXPECT_TRUE( sender::SendFrameRegion(handle, region, 0, 0, 16, 8, 48) );
+    ASSERT_TRUE( sender::SetSendMode(handle, sender::SendMode::ASYNC_DROP_OLDEST) );
+    EXPECT_FALSE( sender::SendFrameRegion(handle, region, 0, 0, 16, 8, 48) );
+
+    sender::DeleteCamera(handle);
+}
+
+TEST(SenderSetSendMode, InvalidArgs)
+{
+    EXPECT_FALSE( sender::SetSendMode(nullptr, sender::SendMode::ASYNC_DROP_OLDEST) );
+    EXPECT_EQ( sender::DroppedFrames(nullptr), 0u );
+
+    auto handle = sender::CreateCamera(320, 240);
+    EXPECT_FALSE( sender::SetSendMode(handle, (sender::SendMode)99) );
+    sender::DeleteCamera(handle);
+
+    EXPECT_FALSE( sender::SetSendMode(handle, sender::SendMode::ASYNC_DROP_OLDEST) );
+    EXPECT_EQ( sender::DroppedFrames(handle), 0u );
+}
+
 } //namespace SenderAPITest
@@ -0,0 +1,52 @@
+#include <softcamcore/SleepCalibration.h>
+#include <gtest/gtest.h>
+
+
+namespace SleepCalibrationTest {
+namespace sc = softcam;
+
+const std::uint64_t FREQUENCY = 1000000;     // a tick is a microsecond
+
+
+TEST(SleepCalibration, StartsWithInitialMargin) {
+    sc::SleepCalibration calibration(FREQUENCY);
+    EXPECT_EQ( calibration.margin(), sc::SleepCalibration::INITIAL_MARGIN_US );
+
+    sc::SleepCalibration fine(10 * FREQUENCY);
+    EXPECT_EQ( fine.margin(), sc::SleepCalibration::INITIAL_MARGIN_US * 10 );
+}
+
+TEST(SleepCalibration, JumpsToLateWakeUp) {
+    sc::SleepCalibration calibration(FREQUENCY);
+    calibration.update(800);
+    EXPECT_EQ( calibration.margin(), 800u );
+}
+
+TEST(SleepCalibration, DecaysSlowlyToPreciseWakeUp) {
+    sc::SleepCalibration calibration(FREQUENCY);
+    calibration.update(1000);
+
+    calibration.update(100);
+    EXPECT_LT( calibration.margin(), 1000u );
+    EXPECT_GT( calibration.margin(), 900u );
+
+    for (int i = 0; i < 500; i++)
+    {
+        calibration.update(100);
+    }
+    EXPECT_EQ( calibration.margin(), 100u );
+}
+
+TEST(SleepCalibration, StaysWithinLimits) {
+    sc::SleepCalibration calibration(FREQUENCY);
+    calibration.update(1000000);
+    EXPECT_EQ( calibration.margin(), sc::SleepCalibration::MAX_MARGIN_US );
+
+    for (int i = 0; i < 1000; i++)
+    {
+        calibration.update(0);
+    }
+    EXPECT_EQ( calibration.margin(), sc::SleepCalibration::MIN_MARGIN_US );
+}
+
+} //namespace SleepCalibrationTest
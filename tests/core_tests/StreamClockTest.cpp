@@ -0,0 +1,123 @@
+#include <softcamcore/StreamClock.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+
+namespace StreamClockTest {
+namespace sc = softcam;
+
+const std::int64_t DURATION = 333333;   // 30 fps
+const std::int64_t CLOCK_ORIGIN = 5000000000;
+
+
+TEST(StreamClock, FirstSampleIsDiscontinuity) {
+    sc::StreamClock clock;
+    clock.reset(DURATION);
+
+    // The reference clock is ahead of the timestamp by CLOCK_ORIGIN, and
+    // the stream started at CLOCK_ORIGIN + 1000.
+    auto sample = clock.map(9000, 0, CLOCK_ORIGIN + 10000, 10000, CLOCK_ORIGIN + 1000);
+    EXPECT_TRUE( sample.discontinuity );
+    EXPECT_EQ( sample.start, 8000 );
+    EXPECT_EQ( sample.stop, 8000 + DURATION );
+    EXPECT_EQ( clock.offset(), CLOCK_ORIGIN );
+}
+
+TEST(StreamClock, KeepsCaptureIntervals) {
+    sc::StreamClock clock;
+    clock.reset(DURATION);
+
+    // Each frame is delivered with a different delay after its capture.
+    const std::int64_t delays[] = { 20000, 150000, 50000, 90000, 10000 };
+    for (int i = 0; i < 5; i++)
+    {
+        std::uint64_t captured = 1000000 + (std::uint64_t)(i * DURATION);
+        std::uint64_t now = captured + (std::uint64_t)delays[i];
+        auto sample = clock.map(captured, (std::uint64_t)DURATION,
+                                CLOCK_ORIGIN + (std::int64_t)now, now, CLOCK_ORIGIN);
+        EXPECT_EQ( sample.start, (std::int64_t)captured );
+        EXPECT_EQ( sample.stop - sample.start, DURATION );
+        EXPECT_EQ( sample.discontinuity, i == 0 );
+    }
+}
+
+TEST(StreamClock, FollowsDriftSlowly) {
+    sc::StreamClock clock;
+    clock.reset(DURATION);
+    clock.map(0, 0, CLOCK_ORIGIN, 0, CLOCK_ORIGIN);
+
+    // The reference clock runs faster by 1000 units every frame.
+    std::int64_t last_offset = clock.offset();
+    for (int i = 1; i <= 100; i++)
+    {
+        std::uint64_t now = (std::uint64_t)(i * DURATION);
+        auto sample = clock.map(now, 0, CLOCK_ORIGIN + (std::int64_t)now + i * 1000, now, CLOCK_ORIGIN);
+        EXPECT_FALSE( sample.discontinuity );
+        EXPECT_GE( clock.offset(), last_offset );
+        EXPECT_LE( clock.offset() - last_offset, 1000 * i / 16 + 1 );
+        last_offset = clock.offset();
+    }
+    // Caught up except a lag which a constant drift leaves.
+    auto lag = CLOCK_ORIGIN + 100 * 1000 - clock.offset();
+    EXPECT_GE( lag, 0 );
+    EXPECT_LE( lag, 16 * 1000 );
+}
+
+TEST(StreamClock, IgnoresSmallJitter) {
+    sc::StreamClock clock;
+    clock.reset(DURATION);
+    clock.map(0, 0, CLOCK_ORIGIN, 0, CLOCK_ORIGIN);
+
+    for (int i = 1; i <= 50; i++)
+    {
+        // The two clocks are read a few microseconds apart.
+        std::int64_t jitter = (i % 3 - 1) * 15;
+        std::uint64_t now = (std::uint64_t)(i * DURATION);
+        auto sample = clock.map(now, 0, CLOCK_ORIGIN + (std::int64_t)now + jitter, now, CLOCK_ORIGIN);
+        EXPECT_EQ( sample.start, (std::int64_t)now );
+    }
+    EXPECT_EQ( clock.offset(), CLOCK_ORIGIN );
+}
+
+TEST(StreamClock, JumpOfClockResynchronizes) {
+    sc::StreamClock clock;
+    clock.reset(DURATION);
+    clock.map(0, 0, CLOCK_ORIGIN, 0, CLOCK_ORIGIN);
+
+    auto jump = 5 * sc::StreamClock::MAX_OFFSET_ERROR;
+    auto sample = clock.map(DURATION, 0, CLOCK_ORIGIN + DURATION + jump, DURATION, CLOCK_ORIGIN);
+    EXPECT_TRUE( sample.discontinuity );
+    EXPECT_EQ( clock.offset(), CLOCK_ORIGIN + jump );
+    EXPECT_EQ( sample.start, DURATION + jump );
+}
+
+TEST(StreamClock, NeverGoesBackwards) {
+    sc::StreamClock clock;
+    clock.reset(DURATION);
+    auto first = clock.map(1000000, 0, CLOCK_ORIGIN + 1000000, 1000000, CLOCK_ORIGIN);
+
+    // A frame captured before the previous one
+    auto second = clock.map(900000, 0, CLOCK_ORIGIN + 1100000, 1100000, CLOCK_ORIGIN);
+    EXPECT_TRUE( second.discontinuity );
+    EXPECT_GT( second.start, first.start );
+    EXPECT_GT( second.stop, second.start );
+
+    auto third = clock.map(1400000, 0, CLOCK_ORIGIN + 1400000, 1400000, CLOCK_ORIGIN);
+    EXPECT_FALSE( third.discontinuity );
+    EXPECT_EQ( third.start, 1400000 );
+}
+
+TEST(StreamClock, ResetStartsOver) {
+    sc::StreamClock clock;
+    clock.reset(DURATION);
+    clock.map(1000000, 0, CLOCK_ORIGIN + 1000000, 1000000, CLOCK_ORIGIN);
+
+    clock.reset(2 * DURATION);
+    auto sample = clock.map(10, 0, 20, 20, 0);
+    EXPECT_TRUE( sample.discontinuity );
+    EXPECT_EQ( sample.start, 10 );
+    EXPECT_EQ( sample.stop, 10 + 2 * DURATION );
+}
+
+} //namespace StreamClockTest
@@ -0,0 +1,125 @@
+#include <softcamcore/TimerSchedule.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+
+namespace TimerScheduleTest {
+namespace sc = softcam;
+
+// Runs everything due at `now` and returns the ids in the order they ran.
+std::vector<int> runDue(sc::TimerSchedule& schedule, uint64_t now)
+{
+    std::vector<int> ids;
+    sc::TimerSchedule::Due due;
+    while (schedule.takeDue(now, &due))
+    {
+        (*due.callback)();
+        ids.push_back(due.id);
+    }
+    return ids;
+}
+
+
+TEST(TimerSchedule, Empty) {
+    sc::TimerSchedule schedule;
+
+    EXPECT_TRUE( schedule.empty() );
+    EXPECT_EQ( schedule.nextDeadline(), sc::TimerSchedule::NEVER );
+
+    sc::TimerSchedule::Due due;
+    EXPECT_FALSE( schedule.takeDue(1000, &due) );
+}
+
+TEST(TimerSchedule, RunsPeriodically) {
+    sc::TimerSchedule schedule;
+    int count = 0;
+    int id = schedule.add(100, 20, [&] { count++; });
+
+    EXPECT_GT( id, 0 );
+    EXPECT_EQ( schedule.nextDeadline(), 120u );
+    EXPECT_TRUE( runDue(schedule, 119).empty() );
+    EXPECT_EQ( runDue(schedule, 120), std::vector<int>{ id } );
+    EXPECT_EQ( schedule.nextDeadline(), 140u );
+    EXPECT_EQ( runDue(schedule, 145), std::vector<int>{ id } );
+    EXPECT_EQ( schedule.nextDeadline(), 160u );     // keeps the phase
+    EXPECT_EQ( count, 2 );
+}
+
+TEST(TimerSchedule, SkipsMissedPeriods) {
+    sc::TimerSchedule schedule;
+    int count = 0;
+    schedule.add(0, 20, [&] { count++; });
+
+    // The thread has been stalled for five periods.
+    runDue(schedule, 105);
+    EXPECT_EQ( count, 1 );
+    EXPECT_EQ( schedule.nextDeadline(), 125u );
+}
+
+TEST(TimerSchedule, EarliestFirst) {
+    sc::TimerSchedule schedule;
+    int slow = schedule.add(0, 50, []{});
+    int fast = schedule.add(0, 20, []{});
+
+    EXPECT_EQ( schedule.nextDeadline(), 20u );
+    EXPECT_EQ( runDue(schedule, 20), std::vector<int>{ fast } );
+    EXPECT_EQ( runDue(schedule, 40), std::vector<int>{ fast } );
+    EXPECT_EQ( runDue(schedule, 50), std::vector<int>{ slow } );
+    EXPECT_EQ( runDue(schedule, 60), std::vector<int>{ fast } );
+
+    // Both are due; the one late the longest goes first.
+    auto ids = runDue(schedule, 100);
+    EXPECT_EQ( ids, (std::vector<int>{ fast, slow }) );
+}
+
+TEST(TimerSchedule, Remove) {
+    sc::TimerSchedule schedule;
+    int a = schedule.add(0, 10, []{});
+    int b = schedule.add(0, 30, []{});
+    EXPECT_EQ( schedule.size(), 2u );
+
+    EXPECT_TRUE( schedule.remove(a) );
+    EXPECT_FALSE( schedule.remove(a) );
+    EXPECT_EQ( schedule.size(), 1u );
+    EXPECT_EQ( schedule.nextDeadline(), 30u );
+    EXPECT_EQ( runDue(schedule, 30), std::vector<int>{ b } );
+
+    EXPECT_TRUE( schedule.remove(b) );
+    EXPECT_TRUE( schedule.empty() );
+    EXPECT_FALSE( schedule.remove(12345) );
+}
+
+TEST(TimerSchedule, IdsAreNotReused) {
+    sc::TimerSchedule schedule;
+    int a = schedule.add(0, 10, []{});
+    schedule.remove(a);
+    int b = schedule.add(0, 10, []{});
+    EXPECT_NE( a, b );
+
+    // A stale id doesn't remove the new timer.
+    EXPECT_FALSE( schedule.remove(a) );
+    EXPECT_EQ( schedule.size(), 1u );
+}
+
+TEST(TimerSchedule, ZeroIntervalStillAdvances) {
+    sc::TimerSchedule schedule;
+    schedule.add(0, 0, []{});
+
+    EXPECT_EQ( runDue(schedule, 5).size(), 1u );
+    EXPECT_EQ( schedule.nextDeadline(), 6u );
+}
+
+TEST(TimerSchedule, CallbackOutlivesRemoval) {
+    sc::TimerSchedule schedule;
+    int count = 0;
+    int id = schedule.add(0, 10, [&] { count++; });
+
+    sc::TimerSchedule::Due due;
+    ASSERT_TRUE( schedule.takeDue(10, &due) );
+    schedule.remove(id);
+    (*due.callback)();
+    EXPECT_EQ( count, 1 );
+}
+
+} //namespace TimerScheduleTest
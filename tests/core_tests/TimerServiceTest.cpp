@@ -0,0 +1,131 @@
+#include <softcamcore/TimerService.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <set>
+
+
+namespace TimerServiceTest {
+namespace sc = softcam;
+
+#define SLEEP_MS(msec) \
+        std::this_thread::sleep_for(std::chrono::milliseconds(msec))
+
+
+TEST(TimerService, CallsPeriodically)
+{
+    std::atomic<int> count{0};
+    auto timer = sc::TimerService::schedule(0.01f, [&] { ++count; });
+
+    SLEEP_MS(100);
+    EXPECT_GE( count.load(), 3 );
+    EXPECT_LE( count.load(), 11 );
+}
+
+TEST(TimerService, AllTimersShareOneThread)
+{
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    auto record = [&]
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.insert(std::this_thread::get_id());
+    };
+    auto timer1 = sc::TimerService::schedule(0.01f, record);
+    auto timer2 = sc::TimerService::schedule(0.02f, record);
+    auto timer3 = sc::TimerService::schedule(0.005f, record);
+    EXPECT_EQ( sc::TimerService::timerCount(), 3u );
+
+    SLEEP_MS(100);
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ( threads.size(), 1u );
+    EXPECT_EQ( threads.count(std::this_thread::get_id()), 0u );
+}
+
+TEST(TimerService, ReleasingHandleStopsCallbacks)
+{
+    std::atomic<int> count{0};
+    auto timer = sc::TimerService::schedule(0.005f, [&] { ++count; });
+    SLEEP_MS(50);
+
+    timer.reset();
+    auto value = count.load();
+    SLEEP_MS(50);
+    EXPECT_EQ( count.load(), value );
+    EXPECT_EQ( sc::TimerService::timerCount(), 0u );
+}
+
+TEST(TimerService, ReleasingHandleWaitsForRunningCallback)
+{
+    std::atomic<bool> entered{false}, finished{false};
+    auto timer = sc::TimerService::schedule(0.001f, [&]
+    {
+        entered = true;
+        SLEEP_MS(50);
+        finished = true;
+    });
+    while (!entered) { SLEEP_MS(1); }
+
+    timer.reset();
+    EXPECT_TRUE( finished.load() );
+}
+
+TEST(TimerService, SlowCallbackDelaysOthersOnly)
+{
+    std::atomic<int> count{0};
+    auto slow = sc::TimerService::schedule(0.01f, [] { SLEEP_MS(30); });
+    auto fast = sc::TimerService::schedule(0.01f, [&] { ++count; });
+
+    SLEEP_MS(200);
+    slow.reset();
+    EXPECT_GE( count.load(), 3 );
+}
+
+TEST(TimerService, CallbackCanReleaseItsOwnHandle)
+{
+    // The callback may still be running after the test, so it refers only
+    // to what it owns.
+    struct Context
+    {
+        std::mutex              mutex;
+        std::shared_ptr<void>   timer;
+        std::atomic<int>        count{0};
+    };
+    auto context = std::make_shared<Context>();
+    {
+        std::lock_guard<std::mutex> lock(context->mutex);
+        auto ptr = context.get();
+        context->timer = sc::TimerService::schedule(0.005f, [ptr]
+        {
+            std::lock_guard<std::mutex> lock(ptr->mutex);
+            if (ptr->timer)
+            {
+                ++ptr->count;
+                auto timer = std::move(ptr->timer);
+                timer.reset();
+            }
+        });
+    }
+    SLEEP_MS(50);
+    std::lock_guard<std::mutex> lock(context->mutex);
+    EXPECT_EQ( context->count.load(), 1 );
+    EXPECT_EQ( sc::TimerService::timerCount(), 0u );
+}
+
+TEST(TimerService, ThreadRestartsAfterLastTimer)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        std::atomic<int> count{0};
+        auto timer = sc::TimerService::schedule(0.005f, [&] { ++count; });
+        SLEEP_MS(30);
+        timer.reset();
+        EXPECT_GT( count.load(), 0 );
+        EXPECT_EQ( sc::TimerService::timerCount(), 0u );
+    }
+}
+
+} //namespace TimerServiceTest
@@ -167,4 +167,43 @@ TEST(Watchdog, MonitorDetectsRevival)
     EXPECT_EQ( monitor.alive(), true );
 }
 
+TEST(Watchdog, LazyMonitorContinues)
+{
+    const float MONITOR_TIMEOUT = 0.10f;
+
+    std::atomic<unsigned>   signal{0};
+
+    auto monitor = sc::Watchdog::createLazyMonitor(
+                        MONITOR_TIMEOUT,
+                        [&] { return signal.load(); });
+    EXPECT_EQ( monitor.alive(), true );
+
+    for (int i = 0; i < 10; i++)
+    {
+        SLEEP_S(MONITOR_TIMEOUT / 4);
+        ++signal;
+        EXPECT_EQ( monitor.alive(), true );
+    }
+}
+
+TEST(Watchdog, LazyMonitorTimeouts)
+{
+    const float MONITOR_TIMEOUT = 0.10f;
+
+    std::atomic<unsigned>   signal{0};
+
+    auto monitor = sc::Watchdog::createLazyMonitor(
+                        MONITOR_TIMEOUT,
+                        [&] { return signal.load(); });
+
+    SLEEP_S(MONITOR_TIMEOUT * 2);
+    EXPECT_EQ( monitor.alive(), false );
+
+    ++signal;
+    EXPECT_EQ( monitor.alive(), true );     // revived
+
+    monitor.stop();
+    EXPECT_EQ( monitor.alive(), false );
+}
+
 } //namespace WatchdogTest
@@ -1,6 +1,8 @@
 #include <softcam/softcam.h>
 #include <gtest/gtest.h>
 
+#include <vector>
+
 
 namespace RawAPITest {
 
@@ -78,6 +80,90 @@ TEST(scCreateCamera, TooLarge) {
     scDeleteCamera(cam);
 }
 
+TEST(scCreateCameraEx, Basic) {
+    for (int format : { scPixelFormat_BGR24, scPixelFormat_BGRA32, scPixelFormat_NV12,
+                        scPixelFormat_I420, scPixelFormat_YUY2 })
+    {
+        void* cam = scCreateCameraEx(320, 240, 60, format);
+        EXPECT_NE( cam, nullptr ) << "format=" << format;
+        scDeleteCamera(cam);
+    }
+}
+
+TEST(scCreateCameraEx, DIBLayout) {
+    void* cam = scCreateCameraEx(320, 240, 60, scPixelFormat_BGR24 | scPixelFormat_FlagDIBLayout);
+    ASSERT_NE( cam, nullptr );
+    void* bits = nullptr;
+    int stride = 0;
+    EXPECT_TRUE( scLockFrame(cam, &bits, &stride) );
+    EXPECT_EQ( stride, -320 * 3 );
+    scUnlockFrame(cam);
+    scDeleteCamera(cam);
+}
+
+TEST(scCreateCameraEx, InvalidArgs) {
+    EXPECT_EQ( scCreateCameraEx(320, 240, 60, -1), nullptr );
+    EXPECT_EQ( scCreateCameraEx(320, 240, 60, 5), nullptr );
+    EXPECT_EQ( scCreateCameraEx(320, 240, 60, scPixelFormat_BGR24 | 0x40000), nullptr );
+    EXPECT_EQ( scCreateCameraEx(0, 240, 60, scPixelFormat_NV12), nullptr );
+    EXPECT_EQ( scCreateCameraEx(320, 240, -60, scPixelFormat_NV12), nullptr );
+}
+
+TEST(scCreateCameraEx, LargePages) {
+    void* cam = scCreateCameraEx(1920, 1080, 60, scPixelFormat_BGR24);
+    EXPECT_FALSE( scUsesLargePages(cam) );
+    scDeleteCamera(cam);
+    EXPECT_FALSE( scUsesLargePages(nullptr) );
+
+    // Without the "Lock pages in memory" privilege the camera falls back to
+    // normal pages.
+    cam = scCreateCameraEx(1920, 1080, 60, scPixelFormat_BGR24 | scPixelFormat_FlagLargePages);
+    ASSERT_NE( cam, nullptr );
+    bool large_pages = scUsesLargePages(cam);
+    std::vector<unsigned char> image(1920 * 1080 * 3, 128);
+    scSendFrame(cam, image.data());
+    void* bits = nullptr;
+    int stride = 0;
+    EXPECT_TRUE( scLockFrame(cam, &bits, &stride) );
+    EXPECT_NE( bits, nullptr );
+    EXPECT_EQ( stride, 1920 * 3 );
+    scUnlockFrame(cam);
+    scDeleteCamera(cam);
+    if (!large_pages) {
+        GTEST_SKIP() << "large pages not granted (needs the \"Lock pages in memory\" privilege)";
+    }
+}
+
+TEST(scCreateCameraInstance, Basic) {
+    void* cam0 = scCreateCameraInstance(0, "Main", 320, 240, 60, scPixelFormat_BGR24);
+    void* cam1 = scCreateCameraInstance(1, "Slides", 640, 480, 30, scPixelFormat_NV12);
+    void* cam3 = scCreateCameraInstance(3, nullptr, 320, 240, 60, scPixelFormat_BGR24);
+    EXPECT_NE( cam0, nullptr );
+    EXPECT_NE( cam1, nullptr );
+    EXPECT_NE( cam3, nullptr );
+    scDeleteCamera(cam0);
+    scDeleteCamera(cam1);
+    scDeleteCamera(cam3);
+}
+
+TEST(scCreateCameraInstance, SameInstanceTwiceFails) {
+    void* cam = scCreateCameraInstance(2, "Feed", 320, 240, 60, scPixelFormat_BGR24);
+    ASSERT_NE( cam, nullptr );
+    EXPECT_EQ( scCreateCameraInstance(2, "Feed", 320, 240, 60, scPixelFormat_BGR24), nullptr );
+    scDeleteCamera(cam);
+
+    cam = scCreateCameraInstance(2, "Feed", 320, 240, 60, scPixelFormat_BGR24);
+    EXPECT_NE( cam, nullptr );
+    scDeleteCamera(cam);
+}
+
+TEST(scCreateCameraInstance, InvalidArgs) {
+    EXPECT_EQ( scCreateCameraInstance(-1, nullptr, 320, 240, 60, scPixelFormat_BGR24), nullptr );
+    EXPECT_EQ( scCreateCameraInstance(4, nullptr, 320, 240, 60, scPixelFormat_BGR24), nullptr );
+    EXPECT_EQ( scCreateCameraInstance(1, nullptr, 0, 240, 60, scPixelFormat_BGR24), nullptr );
+    EXPECT_EQ( scCreateCameraInstance(1, nullptr, 320, 240, 60, 5), nullptr );
+}
+
 TEST(scDeleteCamera, IgnoresNullPointer) {
     scDeleteCamera(nullptr);
 }
@@ -93,4 +179,75 @@ TEST(scDeleteCamera, IgnoresInvalidPointer) {
     scDeleteCamera(&x);
 }
 
+TEST(scSendFrameWithTimestamp, Basic) {
+    void* cam = scCreateCamera(320, 240, 60);
+    std::vector<unsigned char> image(320 * 240 * 3);
+    scSendFrameWithTimestamp(cam, image.data(), 0, 0);                // now
+    scSendFrameWithTimestamp(cam, image.data(), 123456789, 166667);
+    scSendFrameWithTimestamp(cam, image.data(), -1, -1);              // same as 0
+    scDeleteCamera(cam);
+}
+
+TEST(scSendFrameWithTimestamp, IgnoresInvalidPointer) {
+    int x = 0;
+    std::vector<unsigned char> image(320 * 240 * 3);
+    scSendFrameWithTimestamp(nullptr, image.data(), 0, 0);
+    scSendFrameWithTimestamp(&x, image.data(), 0, 0);
+}
+
+TEST(scSetSendMode, Basic) {
+    void* cam = scCreateCamera(320, 240, 60);
+    std::vector<unsigned char> image(320 * 240 * 3);
+    EXPECT_TRUE( scSetSendMode(cam, scSendMode_AsyncDropOldest) );
+    scSendFrame(cam, image.data());
+    scSendFrame(cam, image.data());
+    scSendFrame(cam, image.data());
+    EXPECT_TRUE( scSetSendMode(cam, scSendMode_AsyncDropNewest) );
+    EXPECT_TRUE( scSetSendMode(cam, scSendMode_Blocking) );
+    EXPECT_GE( scGetDroppedFrames(cam), 0 );
+    EXPECT_FALSE( scSetSendMode(cam, 3) );
+    EXPECT_FALSE( scSetSendMode(cam, -1) );
+    scDeleteCamera(cam);
+}
+
+TEST(scSetSendMode, IgnoresInvalidPointer) {
+    int x = 0;
+    EXPECT_FALSE( scSetSendMode(nullptr, scSendMode_AsyncDropOldest) );
+    EXPECT_FALSE( scSetSendMode(&x, scSendMode_AsyncDropOldest) );
+    EXPECT_EQ( scGetDroppedFrames(nullptr), 0 );
+    EXPECT_EQ( scGetDroppedFrames(&x), 0 );
+}
+
+TEST(scSendFrameRegion, Basic) {
+    void* cam = scCreateCamera(320, 240, 60);
+    unsigned char region[16 * 3 * 8] = {};
+    EXPECT_TRUE( scSendFrameRegion(cam, region, 0, 0, 16, 8, 16 * 3) );
+    EXPECT_FALSE( scSendFrameRegion(cam, region, 310, 0, 16, 8, 16 * 3) );
+    scDeleteCamera(cam);
+
+    void* nv12 = scCreateCameraEx(320, 240, 60, scPixelFormat_NV12);
+    EXPECT_FALSE( scSendFrameRegion(nv12, region, 0, 0, 16, 8, 16) );
+    scDeleteCamera(nv12);
+}
+
+TEST(scLockFrame, Basic) {
+    void* cam = scCreateCamera(320, 240, 60);
+    void* bits = nullptr;
+    int stride = 0;
+    EXPECT_TRUE( scLockFrame(cam, &bits, &stride) );
+    EXPECT_NE( bits, nullptr );
+    EXPECT_EQ( stride, 320 * 3 );
+    scUnlockFrame(cam);
+    scDeleteCamera(cam);
+}
+
+TEST(scLockFrame, IgnoresInvalidPointer) {
+    int x = 0;
+    void* bits = nullptr;
+    EXPECT_FALSE( scLockFrame(nullptr, &bits, nullptr) );
+    EXPECT_FALSE( scLockFrame(&x, &bits, nullptr) );
+    scUnlockFrame(nullptr);
+    scUnlockFrame(&x);
+}
+
 } //namespace RawAPITest
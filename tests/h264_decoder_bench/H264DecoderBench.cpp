@@ -0,0 +1,101 @@
+// Decodes an H.264 Annex B file with the software decoder and reports how
+// fast it went, for profiling off Windows:
+//
+//   h264_decoder_bench <stream.h264> [--repeat N] [--scalar] [--output frames.nv12]
+//
+// Access units are split at access unit delimiters, or at slices with
+// first_mb_in_slice 0 when the stream has none, and fed one per DecodeNal()
+// call as the MF source does with pipe messages. --output writes the decoded
+// frames as raw NV12 (the cropped size), to compare with another decoder,
+// e.g. the output of ffmpeg -pix_fmt nv12.
+
+#include <mf_source/SoftH264Decoder.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "../mf_source_tests/H264StreamFile.h"
+
+namespace fm = FluxMic;
+namespace sf = H264StreamFile;
+
+namespace {
+
+void WriteFrame(FILE* f, const fm::DecodedFrame& frame) {
+    sf::ForEachNv12Row(frame, [f](const uint8_t* row, size_t size) { fwrite(row, 1, size, f); });
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* input = nullptr;
+    const char* output = nullptr;
+    int repeat = 1;
+    bool scalar = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+            repeat = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--output") && i + 1 < argc) {
+            output = argv[++i];
+        } else if (!strcmp(argv[i], "--scalar")) {
+            scalar = true;
+        } else if (!input) {
+            input = argv[i];
+        }
+    }
+    if (!input) {
+        fprintf(stderr, "usage: %s <stream.h264> [--repeat N] [--scalar] [--output frames.nv12]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<uint8_t> data;
+    if (!sf::ReadFile(input, data)) {
+        fprintf(stderr, "cannot read %s\n", input);
+        return 1;
+    }
+    std::vector<sf::AccessUnit> units = sf::SplitAccessUnits(data);
+
+    const fm::H264DspFunctions& dsp = scalar ? fm::H264DspScalar() : fm::H264DspBest();
+    fm::SoftH264Decoder decoder(dsp);
+    decoder.Initialize();
+    FILE* out = output ? fopen(output, "wb") : nullptr;
+    if (output && !out) {
+        fprintf(stderr, "cannot write %s\n", output);
+        return 1;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    uint64_t frames = 0;
+    double totalUs = 0, maxUs = 0;
+    for (int pass = 0; pass < repeat; pass++) {
+        for (const sf::AccessUnit& unit : units) {
+            Clock::time_point start = Clock::now();
+            bool decoded = decoder.DecodeNal(data.data() + unit.offset, (uint32_t)unit.size);
+            double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+            totalUs += us;
+            maxUs = std::max(maxUs, us);
+            if (!decoded) continue;
+            frames++;
+            if (out && pass == 0) WriteFrame(out, *decoder.GetDecodedFrame());
+        }
+    }
+    if (out) fclose(out);
+
+    printf("%s: %zu access units x %d, %llu frames of %ux%u decoded (%s kernels)\n",
+           input, units.size(), repeat, (unsigned long long)frames,
+           decoder.GetDecodedWidth(), decoder.GetDecodedHeight(), dsp.name);
+    if (frames > 0) {
+        printf("%.1f fps, %.3f ms per frame, %.3f ms max\n",
+               frames * 1e6 / totalUs, totalUs / 1000.0 / frames, maxUs / 1000.0);
+    }
+    printf("allocations in=%llu out=%llu, concealed macroblocks=%llu\n",
+           (unsigned long long)decoder.GetInputAllocations(),
+           (unsigned long long)decoder.GetOutputAllocations(),
+           (unsigned long long)decoder.ConcealedMacroblocks());
+    if (decoder.LastError()) printf("last error: %s\n", decoder.LastError());
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include <mf_source/AnnexB.h>
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+
+namespace AnnexBTest {
+namespace fm = FluxMic;
+
+// NAL header bytes: forbidden_zero_bit | nal_ref_idc << 5 | nal_unit_type
+const uint8_t SPS = 0x67;           // ref_idc 3, type 7
+const uint8_t PPS = 0x68;           // ref_idc 3, type 8
+const uint8_t IDR = 0x65;           // ref_idc 3, type 5
+const uint8_t P_SLICE = 0x41;       // ref_idc 2, type 1
+const uint8_t B_SLICE = 0x01;       // ref_idc 0, type 1
+const uint8_t SEI = 0x06;           // ref_idc 0, type 6
+
+
+TEST(NalScanner, FindsUnitsAfterBothStartCodes) {
+    std::vector<uint8_t> data = {
+        0, 0, 0, 1, SPS, 0x42, 0x00, 0x1F,
+        0, 0, 1, PPS, 0xCE,
+        0, 0, 0, 1, IDR, 0x88, 0x84,
+    };
+    fm::NalScanner scanner(data.data(), data.size());
+    fm::NalUnit nal;
+
+    ASSERT_TRUE( scanner.Next(nal) );
+    EXPECT_EQ( nal.type, fm::kNalSps );
+    EXPECT_EQ( nal.refIdc, 3 );
+    EXPECT_EQ( nal.data, data.data() + 4 );
+    EXPECT_EQ( nal.size, 4u );
+
+    ASSERT_TRUE( scanner.Next(nal) );
+    EXPECT_EQ( nal.type, fm::kNalPps );
+    EXPECT_EQ( nal.size, 2u );     // the leading zero of the next start code is excluded
+
+    ASSERT_TRUE( scanner.Next(nal) );
+    EXPECT_EQ( nal.type, fm::kNalSliceIdr );
+    EXPECT_EQ( nal.size, 3u );
+
+    EXPECT_FALSE( scanner.Next(nal) );
+    EXPECT_FALSE( scanner.Next(nal) );
+}
+
+TEST(NalScanner, KeepsEmulationPreventedZeros) {
+    // 00 00 03 is not a start code; the payload may contain zeros
+    std::vector<uint8_t> data = { 0, 0, 1, P_SLICE, 0x00, 0x00, 0x03, 0x01, 0x9A };
+    fm::NalScanner scanner(data.data(), data.size());
+    fm::NalUnit nal;
+    ASSERT_TRUE( scanner.Next(nal) );
+    EXPECT_EQ( nal.size, 6u );
+    EXPECT_FALSE( scanner.Next(nal) );
+}
+
+TEST(NalScanner, IgnoresGarbageAndEmptyUnits) {
+    std::vector<uint8_t> data = { 0xFF, 0x12, 0, 0, 1, 0, 0, 0, 1, SEI, 0x05 };
+    fm::NalScanner scanner(data.data(), data.size());
+    fm::NalUnit nal;
+    ASSERT_TRUE( scanner.Next(nal) );
+    EXPECT_EQ( nal.type, fm::kNalSei );
+    EXPECT_FALSE( scanner.Next(nal) );
+
+    std::vector<uint8_t> none = { 0x12, 0x34, 0x00, 0x00 };
+    fm::NalScanner empty(none.data(), none.size());
+    EXPECT_FALSE( empty.Next(nal) );
+}
+
+TEST(FindStartCode, MatchesTheScalarSearch) {
+    // Mostly zeros and ones, so that near misses (00 00 00, 00 01, 00 00 02)
+    // fall on every position of a vector
+    std::mt19937 random(1);
+    for (int n = 0; n < 200; n++) {
+        std::vector<uint8_t> data(random() % 100);
+        for (uint8_t& byte : data) {
+            uint32_t r = random() % 8;
+            byte = (uint8_t)(r < 5 ? 0 : r < 7 ? 1 : random());
+        }
+        for (size_t from = 0; from <= data.size(); from++) {
+            ASSERT_EQ( fm::FindStartCode(data.data(), data.size(), from),
+                       fm::FindStartCodeScalar(data.data(), data.size(), from) ) << n << " from " << from;
+        }
+    }
+}
+
+TEST(FindStartCode, FindsStartCodesAtEveryOffset) {
+    for (size_t at = 0; at + 3 <= 40; at++) {
+        std::vector<uint8_t> data(40, 0x80);
+        data[at] = 0;
+        data[at + 1] = 0;
+        data[at + 2] = 1;
+        EXPECT_EQ( fm::FindStartCode(data.data(), data.size(), 0), at );
+        EXPECT_EQ( fm::FindStartCode(data.data(), data.size(), at + 1), data.size() );
+        EXPECT_EQ( fm::FindStartCode(data.data(), at + 2, 0), at + 2 );     // cut off before the 01
+    }
+}
+
+TEST(ScanAccessUnit, Keyframe) {
+    std::vector<uint8_t> data = {
+        0, 0, 0, 1, SPS, 0x42, 0, 0, 0, 1, PPS, 0xCE, 0, 0, 0, 1, IDR, 0x88,
+    };
+    auto info = fm::ScanAccessUnit(data.data(), data.size());
+    EXPECT_TRUE( info.hasPicture );
+    EXPECT_TRUE( info.isIdr );
+    EXPECT_TRUE( info.isReference );
+    EXPECT_TRUE( info.hasParameterSets );
+}
+
+TEST(ScanAccessUnit, ReferenceAndNonReferenceFrames) {
+    std::vector<uint8_t> p = { 0, 0, 0, 1, P_SLICE, 0x9A, 0, 0, 1, P_SLICE, 0x9B };
+    auto info = fm::ScanAccessUnit(p.data(), p.size());
+    EXPECT_TRUE( info.hasPicture );
+    EXPECT_FALSE( info.isIdr );
+    EXPECT_TRUE( info.isReference );
+    EXPECT_FALSE( info.hasParameterSets );
+
+    std::vector<uint8_t> b = { 0, 0, 0, 1, SEI, 0x05, 0, 0, 0, 1, B_SLICE, 0x9E };
+    info = fm::ScanAccessUnit(b.data(), b.size());
+    EXPECT_TRUE( info.hasPicture );
+    EXPECT_FALSE( info.isReference );
+}
+
+TEST(ScanAccessUnit, NoPicture) {
+    std::vector<uint8_t> data = { 0, 0, 0, 1, SEI, 0x05 };
+    auto info = fm::ScanAccessUnit(data.data(), data.size());
+    EXPECT_FALSE( info.hasPicture );
+    EXPECT_FALSE( fm::ScanAccessUnit(nullptr, 0).hasPicture );
+}
+
+TEST(ExtractParameterSets, DropsEverythingElse) {
+    std::vector<uint8_t> data = {
+        0, 0, 0, 1, SPS, 0x42, 0x00, 0x1F,
+        0, 0, 0, 1, SEI, 0x05,
+        0, 0, 0, 1, PPS, 0xCE, 0x3C, 0x80,
+        0, 0, 0, 1, P_SLICE, 0x9A, 0x00, 0x00, 0x03, 0x01,
+    };
+    std::vector<uint8_t> out(data.size());
+    size_t size = fm::ExtractParameterSets(data.data(), data.size(), out.data());
+    out.resize(size);
+    const std::vector<uint8_t> expected = {
+        0, 0, 1, SPS, 0x42, 0x00, 0x1F,
+        0, 0, 1, PPS, 0xCE, 0x3C, 0x80,
+    };
+    EXPECT_EQ( out, expected );
+
+    std::vector<uint8_t> slice = { 0, 0, 1, P_SLICE, 0x9A };
+    EXPECT_EQ( fm::ExtractParameterSets(slice.data(), slice.size(), out.data()), 0u );
+    EXPECT_EQ( fm::ExtractParameterSets(nullptr, 0, out.data()), 0u );
+}
+
+} //namespace AnnexBTest
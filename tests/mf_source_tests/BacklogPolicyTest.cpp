@@ -0,0 +1,84 @@
+#include <mf_source/BacklogPolicy.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+
+namespace BacklogPolicyTest {
+namespace fm = FluxMic;
+
+const size_t THRESHOLD = 4;
+
+
+// 'I' IDR with parameter sets, 'i' IDR alone, 'P' reference picture,
+// 'p' reference picture with parameter sets, 'b' non-reference picture,
+// 'S' parameter sets only, 'e' no picture (SEI)
+std::vector<fm::AccessUnitInfo> Units(const std::string& pattern)
+{
+    std::vector<fm::AccessUnitInfo> units;
+    for (char c : pattern)
+    {
+        fm::AccessUnitInfo unit;
+        unit.hasPicture = (c == 'I' || c == 'i' || c == 'P' || c == 'p' || c == 'b');
+        unit.isIdr = (c == 'I' || c == 'i');
+        unit.isReference = (c == 'I' || c == 'i' || c == 'P' || c == 'p');
+        unit.hasParameterSets = (c == 'I' || c == 'p' || c == 'S');
+        units.push_back(unit);
+    }
+    return units;
+}
+
+// 'D' for Decode, '-' for Skip and 'S' for ParameterSets, one per unit
+std::string Plan(const std::string& pattern, size_t threshold = THRESHOLD)
+{
+    auto units = Units(pattern);
+    std::vector<fm::BacklogAction> actions(units.size());
+    fm::PlanBacklog(units.data(), units.size(), threshold, actions.data());
+    std::string result;
+    for (auto action : actions)
+    {
+        result += action == fm::BacklogAction::Decode ? 'D'
+                : action == fm::BacklogAction::ParameterSets ? 'S' : '-';
+    }
+    return result;
+}
+
+
+TEST(PlanBacklog, NewestIsAlwaysDecoded) {
+    EXPECT_EQ( Plan("P"), "D" );
+    EXPECT_EQ( Plan("b"), "D" );
+    EXPECT_EQ( Plan("bb"), "-D" );
+    EXPECT_EQ( Plan(""), "" );
+}
+
+TEST(PlanBacklog, ShortBacklogDecodesEveryReference) {
+    EXPECT_EQ( Plan("PPP"), "DDD" );
+    EXPECT_EQ( Plan("PbPb"), "D-DD" );
+    EXPECT_EQ( Plan("IPPP"), "DDDD" );     // the IDR is not skipped to
+}
+
+TEST(PlanBacklog, LongBacklogSkipsToNewestIdr) {
+    EXPECT_EQ( Plan("PPPiPP"), "---DDD" );
+    EXPECT_EQ( Plan("IPPiPI"), "S----D" );
+    EXPECT_EQ( Plan("PSPPiP"), "-D--DD" );   // parameter sets are kept
+    EXPECT_EQ( Plan("PPPbPP", 100), "DDD-DD" );
+}
+
+TEST(PlanBacklog, LongBacklogFeedsOnlyParameterSetsBeforeIdr) {
+    // The sender may repeat SPS/PPS on P frames; their slices refer to
+    // skipped frames
+    EXPECT_EQ( Plan("PpPPiP"), "-S--DD" );
+    EXPECT_EQ( Plan("IPpPPi"), "S-S--D" );
+    EXPECT_EQ( Plan("PpPP", 100), "DDDD" );  // decoded whole without an IDR to skip to
+}
+
+TEST(PlanBacklog, LongBacklogWithoutIdrDecodesEveryReference) {
+    EXPECT_EQ( Plan("PPbPPbP"), "DD-DD-D" );
+}
+
+TEST(PlanBacklog, UnknownContentIsDecoded) {
+    EXPECT_EQ( Plan("ePb"), "DDD" );
+}
+
+} //namespace BacklogPolicyTest
@@ -0,0 +1,225 @@
+#include <mf_source/ControlChannel.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+namespace ControlChannelTest {
+namespace fm = FluxMic;
+
+
+// Stand-in for the control pipe: a SOCK_SEQPACKET socket keeps the message
+// boundaries the same way, and doesn't block when the server is gone.
+class SocketControlTransport : public fm::ControlTransport
+{
+ public:
+    explicit SocketControlTransport(int fd) : m_fd(fd) {}
+    ~SocketControlTransport() override { close(m_fd); }
+
+    bool WriteMessage(const uint8_t* data, size_t size) override
+    {
+        return send(m_fd, data, size, MSG_DONTWAIT | MSG_NOSIGNAL) == (ssize_t)size;
+    }
+
+ private:
+    int m_fd;
+};
+
+
+class ControlChannel : public ::testing::Test
+{
+ protected:
+    int m_server = -1;
+    int m_client = -1;
+
+    void SetUp() override
+    {
+        int fds[2];
+        ASSERT_EQ( socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds), 0 );
+        m_server = fds[0];
+        m_client = fds[1];
+    }
+    void TearDown() override
+    {
+        CloseServer();
+    }
+
+    std::unique_ptr<fm::ControlTransport> ClientTransport()
+    {
+        return std::unique_ptr<fm::ControlTransport>(new SocketControlTransport(m_client));
+    }
+
+    void CloseServer()
+    {
+        if (m_server >= 0) close(m_server);
+        m_server = -1;
+    }
+
+    // What the app has received since the last call; each must parse
+    std::vector<fm::ControlMessage> Received()
+    {
+        std::vector<fm::ControlMessage> messages;
+        uint8_t buffer[64];
+        ssize_t size;
+        while ((size = recv(m_server, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0)
+        {
+            fm::ControlMessage message = {};
+            EXPECT_TRUE( fm::ParseControlMessage(buffer, (size_t)size, message) );
+            messages.push_back(message);
+        }
+        return messages;
+    }
+
+    static void ExpectRequest(const fm::ControlMessage& message, fm::KeyframeReason reason, uint32_t sequence)
+    {
+        EXPECT_EQ( message.type, fm::kControlRequestKeyframe );
+        EXPECT_EQ( message.reason, (uint32_t)reason );
+        EXPECT_EQ( message.sequence, sequence );
+    }
+};
+
+
+TEST_F(ControlChannel, AttachSendsStateAndRequestsKeyframe) {
+    fm::ControlChannel channel;
+    channel.SetConsumerActive(true);
+    channel.Attach(ClientTransport(), 0);
+    EXPECT_TRUE( channel.IsAttached() );
+
+    auto messages = Received();
+    ASSERT_EQ( messages.size(), 2u );
+    EXPECT_EQ( messages[0].type, fm::kControlConsumerActive );
+    ExpectRequest(messages[1], fm::kKeyframeConnect, 0);
+    EXPECT_EQ( channel.KeyframeRequests(), 1u );
+
+    channel.SetConsumerActive(true);
+    channel.SetConsumerActive(false);
+    messages = Received();
+    ASSERT_EQ( messages.size(), 1u );
+    EXPECT_EQ( messages[0].type, fm::kControlConsumerIdle );
+}
+
+TEST_F(ControlChannel, SequenceGapRequestsKeyframe) {
+    fm::ControlChannel channel;
+    channel.Attach(ClientTransport(), 0);
+    channel.OnFrameReceived(10, true, 0);
+    Received();
+
+    channel.OnFrameReceived(11, false, 10);
+    channel.OnFrameReceived(12, false, 20);
+    EXPECT_TRUE( Received().empty() );
+
+    channel.OnFrameReceived(15, false, 30);
+    auto messages = Received();
+    ASSERT_EQ( messages.size(), 1u );
+    ExpectRequest(messages[0], fm::kKeyframeSequenceGap, 13);
+}
+
+TEST_F(ControlChannel, RequestsWaitForTheKeyframeOrTheInterval) {
+    fm::ControlChannel channel(1000);
+    channel.Attach(ClientTransport(), 0);
+    ASSERT_EQ( Received().size(), 2u );
+
+    // Outstanding: another gap leaves a request pending
+    channel.OnFrameReceived(1, false, 100);
+    channel.OnFrameReceived(3, false, 200);
+    channel.Poll(500);
+    EXPECT_TRUE( Received().empty() );
+
+    channel.Poll(1000);
+    auto messages = Received();
+    ASSERT_EQ( messages.size(), 1u );
+    ExpectRequest(messages[0], fm::kKeyframeSequenceGap, 2);
+
+    // The keyframe answers it; the next gap is requested at once
+    channel.OnFrameReceived(4, true, 1100);
+    channel.OnFrameReceived(6, false, 1200);
+    messages = Received();
+    ASSERT_EQ( messages.size(), 1u );
+    ExpectRequest(messages[0], fm::kKeyframeSequenceGap, 5);
+    EXPECT_EQ( channel.KeyframeRequests(), 3u );
+}
+
+TEST_F(ControlChannel, KeyframeClearsPendingRequest) {
+    fm::ControlChannel channel(1000);
+    channel.Attach(ClientTransport(), 0);
+    Received();
+
+    channel.OnFrameReceived(1, false, 100);
+    channel.OnFrameReceived(3, false, 200);
+    channel.OnFrameReceived(4, true, 300);
+    channel.Poll(5000);
+    EXPECT_TRUE( Received().empty() );
+    EXPECT_EQ( channel.KeyframeRequests(), 1u );
+}
+
+TEST_F(ControlChannel, DecodeErrorIsReportedOncePerRequest) {
+    fm::ControlChannel channel(1000);
+    channel.Attach(ClientTransport(), 0);
+    channel.OnFrameReceived(1, true, 0);
+    Received();
+
+    channel.OnDecodeError(2, 100);
+    auto messages = Received();
+    ASSERT_EQ( messages.size(), 2u );
+    EXPECT_EQ( messages[0].type, fm::kControlDecodeError );
+    EXPECT_EQ( messages[0].sequence, 2u );
+    ExpectRequest(messages[1], fm::kKeyframeDecodeError, 2);
+
+    // The frames up to the keyframe fail as well
+    channel.OnDecodeError(3, 200);
+    channel.OnDecodeError(4, 300);
+    EXPECT_TRUE( Received().empty() );
+
+    // Unless the keyframe doesn't come
+    channel.OnDecodeError(40, 1100);
+    messages = Received();
+    ASSERT_EQ( messages.size(), 2u );
+    EXPECT_EQ( messages[0].sequence, 40u );
+    ExpectRequest(messages[1], fm::kKeyframeDecodeError, 40);
+}
+
+TEST_F(ControlChannel, FeedReconnectRequestsKeyframe) {
+    fm::ControlChannel channel(1000);
+    channel.Attach(ClientTransport(), 0);
+    channel.OnFrameReceived(100, true, 0);
+    Received();
+
+    // Sequence numbers start over with the new connection; no gap
+    channel.OnFeedConnected(50);
+    channel.OnFrameReceived(1, false, 60);
+    auto messages = Received();
+    ASSERT_EQ( messages.size(), 1u );
+    ExpectRequest(messages[0], fm::kKeyframeConnect, 0);
+}
+
+TEST_F(ControlChannel, DetachesWhenServerCloses) {
+    fm::ControlChannel channel;
+    channel.Attach(ClientTransport(), 0);
+    channel.OnFrameReceived(1, true, 0);
+    CloseServer();
+
+    channel.OnFrameReceived(3, false, 10);
+    EXPECT_FALSE( channel.IsAttached() );
+    EXPECT_EQ( channel.SendFailures(), 1u );
+    EXPECT_EQ( channel.KeyframeRequests(), 1u );
+}
+
+TEST_F(ControlChannel, PendingRequestIsSentOnAttach) {
+    fm::ControlChannel channel;
+    channel.OnFrameReceived(1, true, 0);
+    channel.OnFrameReceived(5, false, 10);
+    channel.Poll(20);
+    EXPECT_EQ( channel.KeyframeRequests(), 0u );
+    EXPECT_EQ( channel.SendFailures(), 0u );
+
+    channel.Attach(ClientTransport(), 30);
+    auto messages = Received();
+    ASSERT_EQ( messages.size(), 2u );
+    EXPECT_EQ( messages[0].type, fm::kControlConsumerIdle );
+    ExpectRequest(messages[1], fm::kKeyframeSequenceGap, 2);
+}
+
+} //namespace ControlChannelTest
@@ -0,0 +1,78 @@
+#include <mf_source/ControlMessage.h>
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+
+namespace ControlMessageTest {
+namespace fm = FluxMic;
+
+
+std::vector<uint8_t> Encode(const fm::ControlMessage& message)
+{
+    std::vector<uint8_t> bytes(sizeof(message));
+    std::memcpy(bytes.data(), &message, sizeof(message));
+    return bytes;
+}
+
+
+TEST(ControlMessage, LayoutIsLittleEndian) {
+    auto bytes = Encode(fm::MakeControlMessage(fm::kControlRequestKeyframe, 0x01020304,
+                                               fm::kKeyframeSequenceGap));
+    const std::vector<uint8_t> expected = {
+        1, 0,           // version
+        1, 0,           // type
+        4, 3, 2, 1,     // sequence
+        2, 0, 0, 0,     // reason
+        0, 0, 0, 0,     // reserved
+    };
+    EXPECT_EQ( bytes, expected );
+}
+
+TEST(ControlMessage, RoundTrip) {
+    auto bytes = Encode(fm::MakeControlMessage(fm::kControlDecodeError, 77));
+    fm::ControlMessage message = {};
+    ASSERT_TRUE( fm::ParseControlMessage(bytes.data(), bytes.size(), message) );
+    EXPECT_EQ( message.version, fm::kControlProtocolVersion );
+    EXPECT_EQ( message.type, fm::kControlDecodeError );
+    EXPECT_EQ( message.sequence, 77u );
+    EXPECT_EQ( message.reason, (uint32_t)fm::kKeyframeNone );
+
+    bytes = Encode(fm::MakeControlMessage(fm::kControlConsumerIdle));
+    ASSERT_TRUE( fm::ParseControlMessage(bytes.data(), bytes.size(), message) );
+    EXPECT_EQ( message.type, fm::kControlConsumerIdle );
+}
+
+TEST(ControlMessage, RejectsWrongSize) {
+    auto bytes = Encode(fm::MakeControlMessage(fm::kControlConsumerActive));
+    fm::ControlMessage message = {};
+    EXPECT_FALSE( fm::ParseControlMessage(bytes.data(), bytes.size() - 1, message) );
+    bytes.push_back(0);
+    EXPECT_FALSE( fm::ParseControlMessage(bytes.data(), bytes.size(), message) );
+    EXPECT_FALSE( fm::ParseControlMessage(nullptr, 0, message) );
+}
+
+TEST(ControlMessage, RejectsUnknownVersionTypeAndReason) {
+    fm::ControlMessage message = {};
+
+    fm::ControlMessage newer = fm::MakeControlMessage(fm::kControlConsumerActive);
+    newer.version = fm::kControlProtocolVersion + 1;
+    auto bytes = Encode(newer);
+    EXPECT_FALSE( fm::ParseControlMessage(bytes.data(), bytes.size(), message) );
+
+    fm::ControlMessage unknown = fm::MakeControlMessage(fm::kControlConsumerActive);
+    unknown.type = 99;
+    bytes = Encode(unknown);
+    EXPECT_FALSE( fm::ParseControlMessage(bytes.data(), bytes.size(), message) );
+
+    // A keyframe request always says why
+    bytes = Encode(fm::MakeControlMessage(fm::kControlRequestKeyframe));
+    EXPECT_FALSE( fm::ParseControlMessage(bytes.data(), bytes.size(), message) );
+    fm::ControlMessage badReason = fm::MakeControlMessage(fm::kControlRequestKeyframe, 0, fm::kKeyframeConnect);
+    badReason.reason = 42;
+    bytes = Encode(badReason);
+    EXPECT_FALSE( fm::ParseControlMessage(bytes.data(), bytes.size(), message) );
+}
+
+} //namespace ControlMessageTest
@@ -0,0 +1,69 @@
+#include <mf_source/DecodedFrame.h>
+#include <gtest/gtest.h>
+
+#include <utility>
+
+
+namespace DecodedFrameTest {
+namespace fm = FluxMic;
+
+
+int g_live = 0;
+
+class CountedFrame : public fm::DecodedFrame
+{
+ public:
+    CountedFrame() { g_live++; }
+ protected:
+    ~CountedFrame() override { g_live--; }
+};
+
+
+TEST(FrameRef, ReleasesWithLastReference) {
+    g_live = 0;
+    {
+        fm::FrameRef first(new CountedFrame());
+        EXPECT_EQ( g_live, 1 );
+        {
+            fm::FrameRef second = first;
+            EXPECT_EQ( second.Get(), first.Get() );
+            first.Reset();
+            EXPECT_FALSE( first );
+            EXPECT_EQ( g_live, 1 );
+        }
+        EXPECT_EQ( g_live, 0 );
+    }
+    EXPECT_EQ( g_live, 0 );
+}
+
+TEST(FrameRef, MoveAndAssign) {
+    g_live = 0;
+    fm::FrameRef a(new CountedFrame());
+    fm::FrameRef b(new CountedFrame());
+    EXPECT_EQ( g_live, 2 );
+
+    fm::FrameRef c = std::move(a);
+    EXPECT_FALSE( a );
+    EXPECT_TRUE( c );
+    c = b;                  // the first frame goes
+    EXPECT_EQ( g_live, 1 );
+    EXPECT_EQ( c.Get(), b.Get() );
+    b = fm::FrameRef();
+    c = c;
+    EXPECT_EQ( g_live, 1 );
+    c.Reset();
+    EXPECT_EQ( g_live, 0 );
+}
+
+TEST(MemoryFrame, BlackNv12Layout) {
+    auto frame = fm::MemoryFrame::Create(4, 2);
+    ASSERT_TRUE( frame );
+    EXPECT_EQ( frame->width, 4u );
+    EXPECT_EQ( frame->height, 2u );
+    EXPECT_EQ( frame->pitch, 4u );
+    EXPECT_EQ( frame->chroma, frame->luma + 8 );
+    EXPECT_EQ( frame->luma[7], 16 );
+    EXPECT_EQ( frame->chroma[3], 128 );
+}
+
+} //namespace DecodedFrameTest
@@ -0,0 +1,137 @@
+#include <mf_source/FrameHandoff.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+
+namespace FrameHandoffTest {
+namespace fm = FluxMic;
+
+
+// Counts the frames alive, to check the handoff releases them.
+std::atomic<int> g_live{0};
+
+class CountedFrame : public fm::DecodedFrame
+{
+ public:
+    explicit CountedFrame(uint32_t seq) { sequence = seq; g_live++; }
+ protected:
+    ~CountedFrame() override { g_live--; }
+};
+
+fm::FrameRef MakeFrame(uint32_t sequence)
+{
+    return fm::FrameRef(new CountedFrame(sequence));
+}
+
+
+TEST(FrameHandoff, NothingBeforeFirstPublish) {
+    fm::FrameHandoff handoff;
+    bool isNew = true;
+    EXPECT_EQ( handoff.Latest(&isNew), nullptr );
+    EXPECT_FALSE( isNew );
+}
+
+TEST(FrameHandoff, LatestFrameIsRepeated) {
+    fm::FrameHandoff handoff;
+    handoff.Publish(MakeFrame(1));
+
+    bool isNew = false;
+    auto frame = handoff.Latest(&isNew);
+    ASSERT_NE( frame, nullptr );
+    EXPECT_TRUE( isNew );
+    EXPECT_EQ( frame->sequence, 1u );
+
+    frame = handoff.Latest(&isNew);
+    ASSERT_NE( frame, nullptr );
+    EXPECT_FALSE( isNew );
+    EXPECT_EQ( frame->sequence, 1u );
+}
+
+TEST(FrameHandoff, OlderFramesAreReplaced) {
+    fm::FrameHandoff handoff;
+    handoff.Publish(MakeFrame(1));
+    handoff.Publish(MakeFrame(2));
+    handoff.Publish(MakeFrame(3));
+
+    auto frame = handoff.Latest();
+    ASSERT_NE( frame, nullptr );
+    EXPECT_EQ( frame->sequence, 3u );
+    EXPECT_EQ( handoff.PublishedFrames(), 3u );
+    EXPECT_EQ( handoff.OverwrittenFrames(), 2u );
+}
+
+TEST(FrameHandoff, ConsumerFrameStaysAliveUntilNextCall) {
+    g_live = 0;
+    {
+        fm::FrameHandoff handoff;
+        handoff.Publish(MakeFrame(1));
+        auto frame = handoff.Latest();
+        ASSERT_NE( frame, nullptr );
+
+        for (uint32_t i = 2; i < 10; i++)
+        {
+            handoff.Publish(MakeFrame(i));
+        }
+        // Only the consumer's frame and two others are held.
+        EXPECT_EQ( frame->sequence, 1u );
+        EXPECT_LE( g_live.load(), 3 );
+        EXPECT_EQ( handoff.Latest()->sequence, 9u );
+    }
+    EXPECT_EQ( g_live.load(), 0 );
+}
+
+TEST(FrameHandoff, ResetReleasesFrames) {
+    g_live = 0;
+    fm::FrameHandoff handoff;
+    handoff.Publish(MakeFrame(1));
+    handoff.Latest();
+    handoff.Publish(MakeFrame(2));
+    handoff.Reset();
+    EXPECT_EQ( g_live.load(), 0 );
+    EXPECT_EQ( handoff.Latest(), nullptr );
+    handoff.Publish(MakeFrame(3));
+    EXPECT_EQ( handoff.Latest()->sequence, 3u );
+}
+
+TEST(FrameHandoff, TwoThreadsSeeWholeFramesInOrder) {
+    const uint32_t COUNT = 50000;
+    fm::FrameHandoff handoff;
+    std::atomic<bool> done{false};
+
+    std::thread producer([&]
+    {
+        for (uint32_t i = 1; i <= COUNT; i++)
+        {
+            auto frame = fm::MemoryFrame::Create(8, 8);
+            auto memory = static_cast<fm::MemoryFrame*>(frame.Get());
+            std::fill(memory->Data(), memory->Data() + 8 * 8 * 3 / 2, (uint8_t)i);
+            frame->sequence = i;
+            handoff.Publish(std::move(frame));
+        }
+        done = true;
+    });
+
+    uint32_t last = 0;
+    bool consistent = true;
+    while (!done || last < COUNT)
+    {
+        auto frame = handoff.Latest();
+        if (!frame) continue;
+        if (frame->sequence < last) consistent = false;
+        for (uint32_t row = 0; row < frame->height; row++)
+        {
+            for (uint32_t x = 0; x < frame->width; x++)
+            {
+                if (frame->luma[row * frame->pitch + x] != (uint8_t)frame->sequence) consistent = false;
+            }
+        }
+        last = frame->sequence;
+    }
+    producer.join();
+    EXPECT_TRUE( consistent );
+    EXPECT_EQ( last, COUNT );
+}
+
+} //namespace FrameHandoffTest
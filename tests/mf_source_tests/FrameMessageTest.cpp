@@ -0,0 +1,51 @@
+#include <mf_source/FrameMessage.h>
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+
+namespace FrameMessageTest {
+namespace fm = FluxMic;
+
+
+std::vector<uint8_t> MakeMessage(uint32_t sequence, uint32_t frameSize, size_t payloadSize)
+{
+    fm::FrameHeader header = { 640, 480, 12345, sequence, frameSize };
+    std::vector<uint8_t> message(fm::kHeaderSize + payloadSize, 0xAB);
+    std::memcpy(message.data(), &header, sizeof(header));
+    return message;
+}
+
+
+TEST(ParseFrameMessage, AcceptsWholeMessage) {
+    auto message = MakeMessage(7, 100, 100);
+    fm::FrameHeader header = {};
+    EXPECT_TRUE( fm::ParseFrameMessage(message.data(), message.size(), header) );
+    EXPECT_EQ( header.width, 640u );
+    EXPECT_EQ( header.height, 480u );
+    EXPECT_EQ( header.timestamp, 12345u );
+    EXPECT_EQ( header.sequence, 7u );
+    EXPECT_EQ( header.frame_size, 100u );
+}
+
+TEST(ParseFrameMessage, RejectsSizeMismatch) {
+    fm::FrameHeader header = {};
+    auto truncated = MakeMessage(1, 100, 99);
+    EXPECT_FALSE( fm::ParseFrameMessage(truncated.data(), truncated.size(), header) );
+    auto padded = MakeMessage(1, 100, 101);
+    EXPECT_FALSE( fm::ParseFrameMessage(padded.data(), padded.size(), header) );
+    auto shortHeader = MakeMessage(1, 100, 100);
+    EXPECT_FALSE( fm::ParseFrameMessage(shortHeader.data(), fm::kHeaderSize - 1, header) );
+    EXPECT_FALSE( fm::ParseFrameMessage(nullptr, 0, header) );
+}
+
+TEST(ParseFrameMessage, RejectsEmptyAndOversizedFrames) {
+    fm::FrameHeader header = {};
+    auto empty = MakeMessage(1, 0, 0);
+    EXPECT_FALSE( fm::ParseFrameMessage(empty.data(), empty.size(), header) );
+    auto oversized = MakeMessage(1, (uint32_t)fm::kMaxFrameDataSize + 1, 0);
+    EXPECT_FALSE( fm::ParseFrameMessage(oversized.data(), oversized.size(), header) );
+}
+
+} //namespace FrameMessageTest
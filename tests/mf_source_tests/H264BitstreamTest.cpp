@@ -0,0 +1,101 @@
+#include <mf_source/H264Bitstream.h>
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include "H264TestStream.h"
+
+
+namespace H264BitstreamTest {
+namespace fm = FluxMic;
+namespace ts = H264TestStream;
+
+
+TEST(UnescapeRbsp, DropsEmulationPreventionBytes) {
+    std::vector<uint8_t> nal = { 0x00, 0x00, 0x03, 0x01, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03 };
+    std::vector<uint8_t> rbsp;
+    size_t size = fm::UnescapeRbsp(nal.data(), nal.size(), rbsp);
+    ASSERT_EQ( size, 7u );
+    EXPECT_EQ( std::vector<uint8_t>(rbsp.begin(), rbsp.begin() + size),
+               std::vector<uint8_t>({ 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00 }) );
+    ASSERT_GE( rbsp.size(), size + fm::BitReader::kReadAhead );
+    for (size_t i = size; i < size + fm::BitReader::kReadAhead; i++) {
+        EXPECT_EQ( rbsp[i], 0 );
+    }
+}
+
+TEST(UnescapeRbsp, KeepsThreesThatFollowOtherBytes) {
+    std::vector<uint8_t> nal = { 0x03, 0x00, 0x03, 0x00, 0x00, 0x04, 0x03 };
+    std::vector<uint8_t> rbsp;
+    size_t size = fm::UnescapeRbsp(nal.data(), nal.size(), rbsp);
+    EXPECT_EQ( std::vector<uint8_t>(rbsp.begin(), rbsp.begin() + size), nal );
+}
+
+TEST(UnescapeRbsp, ReusesTheBuffer) {
+    std::vector<uint8_t> nal(1000, 0x55);
+    std::vector<uint8_t> rbsp;
+    fm::UnescapeRbsp(nal.data(), nal.size(), rbsp);
+    const uint8_t* data = rbsp.data();
+    fm::UnescapeRbsp(nal.data(), 500, rbsp);
+    fm::UnescapeRbsp(nal.data(), nal.size(), rbsp);
+    EXPECT_EQ( rbsp.data(), data );
+}
+
+TEST(UnescapeRbsp, CutsShortToAFixedBuffer) {
+    std::vector<uint8_t> nal = { 0x11, 0x00, 0x00, 0x03, 0x01, 0x22, 0x33, 0x44, 0x55 };
+    uint8_t rbsp[4 + fm::BitReader::kReadAhead];
+    memset(rbsp, 0xFF, sizeof(rbsp));
+    size_t size = fm::UnescapeRbsp(nal.data(), nal.size(), rbsp, sizeof(rbsp));
+    ASSERT_EQ( size, 4u );
+    EXPECT_EQ( std::vector<uint8_t>(rbsp, rbsp + size), std::vector<uint8_t>({ 0x11, 0x00, 0x00, 0x01 }) );
+    for (size_t i = size; i < sizeof(rbsp); i++) {
+        EXPECT_EQ( rbsp[i], 0 );
+    }
+}
+
+TEST(BitReader, ReadsExpGolombCodes) {
+    const uint32_t values[] = { 0, 1, 2, 3, 7, 254, 255, 65534, 65535, 65536, 1u << 24, 0xFFFFFFFEu };
+    ts::BitWriter w;
+    for (uint32_t value : values) {
+        w.Ue(value);
+        w.Se(-(int32_t)(value & 0xFFFF));
+        w.Bits(5, 3);
+    }
+    w.Trailing();
+
+    for (bool padded : { false, true }) {
+        std::vector<uint8_t> data = w.bytes;
+        if (padded) data.resize(data.size() + fm::BitReader::kReadAhead);
+        fm::BitReader reader(data.data(), w.bytes.size(), padded);
+        for (uint32_t value : values) {
+            EXPECT_EQ( reader.ReadUe(), value );
+            EXPECT_EQ( reader.ReadSe(), -(int32_t)(value & 0xFFFF) );
+            EXPECT_EQ( reader.ReadBits(3), 5u );
+        }
+        EXPECT_FALSE( reader.MoreRbspData() );
+        EXPECT_FALSE( reader.Overrun() );
+    }
+}
+
+TEST(BitReader, NoticesMoreRbspData) {
+    // 1 bit of data, then rbsp_trailing_bits()
+    std::vector<uint8_t> data = { 0x40 };
+    fm::BitReader reader(data.data(), data.size());
+    EXPECT_TRUE( reader.MoreRbspData() );
+    EXPECT_EQ( reader.ReadBit(), 0u );
+    EXPECT_FALSE( reader.MoreRbspData() );
+}
+
+TEST(BitReader, ReadsZerosPastTheEnd) {
+    std::vector<uint8_t> data = { 0xFF, 0xFF };
+    fm::BitReader reader(data.data(), data.size());
+    EXPECT_EQ( reader.ReadBits(12), 0xFFFu );
+    EXPECT_FALSE( reader.Overrun() );
+    EXPECT_EQ( reader.ReadBits(8), 0xF0u );
+    EXPECT_TRUE( reader.Overrun() );
+    EXPECT_EQ( reader.ReadUe(), 0u );     // only zeros follow: no valid code
+    EXPECT_EQ( reader.BitsLeft(), 0u );
+}
+
+} // namespace H264BitstreamTest
@@ -0,0 +1,90 @@
+#include <mf_source/H264Cavlc.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "H264TestStream.h"
+
+
+namespace H264CavlcTest {
+namespace fm = FluxMic;
+namespace ts = H264TestStream;
+
+int Read(const ts::BitWriter& w, int nC, int maxNumCoeff, int16_t* levels, size_t* bitsRead = nullptr) {
+    std::vector<uint8_t> data = w.bytes;
+    fm::BitReader reader(data.data(), data.size());
+    int totalCoeff = fm::ReadResidualBlock(reader, nC, maxNumCoeff, levels);
+    if (bitsRead) *bitsRead = reader.BitPosition();
+    return totalCoeff;
+}
+
+
+TEST(ReadResidualBlock, DecodesAFullExample) {
+    // Levels 0 3 0 1 -1 -1 0 1 in scan order: TotalCoeff 5, TrailingOnes 3,
+    // total_zeros 3 and the runs 1 0 0 1
+    ts::BitWriter w;
+    w.Bits(0x4, 7);         // coeff_token, 0 <= nC < 2
+    w.Bits(0x3, 3);         // trailing_ones_sign_flag: +1 -1 -1, last first
+    w.Bits(0x1, 1);         // level_prefix 0: +1
+    w.Bits(0x2, 4);         // level_prefix 2, level_suffix 0: +3 (suffixLength 1)
+    w.Bits(0x7, 3);         // total_zeros 3
+    w.Bits(0x2, 2);         // run_before 1 (zerosLeft 3)
+    w.Bits(0x1, 1);         // run_before 0 (zerosLeft 2)
+    w.Bits(0x1, 1);         // run_before 0
+    w.Bits(0x1, 2);         // run_before 1 (zerosLeft 2)
+    w.Bits(0, 8);
+
+    int16_t levels[16];
+    size_t bits = 0;
+    EXPECT_EQ( Read(w, 0, 16, levels, &bits), 5 );
+    EXPECT_EQ( bits, 24u );
+    const int16_t expected[16] = { 0, 3, 0, 1, -1, -1, 0, 1 };
+    for (int i = 0; i < 16; i++) {
+        EXPECT_EQ( levels[i], expected[i] ) << i;
+    }
+}
+
+TEST(ReadResidualBlock, DecodesChromaDc) {
+    ts::BitWriter w;
+    w.Bit(1);               // coeff_token TrailingOnes 1, TotalCoeff 1 (nC -1)
+    w.Bit(1);               // -1
+    w.Bits(0x1, 3);         // total_zeros 2 (chroma DC table)
+    w.Bits(0, 8);
+
+    int16_t levels[4];
+    EXPECT_EQ( Read(w, fm::kCavlcChromaDcNc, 4, levels), 1 );
+    EXPECT_EQ( levels[0], 0 );
+    EXPECT_EQ( levels[1], 0 );
+    EXPECT_EQ( levels[2], -1 );
+    EXPECT_EQ( levels[3], 0 );
+}
+
+TEST(ReadResidualBlock, DecodesAnEmptyBlockWithEachTable) {
+    // TotalCoeff 0: "1", "11", "1111", "000011" and "01" for nC -1
+    const struct { int nC; uint32_t code; int length; } cases[] = {
+        { 0, 0x1, 1 }, { 2, 0x3, 2 }, { 4, 0xF, 4 }, { 8, 0x3, 6 }, { fm::kCavlcChromaDcNc, 0x1, 2 },
+    };
+    for (const auto& c : cases) {
+        ts::BitWriter w;
+        w.Bits(c.code, c.length);
+        w.Bits(0xFF, 8);
+        int16_t levels[16];
+        size_t bits = 0;
+        EXPECT_EQ( Read(w, c.nC, 16, levels, &bits), 0 ) << c.nC;
+        EXPECT_EQ( bits, (size_t)c.length ) << c.nC;
+        for (int16_t level : levels) {
+            EXPECT_EQ( level, 0 );
+        }
+    }
+}
+
+TEST(ReadResidualBlock, RejectsTooManyCoefficients) {
+    // TotalCoeff 16 doesn't fit in a 15 coefficient AC block
+    ts::BitWriter w;
+    w.Bits(0x3F, 6);        // coeff_token TrailingOnes 3, TotalCoeff 16 (8 <= nC)
+    w.Bits(0, 40);
+    int16_t levels[16];
+    EXPECT_EQ( Read(w, 8, 15, levels), -1 );
+}
+
+} // namespace H264CavlcTest
@@ -0,0 +1,130 @@
+#include <mf_source/SoftH264Decoder.h>
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "H264StreamFile.h"
+#include "Md5.h"
+
+
+// Decodes real streams, such as the JVT conformance streams of the
+// Constrained Baseline profile (BA1_Sony_D, BAMQ1_JVC_C, ...) or captures
+// of the sender, and compares every frame with a reference decoder.
+//
+// FLUXMIC_H264_STREAMS names a directory of Annex B files, each next to the
+// per-frame hashes of the reference decoder's NV12 output, made with
+//
+//   ffmpeg -i BA1_Sony_D.jsv -pix_fmt nv12 -f framemd5 BA1_Sony_D.framemd5
+//
+// The test is skipped when the variable isn't set.
+
+namespace H264ConformanceTest {
+namespace fm = FluxMic;
+namespace sf = H264StreamFile;
+namespace fs = std::filesystem;
+
+
+// The hash of each frame, from the last field of every line which isn't a
+// comment ("stream, dts, pts, duration, size, hash")
+std::vector<std::string> ReadFrameMd5(const fs::path& path)
+{
+    std::vector<std::string> hashes;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#') continue;
+        size_t comma = line.find_last_of(',');
+        if (comma == std::string::npos) continue;
+        size_t begin = line.find_first_not_of(" \t", comma + 1);
+        size_t end = line.find_last_not_of(" \t\r");
+        if (begin == std::string::npos || end < begin) continue;
+        hashes.push_back(line.substr(begin, end - begin + 1));
+    }
+    return hashes;
+}
+
+std::vector<std::string> DecodeFrameMd5(const fs::path& path, std::string& error)
+{
+    std::vector<uint8_t> data;
+    if (!sf::ReadFile(path.string().c_str(), data))
+    {
+        error = "cannot read the stream";
+        return {};
+    }
+    fm::SoftH264Decoder decoder;
+    decoder.Initialize();
+    std::vector<std::string> hashes;
+    for (const sf::AccessUnit& unit : sf::SplitAccessUnits(data))
+    {
+        if (!decoder.DecodeNal(data.data() + unit.offset, (uint32_t)unit.size)) continue;
+        Md5::Hasher hasher;
+        sf::ForEachNv12Row(*decoder.GetDecodedFrame(), [&](const uint8_t* row, size_t size) {
+            hasher.Update(row, size);
+        });
+        hashes.push_back(hasher.Finish());
+    }
+    if (decoder.LastError()) error = decoder.LastError();
+    return hashes;
+}
+
+bool IsStream(const fs::path& path)
+{
+    static const char* const kExtensions[] = { ".264", ".h264", ".jsv", ".26l", ".jvt", ".avc" };
+    for (const char* extension : kExtensions)
+    {
+        if (path.extension() == extension) return true;
+    }
+    return false;
+}
+
+
+TEST(Md5, KnownDigests) {
+    EXPECT_EQ( Md5::Hash("", 0), "d41d8cd98f00b204e9800998ecf8427e" );
+    EXPECT_EQ( Md5::Hash("abc", 3), "900150983cd24fb0d6963f7d28e17f72" );
+    const std::string text = "The quick brown fox jumps over the lazy dog";
+    EXPECT_EQ( Md5::Hash(text.data(), text.size()), "9e107d9d372bb6826bd81d3542a419d6" );
+
+    // Split across blocks the same as whole
+    std::vector<uint8_t> bytes(1000);
+    for (size_t i = 0; i < bytes.size(); i++) bytes[i] = (uint8_t)(i * 7);
+    Md5::Hasher hasher;
+    hasher.Update(bytes.data(), 3);
+    hasher.Update(bytes.data() + 3, 61);
+    hasher.Update(bytes.data() + 64, bytes.size() - 64);
+    EXPECT_EQ( hasher.Finish(), Md5::Hash(bytes.data(), bytes.size()) );
+}
+
+TEST(H264Conformance, MatchesReferenceDecoder) {
+    const char* directory = std::getenv("FLUXMIC_H264_STREAMS");
+    if (!directory || !*directory) {
+        GTEST_SKIP() << "set FLUXMIC_H264_STREAMS to a directory of H.264 streams and .framemd5 files";
+    }
+
+    size_t streams = 0;
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        const fs::path& path = entry.path();
+        fs::path reference = fs::path(path).replace_extension(".framemd5");
+        if (!IsStream(path) || !fs::exists(reference)) continue;
+        streams++;
+        SCOPED_TRACE(path.filename().string());
+
+        std::vector<std::string> expected = ReadFrameMd5(reference);
+        std::string error;
+        std::vector<std::string> actual = DecodeFrameMd5(path, error);
+        EXPECT_EQ( actual.size(), expected.size() ) << "last error: " << error;
+        for (size_t i = 0; i < std::min(actual.size(), expected.size()); i++) {
+            if (actual[i] != expected[i]) {
+                ADD_FAILURE() << "frame " << i << " differs from the reference decoder";
+                break;
+            }
+        }
+    }
+    EXPECT_GT( streams, 0u ) << "no stream with a .framemd5 file in " << directory;
+}
+
+} //namespace H264ConformanceTest
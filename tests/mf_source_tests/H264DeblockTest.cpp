@@ -0,0 +1,94 @@
+#include <mf_source/H264Deblock.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+
+namespace H264DeblockTest {
+namespace fm = FluxMic;
+
+// 16 rows crossing a vertical edge at column 4 of an 8 sample wide block,
+// each row p3 p2 p1 p0 | q0 q1 q2 q3
+std::vector<uint8_t> Rows(const std::vector<uint8_t>& row, int count = 16) {
+    std::vector<uint8_t> rows;
+    for (int i = 0; i < count; i++) {
+        rows.insert(rows.end(), row.begin(), row.end());
+    }
+    return rows;
+}
+
+std::vector<uint8_t> Row(const std::vector<uint8_t>& rows, int index, int width = 8) {
+    return std::vector<uint8_t>(rows.begin() + index * width, rows.begin() + (index + 1) * width);
+}
+
+// indexA 40 gives alpha 80 and beta 13
+const int kIndex = 40;
+
+
+TEST(DeblockLumaEdge, StrongFilterSmoothsAnIntraEdge) {
+    std::vector<uint8_t> rows = Rows({ 100, 100, 100, 100, 104, 104, 104, 104 });
+    const uint8_t bS[4] = { 4, 4, 4, 4 };
+    fm::DeblockLumaEdge(rows.data() + 4, 1, 8, bS, kIndex, kIndex);
+    for (int i = 0; i < 16; i++) {
+        EXPECT_EQ( Row(rows, i), std::vector<uint8_t>({ 100, 101, 101, 102, 103, 103, 104, 104 }) );
+    }
+}
+
+TEST(DeblockLumaEdge, NormalFilterMovesTheSamplesNextToTheEdge) {
+    std::vector<uint8_t> rows = Rows({ 100, 100, 100, 100, 104, 104, 104, 104 });
+    // Only the second 4 lines have a non-zero strength
+    const uint8_t bS[4] = { 0, 1, 0, 0 };
+    fm::DeblockLumaEdge(rows.data() + 4, 1, 8, bS, kIndex, kIndex);
+    for (int i = 0; i < 16; i++) {
+        if (i >= 4 && i < 8) {
+            EXPECT_EQ( Row(rows, i), std::vector<uint8_t>({ 100, 100, 101, 102, 102, 103, 104, 104 }) );
+        } else {
+            EXPECT_EQ( Row(rows, i), std::vector<uint8_t>({ 100, 100, 100, 100, 104, 104, 104, 104 }) );
+        }
+    }
+}
+
+TEST(DeblockLumaEdge, KeepsRealEdges) {
+    // |p0 - q0| >= alpha: an edge of the picture, not of the blocks
+    std::vector<uint8_t> rows = Rows({ 20, 20, 20, 20, 200, 200, 200, 200 });
+    const std::vector<uint8_t> before = rows;
+    const uint8_t bS[4] = { 4, 4, 4, 4 };
+    fm::DeblockLumaEdge(rows.data() + 4, 1, 8, bS, kIndex, kIndex);
+    EXPECT_EQ( rows, before );
+}
+
+TEST(DeblockLumaEdge, FiltersHorizontalEdges) {
+    // The same step, transposed: 8 rows of 16 samples
+    std::vector<uint8_t> rows(8 * 16);
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 16; x++) {
+            rows[y * 16 + x] = (y < 4) ? 100 : 104;
+        }
+    }
+    const uint8_t bS[4] = { 4, 4, 4, 4 };
+    fm::DeblockLumaEdge(rows.data() + 4 * 16, 16, 1, bS, kIndex, kIndex);
+    const uint8_t expected[8] = { 100, 101, 101, 102, 103, 103, 104, 104 };
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 16; x++) {
+            ASSERT_EQ( rows[y * 16 + x], expected[y] );
+        }
+    }
+}
+
+TEST(DeblockChromaEdge, FiltersOneComponentOfInterleavedSamples) {
+    // Cb steps from 100 to 104 and Cr from 150 to 154, interleaved
+    std::vector<uint8_t> rows = Rows({ 100, 150, 100, 150, 104, 154, 104, 154 }, 8);
+    const uint8_t bS[4] = { 4, 4, 1, 1 };
+    fm::DeblockChromaEdge(rows.data() + 4, 2, 8, bS, kIndex, kIndex);
+    for (int i = 0; i < 8; i++) {
+        if (i < 4) {
+            // bS 4: p0' = (2 p1 + p0 + q1 + 2) >> 2
+            EXPECT_EQ( Row(rows, i), std::vector<uint8_t>({ 100, 150, 101, 150, 103, 154, 104, 154 }) ) << i;
+        } else {
+            // bS 1: a delta of 2, within tc
+            EXPECT_EQ( Row(rows, i), std::vector<uint8_t>({ 100, 150, 102, 150, 102, 154, 104, 154 }) ) << i;
+        }
+    }
+}
+
+} // namespace H264DeblockTest
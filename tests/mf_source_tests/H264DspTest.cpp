@@ -0,0 +1,215 @@
+#include <mf_source/H264Dsp.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+
+namespace H264DspTest {
+namespace fm = FluxMic;
+
+int Clip(int value) { return std::min(std::max(value, 0), 255); }
+
+// The inverse transform as written in ITU-T H.264 8.5.12.2
+void ReferenceIdctAdd(uint8_t* dst, ptrdiff_t stride, const int16_t* d) {
+    int f[4][4], h[4][4];
+    for (int i = 0; i < 4; i++) {
+        int e = d[i * 4 + 0] + d[i * 4 + 2];
+        int ff = d[i * 4 + 0] - d[i * 4 + 2];
+        int g = (d[i * 4 + 1] >> 1) - d[i * 4 + 3];
+        int hh = d[i * 4 + 1] + (d[i * 4 + 3] >> 1);
+        f[i][0] = e + hh;
+        f[i][1] = ff + g;
+        f[i][2] = ff - g;
+        f[i][3] = e - hh;
+    }
+    for (int j = 0; j < 4; j++) {
+        int g0 = f[0][j] + f[2][j];
+        int g1 = f[0][j] - f[2][j];
+        int g2 = (f[1][j] >> 1) - f[3][j];
+        int g3 = f[1][j] + (f[3][j] >> 1);
+        h[0][j] = g0 + g3;
+        h[1][j] = g1 + g2;
+        h[2][j] = g1 - g2;
+        h[3][j] = g0 - g3;
+    }
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            dst[i * stride + j] = (uint8_t)Clip(dst[i * stride + j] + ((h[i][j] + 32) >> 6));
+        }
+    }
+}
+
+// Luma sample interpolation as written in 8.4.2.2.1, one sample at a time
+int Tap(int e, int f, int g, int h, int i, int j) { return e - 5 * f + 20 * g + 20 * h - 5 * i + j; }
+
+int ReferenceLuma(const uint8_t* src, ptrdiff_t stride, int xFrac, int yFrac) {
+    auto P = [&](int x, int y) { return (int)src[y * stride + x]; };
+    auto B1 = [&](int y) { return Tap(P(-2, y), P(-1, y), P(0, y), P(1, y), P(2, y), P(3, y)); };
+    auto H1 = [&](int x) { return Tap(P(x, -2), P(x, -1), P(x, 0), P(x, 1), P(x, 2), P(x, 3)); };
+    int G = P(0, 0), H = P(1, 0), M = P(0, 1);
+    int b = Clip((B1(0) + 16) >> 5);
+    int h = Clip((H1(0) + 16) >> 5);
+    int s = Clip((B1(1) + 16) >> 5);
+    int m = Clip((H1(1) + 16) >> 5);
+    int j = Clip((Tap(B1(-2), B1(-1), B1(0), B1(1), B1(2), B1(3)) + 512) >> 10);
+    const int table[4][4] = {       // [xFrac][yFrac] (Table 8-12)
+        { G,                  (G + h + 1) >> 1,  h,                  (M + h + 1) >> 1 },
+        { (G + b + 1) >> 1,   (b + h + 1) >> 1,  (h + j + 1) >> 1,   (h + s + 1) >> 1 },
+        { b,                  (b + j + 1) >> 1,  j,                  (j + s + 1) >> 1 },
+        { (H + b + 1) >> 1,   (b + m + 1) >> 1,  (j + m + 1) >> 1,   (m + s + 1) >> 1 },
+    };
+    return table[xFrac][yFrac];
+}
+
+class Random {
+public:
+    explicit Random(uint32_t seed) : m_engine(seed) {}
+    int Next(int low, int high) { return std::uniform_int_distribution<int>(low, high)(m_engine); }
+    void Fill(std::vector<uint8_t>& data) {
+        for (uint8_t& byte : data) {
+            byte = (uint8_t)Next(0, 255);
+        }
+    }
+
+private:
+    std::mt19937 m_engine;
+};
+
+
+TEST(H264Dsp, IdctMatchesTheSpec) {
+    Random random(1);
+    for (const fm::H264DspFunctions* dsp : { &fm::H264DspScalar(), &fm::H264DspBest() }) {
+        for (int n = 0; n < 2000; n++) {
+            alignas(16) int16_t block[16];
+            for (int16_t& c : block) {
+                c = (int16_t)(random.Next(0, 3) == 0 ? random.Next(-2048, 2047) : 0);
+            }
+            std::vector<uint8_t> pixels(8 * 4), expected;
+            random.Fill(pixels);
+            expected = pixels;
+            ReferenceIdctAdd(expected.data(), 8, block);
+            dsp->idctAdd4x4(pixels.data(), 8, block);
+            ASSERT_EQ( pixels, expected ) << dsp->name;
+            for (int16_t c : block) {
+                ASSERT_EQ( c, 0 );
+            }
+        }
+    }
+}
+
+TEST(H264Dsp, DcIdctMatchesTheFullOne) {
+    Random random(2);
+    for (const fm::H264DspFunctions* dsp : { &fm::H264DspScalar(), &fm::H264DspBest() }) {
+        for (int n = 0; n < 500; n++) {
+            alignas(16) int16_t block[16] = {};
+            int16_t dc = (int16_t)random.Next(-4096, 4095);
+            std::vector<uint8_t> pixels(8 * 4), expected;
+            random.Fill(pixels);
+            expected = pixels;
+            block[0] = dc;
+            ReferenceIdctAdd(expected.data(), 8, block);
+            dsp->idctDcAdd4x4(pixels.data(), 8, block);
+            ASSERT_EQ( pixels, expected ) << dsp->name;
+            ASSERT_EQ( block[0], 0 );
+        }
+    }
+}
+
+TEST(H264Dsp, LumaMcMatchesTheSpec) {
+    Random random(3);
+    const int stride = 48;
+    std::vector<uint8_t> src(stride * 40);
+    for (const fm::H264DspFunctions* dsp : { &fm::H264DspScalar(), &fm::H264DspBest() }) {
+        for (int size : { 4, 8, 16 }) {
+            for (int frac = 0; frac < 16; frac++) {
+                random.Fill(src);
+                const uint8_t* origin = src.data() + 8 * stride + 8;
+                uint8_t dst[16 * 16];
+                dsp->lumaMc(dst, 16, origin, stride, size, size, frac & 3, frac >> 2);
+                for (int y = 0; y < size; y++) {
+                    for (int x = 0; x < size; x++) {
+                        ASSERT_EQ( dst[y * 16 + x], ReferenceLuma(origin + y * stride + x, stride, frac & 3, frac >> 2) )
+                            << dsp->name << " size " << size << " frac " << (frac & 3) << "," << (frac >> 2);
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(H264Dsp, ChromaMcMatchesTheSpec) {
+    Random random(4);
+    const int stride = 48;
+    std::vector<uint8_t> src(stride * 24);
+    for (const fm::H264DspFunctions* dsp : { &fm::H264DspScalar(), &fm::H264DspBest() }) {
+        for (int size : { 2, 4, 8 }) {
+            for (int frac = 0; frac < 64; frac++) {
+                int xFrac = frac & 7, yFrac = frac >> 3;
+                random.Fill(src);
+                const uint8_t* origin = src.data() + 4 * stride + 8;
+                uint8_t dst[16 * 8];
+                dsp->chromaMc(dst, 16, origin, stride, size, size, xFrac, yFrac);
+                for (int y = 0; y < size; y++) {
+                    for (int x = 0; x < 2 * size; x++) {
+                        const uint8_t* p = origin + y * stride + x;
+                        int expected = ((8 - xFrac) * (8 - yFrac) * p[0] + xFrac * (8 - yFrac) * p[2]
+                                        + (8 - xFrac) * yFrac * p[stride] + xFrac * yFrac * p[stride + 2] + 32) >> 6;
+                        ASSERT_EQ( dst[y * 16 + x], expected ) << dsp->name << " size " << size;
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(H264Dsp, RectangularBlocksMatchTheScalarKernels) {
+    Random random(5);
+    const int stride = 64;
+    std::vector<uint8_t> src(stride * 48);
+    const fm::H264DspFunctions& scalar = fm::H264DspScalar();
+    const fm::H264DspFunctions& best = fm::H264DspBest();
+    const int shapes[][2] = { { 16, 8 }, { 8, 16 }, { 8, 4 }, { 4, 8 } };
+    for (const auto& shape : shapes) {
+        for (int frac = 0; frac < 16; frac++) {
+            random.Fill(src);
+            const uint8_t* origin = src.data() + 8 * stride + 8;
+            uint8_t a[16 * 16], b[16 * 16];
+            scalar.lumaMc(a, 16, origin, stride, shape[0], shape[1], frac & 3, frac >> 2);
+            best.lumaMc(b, 16, origin, stride, shape[0], shape[1], frac & 3, frac >> 2);
+            for (int y = 0; y < shape[1]; y++) {
+                ASSERT_TRUE( std::equal(a + y * 16, a + y * 16 + shape[0], b + y * 16) );
+            }
+            scalar.chromaMc(a, 16, origin, stride, shape[0] / 2, shape[1] / 2, frac & 7, frac >> 1);
+            best.chromaMc(b, 16, origin, stride, shape[0] / 2, shape[1] / 2, frac & 7, frac >> 1);
+            for (int y = 0; y < shape[1] / 2; y++) {
+                ASSERT_TRUE( std::equal(a + y * 16, a + y * 16 + shape[0], b + y * 16) );
+            }
+        }
+    }
+}
+
+TEST(H264Dsp, DcDequantisation) {
+    // A single level of 1 spreads over every block (8.5.10, 8.5.11.2);
+    // at QP 28 LevelScale4x4(4, 0, 0) is 256
+    int16_t luma[16] = { 1 };
+    fm::H264LumaDcDequant(luma, 28);
+    for (int16_t dc : luma) {
+        EXPECT_EQ( dc, (256 + 2) >> 2 );
+    }
+    int16_t chroma[4] = { 1 };
+    fm::H264ChromaDcDequant(chroma, 28);
+    for (int16_t dc : chroma) {
+        EXPECT_EQ( dc, (256 << 4) >> 5 );
+    }
+
+    // From QP 36 the luma DC scale is shifted left instead of rounded
+    int16_t high[16] = { -3 };
+    fm::H264LumaDcDequant(high, 40);
+    for (int16_t dc : high) {
+        EXPECT_EQ( dc, -3 * 16 * 16 );     // LevelScale4x4(4, 0, 0) << (40 / 6 - 6)
+    }
+}
+
+} // namespace H264DspTest
@@ -0,0 +1,101 @@
+#include <mf_source/H264Intra.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+
+namespace H264IntraTest {
+namespace fm = FluxMic;
+
+// A block at (8, 8) of a 32x32 plane, the samples around it set by the test
+struct Plane {
+    static const int kStride = 32;
+    std::vector<uint8_t> samples = std::vector<uint8_t>(kStride * 32, 0);
+
+    uint8_t* Block() { return samples.data() + 8 * kStride + 8; }
+    uint8_t At(int x, int y) { return Block()[y * kStride + x]; }
+    void Set(int x, int y, uint8_t value) { Block()[y * kStride + x] = value; }
+};
+
+
+TEST(PredictIntra, UsesMidGreyWithoutNeighbours) {
+    Plane plane;
+    fm::PredictIntra16x16(plane.Block(), Plane::kStride, fm::kIntra16x16Dc, 0);
+    for (int y = 0; y < 16; y++) {
+        for (int x = 0; x < 16; x++) {
+            ASSERT_EQ( plane.At(x, y), 128 );
+        }
+    }
+    fm::PredictIntraChroma(plane.Block(), Plane::kStride, fm::kIntraChromaDc, 0);
+    EXPECT_EQ( plane.At(0, 0), 128 );
+    EXPECT_EQ( plane.At(15, 7), 128 );
+}
+
+TEST(PredictIntra, Intra4x4DcAveragesTheAvailableSide) {
+    Plane plane;
+    for (int i = 0; i < 4; i++) {
+        plane.Set(-1, i, (uint8_t)(10 * i));    // left: 0 10 20 30
+        plane.Set(i, -1, 200);                  // top, not available
+    }
+    fm::PredictIntra4x4(plane.Block(), Plane::kStride, fm::kIntra4x4Dc, fm::kIntraLeft);
+    EXPECT_EQ( plane.At(0, 0), 15 );            // (60 + 2) >> 2
+    EXPECT_EQ( plane.At(3, 3), 15 );
+
+    fm::PredictIntra4x4(plane.Block(), Plane::kStride, fm::kIntra4x4Dc, fm::kIntraLeft | fm::kIntraTop);
+    EXPECT_EQ( plane.At(2, 1), 108 );           // (60 + 800 + 4) >> 3
+}
+
+TEST(PredictIntra, DiagonalDownLeftSubstitutesTheTopRight) {
+    Plane plane;
+    for (int i = 0; i < 8; i++) {
+        plane.Set(i, -1, (uint8_t)(10 * i));
+    }
+    fm::PredictIntra4x4(plane.Block(), Plane::kStride, fm::kIntra4x4DiagonalDownLeft,
+                        fm::kIntraTop | fm::kIntraTopRight);
+    // (p[x+y] + 2 p[x+y+1] + p[x+y+2] + 2) >> 2 on a ramp, and the corner
+    // (p[6] + 3 p[7] + 2) >> 2
+    EXPECT_EQ( plane.At(0, 0), 10 );
+    EXPECT_EQ( plane.At(2, 1), 40 );
+    EXPECT_EQ( plane.At(3, 3), 68 );
+
+    // Without the top-right block p[3, -1] stands in for it
+    fm::PredictIntra4x4(plane.Block(), Plane::kStride, fm::kIntra4x4DiagonalDownLeft, fm::kIntraTop);
+    EXPECT_EQ( plane.At(0, 0), 10 );
+    EXPECT_EQ( plane.At(2, 1), 30 );            // (30 + 60 + 30 + 2) >> 2
+    EXPECT_EQ( plane.At(3, 3), 30 );
+}
+
+TEST(PredictIntra, Intra16x16PlaneReproducesARamp) {
+    Plane plane;
+    for (int i = 0; i < 16; i++) {
+        plane.Set(i, -1, (uint8_t)(100 + 2 * i));   // top
+        plane.Set(-1, i, (uint8_t)(100 + 3 * i));   // left
+    }
+    plane.Set(-1, -1, 97);
+    fm::PredictIntra16x16(plane.Block(), Plane::kStride, fm::kIntra16x16Plane,
+                          fm::kIntraLeft | fm::kIntraTop | fm::kIntraTopLeft);
+    // H = 824 and V = 1224 give b = 64 and c = 96, 2 and 3 per sample;
+    // a = 16 * (145 + 130)
+    for (int y = 0; y < 16; y++) {
+        for (int x = 0; x < 16; x++) {
+            ASSERT_EQ( plane.At(x, y), 103 + 2 * x + 3 * y ) << x << "," << y;
+        }
+    }
+}
+
+TEST(PredictIntra, ChromaHorizontalKeepsTheComponentsApart) {
+    Plane plane;
+    for (int i = 0; i < 8; i++) {
+        plane.Set(-2, i, (uint8_t)(50 + i));    // Cb
+        plane.Set(-1, i, (uint8_t)(150 + i));   // Cr
+    }
+    fm::PredictIntraChroma(plane.Block(), Plane::kStride, fm::kIntraChromaHorizontal, fm::kIntraLeft);
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            ASSERT_EQ( plane.At(2 * x, y), 50 + y );
+            ASSERT_EQ( plane.At(2 * x + 1, y), 150 + y );
+        }
+    }
+}
+
+} // namespace H264IntraTest
@@ -0,0 +1,155 @@
+#include <mf_source/H264ParameterSets.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "H264TestStream.h"
+
+
+namespace H264ParameterSetsTest {
+namespace fm = FluxMic;
+namespace ts = H264TestStream;
+
+bool Parse(const std::vector<uint8_t>& rbsp, fm::H264Sps& sps) {
+    fm::BitReader reader(rbsp.data(), rbsp.size());
+    return fm::ParseSps(reader, sps);
+}
+
+bool Parse(const std::vector<uint8_t>& rbsp, fm::H264Pps& pps) {
+    fm::BitReader reader(rbsp.data(), rbsp.size());
+    return fm::ParsePps(reader, pps);
+}
+
+
+TEST(ParseSps, ReadsSizeAndCropping) {
+    ts::SpsParams params;
+    params.id = 3;
+    params.widthInMbs = 120;
+    params.heightInMbs = 68;
+    params.cropBottom = 8;
+    params.log2MaxFrameNum = 9;
+    params.maxNumRefFrames = 4;
+    fm::H264Sps sps;
+    ASSERT_TRUE( Parse(ts::Sps(params), sps) );
+    EXPECT_EQ( sps.profileIdc, 66 );
+    EXPECT_EQ( sps.id, 3u );
+    EXPECT_EQ( sps.chromaFormatIdc, 1u );
+    EXPECT_EQ( sps.log2MaxFrameNum, 9u );
+    EXPECT_EQ( sps.picOrderCntType, 2u );
+    EXPECT_EQ( sps.maxNumRefFrames, 4u );
+    EXPECT_TRUE( sps.frameMbsOnly );
+    EXPECT_EQ( sps.CodedWidth(), 1920u );
+    EXPECT_EQ( sps.CodedHeight(), 1088u );
+    EXPECT_EQ( sps.Width(), 1920u );
+    EXPECT_EQ( sps.Height(), 1080u );
+}
+
+TEST(ParseSps, ReadsHighProfileFields) {
+    ts::SpsParams params;
+    params.profileIdc = 100;
+    fm::H264Sps sps;
+    ASSERT_TRUE( Parse(ts::Sps(params), sps) );
+    EXPECT_EQ( sps.profileIdc, 100 );
+    EXPECT_EQ( sps.bitDepthLuma, 8u );
+    EXPECT_FALSE( sps.scalingMatrixPresent );
+    EXPECT_EQ( sps.CodedWidth(), 32u );
+}
+
+TEST(ParseSps, RejectsTruncatedAndOutOfRangeSets) {
+    std::vector<uint8_t> rbsp = ts::Sps({});
+    fm::H264Sps sps;
+    EXPECT_FALSE( Parse(std::vector<uint8_t>(rbsp.begin(), rbsp.begin() + 4), sps) );
+
+    ts::SpsParams params;
+    params.id = 32;
+    EXPECT_FALSE( Parse(ts::Sps(params), sps) );
+}
+
+TEST(ParseSps, ReadsVuiTiming) {
+    ts::SpsParams params;
+    params.numUnitsInTick = 1001;
+    params.timeScale = 60000;
+    fm::H264Sps sps;
+    ASSERT_TRUE( Parse(ts::Sps(params), sps) );
+    EXPECT_TRUE( sps.timingInfoPresent );
+    EXPECT_EQ( sps.numUnitsInTick, 1001u );
+    EXPECT_EQ( sps.timeScale, 60000u );
+    EXPECT_TRUE( sps.fixedFrameRate );
+    EXPECT_NEAR( sps.FrameRate(), 29.97, 0.01 );
+
+    // Without a VUI, or with one cut short, the rest of the SPS still counts
+    ASSERT_TRUE( Parse(ts::Sps({}), sps) );
+    EXPECT_FALSE( sps.timingInfoPresent );
+    EXPECT_EQ( sps.FrameRate(), 0.0 );
+    std::vector<uint8_t> rbsp = ts::Sps(params);
+    rbsp.resize(rbsp.size() - 6);
+    ASSERT_TRUE( Parse(rbsp, sps) );
+    EXPECT_FALSE( sps.timingInfoPresent );
+    EXPECT_EQ( sps.CodedWidth(), 32u );
+}
+
+TEST(FindSps, ParsesTheSpsBeforeTheFirstSlice) {
+    ts::SpsParams params;
+    params.widthInMbs = 80;
+    params.heightInMbs = 45;
+    params.maxNumRefFrames = 2;
+    params.numUnitsInTick = 1;
+    params.timeScale = 120;
+    std::vector<uint8_t> stream;
+    ts::AppendNal(stream, 0, fm::kNalAud, { 0xF0 });
+    ts::AppendNal(stream, 3, fm::kNalSps, ts::Sps(params));
+    ts::AppendNal(stream, 3, fm::kNalPps, ts::Pps({}));
+    ts::AppendNal(stream, 3, fm::kNalSliceIdr, { 0x88, 0x80 });
+
+    fm::H264Sps sps;
+    ASSERT_TRUE( fm::FindSps(stream.data(), stream.size(), sps) );
+    EXPECT_EQ( sps.Width(), 1280u );
+    EXPECT_EQ( sps.Height(), 720u );
+    EXPECT_EQ( sps.maxNumRefFrames, 2u );
+    EXPECT_EQ( sps.FrameRate(), 60.0 );
+}
+
+TEST(FindSps, StopsAtTheFirstSlice) {
+    std::vector<uint8_t> stream;
+    ts::AppendNal(stream, 2, fm::kNalSlice, { 0x9A, 0x80 });
+    ts::AppendNal(stream, 3, fm::kNalSps, ts::Sps({}));
+    fm::H264Sps sps;
+    EXPECT_FALSE( fm::FindSps(stream.data(), stream.size(), sps) );
+    EXPECT_FALSE( fm::FindSps(nullptr, 0, sps) );
+
+    // A damaged SPS is skipped for a later one
+    std::vector<uint8_t> damaged;
+    ts::AppendNal(damaged, 3, fm::kNalSps, { 0x42, 0x00 });
+    ts::AppendNal(damaged, 3, fm::kNalSps, ts::Sps({}));
+    EXPECT_TRUE( fm::FindSps(damaged.data(), damaged.size(), sps) );
+}
+
+TEST(ParsePps, ReadsTheFieldsTheDecoderChecks) {
+    ts::PpsParams params;
+    params.id = 7;
+    params.spsId = 2;
+    params.cabac = true;
+    params.numRefIdxL0DefaultActive = 3;
+    params.picInitQp = 30;
+    params.chromaQpIndexOffset = -2;
+    fm::H264Pps pps;
+    ASSERT_TRUE( Parse(ts::Pps(params), pps) );
+    EXPECT_EQ( pps.id, 7u );
+    EXPECT_EQ( pps.spsId, 2u );
+    EXPECT_TRUE( pps.entropyCodingMode );
+    EXPECT_EQ( pps.numSliceGroups, 1u );
+    EXPECT_EQ( pps.numRefIdxL0DefaultActive, 3u );
+    EXPECT_EQ( pps.picInitQp, 30 );
+    EXPECT_EQ( pps.chromaQpIndexOffset, -2 );
+    EXPECT_EQ( pps.secondChromaQpIndexOffset, -2 );
+    EXPECT_TRUE( pps.deblockingFilterControlPresent );
+    EXPECT_FALSE( pps.transform8x8Mode );
+
+    params.extension = true;
+    params.secondChromaQpIndexOffset = 5;
+    ASSERT_TRUE( Parse(ts::Pps(params), pps) );
+    EXPECT_EQ( pps.chromaQpIndexOffset, -2 );
+    EXPECT_EQ( pps.secondChromaQpIndexOffset, 5 );
+}
+
+} // namespace H264ParameterSetsTest
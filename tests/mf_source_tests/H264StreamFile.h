@@ -0,0 +1,97 @@
+#pragma once
+
+// Reads H.264 Annex B files for the conformance test and the decoder bench:
+// the access units of the stream, fed one per DecodeNal() call as the MF
+// source does with pipe messages, and the decoded frames as raw NV12.
+
+#include <mf_source/AnnexB.h>
+#include <mf_source/DecodedFrame.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+
+namespace H264StreamFile {
+namespace fm = FluxMic;
+
+struct AccessUnit {
+    size_t offset;
+    size_t size;
+};
+
+inline bool ReadFile(const char* path, std::vector<uint8_t>& data) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    uint8_t buffer[65536];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        data.insert(data.end(), buffer, buffer + read);
+    }
+    fclose(f);
+    return true;
+}
+
+// Where the start code before `nal` begins
+inline size_t StartCodeOffset(const std::vector<uint8_t>& data, const fm::NalUnit& nal) {
+    size_t offset = (size_t)(nal.data - data.data()) - 3;
+    if (offset > 0 && data[offset - 1] == 0) offset--;
+    return offset;
+}
+
+/// Split at access unit delimiters, or at slices with first_mb_in_slice 0
+/// when the stream has none.
+inline std::vector<AccessUnit> SplitAccessUnits(const std::vector<uint8_t>& data) {
+    bool hasAud = false;
+    {
+        fm::NalScanner scanner(data.data(), data.size());
+        fm::NalUnit nal;
+        while (scanner.Next(nal) && !hasAud) {
+            hasAud = nal.type == fm::kNalAud;
+        }
+    }
+
+    std::vector<size_t> starts;
+    bool pictureSeen = false;
+    size_t pending = data.size();   // parameter sets or SEI before the next picture
+    fm::NalScanner scanner(data.data(), data.size());
+    fm::NalUnit nal;
+    while (scanner.Next(nal)) {
+        size_t offset = StartCodeOffset(data, nal);
+        bool isSlice = nal.type == fm::kNalSlice || nal.type == fm::kNalSliceIdr;
+        bool firstSlice = isSlice && nal.size > 1 && (nal.data[1] & 0x80);   // ue(v) 0
+        if (hasAud) {
+            if (nal.type == fm::kNalAud) starts.push_back(offset);
+        } else if (isSlice) {
+            if (firstSlice || !pictureSeen) starts.push_back(std::min(pending, offset));
+            pictureSeen = true;
+            pending = data.size();
+        } else if (pending == data.size()) {
+            pending = offset;
+        }
+    }
+
+    std::vector<AccessUnit> units;
+    if (!starts.empty()) starts[0] = 0;
+    for (size_t i = 0; i < starts.size(); i++) {
+        size_t end = (i + 1 < starts.size()) ? starts[i + 1] : data.size();
+        units.push_back({ starts[i], end - starts[i] });
+    }
+    return units;
+}
+
+/// The frame as raw NV12 of the cropped size, rows without padding, as
+/// `ffmpeg -pix_fmt nv12` writes it: `write(data, size)` once per row.
+template <typename Write>
+void ForEachNv12Row(const fm::DecodedFrame& frame, Write write) {
+    for (uint32_t y = 0; y < frame.height; y++) {
+        write(frame.luma + (size_t)y * frame.pitch, (size_t)frame.width);
+    }
+    uint32_t chromaWidth = (frame.width + 1) & ~1u;
+    for (uint32_t y = 0; y < (frame.height + 1) / 2; y++) {
+        write(frame.chroma + (size_t)y * frame.pitch, (size_t)chromaWidth);
+    }
+}
+
+} // namespace H264StreamFile
@@ -0,0 +1,228 @@
+#pragma once
+
+// Writes small H.264 streams for the decoder tests: the bits of parameter
+// sets, slice headers and macroblocks, and Annex B NAL units around them.
+
+#include <cstdint>
+#include <vector>
+
+
+namespace H264TestStream {
+
+class BitWriter {
+public:
+    void Bits(uint32_t value, int count) {
+        for (int i = count - 1; i >= 0; i--) {
+            Bit((value >> i) & 1);
+        }
+    }
+    void Bit(uint32_t bit) {
+        if (m_bits == 0) bytes.push_back(0);
+        bytes.back() |= (uint8_t)(bit << (7 - m_bits));
+        m_bits = (m_bits + 1) & 7;
+    }
+    void Ue(uint32_t value) {
+        uint64_t code = (uint64_t)value + 1;
+        int length = 0;
+        while ((code >> length) > 1) {
+            length++;
+        }
+        Bits(0, length);
+        for (int i = length; i >= 0; i--) {
+            Bit((uint32_t)(code >> i) & 1);
+        }
+    }
+    void Se(int32_t value) {
+        Ue(value > 0 ? 2 * (uint32_t)value - 1 : 2 * (uint32_t)-value);
+    }
+    /// rbsp_trailing_bits()
+    void Trailing() {
+        Bit(1);
+        while (m_bits != 0) {
+            Bit(0);
+        }
+    }
+    bool IsByteAligned() const { return m_bits == 0; }
+
+    std::vector<uint8_t> bytes;
+
+private:
+    int m_bits = 0;     // used in the last byte
+};
+
+/// Start code, NAL header and the RBSP with emulation prevention bytes
+inline void AppendNal(std::vector<uint8_t>& stream, uint8_t refIdc, uint8_t type,
+                      const std::vector<uint8_t>& rbsp) {
+    stream.insert(stream.end(), { 0, 0, 0, 1, (uint8_t)(refIdc << 5 | type) });
+    int zeros = 0;
+    for (uint8_t byte : rbsp) {
+        if (zeros == 2 && byte <= 3) {
+            stream.push_back(3);
+            zeros = 0;
+        }
+        stream.push_back(byte);
+        zeros = (byte == 0) ? zeros + 1 : 0;
+    }
+}
+
+struct SpsParams {
+    uint8_t profileIdc = 66;        // Constrained Baseline
+    uint32_t id = 0;
+    uint32_t widthInMbs = 2;
+    uint32_t heightInMbs = 2;
+    uint32_t log2MaxFrameNum = 4;
+    uint32_t maxNumRefFrames = 1;
+    uint32_t cropRight = 0;         // in luma samples, even
+    uint32_t cropBottom = 0;
+    bool frameMbsOnly = true;
+    uint32_t numUnitsInTick = 0;    // VUI timing, with an extended SAR before it, if set
+    uint32_t timeScale = 0;
+};
+
+inline std::vector<uint8_t> Sps(const SpsParams& p) {
+    BitWriter w;
+    w.Bits(p.profileIdc, 8);
+    w.Bits(0xC0, 8);                // constraint_set0 and 1
+    w.Bits(31, 8);
+    w.Ue(p.id);
+    if (p.profileIdc == 100) {
+        w.Ue(1);                    // chroma_format_idc
+        w.Ue(0);
+        w.Ue(0);
+        w.Bit(0);
+        w.Bit(0);
+    }
+    w.Ue(p.log2MaxFrameNum - 4);
+    w.Ue(2);                        // pic_order_cnt_type
+    w.Ue(p.maxNumRefFrames);
+    w.Bit(0);                       // gaps_in_frame_num_value_allowed_flag
+    w.Ue(p.widthInMbs - 1);
+    w.Ue(p.heightInMbs - 1);
+    w.Bit(p.frameMbsOnly);
+    if (!p.frameMbsOnly) w.Bit(0);
+    w.Bit(1);                       // direct_8x8_inference_flag
+    bool crop = p.cropRight || p.cropBottom;
+    w.Bit(crop);
+    if (crop) {
+        w.Ue(0);
+        w.Ue(p.cropRight / 2);
+        w.Ue(0);
+        w.Ue(p.cropBottom / 2);
+    }
+    bool vui = p.numUnitsInTick != 0;
+    w.Bit(vui);                     // vui_parameters_present_flag
+    if (vui) {
+        w.Bit(1);                   // aspect_ratio_info_present_flag
+        w.Bits(255, 8);             // Extended_SAR
+        w.Bits(1, 16);
+        w.Bits(1, 16);
+        w.Bit(0);                   // overscan_info_present_flag
+        w.Bit(1);                   // video_signal_type_present_flag
+        w.Bits(5, 3);
+        w.Bit(0);
+        w.Bit(1);                   // colour_description_present_flag
+        w.Bits(0x010101, 24);
+        w.Bit(0);                   // chroma_loc_info_present_flag
+        w.Bit(1);                   // timing_info_present_flag
+        w.Bits(p.numUnitsInTick, 32);
+        w.Bits(p.timeScale, 32);
+        w.Bit(1);                   // fixed_frame_rate_flag
+        w.Bits(0, 5);               // no HRD, pic_struct, bitstream_restriction
+    }
+    w.Trailing();
+    return w.bytes;
+}
+
+struct PpsParams {
+    uint32_t id = 0;
+    uint32_t spsId = 0;
+    bool cabac = false;
+    uint32_t numRefIdxL0DefaultActive = 1;
+    int32_t picInitQp = 26;
+    int32_t chromaQpIndexOffset = 0;
+    bool extension = false;         // the High profile fields after redundant_pic_cnt
+    int32_t secondChromaQpIndexOffset = 0;
+};
+
+inline std::vector<uint8_t> Pps(const PpsParams& p) {
+    BitWriter w;
+    w.Ue(p.id);
+    w.Ue(p.spsId);
+    w.Bit(p.cabac);
+    w.Bit(0);                       // bottom_field_pic_order_in_frame_present_flag
+    w.Ue(0);                        // num_slice_groups_minus1
+    w.Ue(p.numRefIdxL0DefaultActive - 1);
+    w.Ue(0);
+    w.Bit(0);                       // weighted_pred_flag
+    w.Bits(0, 2);
+    w.Se(p.picInitQp - 26);
+    w.Se(0);
+    w.Se(p.chromaQpIndexOffset);
+    w.Bit(1);                       // deblocking_filter_control_present_flag
+    w.Bit(0);                       // constrained_intra_pred_flag
+    w.Bit(0);                       // redundant_pic_cnt_present_flag
+    if (p.extension) {
+        w.Bit(0);                   // transform_8x8_mode_flag
+        w.Bit(0);                   // pic_scaling_matrix_present_flag
+        w.Se(p.secondChromaQpIndexOffset);
+    }
+    w.Trailing();
+    return w.bytes;
+}
+
+struct SliceParams {
+    bool idr = true;
+    bool intra = true;              // I slice, else P
+    uint32_t firstMb = 0;
+    uint32_t ppsId = 0;
+    uint32_t frameNum = 0;
+    uint32_t log2MaxFrameNum = 4;
+    uint32_t idrPicId = 0;
+    bool reference = true;
+    int32_t sliceQpDelta = 0;
+    uint32_t disableDeblocking = 0;
+};
+
+/// slice_header() for pic_order_cnt_type 2, without list modification
+/// or adaptive marking
+inline void SliceHeader(BitWriter& w, const SliceParams& p) {
+    w.Ue(p.firstMb);
+    w.Ue(p.intra ? 7 : 5);          // all slices of the picture have this type
+    w.Ue(p.ppsId);
+    w.Bits(p.frameNum, (int)p.log2MaxFrameNum);
+    if (p.idr) w.Ue(p.idrPicId);
+    if (!p.intra) {
+        w.Bit(0);                   // num_ref_idx_active_override_flag
+        w.Bit(0);                   // ref_pic_list_modification_flag_l0
+    }
+    if (p.reference) {
+        if (p.idr) {
+            w.Bit(0);               // no_output_of_prior_pics_flag
+            w.Bit(0);               // long_term_reference_flag
+        } else {
+            w.Bit(0);               // adaptive_ref_pic_marking_mode_flag
+        }
+    }
+    w.Se(p.sliceQpDelta);
+    w.Ue(p.disableDeblocking);
+    if (p.disableDeblocking != 1) {
+        w.Se(0);                    // slice_alpha_c0_offset_div2
+        w.Se(0);                    // slice_beta_offset_div2
+    }
+}
+
+/// mb_type I_PCM with its samples; `luma` is 16x16, `chroma` 8x8 Cb then 8x8 Cr
+inline void PcmMacroblock(BitWriter& w, bool pSlice, const uint8_t* luma, const uint8_t* chroma) {
+    w.Ue(pSlice ? 5 + 25 : 25);
+    while (!w.IsByteAligned()) {
+        w.Bit(0);                   // pcm_alignment_zero_bit
+    }
+    for (int i = 0; i < 256; i++) {
+        w.Bits(luma[i], 8);
+    }
+    for (int i = 0; i < 128; i++) {
+        w.Bits(chroma[i], 8);
+    }
+}
+
+} // namespace H264TestStream
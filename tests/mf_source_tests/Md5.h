@@ -0,0 +1,114 @@
+#pragma once
+
+// MD5 (RFC 1321), to compare decoded frames with the per-frame hashes of
+// a reference decoder (ffmpeg -f framemd5). Not for anything secure.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+
+namespace Md5 {
+
+class Hasher {
+public:
+    void Update(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        m_length += size;
+        while (size > 0) {
+            size_t take = std::min(size, (size_t)64 - m_buffered);
+            std::memcpy(m_buffer + m_buffered, bytes, take);
+            m_buffered += take;
+            bytes += take;
+            size -= take;
+            if (m_buffered == 64) {
+                Block(m_buffer);
+                m_buffered = 0;
+            }
+        }
+    }
+
+    /// Lowercase hex digest; the hasher can't be updated afterwards.
+    std::string Finish() {
+        uint64_t bits = m_length * 8;
+        uint8_t pad = 0x80;
+        Update(&pad, 1);
+        pad = 0;
+        while (m_buffered != 56) {
+            Update(&pad, 1);
+        }
+        uint8_t length[8];
+        for (int i = 0; i < 8; i++) {
+            length[i] = (uint8_t)(bits >> (8 * i));
+        }
+        Update(length, 8);
+
+        std::string hex;
+        for (uint32_t word : m_state) {
+            for (int i = 0; i < 4; i++) {
+                char digits[3];
+                std::snprintf(digits, sizeof(digits), "%02x", (word >> (8 * i)) & 0xFF);
+                hex += digits;
+            }
+        }
+        return hex;
+    }
+
+private:
+    static uint32_t Rotate(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+    void Block(const uint8_t* block) {
+        static const uint32_t K[64] = {
+            0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+            0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+            0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+            0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+            0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+            0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+            0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+            0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+        };
+        static const int S[16] = { 7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };
+
+        uint32_t m[16];
+        for (int i = 0; i < 16; i++) {
+            m[i] = (uint32_t)block[4 * i] | (uint32_t)block[4 * i + 1] << 8
+                 | (uint32_t)block[4 * i + 2] << 16 | (uint32_t)block[4 * i + 3] << 24;
+        }
+        uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+        for (int i = 0; i < 64; i++) {
+            uint32_t f;
+            int g;
+            switch (i / 16) {
+            case 0:  f = (b & c) | (~b & d); g = i; break;
+            case 1:  f = (d & b) | (~d & c); g = (5 * i + 1) % 16; break;
+            case 2:  f = b ^ c ^ d;          g = (3 * i + 5) % 16; break;
+            default: f = c ^ (b | ~d);       g = (7 * i) % 16; break;
+            }
+            uint32_t next = b + Rotate(a + f + K[i] + m[g], S[(i / 16) * 4 + i % 4]);
+            a = d;
+            d = c;
+            c = b;
+            b = next;
+        }
+        m_state[0] += a;
+        m_state[1] += b;
+        m_state[2] += c;
+        m_state[3] += d;
+    }
+
+    uint32_t m_state[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    uint8_t m_buffer[64] = {};
+    size_t m_buffered = 0;
+    uint64_t m_length = 0;
+};
+
+inline std::string Hash(const void* data, size_t size) {
+    Hasher hasher;
+    hasher.Update(data, size);
+    return hasher.Finish();
+}
+
+} // namespace Md5
@@ -0,0 +1,270 @@
+#include <mf_source/MessageReader.h>
+#include <mf_source/FrameMessage.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+namespace MessageReaderTest {
+namespace fm = FluxMic;
+
+
+// Stand-in for the message-mode pipe: a SOCK_SEQPACKET socket keeps the
+// message boundaries the same way, and Cancel() wakes poll() through a
+// second socket pair.
+class SocketMessageSource : public fm::MessageSource
+{
+ public:
+    explicit SocketMessageSource(int fd) : m_fd(fd)
+    {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, m_cancel);
+    }
+    ~SocketMessageSource() override
+    {
+        close(m_fd);
+        close(m_cancel[0]);
+        close(m_cancel[1]);
+    }
+
+    Result ReadMessage(std::vector<uint8_t>& buffer, size_t& size) override
+    {
+        pollfd fds[2] = { { m_fd, POLLIN, 0 }, { m_cancel[0], POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0 || (fds[1].revents & POLLIN))
+        {
+            return Result::Cancelled;
+        }
+        // Peek at the length first, as PeekNamedPipe() does for the pipe.
+        ssize_t length = recv(m_fd, nullptr, 0, MSG_PEEK | MSG_TRUNC);
+        if (length <= 0)
+        {
+            return Result::Closed;
+        }
+        if ((size_t)length > fm::kMaxMessageSize)
+        {
+            recv(m_fd, nullptr, 0, MSG_TRUNC);
+            return Result::TooLarge;
+        }
+        if (buffer.size() < (size_t)length)
+        {
+            buffer.resize(length);
+        }
+        size = (size_t)recv(m_fd, buffer.data(), buffer.size(), 0);
+        return Result::Message;
+    }
+
+    void Cancel() override
+    {
+        char c = 0;
+        (void)!write(m_cancel[1], &c, 1);
+    }
+
+ private:
+    int m_fd;
+    int m_cancel[2];
+};
+
+
+class MessageReader : public ::testing::Test
+{
+ protected:
+    int m_server = -1;
+    int m_client = -1;
+
+    void SetUp() override
+    {
+        int fds[2];
+        ASSERT_EQ( socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds), 0 );
+        m_server = fds[0];
+        m_client = fds[1];
+        // Room for the large message test without blocking the sender
+        int bufferSize = 1024 * 1024;
+        setsockopt(m_server, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+        setsockopt(m_client, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+    }
+    void TearDown() override
+    {
+        if (m_server >= 0) close(m_server);
+    }
+
+    std::unique_ptr<fm::MessageSource> ClientSource()
+    {
+        return std::unique_ptr<fm::MessageSource>(new SocketMessageSource(m_client));
+    }
+
+    void SendFrame(uint32_t sequence, uint32_t frameSize)
+    {
+        fm::FrameHeader header = { 640, 480, 1000u + sequence, sequence, frameSize };
+        std::vector<uint8_t> message(fm::kHeaderSize + frameSize, (uint8_t)sequence);
+        std::memcpy(message.data(), &header, sizeof(header));
+        ASSERT_EQ( send(m_server, message.data(), message.size(), 0), (ssize_t)message.size() );
+    }
+
+    void SendRaw(const std::vector<uint8_t>& bytes)
+    {
+        ASSERT_EQ( send(m_server, bytes.data(), bytes.size(), 0), (ssize_t)bytes.size() );
+    }
+
+    static fm::FrameHeader FrontHeader(fm::MessageRing& ring)
+    {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        fm::FrameHeader header = {};
+        EXPECT_TRUE( ring.Front(data, size) );
+        EXPECT_TRUE( data && fm::ParseFrameMessage(data, size, header) );
+        return header;
+    }
+
+    static bool WaitUntil(const std::function<bool()>& condition)
+    {
+        auto limit = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!condition())
+        {
+            if (std::chrono::steady_clock::now() > limit) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+};
+
+
+TEST_F(MessageReader, DeliversFramesInOrder) {
+    fm::MessageReader reader(4, 256);
+    reader.Start(ClientSource());
+    EXPECT_TRUE( reader.IsRunning() );
+
+    SendFrame(1, 100);
+    SendFrame(2, 200);
+    SendFrame(3, 50);
+    ASSERT_TRUE( WaitUntil([&] { return reader.Ring().Count() == 3; }) );
+
+    auto& ring = reader.Ring();
+    EXPECT_EQ( FrontHeader(ring).sequence, 1u );
+    ring.Pop();
+    EXPECT_EQ( FrontHeader(ring).frame_size, 200u );
+    ring.Pop();
+    EXPECT_EQ( FrontHeader(ring).sequence, 3u );
+    ring.Pop();
+    EXPECT_EQ( reader.DroppedMessages(), 0u );
+    EXPECT_EQ( reader.InvalidMessages(), 0u );
+}
+
+TEST_F(MessageReader, WaitForMessage) {
+    fm::MessageReader reader(4, 256);
+    reader.Start(ClientSource());
+    EXPECT_FALSE( reader.WaitForMessage(0) );
+    EXPECT_FALSE( reader.WaitForMessage(10) );
+
+    std::thread sender([this]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        SendFrame(1, 10);
+    });
+    EXPECT_TRUE( reader.WaitForMessage(5000) );
+    EXPECT_EQ( FrontHeader(reader.Ring()).sequence, 1u );
+    sender.join();
+}
+
+TEST_F(MessageReader, GrowsBufferForLargeMessage) {
+    fm::MessageReader reader(2, 64);
+    reader.Start(ClientSource());
+
+    SendFrame(1, 300 * 1024);
+    ASSERT_TRUE( reader.WaitForMessage(5000) );
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    ASSERT_TRUE( reader.Ring().Front(data, size) );
+    EXPECT_EQ( size, fm::kHeaderSize + 300 * 1024 );
+    EXPECT_EQ( data[size - 1], 1 );
+}
+
+TEST_F(MessageReader, DiscardsMalformedMessages) {
+    fm::MessageReader reader(4, 256);
+    reader.Start(ClientSource());
+
+    SendRaw(std::vector<uint8_t>(10, 0));           // shorter than the header
+    fm::FrameHeader header = { 640, 480, 0, 5, 100 };
+    std::vector<uint8_t> truncated(fm::kHeaderSize + 50);
+    std::memcpy(truncated.data(), &header, sizeof(header));
+    SendRaw(truncated);                             // frame_size doesn't match
+    SendFrame(7, 20);
+
+    ASSERT_TRUE( reader.WaitForMessage(5000) );
+    EXPECT_EQ( FrontHeader(reader.Ring()).sequence, 7u );
+    EXPECT_EQ( reader.Ring().Count(), 1u );
+    EXPECT_EQ( reader.InvalidMessages(), 2u );
+}
+
+TEST_F(MessageReader, DropsNewFramesWhenRingIsFull) {
+    fm::MessageReader reader(2, 256);
+    reader.Start(ClientSource());
+
+    for (uint32_t i = 1; i <= 5; i++)
+    {
+        SendFrame(i, 10);
+    }
+    ASSERT_TRUE( WaitUntil([&] { return reader.DroppedMessages() == 3; }) );
+    EXPECT_EQ( reader.Ring().Count(), 2u );
+    EXPECT_EQ( FrontHeader(reader.Ring()).sequence, 1u );
+
+    // The reader goes on once the consumer makes room.
+    reader.Ring().Pop();
+    reader.Ring().Pop();
+    SendFrame(6, 10);
+    ASSERT_TRUE( reader.WaitForMessage(5000) );
+    EXPECT_EQ( FrontHeader(reader.Ring()).sequence, 6u );
+}
+
+TEST_F(MessageReader, StopsWhenServerCloses) {
+    fm::MessageReader reader(4, 256);
+    reader.Start(ClientSource());
+    SendFrame(1, 10);
+    ASSERT_TRUE( reader.WaitForMessage(5000) );
+
+    close(m_server);
+    m_server = -1;
+    ASSERT_TRUE( WaitUntil([&] { return !reader.IsRunning(); }) );
+    // What was received before is still there.
+    EXPECT_EQ( reader.Ring().Count(), 1u );
+}
+
+TEST_F(MessageReader, StopCancelsPendingRead) {
+    fm::MessageReader reader(4, 256);
+    reader.Start(ClientSource());
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    auto start = std::chrono::steady_clock::now();
+    reader.Stop();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_FALSE( reader.IsRunning() );
+    EXPECT_LT( elapsed, std::chrono::seconds(1) );
+    EXPECT_FALSE( reader.WaitForMessage(0) );
+}
+
+TEST_F(MessageReader, RestartDiscardsOldMessages) {
+    fm::MessageReader reader(4, 256);
+    reader.Start(ClientSource());
+    SendFrame(1, 10);
+    ASSERT_TRUE( reader.WaitForMessage(5000) );
+    reader.Stop();
+
+    int fds[2];
+    ASSERT_EQ( socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds), 0 );
+    close(m_server);
+    m_server = fds[0];
+    m_client = fds[1];
+    reader.Start(ClientSource());
+    EXPECT_EQ( reader.Ring().Count(), 0u );
+    SendFrame(2, 10);
+    ASSERT_TRUE( reader.WaitForMessage(5000) );
+    EXPECT_EQ( FrontHeader(reader.Ring()).sequence, 2u );
+}
+
+} //namespace MessageReaderTest
@@ -0,0 +1,157 @@
+#include <mf_source/MessageRing.h>
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <thread>
+
+
+namespace MessageRingTest {
+namespace fm = FluxMic;
+
+
+void Put(fm::MessageRing& ring, uint32_t value)
+{
+    auto buffer = ring.BeginWrite();
+    ASSERT_NE( buffer, nullptr );
+    std::memcpy(buffer->data(), &value, sizeof(value));
+    ring.CommitWrite(sizeof(value));
+}
+
+uint32_t Take(fm::MessageRing& ring)
+{
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    uint32_t value = 0;
+    EXPECT_TRUE( ring.Front(data, size) );
+    EXPECT_EQ( size, sizeof(value) );
+    std::memcpy(&value, data, sizeof(value));
+    ring.Pop();
+    return value;
+}
+
+
+TEST(MessageRing, StartsEmpty) {
+    fm::MessageRing ring(4, 16);
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    EXPECT_EQ( ring.SlotCount(), 4u );
+    EXPECT_EQ( ring.Count(), 0u );
+    EXPECT_FALSE( ring.Front(data, size) );
+    ring.Pop();     // no effect
+    EXPECT_EQ( ring.Count(), 0u );
+}
+
+TEST(MessageRing, BuffersArePreallocated) {
+    fm::MessageRing ring(3, 1000);
+    for (int i = 0; i < 3; i++)
+    {
+        auto buffer = ring.BeginWrite();
+        ASSERT_NE( buffer, nullptr );
+        EXPECT_EQ( buffer->size(), 1000u );
+        ring.CommitWrite(1);
+    }
+}
+
+TEST(MessageRing, FirstInFirstOut) {
+    fm::MessageRing ring(4, 16);
+    Put(ring, 1);
+    Put(ring, 2);
+    EXPECT_EQ( ring.Count(), 2u );
+    EXPECT_EQ( Take(ring), 1u );
+    Put(ring, 3);
+    EXPECT_EQ( Take(ring), 2u );
+    EXPECT_EQ( Take(ring), 3u );
+    EXPECT_EQ( ring.Count(), 0u );
+}
+
+TEST(MessageRing, PeekLooksBehindFront) {
+    fm::MessageRing ring(3, 16);
+    Put(ring, 1);
+    Take(ring);
+    Put(ring, 2);
+    Put(ring, 3);
+    Put(ring, 4);   // wraps around
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    uint32_t value = 0;
+    ASSERT_TRUE( ring.Peek(2, data, size) );
+    std::memcpy(&value, data, sizeof(value));
+    EXPECT_EQ( value, 4u );
+    EXPECT_FALSE( ring.Peek(3, data, size) );
+    EXPECT_EQ( Take(ring), 2u );
+}
+
+TEST(MessageRing, FullRingRefusesWrites) {
+    fm::MessageRing ring(2, 16);
+    Put(ring, 1);
+    Put(ring, 2);
+    EXPECT_EQ( ring.BeginWrite(), nullptr );
+    EXPECT_EQ( Take(ring), 1u );
+    EXPECT_NE( ring.BeginWrite(), nullptr );
+}
+
+TEST(MessageRing, ProducerMayGrowItsBuffer) {
+    fm::MessageRing ring(2, 4);
+    auto buffer = ring.BeginWrite();
+    buffer->resize(100, 0x5A);
+    ring.CommitWrite(100);
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    ASSERT_TRUE( ring.Front(data, size) );
+    EXPECT_EQ( size, 100u );
+    EXPECT_EQ( data[99], 0x5A );
+}
+
+TEST(MessageRing, ResetDiscardsMessages) {
+    fm::MessageRing ring(2, 16);
+    Put(ring, 1);
+    Put(ring, 2);
+    ring.Reset();
+    EXPECT_EQ( ring.Count(), 0u );
+    Put(ring, 3);
+    EXPECT_EQ( Take(ring), 3u );
+}
+
+TEST(MessageRing, TwoThreadsKeepOrder) {
+    const uint32_t COUNT = 100000;
+    fm::MessageRing ring(4, 16);
+
+    std::thread producer([&]
+    {
+        for (uint32_t i = 0; i < COUNT; )
+        {
+            if (auto buffer = ring.BeginWrite())
+            {
+                std::memcpy(buffer->data(), &i, sizeof(i));
+                ring.CommitWrite(sizeof(i));
+                i++;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint32_t expected = 0;
+    while (expected < COUNT)
+    {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        if (!ring.Front(data, size))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        EXPECT_EQ( value, expected );
+        ring.Pop();
+        expected++;
+    }
+    producer.join();
+}
+
+} //namespace MessageRingTest
@@ -0,0 +1,118 @@
+#include <mf_source/SamplePool.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+
+namespace SamplePoolTest {
+namespace fm = FluxMic;
+
+
+struct FakeSample
+{
+    size_t capacity;
+    int refs;
+};
+
+int g_live = 0;
+
+struct FakeOps
+{
+    static FakeSample* Create(size_t capacity)
+    {
+        g_live++;
+        return new FakeSample{ capacity, 1 };
+    }
+    static bool Grow(FakeSample* sample, size_t capacity) { sample->capacity = capacity; return true; }
+    static size_t Capacity(FakeSample* sample) { return sample->capacity; }
+    static bool IsIdle(FakeSample* sample) { return sample->refs == 1; }
+    static void Destroy(FakeSample* sample)
+    {
+        if (--sample->refs == 0)
+        {
+            g_live--;
+            delete sample;
+        }
+    }
+};
+
+using Pool = fm::SamplePool<FakeSample, FakeOps>;
+
+
+TEST(SamplePool, SteadyStateDoesNotAllocate) {
+    Pool pool;
+    for (int i = 0; i < 100; i++)
+    {
+        auto sample = pool.Acquire(1000);
+        ASSERT_NE( sample, nullptr );
+        EXPECT_GE( sample->capacity, 1000u );
+    }
+    EXPECT_EQ( pool.Size(), 1u );
+    EXPECT_EQ( pool.Allocations(), 1u );
+}
+
+TEST(SamplePool, HeldSamplesAreNotReused) {
+    Pool pool;
+    auto first = pool.Acquire(100);
+    first->refs++;                      // e.g. the decoder keeps it
+    auto second = pool.Acquire(100);
+    EXPECT_NE( first, second );
+    EXPECT_EQ( pool.Allocations(), 2u );
+
+    first->refs--;                      // released
+    EXPECT_EQ( pool.Acquire(100), first );
+    EXPECT_EQ( pool.Allocations(), 2u );
+}
+
+TEST(SamplePool, GrowsIdleSampleForLargerRequest) {
+    Pool pool;
+    auto sample = pool.Acquire(100);
+    EXPECT_EQ( pool.Acquire(5000), sample );
+    EXPECT_EQ( sample->capacity, 5000u );
+    EXPECT_EQ( pool.Size(), 1u );
+    EXPECT_EQ( pool.Allocations(), 2u );
+
+    // Smaller requests fit the grown sample.
+    EXPECT_EQ( pool.Acquire(200), sample );
+    EXPECT_EQ( pool.Allocations(), 2u );
+}
+
+TEST(SamplePool, ReserveAllocatesUpFront) {
+    Pool pool;
+    auto small = pool.Acquire(100);
+    EXPECT_TRUE( pool.Reserve(3, 4000) );
+    EXPECT_EQ( pool.Size(), 3u );
+    EXPECT_EQ( small->capacity, 4000u );
+    EXPECT_EQ( pool.Allocations(), 4u );
+
+    // Three samples in use at once fit without another allocation
+    FakeSample* held[3];
+    for (FakeSample*& sample : held) {
+        sample = pool.Acquire(4000);
+        sample->refs++;
+    }
+    EXPECT_EQ( pool.Allocations(), 4u );
+    EXPECT_TRUE( pool.Reserve(2, 8000) );    // nothing idle to grow, enough samples
+    EXPECT_EQ( pool.Allocations(), 4u );
+    for (FakeSample* sample : held) {
+        sample->refs--;
+    }
+}
+
+TEST(SamplePool, ClearLeavesHeldSamplesToTheirHolders) {
+    g_live = 0;
+    FakeSample* held = nullptr;
+    {
+        Pool pool;
+        pool.Acquire(10);
+        held = pool.Acquire(10);
+        held->refs++;
+        pool.Acquire(10);
+        EXPECT_EQ( g_live, 2 );
+    }
+    EXPECT_EQ( g_live, 1 );
+    FakeOps::Destroy(held);
+    EXPECT_EQ( g_live, 0 );
+}
+
+} //namespace SamplePoolTest
@@ -0,0 +1,420 @@
+#include <mf_source/SoftH264Decoder.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "H264TestStream.h"
+
+
+namespace SoftH264DecoderTest {
+namespace fm = FluxMic;
+namespace ts = H264TestStream;
+
+// A planar 4:2:0 picture of whole macroblocks, as the test encoder has it
+struct Picture {
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> y;
+    std::vector<uint8_t> cb;
+    std::vector<uint8_t> cr;
+
+    Picture(uint32_t w, uint32_t h)
+        : width(w), height(h), y(w * h), cb(w * h / 4), cr(w * h / 4) {}
+
+    static Picture Random(uint32_t w, uint32_t h, uint32_t seed) {
+        Picture picture(w, h);
+        std::mt19937 random(seed);
+        for (auto* plane : { &picture.y, &picture.cb, &picture.cr }) {
+            for (uint8_t& sample : *plane) {
+                sample = (uint8_t)random();
+            }
+        }
+        return picture;
+    }
+};
+
+std::vector<uint8_t> ParameterSets(const ts::SpsParams& sps, const ts::PpsParams& pps = {}) {
+    std::vector<uint8_t> stream;
+    ts::AppendNal(stream, 3, fm::kNalSps, ts::Sps(sps));
+    ts::AppendNal(stream, 3, fm::kNalPps, ts::Pps(pps));
+    return stream;
+}
+
+// One slice of I_PCM macroblocks carrying `picture`, to its end or for
+// `count` macroblocks
+std::vector<uint8_t> PcmPicture(const Picture& picture, ts::SliceParams slice = {}, uint32_t count = ~0u) {
+    ts::BitWriter w;
+    ts::SliceHeader(w, slice);
+    const uint32_t widthInMbs = picture.width / 16;
+    const uint32_t mbs = std::min(widthInMbs * (picture.height / 16), slice.firstMb + count);
+    for (uint32_t mb = slice.firstMb; mb < mbs; mb++) {
+        if (!slice.intra) w.Ue(0);  // mb_skip_run
+        uint32_t x = mb % widthInMbs * 16, y = mb / widthInMbs * 16;
+        uint8_t luma[256], chroma[128];
+        for (int i = 0; i < 16; i++) {
+            memcpy(luma + i * 16, &picture.y[(y + i) * picture.width + x], 16);
+        }
+        for (int i = 0; i < 8; i++) {
+            memcpy(chroma + i * 8, &picture.cb[(y / 2 + i) * picture.width / 2 + x / 2], 8);
+            memcpy(chroma + 64 + i * 8, &picture.cr[(y / 2 + i) * picture.width / 2 + x / 2], 8);
+        }
+        ts::PcmMacroblock(w, !slice.intra, luma, chroma);
+    }
+    w.Trailing();
+    std::vector<uint8_t> stream;
+    ts::AppendNal(stream, slice.reference ? 3 : 0, slice.idr ? fm::kNalSliceIdr : fm::kNalSlice, w.bytes);
+    return stream;
+}
+
+// A P slice skipping the first `skipped` macroblocks and nothing else
+std::vector<uint8_t> SkipPicture(uint32_t frameNum, uint32_t skipped) {
+    ts::SliceParams slice;
+    slice.idr = false;
+    slice.intra = false;
+    slice.frameNum = frameNum;
+    ts::BitWriter w;
+    ts::SliceHeader(w, slice);
+    w.Ue(skipped);
+    w.Trailing();
+    std::vector<uint8_t> stream;
+    ts::AppendNal(stream, 2, fm::kNalSlice, w.bytes);
+    return stream;
+}
+
+std::vector<uint8_t> Concat(std::vector<uint8_t> a, const std::vector<uint8_t>& b) {
+    a.insert(a.end(), b.begin(), b.end());
+    return a;
+}
+
+bool Decode(fm::SoftH264Decoder& decoder, const std::vector<uint8_t>& data) {
+    return decoder.DecodeNal(data.data(), (uint32_t)data.size());
+}
+
+// Compare the decoded NV12 frame with the top-left of `expected`
+void ExpectFrame(const fm::FrameRef& frame, const Picture& expected, uint32_t width, uint32_t height) {
+    ASSERT_TRUE( frame );
+    ASSERT_EQ( frame->width, width );
+    ASSERT_EQ( frame->height, height );
+    int mismatches = 0;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            if (frame->luma[y * frame->pitch + x] != expected.y[y * expected.width + x]) mismatches++;
+        }
+    }
+    for (uint32_t y = 0; y < height / 2; y++) {
+        for (uint32_t x = 0; x < width / 2; x++) {
+            const uint8_t* pair = frame->chroma + y * frame->pitch + 2 * x;
+            if (pair[0] != expected.cb[y * expected.width / 2 + x]) mismatches++;
+            if (pair[1] != expected.cr[y * expected.width / 2 + x]) mismatches++;
+        }
+    }
+    EXPECT_EQ( mismatches, 0 );
+}
+
+
+TEST(SoftH264Decoder, DecodesPcmPictureWithCropping) {
+    fm::SoftH264Decoder decoder;
+    ASSERT_TRUE( decoder.Initialize() );
+
+    ts::SpsParams sps;
+    sps.widthInMbs = 3;
+    sps.cropRight = 8;
+    sps.cropBottom = 6;
+    Picture picture = Picture::Random(48, 32, 1);
+
+    EXPECT_TRUE( Decode(decoder, Concat(ParameterSets(sps), PcmPicture(picture))) );
+    EXPECT_EQ( decoder.GetDecodedWidth(), 40u );
+    EXPECT_EQ( decoder.GetDecodedHeight(), 26u );
+    ExpectFrame(decoder.GetDecodedFrame(), picture, 40, 26);
+    EXPECT_EQ( decoder.ConcealedMacroblocks(), 0u );
+}
+
+TEST(SoftH264Decoder, SkippedMacroblocksCopyTheReference) {
+    fm::SoftH264Decoder decoder;
+    ASSERT_TRUE( decoder.Initialize() );
+    Picture picture = Picture::Random(32, 32, 2);
+    ASSERT_TRUE( Decode(decoder, Concat(ParameterSets({}), PcmPicture(picture))) );
+    fm::FrameRef first = decoder.GetDecodedFrame();
+
+    EXPECT_TRUE( Decode(decoder, SkipPicture(1, 4)) );
+    fm::FrameRef second = decoder.GetDecodedFrame();
+    EXPECT_NE( second.Get(), first.Get() );
+    ExpectFrame(second, picture, 32, 32);
+}
+
+TEST(SoftH264Decoder, MotionVectorsMoveTheReference) {
+    fm::SoftH264Decoder decoder;
+    ASSERT_TRUE( decoder.Initialize() );
+    ts::SpsParams sps;
+    sps.widthInMbs = 3;
+    Picture picture = Picture::Random(48, 32, 3);
+    ASSERT_TRUE( Decode(decoder, Concat(ParameterSets(sps), PcmPicture(picture))) );
+
+    // P_L0_16x16 with the same vector (-4, +2) everywhere, which every
+    // macroblock but the first predicts exactly, and no residual
+    ts::SliceParams slice;
+    slice.idr = false;
+    slice.intra = false;
+    slice.frameNum = 1;
+    ts::BitWriter w;
+    ts::SliceHeader(w, slice);
+    for (int mb = 0; mb < 6; mb++) {
+        w.Ue(0);        // mb_skip_run
+        w.Ue(0);        // P_L0_16x16
+        w.Se(mb == 0 ? -16 : 0);
+        w.Se(mb == 0 ? 8 : 0);
+        w.Ue(0);        // coded_block_pattern 0
+    }
+    w.Trailing();
+    std::vector<uint8_t> stream;
+    ts::AppendNal(stream, 2, fm::kNalSlice, w.bytes);
+    EXPECT_TRUE( Decode(decoder, stream) );
+
+    // Samples outside the reference repeat its edge
+    Picture expected(48, 32);
+    for (int y = 0; y < 32; y++) {
+        for (int x = 0; x < 48; x++) {
+            expected.y[y * 48 + x] = picture.y[std::min(y + 2, 31) * 48 + std::max(x - 4, 0)];
+        }
+    }
+    for (int y = 0; y < 16; y++) {
+        for (int x = 0; x < 24; x++) {
+            int from = std::min(y + 1, 15) * 24 + std::max(x - 2, 0);
+            expected.cb[y * 24 + x] = picture.cb[from];
+            expected.cr[y * 24 + x] = picture.cr[from];
+        }
+    }
+    ExpectFrame(decoder.GetDecodedFrame(), expected, 48, 32);
+}
+
+TEST(SoftH264Decoder, DecodesIntra16x16DcLevel) {
+    fm::SoftH264Decoder decoder;
+    ASSERT_TRUE( decoder.Initialize() );
+
+    // I_16x16_2_0_0 (DC prediction, no AC), QP 28. The first macroblock
+    // has a luma DC level of 1, which comes out as +1 on every sample; the
+    // others predict from it.
+    ts::SliceParams slice;
+    slice.sliceQpDelta = 2;
+    ts::BitWriter w;
+    ts::SliceHeader(w, slice);
+    for (int mb = 0; mb < 4; mb++) {
+        w.Ue(3);        // mb_type
+        w.Ue(0);        // intra_chroma_pred_mode DC
+        w.Se(0);        // mb_qp_delta
+        if (mb == 0) {
+            w.Bits(0x1, 2); // coeff_token TrailingOnes 1, TotalCoeff 1 (0 <= nC < 2)
+            w.Bit(0);       // trailing_ones_sign_flag: +1
+            w.Bit(1);       // total_zeros 0
+        } else {
+            w.Bit(1);       // coeff_token TotalCoeff 0
+        }
+    }
+    w.Trailing();
+    std::vector<uint8_t> stream = ParameterSets({});
+    ts::AppendNal(stream, 3, fm::kNalSliceIdr, w.bytes);
+    EXPECT_TRUE( Decode(decoder, stream) );
+
+    Picture expected(32, 32);
+    std::fill(expected.y.begin(), expected.y.end(), (uint8_t)129);
+    std::fill(expected.cb.begin(), expected.cb.end(), (uint8_t)128);
+    std::fill(expected.cr.begin(), expected.cr.end(), (uint8_t)128);
+    ExpectFrame(decoder.GetDecodedFrame(), expected, 32, 32);
+}
+
+TEST(SoftH264Decoder, CrUsesTheSecondChromaQpOffset) {
+    // I_16x16_2_1_0 then I_16x16_2_0_0 (DC prediction, chroma DC only),
+    // QP 40. The first macroblock has a chroma DC level of 1 in Cb and in
+    // Cr: +5 at QPc 36 (offset 0), +2 at QPc 28 (offset -12).
+    ts::SliceParams slice;
+    slice.sliceQpDelta = 14;
+    ts::BitWriter w;
+    ts::SliceHeader(w, slice);
+    for (int mb = 0; mb < 4; mb++) {
+        w.Ue(mb == 0 ? 7 : 3);  // mb_type
+        w.Ue(0);                // intra_chroma_pred_mode DC
+        w.Se(0);                // mb_qp_delta
+        w.Bit(1);               // luma DC coeff_token TotalCoeff 0
+        if (mb == 0) {
+            for (int c = 0; c < 2; c++) {
+                w.Bit(1);       // chroma DC coeff_token TrailingOnes 1, TotalCoeff 1
+                w.Bit(0);       // trailing_ones_sign_flag: +1
+                w.Bit(1);       // total_zeros 0
+            }
+        }
+    }
+    w.Trailing();
+
+    auto decodeCbCr = [&](int32_t cbOffset, int32_t crOffset, uint8_t cb, uint8_t cr) {
+        SCOPED_TRACE(testing::Message() << "offsets " << cbOffset << ", " << crOffset);
+        fm::SoftH264Decoder decoder;
+        ASSERT_TRUE( decoder.Initialize() );
+        ts::PpsParams pps;
+        pps.chromaQpIndexOffset = cbOffset;
+        pps.extension = true;
+        pps.secondChromaQpIndexOffset = crOffset;
+        std::vector<uint8_t> stream = ParameterSets({}, pps);
+        ts::AppendNal(stream, 3, fm::kNalSliceIdr, w.bytes);
+        EXPECT_TRUE( Decode(decoder, stream) );
+
+        Picture expected(32, 32);
+        std::fill(expected.y.begin(), expected.y.end(), (uint8_t)128);
+        std::fill(expected.cb.begin(), expected.cb.end(), cb);
+        std::fill(expected.cr.begin(), expected.cr.end(), cr);
+        ExpectFrame(decoder.GetDecodedFrame(), expected, 32, 32);
+    };
+    decodeCbCr(0, 0, 133, 133);
+    decodeCbCr(0, -12, 133, 130);
+    decodeCbCr(-12, 0, 130, 133);
+}
+
+TEST(SoftH264Decoder, WaitsForAnIntraPicture) {
+    fm::SoftH264Decoder decoder;
+    ASSERT_TRUE( decoder.Initialize() );
+    EXPECT_FALSE( Decode(decoder, Concat(ParameterSets({}), SkipPicture(3, 4))) );
+    EXPECT_FALSE( decoder.GetDecodedFrame() );
+    EXPECT_NE( decoder.LastError(), nullptr );
+    EXPECT_EQ( decoder.DecodeErrors(), 1u );
+
+    Picture picture = Picture::Random(32, 32, 4);
+    EXPECT_TRUE( Decode(decoder, PcmPicture(picture)) );
+    EXPECT_TRUE( Decode(decoder, SkipPicture(1, 4)) );
+    EXPECT_EQ( decoder.DecodeErrors(), 1u );
+}
+
+TEST(SoftH264Decoder, DropsPicturesItCannotDecode) {
+    fm::SoftH264Decoder decoder;
+    ASSERT_TRUE( decoder.Initialize() );
+    ts::PpsParams pps;
+    pps.cabac = true;
+    Picture picture = Picture::Random(32, 32, 5);
+    EXPECT_FALSE( Decode(decoder, Concat(ParameterSets({}, pps), PcmPicture(picture))) );
+    ASSERT_NE( decoder.LastError(), nullptr );
+    EXPECT_STREQ( decoder.LastError(), "CABAC" );
+
+    ts::SpsParams interlaced;
+    interlaced.frameMbsOnly = false;
+    EXPECT_FALSE( Decode(decoder, Concat(ParameterSets(interlaced), PcmPicture(picture))) );
+    EXPECT_STREQ( decoder.LastError(), "interlaced coding" );
+    EXPECT_EQ( decoder.DecodeErrors(), 2u );
+}
+
+TEST(SoftH264Decoder, ConcealsMissingMacroblocksFromThePreviousPicture) {
+    fm::SoftH264Decoder decoder;
+    ASSERT_TRUE( decoder.Initialize() );
+    Picture first = Picture::Random(32, 32, 6);
+    ASSERT_TRUE( Decode(decoder, Concat(ParameterSets({}), PcmPicture(first))) );
+
+    // Of the second picture, only the slice with macroblocks 0 and 1 arrives
+    Picture second = Picture::Random(32, 32, 7);
+    ts::SliceParams slice;
+    slice.idr = false;
+    slice.intra = false;
+    slice.frameNum = 1;
+    EXPECT_TRUE( Decode(decoder, PcmPicture(second, slice, 2)) );
+    EXPECT_EQ( decoder.ConcealedMacroblocks(), 2u );
+    EXPECT_EQ( decoder.DecodeErrors(), 1u );
+
+    Picture expected = first;
+    std::copy(second.y.begin(), second.y.begin() + 32 * 16, expected.y.begin());
+    std::copy(second.cb.begin(), second.cb.begin() + 16 * 8, expected.cb.begin());
+    std::copy(second.cr.begin(), second.cr.begin() + 16 * 8, expected.cr.begin());
+    ExpectFrame(decoder.GetDecodedFrame(), expected, 32, 32);
+}
+
+TEST(SoftH264Decoder, FollowsSizeChanges) {
+    fm::SoftH264Decoder decoder;
+    ASSERT_TRUE( decoder.Initialize() );
+    Picture small = Picture::Random(32, 32, 8);
+    ASSERT_TRUE( Decode(decoder, Concat(ParameterSets({}), PcmPicture(small))) );
+
+    ts::SpsParams sps;
+    sps.widthInMbs = 4;
+    sps.heightInMbs = 3;
+    Picture large = Picture::Random(64, 48, 9);
+    ts::SliceParams slice;
+    slice.idrPicId = 1;
+    EXPECT_TRUE( Decode(decoder, Concat(ParameterSets(sps), PcmPicture(large, slice))) );
+    ExpectFrame(decoder.GetDecodedFrame(), large, 64, 48);
+}
+
+TEST(SoftH264Decoder, ReusesPicturesOnceTheyAreReleased) {
+    fm::SoftH264Decoder decoder;
+    ASSERT_TRUE( decoder.Initialize() );
+    Picture picture = Picture::Random(32, 32, 10);
+    ASSERT_TRUE( Decode(decoder, Concat(ParameterSets({}), PcmPicture(picture))) );
+
+    // A consumer holding the latest frame until the next one, like the
+    // frame handoff
+    fm::FrameRef held;
+    uint64_t allocations = 0;
+    for (uint32_t i = 1; i < 40; i++) {
+        ASSERT_TRUE( Decode(decoder, SkipPicture(i % 16, 4)) );
+        held = decoder.GetDecodedFrame();
+        if (i == 8) {
+            allocations = decoder.GetOutputAllocations() + decoder.GetInputAllocations();
+        }
+    }
+    EXPECT_EQ( decoder.GetOutputAllocations() + decoder.GetInputAllocations(), allocations );
+    EXPECT_LE( decoder.GetOutputAllocations(), 4u );
+    ExpectFrame(held, picture, 32, 32);
+}
+
+TEST(SoftH264Decoder, PreparedDecoderAllocatesNoPictures) {
+    fm::SoftH264Decoder decoder;
+    ASSERT_TRUE( decoder.Initialize() );
+    ts::SpsParams params;
+    params.maxNumRefFrames = 2;
+    std::vector<uint8_t> stream = Concat(ParameterSets(params), PcmPicture(Picture::Random(32, 32, 12)));
+    fm::H264Sps sps;
+    ASSERT_TRUE( fm::FindSps(stream.data(), stream.size(), sps) );
+    decoder.Prepare(sps);
+    const uint64_t allocations = decoder.GetOutputAllocations();
+    EXPECT_EQ( allocations, 4u );
+
+    ASSERT_TRUE( Decode(decoder, stream) );
+    fm::FrameRef held;
+    for (uint32_t i = 1; i < 20; i++) {
+        ASSERT_TRUE( Decode(decoder, SkipPicture(i % 16, 4)) );
+        held = decoder.GetDecodedFrame();
+    }
+    EXPECT_EQ( decoder.GetOutputAllocations(), allocations );
+}
+
+TEST(SoftH264Decoder, SurvivesDamagedSlices) {
+    fm::SoftH264Decoder decoder;
+    ASSERT_TRUE( decoder.Initialize() );
+    Picture picture = Picture::Random(48, 48, 11);
+    ts::SpsParams sps;
+    sps.widthInMbs = 3;
+    sps.heightInMbs = 3;
+    ASSERT_TRUE( Decode(decoder, Concat(ParameterSets(sps), PcmPicture(picture))) );
+
+    // Random bits after a valid P slice header: whatever they decode to,
+    // each picture comes out whole
+    std::mt19937 random(12);
+    for (uint32_t i = 1; i < 300; i++) {
+        ts::SliceParams slice;
+        slice.idr = false;
+        slice.intra = false;
+        slice.frameNum = i % 16;
+        ts::BitWriter w;
+        ts::SliceHeader(w, slice);
+        size_t length = random() % 64;
+        for (size_t n = 0; n < length; n++) {
+            w.Bits(random() & 0xFF, 8);
+        }
+        w.Trailing();
+        std::vector<uint8_t> stream;
+        ts::AppendNal(stream, 2, fm::kNalSlice, w.bytes);
+        EXPECT_TRUE( Decode(decoder, stream) );
+        fm::FrameRef frame = decoder.GetDecodedFrame();
+        ASSERT_TRUE( frame );
+        EXPECT_EQ( frame->width, 48u );
+    }
+}
+
+} // namespace SoftH264DecoderTest
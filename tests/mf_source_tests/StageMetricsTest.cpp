@@ -0,0 +1,39 @@
+#include <mf_source/StageMetrics.h>
+#include <gtest/gtest.h>
+
+
+namespace StageMetricsTest {
+namespace fm = FluxMic;
+
+
+TEST(StageMetrics, StartsEmpty) {
+    fm::StageMetrics metrics;
+    auto summary = metrics.Get();
+    EXPECT_EQ( summary.count, 0u );
+    EXPECT_EQ( summary.averageUs, 0u );
+    EXPECT_EQ( summary.maxUs, 0u );
+}
+
+TEST(StageMetrics, Summary) {
+    fm::StageMetrics metrics;
+    metrics.Record(100);
+    metrics.Record(700);
+    metrics.Record(400);
+    auto summary = metrics.Get();
+    EXPECT_EQ( summary.count, 3u );
+    EXPECT_EQ( summary.averageUs, 400u );
+    EXPECT_EQ( summary.maxUs, 700u );
+    EXPECT_EQ( summary.lastUs, 400u );
+}
+
+TEST(StageMetrics, Reset) {
+    fm::StageMetrics metrics;
+    metrics.Record(1000);
+    metrics.Reset();
+    metrics.Record(10);
+    auto summary = metrics.Get();
+    EXPECT_EQ( summary.count, 1u );
+    EXPECT_EQ( summary.maxUs, 10u );
+}
+
+} //namespace StageMetricsTest
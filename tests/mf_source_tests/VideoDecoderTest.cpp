@@ -0,0 +1,52 @@
+#include <mf_source/SoftH264Decoder.h>
+#include <mf_source/VideoDecoder.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+
+
+namespace VideoDecoderTest {
+namespace fm = FluxMic;
+
+
+TEST(DecoderBackend, ParsesNamesInAnyCase) {
+    EXPECT_EQ( fm::ParseDecoderBackend("mf"), fm::DecoderBackend::MediaFoundation );
+    EXPECT_EQ( fm::ParseDecoderBackend("MediaFoundation"), fm::DecoderBackend::MediaFoundation );
+    EXPECT_EQ( fm::ParseDecoderBackend("Software"), fm::DecoderBackend::Software );
+    EXPECT_EQ( fm::ParseDecoderBackend("SW"), fm::DecoderBackend::Software );
+    EXPECT_EQ( fm::ParseDecoderBackend("auto"), fm::DecoderBackend::Auto );
+}
+
+TEST(DecoderBackend, FallsBackToAuto) {
+    EXPECT_EQ( fm::ParseDecoderBackend(nullptr), fm::DecoderBackend::Auto );
+    EXPECT_EQ( fm::ParseDecoderBackend(""), fm::DecoderBackend::Auto );
+    EXPECT_EQ( fm::ParseDecoderBackend("softwarex"), fm::DecoderBackend::Auto );
+}
+
+TEST(DecoderBackend, NamesParseBack) {
+    for (fm::DecoderBackend backend : { fm::DecoderBackend::Auto, fm::DecoderBackend::MediaFoundation,
+                                        fm::DecoderBackend::Software }) {
+        EXPECT_EQ( fm::ParseDecoderBackend(fm::DecoderBackendName(backend)), backend );
+    }
+}
+
+TEST(IVideoDecoder, SoftwareDecoderLifecycle) {
+    std::unique_ptr<fm::IVideoDecoder> decoder(new fm::SoftH264Decoder());
+    EXPECT_STREQ( decoder->Name(), "software" );
+    EXPECT_FALSE( decoder->IsInitialized() );
+
+    const uint8_t garbage[] = { 0, 0, 1, 0x65, 0xFF, 0xFF };
+    EXPECT_FALSE( decoder->DecodeNal(garbage, sizeof(garbage)) );
+
+    ASSERT_TRUE( decoder->Initialize() );
+    EXPECT_TRUE( decoder->IsInitialized() );
+    EXPECT_FALSE( decoder->DecodeNal(garbage, sizeof(garbage)) );
+    EXPECT_FALSE( decoder->GetDecodedFrame() );
+    EXPECT_EQ( decoder->GetDecodedWidth(), 0u );
+
+    decoder->Shutdown();
+    EXPECT_FALSE( decoder->IsInitialized() );
+    EXPECT_TRUE( decoder->Initialize() );
+}
+
+} // namespace VideoDecoderTest